@@ -43,8 +43,11 @@
 #include "button.h"
 #include "led.h"
 #include "lorawan.h"
+#include "lorawan_downlink_ring.h"
 
+#include "energy_cli.h"
 #include "gpio_cli.h"
+#include "sys_cli.h"
 
 #include "application_task.h"
 #include "application_task_cli.h"
@@ -63,7 +66,10 @@
 
 #define APPLICATION_DEFAULT_LORAWAN_CLASS LORAWAN_CLASS_A
 #define APPLICATION_QUEUE_MAX_SIZE        (10)
-#define APPLICATION_RX_BUFFER_MAX_SIZE    (256)
+
+// Downlinks received before the application task gets to them, class C
+// downlinks can arrive back to back.  Must be a power of two.
+#define APPLICATION_RX_SLOTS              (4)
 
 #define LORAWAN_PM_ENABLE   1
 
@@ -73,20 +79,8 @@ typedef enum
     APP_MSG_BUTTON_PRESSED,
 } application_message_t;
 
-typedef struct
-{
-    uint32_t counter;
-    uint32_t port;
-    int32_t slot;
-    int32_t dr;
-    int32_t rssi;
-    int32_t snr;
-    uint32_t size;
-    uint8_t *payload;
-} application_rx_packet_t;
-
-static uint8_t application_rx_buffer[APPLICATION_RX_BUFFER_MAX_SIZE];
-static application_rx_packet_t application_rx_packet;
+static lorawan_downlink_t application_rx_slots[APPLICATION_RX_SLOTS];
+static lorawan_downlink_ring_t application_rx_ring;
 static volatile uint32_t lorawan_joining;
 
 static TaskHandle_t application_task_handle;
@@ -98,22 +92,22 @@ static void on_lorawan_join_request(LmHandlerJoinParams_t *params)
     // Reset the joining flag.  It will be set
     // in the MLME Request callback.
     lorawan_joining = 0;
+
+    // Failed joins are retried by the LoRaWAN task.
     if (params->Status == LORAMAC_HANDLER_ERROR)
     {
-        lorawan_join();
-    }
-    else
-    {
-        lorawan_class_set(APPLICATION_DEFAULT_LORAWAN_CLASS);
-        lorawan_request_time_sync();
-
-        led_command_t command = {
-            .ui32Handle = application_led_handle,
-            .ui32Id = LED_EFFECT_PULSE2,
-            .ui32Repeat = 1
-        };
-        led_send(&command);
+        return;
     }
+
+    lorawan_class_set(APPLICATION_DEFAULT_LORAWAN_CLASS);
+    lorawan_request_time_sync();
+
+    led_command_t command = {
+        .ui32Handle = application_led_handle,
+        .ui32Id = LED_EFFECT_PULSE2,
+        .ui32Repeat = 1
+    };
+    led_send(&command);
 }
 
 static void on_lorawan_receive(LmHandlerAppData_t *data, LmHandlerRxParams_t *params)
@@ -132,20 +126,21 @@ static void on_lorawan_receive(LmHandlerAppData_t *data, LmHandlerRxParams_t *pa
         return;
     }
 
-    application_rx_packet.counter = params->DownlinkCounter;
-    application_rx_packet.port = data->Port;
-    application_rx_packet.slot = params->RxSlot;
-    application_rx_packet.dr = params->Datarate;
-    application_rx_packet.rssi = params->Rssi;
-    application_rx_packet.snr = params->Snr;
-    application_rx_packet.size = data->BufferSize;
-    application_rx_packet.payload = application_rx_buffer;
-    memcpy(application_rx_buffer, data->Buffer, data->BufferSize);
+    // The payload is copied once, into a slot that the application task
+    // owns until it releases it.  A full ring drops the downlink and
+    // counts an overflow.
+    if (!lorawan_downlink_ring_push(&application_rx_ring, data, params))
+    {
+        return;
+    }
 
     // This is executed within the LoRaWAN transport layer context,
-    // do not block.  In this example, we timeout in 100ms if the queue is full.
+    // do not block, waiting here delays the receive windows.  The
+    // application task drains every slot on each message, so a message
+    // lost to a full queue only delays the downlink until the next one.
+    // Subscribe through lorawan_event_subscribe for work that may block.
     msg = APP_MSG_RX;
-    xQueueSend(application_queue_handle, &msg, pdMS_TO_TICKS(100));
+    xQueueSend(application_queue_handle, &msg, 0);
 }
 
 static void on_lorawan_mlme_request(LoRaMacStatus_t status, MlmeReq_t *mlme, TimerTime_t delay)
@@ -181,6 +176,10 @@ static void on_lorawan_sleep(void)
     if (!lorawan_joining)
     {
         am_hal_gpio_state_write(AM_BSP_GPIO_PETAL_CORE_nLORA_EN, AM_HAL_GPIO_OUTPUT_SET);
+
+        // The radio registers are lost when the supply is removed,
+        // let the stack know so they are restored on wake.
+        lorawan_radio_power_lost();
     }
 #endif
 }
@@ -204,24 +203,24 @@ static void on_led_ctimer(void)
     led_interrupt_service(application_led_handle);
 }
 
-static void process_downlink_packet(void)
+static void process_downlink_packet(lorawan_downlink_t *packet)
 {
     am_util_stdio_printf("\n\rReceived Data\n\r");
-    am_util_stdio_printf("  COUNTER   : %-4d\n\r", application_rx_packet.counter);
-    am_util_stdio_printf("  PORT      : %-4d\n\r", application_rx_packet.port);
-    am_util_stdio_printf("  SLOT      : %-4d\n\r", application_rx_packet.slot);
-    am_util_stdio_printf("  DATA RATE : %-4d\n\r", application_rx_packet.dr);
-    am_util_stdio_printf("  RSSI      : %-4d\n\r", application_rx_packet.rssi);
-    am_util_stdio_printf("  SNR       : %-4d\n\r", application_rx_packet.snr);
-    am_util_stdio_printf("  SIZE      : %-4d\n\r", application_rx_packet.size);
+    am_util_stdio_printf("  COUNTER   : %-4d\n\r", packet->ui32Counter);
+    am_util_stdio_printf("  PORT      : %-4d\n\r", packet->ui32Port);
+    am_util_stdio_printf("  SLOT      : %-4d\n\r", packet->i32Slot);
+    am_util_stdio_printf("  DATA RATE : %-4d\n\r", packet->i32Datarate);
+    am_util_stdio_printf("  RSSI      : %-4d\n\r", packet->i32Rssi);
+    am_util_stdio_printf("  SNR       : %-4d\n\r", packet->i32Snr);
+    am_util_stdio_printf("  SIZE      : %-4d\n\r", packet->ui32Size);
     am_util_stdio_printf("  PAYLOAD   :");
-    for (int i = 0; i < application_rx_packet.size; i++)
+    for (int i = 0; i < packet->ui32Size; i++)
     {
         if ((i % 8) == 0)
         {
             am_util_stdio_printf("\n\r    ");
         }
-        am_util_stdio_printf("%02x ", application_rx_packet.payload[i]);
+        am_util_stdio_printf("%02x ", packet->pui8Payload[i]);
     }
     am_util_stdio_printf("\n\r");
 
@@ -279,6 +278,7 @@ static void setup_led(void)
 static void setup_lorawan(void)
 {
     lorawan_joining = 0;
+    lorawan_downlink_ring_init(&application_rx_ring, application_rx_slots, APPLICATION_RX_SLOTS);
     lorawan_tracing_set(1);
 
     lorawan_network_config(LORAWAN_REGION_US915, LORAWAN_DATARATE_0, true, true);
@@ -367,8 +367,15 @@ static void application_task_loop(void)
         switch (msg)
         {
         case APP_MSG_RX:
-            process_downlink_packet();
+        {
+            lorawan_downlink_t *packet;
+            while ((packet = lorawan_downlink_ring_peek(&application_rx_ring)) != NULL)
+            {
+                process_downlink_packet(packet);
+                lorawan_downlink_ring_release(&application_rx_ring);
+            }
             break;
+        }
 
         case APP_MSG_BUTTON_PRESSED:
             process_button_press();
@@ -389,6 +396,8 @@ static void application_task(void *parameter)
 {
 #if defined(CLI_ENABLE)
     gpio_cli_register();
+    energy_cli_register();
+    sys_cli_register();
     application_task_cli_register();
 #endif
     application_task_setup();
@@ -404,3 +413,13 @@ void application_task_create(uint32_t priority)
         xQueueCreate(APPLICATION_QUEUE_MAX_SIZE, sizeof(application_message_t));
     xTaskCreate(application_task, "application", 512, 0, priority, &application_task_handle);
 }
+
+void application_rx_stats_get(lorawan_downlink_ring_stats_t *stats)
+{
+    lorawan_downlink_ring_stats_get(&application_rx_ring, stats);
+}
+
+void application_rx_stats_reset()
+{
+    lorawan_downlink_ring_stats_reset(&application_rx_ring);
+}
@@ -32,12 +32,17 @@
 #ifndef _APPLICATION_TASK_H_
 #define _APPLICATION_TASK_H_
 
+#include "lorawan_downlink_ring.h"
+
 #ifdef __cplusplus
 extern "C" {
 #endif
 
 extern void application_task_create(uint32_t priority);
 
+extern void application_rx_stats_get(lorawan_downlink_ring_stats_t *stats);
+extern void application_rx_stats_reset();
+
 #ifdef __cplusplus
 }
 #endif
@@ -41,6 +41,7 @@
 #include "nm_app_version.h"
 #include "nm_sdk_version.h"
 
+#include "application_task.h"
 #include "application_task_cli.h"
 
 #define COMMAND_LINE_BUFFER_MAX     (128)
@@ -72,6 +73,7 @@ static void help(char *pui8OutBuffer, size_t argc, char **argv)
     am_util_stdio_printf("supported commands are:\r\n");
     am_util_stdio_printf("  help     display help message\r\n");
     am_util_stdio_printf("  reset    perform a soft reset\r\n");
+    am_util_stdio_printf("  rx       [reset] downlink ring statistics\r\n");
     am_util_stdio_printf("  version  output version information\r\n\r\n");
 }
 
@@ -81,6 +83,23 @@ static void version(char *pui8OutBuffer, size_t argc, char **argv)
     am_util_stdio_printf("Application template version %s\r\n", nm_app_version);
 }
 
+static void rx(char *pui8OutBuffer, size_t argc, char **argv)
+{
+    if ((argc == 3) && (strcmp(argv[2], "reset") == 0))
+    {
+        application_rx_stats_reset();
+        return;
+    }
+
+    lorawan_downlink_ring_stats_t stats;
+    application_rx_stats_get(&stats);
+    am_util_stdio_printf("\r\nDownlinks Received : %u\r\n", stats.ui32Received);
+    am_util_stdio_printf("Downlinks Consumed : %u\r\n", stats.ui32Consumed);
+    am_util_stdio_printf("Ring Overflows     : %u\r\n", stats.ui32Overflows);
+    am_util_stdio_printf("Oversize Dropped   : %u\r\n", stats.ui32Oversize);
+    am_util_stdio_printf("Slots High Water   : %u\r\n", stats.ui32HighWater);
+}
+
 portBASE_TYPE
 application_task_cli_entry(char *pui8OutBuffer, size_t ui32OutBufferLength, const char *pui8Command)
 {
@@ -98,6 +117,10 @@ application_task_cli_entry(char *pui8OutBuffer, size_t ui32OutBufferLength, cons
     {
         NVIC_SystemReset();
     }
+    else if (strcmp(argv[1], "rx") == 0)
+    {
+        rx(pui8OutBuffer, argc, argv);
+    }
     else if (strcmp(argv[1], "version") == 0)
     {
         version(pui8OutBuffer, argc, argv);
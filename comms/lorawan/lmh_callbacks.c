@@ -29,6 +29,8 @@
  * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
  * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
  */
+#include <string.h>
+
 #include <am_mcu_apollo.h>
 #include <am_util.h>
 
@@ -37,16 +39,19 @@
 #include "lorawan_config.h"
 
 #include "lorawan.h"
+#include "lorawan_event_bus.h"
+#include "lorawan_instance.h"
+#include "lorawan_latency.h"
+#include "lorawan_port.h"
 #include "lorawan_task.h"
-
-lorawan_event_callback_t lorawan_event_callback_list[LORAWAN_EVENTS];
+#include "lorawan_trace.h"
 
 static void on_mac_process(void)
 {
-    lorawan_task_wake();
+    lorawan_task_wake(LORAWAN_WAKE_MAC);
 
     typedef void (*callback_t)(void);
-    callback_t callback = (callback_t)lorawan_event_callback_list[LORAWAN_EVENT_MAC_PROCESS];
+    callback_t callback = (callback_t)lorawan_event_callback(LORAWAN_EVENT_MAC_PROCESS);
     if (callback)
     {
         callback();
@@ -55,14 +60,26 @@ static void on_mac_process(void)
 
 static void on_nvm_data_change(LmHandlerNvmContextStates_t sState, uint16_t ui16Size)
 {
-    if (lorawan_tracing_enabled)
+    if (lorawan_tracing_enabled == LORAWAN_TRACING_BINARY)
+    {
+        lorawan_trace_nvm_data_change(sState, ui16Size);
+    }
+    else if (lorawan_tracing_enabled)
     {
         am_util_stdio_printf("\r\n");
         DisplayNvmDataChange(sState, ui16Size);
     }
 
+    lorawan_bus_event_t *psEvent = lorawan_event_bus_reserve(LORAWAN_EVENT_NVM_DATA_CHANGE);
+    if (psEvent)
+    {
+        psEvent->uData.sNvm.eState = sState;
+        psEvent->uData.sNvm.ui16Size = ui16Size;
+        lorawan_event_bus_commit();
+    }
+
     typedef void (*callback_t)(LmHandlerNvmContextStates_t, uint16_t);
-    callback_t callback = (callback_t)lorawan_event_callback_list[LORAWAN_EVENT_NVM_DATA_CHANGE];
+    callback_t callback = (callback_t)lorawan_event_callback(LORAWAN_EVENT_NVM_DATA_CHANGE);
     if (callback)
     {
         callback(sState, ui16Size);
@@ -71,14 +88,26 @@ static void on_nvm_data_change(LmHandlerNvmContextStates_t sState, uint16_t ui16
 
 static void on_network_parameters_change(CommissioningParams_t *psParams)
 {
-    if (lorawan_tracing_enabled)
+    if (lorawan_tracing_enabled == LORAWAN_TRACING_BINARY)
+    {
+        lorawan_trace_network_parameters(psParams);
+    }
+    else if (lorawan_tracing_enabled)
     {
         am_util_stdio_printf("\r\n");
         DisplayNetworkParametersUpdate(psParams);
     }
 
+    lorawan_bus_event_t *psEvent =
+        lorawan_event_bus_reserve(LORAWAN_EVENT_NETWORK_PARAMETERS_CHANGE);
+    if (psEvent)
+    {
+        psEvent->uData.sNetwork = *psParams;
+        lorawan_event_bus_commit();
+    }
+
     typedef void (*callback_t)(CommissioningParams_t *);
-    callback_t callback = (callback_t)lorawan_event_callback_list[LORAWAN_EVENT_NETWORK_PARAMETERS_CHANGE];
+    callback_t callback = (callback_t)lorawan_event_callback(LORAWAN_EVENT_NETWORK_PARAMETERS_CHANGE);
     if (callback)
     {
         callback(psParams);
@@ -88,14 +117,27 @@ static void on_network_parameters_change(CommissioningParams_t *psParams)
 static void
 on_mac_mcps_request(LoRaMacStatus_t eStatus, McpsReq_t *psMcpsReq, TimerTime_t ui32NextTxDelay)
 {
-    if (lorawan_tracing_enabled)
+    if (lorawan_tracing_enabled == LORAWAN_TRACING_BINARY)
+    {
+        lorawan_trace_mcps_request(eStatus, psMcpsReq, ui32NextTxDelay);
+    }
+    else if (lorawan_tracing_enabled)
     {
         am_util_stdio_printf("\r\n");
         DisplayMacMcpsRequestUpdate(eStatus, psMcpsReq, ui32NextTxDelay);
     }
 
+    lorawan_bus_event_t *psEvent = lorawan_event_bus_reserve(LORAWAN_EVENT_MAC_MCPS_REQUEST);
+    if (psEvent)
+    {
+        psEvent->uData.sMcps.eStatus = eStatus;
+        psEvent->uData.sMcps.sRequest = *psMcpsReq;
+        psEvent->uData.sMcps.ui32NextTxDelay = ui32NextTxDelay;
+        lorawan_event_bus_commit();
+    }
+
     typedef void (*callback_t)(LoRaMacStatus_t, McpsReq_t *, TimerTime_t);
-    callback_t callback = (callback_t)lorawan_event_callback_list[LORAWAN_EVENT_MAC_MCPS_REQUEST];
+    callback_t callback = (callback_t)lorawan_event_callback(LORAWAN_EVENT_MAC_MCPS_REQUEST);
     if (callback)
     {
         callback(eStatus, psMcpsReq, ui32NextTxDelay);
@@ -105,14 +147,32 @@ on_mac_mcps_request(LoRaMacStatus_t eStatus, McpsReq_t *psMcpsReq, TimerTime_t u
 static void
 on_mac_mlme_request(LoRaMacStatus_t eStatus, MlmeReq_t *psMlmeReq, TimerTime_t ui32NextTxDelay)
 {
-    if (lorawan_tracing_enabled)
+    if (psMlmeReq->Type == MLME_JOIN)
+    {
+        lorawan_join_request_status(eStatus, ui32NextTxDelay);
+    }
+
+    if (lorawan_tracing_enabled == LORAWAN_TRACING_BINARY)
+    {
+        lorawan_trace_mlme_request(eStatus, psMlmeReq, ui32NextTxDelay);
+    }
+    else if (lorawan_tracing_enabled)
     {
         am_util_stdio_printf("\r\n");
         DisplayMacMlmeRequestUpdate(eStatus, psMlmeReq, ui32NextTxDelay);
     }
 
+    lorawan_bus_event_t *psEvent = lorawan_event_bus_reserve(LORAWAN_EVENT_MAC_MLME_REQUEST);
+    if (psEvent)
+    {
+        psEvent->uData.sMlme.eStatus = eStatus;
+        psEvent->uData.sMlme.sRequest = *psMlmeReq;
+        psEvent->uData.sMlme.ui32NextTxDelay = ui32NextTxDelay;
+        lorawan_event_bus_commit();
+    }
+
     typedef void (*callback_t)(LoRaMacStatus_t, MlmeReq_t *, TimerTime_t);
-    callback_t callback = (callback_t)lorawan_event_callback_list[LORAWAN_EVENT_MAC_MLME_REQUEST];
+    callback_t callback = (callback_t)lorawan_event_callback(LORAWAN_EVENT_MAC_MLME_REQUEST);
     if (callback)
     {
         callback(eStatus, psMlmeReq, ui32NextTxDelay);
@@ -121,14 +181,27 @@ on_mac_mlme_request(LoRaMacStatus_t eStatus, MlmeReq_t *psMlmeReq, TimerTime_t u
 
 static void on_join_request(LmHandlerJoinParams_t *psParams)
 {
-    if (lorawan_tracing_enabled)
+    lorawan_join_result(psParams);
+
+    if (lorawan_tracing_enabled == LORAWAN_TRACING_BINARY)
+    {
+        lorawan_trace_join(psParams);
+    }
+    else if (lorawan_tracing_enabled)
     {
         am_util_stdio_printf("\r\n");
         DisplayJoinRequestUpdate(psParams);
     }
 
+    lorawan_bus_event_t *psEvent = lorawan_event_bus_reserve(LORAWAN_EVENT_JOIN_REQUEST);
+    if (psEvent)
+    {
+        psEvent->uData.sJoin = *psParams;
+        lorawan_event_bus_commit();
+    }
+
     typedef void (*callback_t)(LmHandlerJoinParams_t *);
-    callback_t callback = (callback_t)lorawan_event_callback_list[LORAWAN_EVENT_JOIN_REQUEST];
+    callback_t callback = (callback_t)lorawan_event_callback(LORAWAN_EVENT_JOIN_REQUEST);
     if (callback)
     {
         callback(psParams);
@@ -137,14 +210,32 @@ static void on_join_request(LmHandlerJoinParams_t *psParams)
 
 static void on_tx_data(LmHandlerTxParams_t *psParams)
 {
-    if (lorawan_tracing_enabled)
+    lorawan_boot_mark(LORAWAN_BOOT_CONFIRM);
+
+    if (psParams->IsMcpsConfirm)
+    {
+        lorawan_latency_confirm();
+    }
+
+    if (lorawan_tracing_enabled == LORAWAN_TRACING_BINARY)
+    {
+        lorawan_trace_tx(psParams);
+    }
+    else if (lorawan_tracing_enabled)
     {
         am_util_stdio_printf("\r\n");
         DisplayTxUpdate(psParams);
     }
 
+    lorawan_bus_event_t *psEvent = lorawan_event_bus_reserve(LORAWAN_EVENT_TX_DATA);
+    if (psEvent)
+    {
+        psEvent->uData.sTx = *psParams;
+        lorawan_event_bus_commit();
+    }
+
     typedef void (*callback_t)(LmHandlerTxParams_t *);
-    callback_t callback = (callback_t)lorawan_event_callback_list[LORAWAN_EVENT_TX_DATA];
+    callback_t callback = (callback_t)lorawan_event_callback(LORAWAN_EVENT_TX_DATA);
     if (callback)
     {
         callback(psParams);
@@ -153,14 +244,46 @@ static void on_tx_data(LmHandlerTxParams_t *psParams)
 
 static void on_rx_data(LmHandlerAppData_t *psAppData, LmHandlerRxParams_t *psParams)
 {
-    if (lorawan_tracing_enabled)
+    if (lorawan_tracing_enabled == LORAWAN_TRACING_BINARY)
+    {
+        lorawan_trace_rx(psAppData, psParams);
+    }
+    else if (lorawan_tracing_enabled)
     {
         am_util_stdio_printf("\r\n");
         DisplayRxUpdate(psAppData, psParams);
     }
 
+    // Bus subscribers see every downlink, including the ones taken by a
+    // port handler below.
+    lorawan_bus_event_t *psEvent = lorawan_event_bus_reserve(LORAWAN_EVENT_RX_DATA);
+    if (psEvent)
+    {
+        uint32_t ui32Size = psAppData ? psAppData->BufferSize : 0;
+        if (ui32Size > LORAWAN_EVENT_BUS_PAYLOAD_MAX)
+        {
+            ui32Size = LORAWAN_EVENT_BUS_PAYLOAD_MAX;
+        }
+        psEvent->uData.sRx.sParams = *psParams;
+        psEvent->uData.sRx.ui8Port = psAppData ? psAppData->Port : 0;
+        psEvent->uData.sRx.ui8Size = psAppData ? psAppData->BufferSize : 0;
+        psEvent->uData.sRx.ui8Truncated = psEvent->uData.sRx.ui8Size > ui32Size;
+        if (ui32Size)
+        {
+            memcpy(psEvent->uData.sRx.pui8Payload, psAppData->Buffer, ui32Size);
+        }
+        lorawan_event_bus_commit();
+    }
+
+    // Ports with a registered handler are delivered through the dispatch
+    // table, everything else still goes to the event callback.
+    if (lorawan_port_dispatch(psAppData, psParams))
+    {
+        return;
+    }
+
     typedef void (*callback_t)(LmHandlerAppData_t *, LmHandlerRxParams_t *);
-    callback_t callback = (callback_t)lorawan_event_callback_list[LORAWAN_EVENT_RX_DATA];
+    callback_t callback = (callback_t)lorawan_event_callback(LORAWAN_EVENT_RX_DATA);
     if (callback)
     {
         callback(psAppData, psParams);
@@ -169,13 +292,24 @@ static void on_rx_data(LmHandlerAppData_t *psAppData, LmHandlerRxParams_t *psPar
 
 static void on_class_change(DeviceClass_t eDeviceClass)
 {
-    if (lorawan_tracing_enabled)
+    if (lorawan_tracing_enabled == LORAWAN_TRACING_BINARY)
+    {
+        lorawan_trace_class(eDeviceClass);
+    }
+    else if (lorawan_tracing_enabled)
     {
         DisplayClassUpdate(eDeviceClass);
     }
 
+    lorawan_bus_event_t *psEvent = lorawan_event_bus_reserve(LORAWAN_EVENT_CLASS_CHANGE);
+    if (psEvent)
+    {
+        psEvent->uData.eClass = eDeviceClass;
+        lorawan_event_bus_commit();
+    }
+
     typedef void (*callback_t)(DeviceClass_t);
-    callback_t callback = (callback_t)lorawan_event_callback_list[LORAWAN_EVENT_CLASS_CHANGE];
+    callback_t callback = (callback_t)lorawan_event_callback(LORAWAN_EVENT_CLASS_CHANGE);
     if (callback)
     {
         callback(eDeviceClass);
@@ -184,13 +318,24 @@ static void on_class_change(DeviceClass_t eDeviceClass)
 
 static void on_beacon_status_change(LoRaMacHandlerBeaconParams_t *psParams)
 {
-    if (lorawan_tracing_enabled)
+    if (lorawan_tracing_enabled == LORAWAN_TRACING_BINARY)
+    {
+        lorawan_trace_beacon(psParams);
+    }
+    else if (lorawan_tracing_enabled)
     {
         DisplayBeaconUpdate(psParams);
     }
 
+    lorawan_bus_event_t *psEvent = lorawan_event_bus_reserve(LORAWAN_EVENT_BEACON_STATUS_CHANGE);
+    if (psEvent)
+    {
+        psEvent->uData.sBeacon = *psParams;
+        lorawan_event_bus_commit();
+    }
+
     typedef void (*callback_t)(LoRaMacHandlerBeaconParams_t *);
-    callback_t callback = (callback_t)lorawan_event_callback_list[LORAWAN_EVENT_BEACON_STATUS_CHANGE];
+    callback_t callback = (callback_t)lorawan_event_callback(LORAWAN_EVENT_BEACON_STATUS_CHANGE);
     if (callback)
     {
         callback(psParams);
@@ -199,7 +344,11 @@ static void on_beacon_status_change(LoRaMacHandlerBeaconParams_t *psParams)
 
 static void on_sys_time_update(bool bSynchronized, int32_t ui32TimeCorrection)
 {
-    if (lorawan_tracing_enabled)
+    if (lorawan_tracing_enabled == LORAWAN_TRACING_BINARY)
+    {
+        lorawan_trace_time(bSynchronized, ui32TimeCorrection);
+    }
+    else if (lorawan_tracing_enabled)
     {
         am_util_stdio_printf("\r\n");
         am_util_stdio_printf("Clock Synchronized: %d\r\n", bSynchronized);
@@ -207,8 +356,16 @@ static void on_sys_time_update(bool bSynchronized, int32_t ui32TimeCorrection)
         am_util_stdio_printf("\r\n");
     }
 
+    lorawan_bus_event_t *psEvent = lorawan_event_bus_reserve(LORAWAN_EVENT_SYS_TIME_UPDATE);
+    if (psEvent)
+    {
+        psEvent->uData.sTime.bSynchronized = bSynchronized;
+        psEvent->uData.sTime.i32Correction = ui32TimeCorrection;
+        lorawan_event_bus_commit();
+    }
+
     typedef void (*callback_t)(bool, int32_t);
-    callback_t callback = (callback_t)lorawan_event_callback_list[LORAWAN_EVENT_SYS_TIME_UPDATE];
+    callback_t callback = (callback_t)lorawan_event_callback(LORAWAN_EVENT_SYS_TIME_UPDATE);
     if (callback)
     {
         callback(bSynchronized, ui32TimeCorrection);
@@ -235,15 +392,20 @@ void lmh_callbacks_setup(LmHandlerCallbacks_t *psCallbacks)
 
 void lorawan_event_callback_register(lorawan_event_e eEvent, lorawan_event_callback_t pfnHandler)
 {
-    lorawan_event_callback_list[eEvent] = pfnHandler;
+    LORAWAN_INSTANCE->pfnEventCallbacks[eEvent] = pfnHandler;
 }
 
 void lorawan_event_callback_unregister(lorawan_event_e eEvent)
 {
-    lorawan_event_callback_list[eEvent] = NULL;
+    LORAWAN_INSTANCE->pfnEventCallbacks[eEvent] = NULL;
 }
 
 void lorawan_tracing_set(uint32_t ui32Enabled)
 {
+    if (ui32Enabled == LORAWAN_TRACING_BINARY)
+    {
+        lorawan_trace_start();
+    }
+
     lorawan_tracing_enabled = ui32Enabled;
 }
\ No newline at end of file
@@ -35,10 +35,14 @@
 #include <am_mcu_apollo.h>
 #include <am_util.h>
 
-#include "ota_config.h"
+#include <utilities.h>
+
 
 #include "lorawan.h"
+#include "lorawan_flash.h"
+#include "lorawan_frag_store.h"
 #include "lorawan_task.h"
+#include "lorawan_trace.h"
 
 #define AUTH_REQ_BUFFER_SIZE (5)
 static uint8_t auth_req_buffer[AUTH_REQ_BUFFER_SIZE];
@@ -46,7 +50,11 @@ static uint8_t frag_write_status[FRAG_MAX_NB];
 
 static void on_frag_progress(uint16_t ui16Counter, uint16_t ui16Blocks, uint8_t ui8Size, uint16_t ui16Lost)
 {
-    if (lorawan_tracing_enabled)
+    if (lorawan_tracing_enabled == LORAWAN_TRACING_BINARY)
+    {
+        lorawan_trace_frag_progress(ui16Counter, ui16Blocks, ui8Size, ui16Lost);
+    }
+    else if (lorawan_tracing_enabled)
     {
         am_util_stdio_printf("\r\n");
         am_util_stdio_printf("###### =========== FRAG_DECODER ============ ######\r\n");
@@ -60,7 +68,9 @@ static void on_frag_progress(uint16_t ui16Counter, uint16_t ui16Blocks, uint8_t
 
 static void on_frag_done(int32_t ui32Status, uint32_t ui32Size)
 {
-    uint32_t ui32Crc = Crc32((uint8_t *)OTA_FLASH_ADDRESS, ui32Size);
+    lorawan_frag_store_flush();
+
+    uint32_t ui32Crc = Crc32((uint8_t *)lorawan_flash_ota()->pui8Base, ui32Size);
 
     auth_req_buffer[0] = 0x05;
     auth_req_buffer[1] = ui32Crc & 0x000000FF;
@@ -71,81 +81,64 @@ static void on_frag_done(int32_t ui32Status, uint32_t ui32Size)
     lorawan_transmit(
         FRAGMENTATION_PORT, LORAMAC_HANDLER_UNCONFIRMED_MSG, AUTH_REQ_BUFFER_SIZE, auth_req_buffer);
 
-    if (lorawan_tracing_enabled)
+    if (lorawan_tracing_enabled == LORAWAN_TRACING_BINARY)
+    {
+        lorawan_trace_frag_done(ui32Status, ui32Size, ui32Crc);
+    }
+    else if (lorawan_tracing_enabled)
     {
         am_util_stdio_printf("\r\n");
         am_util_stdio_printf("###### =========== FRAG_DECODER ============ ######\r\n");
         am_util_stdio_printf("######               FINISHED                ######\r\n");
         am_util_stdio_printf("###### ===================================== ######\r\n");
-        am_util_stdio_printf("STATUS : %ld\r\n", ui32Status);
-        am_util_stdio_printf("SIZE   : %ld\r\n", ui32Size);
-        am_util_stdio_printf("CRC    : %08lX\n\n", ui32Crc);
+        am_util_stdio_printf("STATUS : %d\r\n", ui32Status);
+        am_util_stdio_printf("SIZE   : %u\r\n", ui32Size);
+        am_util_stdio_printf("CRC    : %08X\n\n", ui32Crc);
     }
 }
 
 static int8_t frag_decoder_write(uint32_t ui32Offset, uint8_t *pui8Data, uint32_t ui32Size)
 {
-    uint32_t *pui32Destination = (uint32_t *)(OTA_FLASH_ADDRESS + ui32Offset);
-    uint32_t pui32Source[64];
-    uint32_t pui32Length = ui32Size >> 2;
+    uint32_t ui32Length = (ui32Size + 3) >> 2;
 
-    if (lorawan_tracing_enabled)
+    // Offsets in the OTA region, its address differs on the host.
+    if (lorawan_tracing_enabled == LORAWAN_TRACING_BINARY)
     {
-        am_util_stdio_printf(
-            "\r\nDecoder Write: 0x%x, 0x%x, %d\r\n", (uint32_t)pui32Destination, (uint32_t)pui32Source, pui32Length);
+        lorawan_trace_frag_write(ui32Offset, ui32Length);
+    }
+    else if (lorawan_tracing_enabled)
+    {
+        am_util_stdio_printf("\r\nDecoder Write: +0x%x, %d\r\n", ui32Offset, ui32Size);
     }
 
-    memcpy(pui32Source, pui8Data, ui32Size);
-
-    AM_CRITICAL_BEGIN
-    am_hal_flash_program_main(AM_HAL_FLASH_PROGRAM_KEY, pui32Source, pui32Destination, pui32Length);
-    AM_CRITICAL_END
-
-    return 0;
+    return lorawan_frag_store_write(ui32Offset, pui8Data, ui32Size);
 }
 
 static int8_t frag_decoder_read(uint32_t ui32Offset, uint8_t *pui8Data, uint32_t ui32Size)
 {
-    uint8_t *pui8UnfragmentedData = (uint8_t *)(OTA_FLASH_ADDRESS);
-    for (uint32_t i = 0; i < ui32Size; i++)
-    {
-        pui8Data[i] = pui8UnfragmentedData[ui32Offset + i];
-    }
-    return 0;
+    return lorawan_frag_store_read(ui32Offset, pui8Data, ui32Size);
 }
 
 static int8_t frag_decoder_erase(uint32_t ui32Offset, uint32_t ui32Block, uint32_t ui32Size)
 {
+    uint32_t ui32PageSize = lorawan_flash_ota()->ui32PageSize;
     uint32_t ui32TotalSize = ui32Block * ui32Size;
-    uint32_t ui32TotalPage = (ui32TotalSize >> 13) + 1;
-    uint32_t ui32Address = OTA_FLASH_ADDRESS;
+    uint32_t ui32TotalPage = (ui32TotalSize + ui32PageSize - 1) / ui32PageSize;
 
     memset(frag_write_status, 1, FRAG_MAX_NB);
     memset(frag_write_status, 0, ui32Block);
 
-    if (lorawan_tracing_enabled)
+    if (lorawan_tracing_enabled == LORAWAN_TRACING_BINARY)
     {
-        am_util_stdio_printf("\r\nErasing %d pages at 0x%x\r\n", ui32TotalPage, ui32Address);
+        lorawan_trace_frag_erase(0, ui32TotalPage);
     }
-
-    for (int i = 0; i < ui32TotalPage; i++)
+    else if (lorawan_tracing_enabled)
     {
-        ui32Address += AM_HAL_FLASH_PAGE_SIZE;
-
-        if (lorawan_tracing_enabled)
-        {
-            am_util_stdio_printf("Instance: %d, Page: %d\r\n",
-                                AM_HAL_FLASH_ADDR2INST(ui32Address),
-                                AM_HAL_FLASH_ADDR2PAGE(ui32Address));
-        }
-
-        AM_CRITICAL_BEGIN
-        am_hal_flash_page_erase(AM_HAL_FLASH_PROGRAM_KEY,
-                                AM_HAL_FLASH_ADDR2INST(ui32Address),
-                                AM_HAL_FLASH_ADDR2PAGE(ui32Address));
-        AM_CRITICAL_END
+        am_util_stdio_printf("\r\nErasing %d pages at +0x0\r\n", ui32TotalPage);
     }
 
+    lorawan_frag_store_open(ui32TotalSize);
+
     return 0;
 }
 
@@ -51,6 +51,16 @@ typedef enum
     LORAWAN_STACK_STOPPED,
 } lorawan_stack_state_e;
 
+/**
+ * @brief Debug trace output, see lorawan_tracing_set.
+ */
+typedef enum
+{
+    LORAWAN_TRACING_OFF = 0,
+    LORAWAN_TRACING_TEXT,
+    LORAWAN_TRACING_BINARY,
+} lorawan_tracing_e;
+
 /**
  * @brief LoRaWAN event types.
  * 
@@ -159,6 +169,15 @@ typedef struct
     uint32_t abp_device_address;
 } lorawan_activation_parameters_t;
 
+/**
+ * @brief LoRaWAN transmit options.
+ */
+typedef struct
+{
+    uint32_t ui32TimeToLive; ///< ms before a queued packet is discarded, 0 to never expire
+    uint32_t ui32Urgent;     ///< queue ahead of regular packets, see lorawan_multicast_preempt_set
+} lorawan_transmit_options_t;
+
 /**
  * @brief LoRaWAN event callback function generic prototype.
  * 
@@ -244,9 +263,22 @@ extern void lorawan_stack_state_get(lorawan_stack_state_e *peState);
 /**
  * @brief Initiate a join request
  * 
+ * @remarks A failed join is retried by the LoRaWAN task until the device
+ * joins or the stack is stopped.  Retries follow an exponential backoff
+ * from LORAWAN_JOIN_BACKOFF_MIN to LORAWAN_JOIN_BACKOFF_MAX with a random
+ * jitter, and the aggregated join request airtime is kept within the
+ * retransmission backoff limits of the LoRaWAN specification.  Calling it
+ * again while a retry is scheduled keeps that retry and the backoff.
  */
 extern void lorawan_join();
 
+/**
+ * @brief Time until the next join attempt.
+ *
+ * @return ms until the next join request is sent, 0 if none is scheduled.
+ */
+extern uint32_t lorawan_join_next_attempt_get();
+
 /**
  * @brief Get the current join state
  * 
@@ -285,6 +317,78 @@ extern void lorawan_request_time_sync();
 extern void
 lorawan_transmit(uint32_t ui32Port, uint32_t ui32Ack, uint32_t ui32Length, uint8_t *pui8Data);
 
+/**
+ * @brief Transmit a packet with queueing options.
+ *
+ * @param ui32Port    Application port.
+ * @param ui32Ack     Set to 1 for a confirmed uplink.
+ * @param ui32Length  Payload size, the payload is copied.
+ * @param pui8Data    Payload.
+ * @param psOptions  Set to NULL for the defaults used by lorawan_transmit,
+ *  no expiry and regular priority.
+ *
+ * @remarks Packets queued during a remote multicast session are held until
+ * the session ends.  When the transmit queue fills up during the session,
+ * the oldest regular packet is discarded to make room.  Packets whose time
+ * to live elapses while queued are discarded.
+ */
+extern void lorawan_transmit_with_options(uint32_t ui32Port,
+                                          uint32_t ui32Ack,
+                                          uint32_t ui32Length,
+                                          uint8_t *pui8Data,
+                                          const lorawan_transmit_options_t *psOptions);
+
+/**
+ * @brief Largest application payload of an uplink at the current data rate.
+ *
+ * @return bytes, without the pending MAC commands which are sent on their
+ * own when they do not fit next to the payload.
+ *
+ * @remarks ADR may lower the data rate before the uplink is sent.
+ */
+extern uint32_t lorawan_transmit_size_max_get();
+
+/**
+ * @brief Allow urgent packets to be transmitted during a remote multicast
+ * session.
+ *
+ * @param ui32Enabled  Set to 1 to let urgent packets preempt the session.
+ *  Set to 0 to hold all packets until the session ends (default).
+ */
+extern void lorawan_multicast_preempt_set(uint32_t ui32Enabled);
+
+/**
+ * @brief Split uplinks larger than the payload limit of the current data
+ * rate over several frames.
+ *
+ * @param ui32Enabled  Set to 1 to segment oversized uplinks.  Set to 0 to
+ *  hand them to the MAC unchanged (default), which replaces them with an
+ *  empty frame.
+ *
+ * @remarks Segments are sent on LORAWAN_SEGMENT_PORT, in order and one
+ * message at a time.  Every segment starts with the message id (u8) and
+ * the segment index (u8, bit 7 set on the last one).  The first segment
+ * adds the application port (u8) and the message length (u8).  The size of
+ * each segment follows the data rate in use when it is sent.  Uplinks that
+ * fit into a single frame are sent unchanged.  tools/lorawan_segments.py
+ * reassembles the messages on the network side.
+ */
+extern void lorawan_segmentation_set(uint32_t ui32Enabled);
+
+/**
+ * @brief Shorten the path from the stack start to the first uplink.
+ *
+ * @param ui32Enabled  Set to 1 to register the compliance and fragmentation
+ *  packages and to request the network time only once the first frame has
+ *  been handed to the MAC.  Set to 0 to do all of it when the stack starts
+ *  (default).
+ *
+ * @remarks Takes effect on the next stack start.  In class A no downlink
+ * can reach the deferred packages before the first uplink.  A device that
+ * switches to class B or C before its first uplink should not use it.
+ */
+extern void lorawan_fast_boot_set(uint32_t ui32Enabled);
+
 /**
  * @brief Set a key by a string.
  * 
@@ -397,10 +501,26 @@ extern void lorawan_event_callback_register(lorawan_event_e eEvent,
  */
 extern void lorawan_event_callback_unregister(lorawan_event_e eEvent);
 
+/**
+ * @brief Notify the stack that the radio supply has been removed.
+ *
+ * @remarks Call this when the radio is powered down externally, for
+ * example by driving nLORA_EN high in the LORAWAN_EVENT_SLEEP callback.
+ * The radio registers lost across the power cycle are written back on
+ * the next wake.  Powering down only the SPI port is handled by the
+ * stack and does not require this call.
+ */
+extern void lorawan_radio_power_lost();
+
 /**
  * @brief Enable or disable debug messages printing.
- * 
- * @param ui32Enabled 
+ *
+ * @param ui32Enabled  One of lorawan_tracing_e, 1 selects the text trace.
+ *
+ * @remarks The text trace is printed synchronously by the LoRaWAN task and
+ * delays the receive windows.  The binary trace only copies a compact
+ * record into RAM, a low priority task writes the records out and
+ * tools/lorawan_trace.py turns them back into text.
  */
 extern void lorawan_tracing_set(uint32_t ui32Enabled);
 
@@ -0,0 +1,447 @@
+/*
+ * BSD 3-Clause License
+ *
+ * Copyright (c) 2024, Northern Mechatronics, Inc.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its
+ *    contributors may be used to endorse or promote products derived from
+ *    this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "lorawan_compress.h"
+
+#define LORAWAN_COMPRESS_WIDTH_BITS (6)
+
+typedef struct
+{
+    uint8_t *pui8Buffer;
+    uint32_t ui32Size;
+    uint32_t ui32Offset;
+    uint32_t ui32Bits;
+    uint32_t ui32Pending;
+    bool bOverflow;
+} lorawan_compress_writer_t;
+
+typedef struct
+{
+    const uint8_t *pui8Buffer;
+    uint32_t ui32Size;
+    uint32_t ui32Offset;
+    uint32_t ui32Bits;
+    uint32_t ui32Pending;
+    bool bUnderflow;
+} lorawan_compress_reader_t;
+
+static inline uint32_t lorawan_compress_zigzag(int32_t i32Value)
+{
+    return ((uint32_t)i32Value << 1) ^ (uint32_t)(i32Value >> 31);
+}
+
+static inline int32_t lorawan_compress_unzigzag(uint32_t ui32Value)
+{
+    return (int32_t)((ui32Value >> 1) ^ (0U - (ui32Value & 1)));
+}
+
+static uint32_t lorawan_compress_bits(uint32_t ui32Value)
+{
+    return ui32Value ? (32 - __builtin_clz(ui32Value)) : 0;
+}
+
+// Differences are taken modulo 2^32 so that any pair of readings round
+// trips, the ones that matter are small either way.
+static uint32_t lorawan_compress_delta(const lorawan_compress_t *psCompress,
+                                       const int32_t *pi32Readings,
+                                       uint32_t ui32Reading,
+                                       uint32_t ui32Field,
+                                       bool bKeyframe)
+{
+    uint32_t ui32Fields = psCompress->psSchema->ui8Fields;
+    uint32_t ui32Value = (uint32_t)pi32Readings[ui32Reading * ui32Fields + ui32Field];
+    uint32_t ui32Previous;
+
+    if (ui32Reading)
+    {
+        ui32Previous = (uint32_t)pi32Readings[(ui32Reading - 1) * ui32Fields + ui32Field];
+    }
+    else
+    {
+        ui32Previous = bKeyframe ? 0 : (uint32_t)psCompress->pi32Last[ui32Field];
+    }
+
+    return lorawan_compress_zigzag((int32_t)(ui32Value - ui32Previous));
+}
+
+static void lorawan_compress_put_byte(lorawan_compress_writer_t *psWriter, uint8_t ui8Value)
+{
+    if (psWriter->ui32Offset >= psWriter->ui32Size)
+    {
+        psWriter->bOverflow = true;
+        return;
+    }
+    psWriter->pui8Buffer[psWriter->ui32Offset++] = ui8Value;
+}
+
+static void lorawan_compress_put_varint(lorawan_compress_writer_t *psWriter, uint32_t ui32Value)
+{
+    while (ui32Value >= 0x80)
+    {
+        lorawan_compress_put_byte(psWriter, (uint8_t)(ui32Value | 0x80));
+        ui32Value >>= 7;
+    }
+    lorawan_compress_put_byte(psWriter, (uint8_t)ui32Value);
+}
+
+static void lorawan_compress_put_bits(lorawan_compress_writer_t *psWriter,
+                                      uint32_t ui32Value,
+                                      uint32_t ui32Bits)
+{
+    for (uint32_t i = 0; i < ui32Bits; i++)
+    {
+        psWriter->ui32Pending |= ((ui32Value >> i) & 1) << psWriter->ui32Bits;
+        if (++psWriter->ui32Bits == 8)
+        {
+            lorawan_compress_put_byte(psWriter, (uint8_t)psWriter->ui32Pending);
+            psWriter->ui32Pending = 0;
+            psWriter->ui32Bits = 0;
+        }
+    }
+}
+
+static void lorawan_compress_flush_bits(lorawan_compress_writer_t *psWriter)
+{
+    if (psWriter->ui32Bits)
+    {
+        lorawan_compress_put_byte(psWriter, (uint8_t)psWriter->ui32Pending);
+        psWriter->ui32Pending = 0;
+        psWriter->ui32Bits = 0;
+    }
+}
+
+static uint8_t lorawan_compress_get_byte(lorawan_compress_reader_t *psReader)
+{
+    if (psReader->ui32Offset >= psReader->ui32Size)
+    {
+        psReader->bUnderflow = true;
+        return 0;
+    }
+    return psReader->pui8Buffer[psReader->ui32Offset++];
+}
+
+static uint32_t lorawan_compress_get_varint(lorawan_compress_reader_t *psReader)
+{
+    uint32_t ui32Value = 0;
+
+    for (uint32_t ui32Shift = 0; ui32Shift < 35; ui32Shift += 7)
+    {
+        uint8_t ui8Byte = lorawan_compress_get_byte(psReader);
+
+        ui32Value |= (uint32_t)(ui8Byte & 0x7F) << ui32Shift;
+        if (!(ui8Byte & 0x80))
+        {
+            return ui32Value;
+        }
+    }
+
+    psReader->bUnderflow = true;
+    return 0;
+}
+
+static uint32_t lorawan_compress_get_bits(lorawan_compress_reader_t *psReader, uint32_t ui32Bits)
+{
+    uint32_t ui32Value = 0;
+
+    for (uint32_t i = 0; i < ui32Bits; i++)
+    {
+        if (psReader->ui32Bits == 0)
+        {
+            psReader->ui32Pending = lorawan_compress_get_byte(psReader);
+            psReader->ui32Bits = 8;
+        }
+        ui32Value |= (psReader->ui32Pending & 1) << i;
+        psReader->ui32Pending >>= 1;
+        psReader->ui32Bits--;
+    }
+
+    return ui32Value;
+}
+
+static uint32_t lorawan_compress_raw_size(const lorawan_compress_schema_t *psSchema)
+{
+    uint32_t ui32Size = 0;
+
+    for (uint32_t i = 0; i < psSchema->ui8Fields; i++)
+    {
+        ui32Size += psSchema->pui8Width[i];
+    }
+
+    return ui32Size;
+}
+
+void lorawan_compress_init(lorawan_compress_t *psCompress, const lorawan_compress_schema_t *psSchema)
+{
+    memset(psCompress, 0, sizeof(lorawan_compress_t));
+    psCompress->psSchema = psSchema;
+}
+
+void lorawan_compress_keyframe(lorawan_compress_t *psCompress)
+{
+    psCompress->bSynchronized = false;
+}
+
+int32_t lorawan_compress_encode(lorawan_compress_t *psCompress,
+                                const int32_t *pi32Readings,
+                                uint32_t ui32Readings,
+                                uint8_t *pui8Frame,
+                                uint32_t ui32Size)
+{
+    const lorawan_compress_schema_t *psSchema = psCompress->psSchema;
+    uint32_t ui32Fields = psSchema->ui8Fields;
+    lorawan_compress_writer_t sWriter = {
+        .pui8Buffer = pui8Frame,
+        .ui32Size = ui32Size,
+    };
+
+    if ((ui32Readings == 0) || (ui32Readings > 255) || (ui32Fields == 0) ||
+        (ui32Fields > LORAWAN_COMPRESS_FIELDS_MAX))
+    {
+        return LORAWAN_COMPRESS_ERROR_SIZE;
+    }
+
+    bool bKeyframe = !psCompress->bSynchronized ||
+                     (psSchema->ui8Keyframe &&
+                      (psCompress->ui32SinceKeyframe + 1 >= psSchema->ui8Keyframe));
+
+    lorawan_compress_put_byte(&sWriter,
+                              (bKeyframe ? LORAWAN_COMPRESS_KEYFRAME : 0) |
+                                  (psCompress->ui32Sequence & LORAWAN_COMPRESS_SEQUENCE));
+    lorawan_compress_put_byte(&sWriter, (uint8_t)ui32Readings);
+
+    uint32_t ui32Varints = ui32Readings;
+    if (psSchema->ui8Encoding == LORAWAN_COMPRESS_BITPACK)
+    {
+        ui32Varints = 1;
+    }
+
+    for (uint32_t r = 0; r < ui32Varints; r++)
+    {
+        for (uint32_t f = 0; f < ui32Fields; f++)
+        {
+            lorawan_compress_put_varint(
+                &sWriter, lorawan_compress_delta(psCompress, pi32Readings, r, f, bKeyframe));
+        }
+    }
+
+    if (ui32Varints < ui32Readings)
+    {
+        uint32_t pui32Bits[LORAWAN_COMPRESS_FIELDS_MAX] = {0};
+
+        for (uint32_t r = 1; r < ui32Readings; r++)
+        {
+            for (uint32_t f = 0; f < ui32Fields; f++)
+            {
+                uint32_t ui32Bits = lorawan_compress_bits(
+                    lorawan_compress_delta(psCompress, pi32Readings, r, f, bKeyframe));
+                if (ui32Bits > pui32Bits[f])
+                {
+                    pui32Bits[f] = ui32Bits;
+                }
+            }
+        }
+
+        for (uint32_t f = 0; f < ui32Fields; f++)
+        {
+            lorawan_compress_put_bits(&sWriter, pui32Bits[f], LORAWAN_COMPRESS_WIDTH_BITS);
+        }
+
+        for (uint32_t r = 1; r < ui32Readings; r++)
+        {
+            for (uint32_t f = 0; f < ui32Fields; f++)
+            {
+                lorawan_compress_put_bits(
+                    &sWriter,
+                    lorawan_compress_delta(psCompress, pi32Readings, r, f, bKeyframe),
+                    pui32Bits[f]);
+            }
+        }
+        lorawan_compress_flush_bits(&sWriter);
+    }
+
+    if (sWriter.bOverflow)
+    {
+        return LORAWAN_COMPRESS_ERROR_SIZE;
+    }
+
+    memcpy(psCompress->pi32Last,
+           &pi32Readings[(ui32Readings - 1) * ui32Fields],
+           ui32Fields * sizeof(int32_t));
+    psCompress->ui32Sequence++;
+    psCompress->bSynchronized = true;
+    psCompress->ui32SinceKeyframe = bKeyframe ? 0 : psCompress->ui32SinceKeyframe + 1;
+
+    psCompress->sStats.ui32Frames++;
+    psCompress->sStats.ui32Keyframes += bKeyframe ? 1 : 0;
+    psCompress->sStats.ui32Readings += ui32Readings;
+    psCompress->sStats.ui32RawBytes += ui32Readings * lorawan_compress_raw_size(psSchema);
+    psCompress->sStats.ui32EncodedBytes += sWriter.ui32Offset;
+
+    return (int32_t)sWriter.ui32Offset;
+}
+
+int32_t lorawan_compress_decode(lorawan_compress_t *psCompress,
+                                const uint8_t *pui8Frame,
+                                uint32_t ui32Size,
+                                int32_t *pi32Readings,
+                                uint32_t ui32Readings)
+{
+    const lorawan_compress_schema_t *psSchema = psCompress->psSchema;
+    uint32_t ui32Fields = psSchema->ui8Fields;
+    lorawan_compress_reader_t sReader = {
+        .pui8Buffer = pui8Frame,
+        .ui32Size = ui32Size,
+    };
+
+    if ((ui32Size < LORAWAN_COMPRESS_HEADER_SIZE) || (ui32Fields == 0) ||
+        (ui32Fields > LORAWAN_COMPRESS_FIELDS_MAX))
+    {
+        return LORAWAN_COMPRESS_ERROR_MALFORMED;
+    }
+
+    uint8_t ui8Flags = lorawan_compress_get_byte(&sReader);
+    uint32_t ui32Count = lorawan_compress_get_byte(&sReader);
+    bool bKeyframe = (ui8Flags & LORAWAN_COMPRESS_KEYFRAME) != 0;
+    uint32_t ui32Sequence = ui8Flags & LORAWAN_COMPRESS_SEQUENCE;
+
+    if (ui32Count == 0)
+    {
+        return LORAWAN_COMPRESS_ERROR_MALFORMED;
+    }
+
+    if (ui32Count > ui32Readings)
+    {
+        return LORAWAN_COMPRESS_ERROR_SIZE;
+    }
+
+    // A delta frame only decodes on top of the frame right before it.
+    if (!bKeyframe)
+    {
+        uint32_t ui32Missing =
+            (ui32Sequence - psCompress->ui32Sequence) & LORAWAN_COMPRESS_SEQUENCE;
+
+        if (psCompress->bSynchronized && ui32Missing)
+        {
+            psCompress->sStats.ui32Lost += ui32Missing;
+            psCompress->bSynchronized = false;
+        }
+
+        if (!psCompress->bSynchronized)
+        {
+            psCompress->ui32Sequence = ui32Sequence + 1;
+            psCompress->sStats.ui32Discarded++;
+            return LORAWAN_COMPRESS_ERROR_SYNC;
+        }
+    }
+    else if (psCompress->bSynchronized)
+    {
+        psCompress->sStats.ui32Lost +=
+            (ui32Sequence - psCompress->ui32Sequence) & LORAWAN_COMPRESS_SEQUENCE;
+    }
+
+    uint32_t ui32Varints = ui32Count;
+    if (psSchema->ui8Encoding == LORAWAN_COMPRESS_BITPACK)
+    {
+        ui32Varints = 1;
+    }
+
+    for (uint32_t r = 0; r < ui32Varints; r++)
+    {
+        for (uint32_t f = 0; f < ui32Fields; f++)
+        {
+            uint32_t ui32Previous = r ? (uint32_t)pi32Readings[(r - 1) * ui32Fields + f]
+                                      : (bKeyframe ? 0 : (uint32_t)psCompress->pi32Last[f]);
+            int32_t i32Delta = lorawan_compress_unzigzag(lorawan_compress_get_varint(&sReader));
+
+            pi32Readings[r * ui32Fields + f] = (int32_t)(ui32Previous + (uint32_t)i32Delta);
+        }
+    }
+
+    if (ui32Varints < ui32Count)
+    {
+        uint32_t pui32Bits[LORAWAN_COMPRESS_FIELDS_MAX];
+
+        for (uint32_t f = 0; f < ui32Fields; f++)
+        {
+            pui32Bits[f] = lorawan_compress_get_bits(&sReader, LORAWAN_COMPRESS_WIDTH_BITS);
+            if (pui32Bits[f] > 32)
+            {
+                return LORAWAN_COMPRESS_ERROR_MALFORMED;
+            }
+        }
+
+        for (uint32_t r = 1; r < ui32Count; r++)
+        {
+            for (uint32_t f = 0; f < ui32Fields; f++)
+            {
+                uint32_t ui32Previous = (uint32_t)pi32Readings[(r - 1) * ui32Fields + f];
+                int32_t i32Delta =
+                    lorawan_compress_unzigzag(lorawan_compress_get_bits(&sReader, pui32Bits[f]));
+
+                pi32Readings[r * ui32Fields + f] = (int32_t)(ui32Previous + (uint32_t)i32Delta);
+            }
+        }
+    }
+
+    if (sReader.bUnderflow || (sReader.ui32Offset != ui32Size))
+    {
+        return LORAWAN_COMPRESS_ERROR_MALFORMED;
+    }
+
+    memcpy(psCompress->pi32Last,
+           &pi32Readings[(ui32Count - 1) * ui32Fields],
+           ui32Fields * sizeof(int32_t));
+    psCompress->ui32Sequence = ui32Sequence + 1;
+    psCompress->bSynchronized = true;
+
+    psCompress->sStats.ui32Frames++;
+    psCompress->sStats.ui32Keyframes += bKeyframe ? 1 : 0;
+    psCompress->sStats.ui32Readings += ui32Count;
+    psCompress->sStats.ui32RawBytes += ui32Count * lorawan_compress_raw_size(psSchema);
+    psCompress->sStats.ui32EncodedBytes += ui32Size;
+
+    return (int32_t)ui32Count;
+}
+
+void lorawan_compress_stats_get(const lorawan_compress_t *psCompress,
+                                lorawan_compress_stats_t *psStats)
+{
+    memcpy(psStats, &psCompress->sStats, sizeof(lorawan_compress_stats_t));
+}
+
+void lorawan_compress_stats_reset(lorawan_compress_t *psCompress)
+{
+    memset(&psCompress->sStats, 0, sizeof(lorawan_compress_stats_t));
+}
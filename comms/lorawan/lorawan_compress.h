@@ -0,0 +1,181 @@
+/*
+ * BSD 3-Clause License
+ *
+ * Copyright (c) 2024, Northern Mechatronics, Inc.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its
+ *    contributors may be used to endorse or promote products derived from
+ *    this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+#ifndef _LORAWAN_COMPRESS_H_
+#define _LORAWAN_COMPRESS_H_
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief Values in one reading.
+ */
+#ifndef LORAWAN_COMPRESS_FIELDS_MAX
+#define LORAWAN_COMPRESS_FIELDS_MAX (8)
+#endif
+
+#define LORAWAN_COMPRESS_HEADER_SIZE (2)
+
+#define LORAWAN_COMPRESS_KEYFRAME (0x80)
+#define LORAWAN_COMPRESS_SEQUENCE (0x7F)
+
+#define LORAWAN_COMPRESS_ERROR_SIZE      (-1) ///< frame buffer too small or frame truncated
+#define LORAWAN_COMPRESS_ERROR_SYNC      (-2) ///< frame lost, waiting for the next keyframe
+#define LORAWAN_COMPRESS_ERROR_MALFORMED (-3)
+
+typedef enum
+{
+    LORAWAN_COMPRESS_VARINT = 0, ///< one zigzag varint per value
+    LORAWAN_COMPRESS_BITPACK,    ///< every delta of a field packed at the widest one's bit count
+} lorawan_compress_encoding_e;
+
+/**
+ * @brief Layout of the readings sent on a port.
+ *
+ * The field widths are the bytes each value takes in the uncompressed
+ * reading, they only serve the statistics.
+ */
+typedef struct
+{
+    uint8_t ui8Port;
+    uint8_t ui8Fields;
+    uint8_t ui8Keyframe; ///< frames from one keyframe to the next, 0 for the first one only
+    uint8_t ui8Encoding; ///< lorawan_compress_encoding_e
+    uint8_t pui8Width[LORAWAN_COMPRESS_FIELDS_MAX];
+} lorawan_compress_schema_t;
+
+typedef struct
+{
+    uint32_t ui32Frames;
+    uint32_t ui32Keyframes;
+    uint32_t ui32Readings;
+    uint32_t ui32RawBytes;     ///< size of the readings uncompressed
+    uint32_t ui32EncodedBytes; ///< size of the frames, headers included
+    uint32_t ui32Lost;         ///< decoder only, frames missing from the sequence
+    uint32_t ui32Discarded;    ///< decoder only, frames dropped waiting for a keyframe
+} lorawan_compress_stats_t;
+
+/**
+ * @brief Encoder or decoder of one port.
+ */
+typedef struct
+{
+    const lorawan_compress_schema_t *psSchema;
+    int32_t pi32Last[LORAWAN_COMPRESS_FIELDS_MAX]; ///< last reading sent or received
+    uint32_t ui32Sequence;
+    uint32_t ui32SinceKeyframe;
+    bool bSynchronized;
+    lorawan_compress_stats_t sStats;
+} lorawan_compress_t;
+
+/**
+ * @brief Compression of slowly varying readings into uplink frames.
+ *
+ * Each frame carries a batch of readings as the difference of every value
+ * to the same value in the reading before, zigzag mapped so that small
+ * negative differences stay small.  A keyframe carries the first reading
+ * of the batch as is, every ui8Keyframe frames or after
+ * lorawan_compress_keyframe, so that the decoder recovers from a lost
+ * frame.
+ *
+ *   flags     u8, bit 7 keyframe, bits 6:0 frame sequence
+ *   readings  u8
+ *   body
+ *
+ * With LORAWAN_COMPRESS_VARINT the body holds one LEB128 varint per value,
+ * reading after reading.  With LORAWAN_COMPRESS_BITPACK it holds the
+ * varints of the first reading, then one 6 bit width per field followed
+ * by the values of the remaining readings packed at their field width,
+ * least significant bit first.
+ *
+ * The encoder and the decoder only depend on the C library, the decoder
+ * builds as is on the backend.  tools/lorawan_compress.py implements the
+ * same format.
+ */
+extern void lorawan_compress_init(lorawan_compress_t *psCompress,
+                                  const lorawan_compress_schema_t *psSchema);
+
+/**
+ * @brief Send the next frame as a keyframe.
+ */
+extern void lorawan_compress_keyframe(lorawan_compress_t *psCompress);
+
+/**
+ * @brief Encode a batch of readings into a frame.
+ *
+ * @param psCompress  Encoder of the port.
+ * @param pi32Readings  ui32Readings readings of ui8Fields values each.
+ * @param ui32Readings  Number of readings, 1 to 255.
+ * @param pui8Frame  Frame buffer, passed to lorawan_transmit on the
+ *  schema port.
+ * @param ui32Size  Size of the frame buffer, the payload limit of the
+ *  current data rate.
+ *
+ * @return Size of the frame, or LORAWAN_COMPRESS_ERROR_SIZE if it does not
+ *  fit in which case the encoder is left as it was.
+ */
+extern int32_t lorawan_compress_encode(lorawan_compress_t *psCompress,
+                                       const int32_t *pi32Readings,
+                                       uint32_t ui32Readings,
+                                       uint8_t *pui8Frame,
+                                       uint32_t ui32Size);
+
+/**
+ * @brief Decode a frame.
+ *
+ * @param psCompress  Decoder of the port.
+ * @param pui8Frame  Frame received on the schema port.
+ * @param ui32Size  Size of the frame.
+ * @param pi32Readings  Filled with the readings.
+ * @param ui32Readings  Readings pi32Readings can hold.
+ *
+ * @return Number of readings, LORAWAN_COMPRESS_ERROR_SYNC if a frame was
+ *  lost since the last keyframe or another negative error.
+ */
+extern int32_t lorawan_compress_decode(lorawan_compress_t *psCompress,
+                                       const uint8_t *pui8Frame,
+                                       uint32_t ui32Size,
+                                       int32_t *pi32Readings,
+                                       uint32_t ui32Readings);
+
+extern void lorawan_compress_stats_get(const lorawan_compress_t *psCompress,
+                                       lorawan_compress_stats_t *psStats);
+extern void lorawan_compress_stats_reset(lorawan_compress_t *psCompress);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
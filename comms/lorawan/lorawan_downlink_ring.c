@@ -0,0 +1,143 @@
+/*
+ * BSD 3-Clause License
+ *
+ * Copyright (c) 2024, Northern Mechatronics, Inc.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its
+ *    contributors may be used to endorse or promote products derived from
+ *    this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+
+#include <LmHandler.h>
+
+#include "lorawan_downlink_ring.h"
+
+int32_t lorawan_downlink_ring_init(lorawan_downlink_ring_t *psRing,
+                                   lorawan_downlink_t *psSlots,
+                                   uint32_t ui32Slots)
+{
+    if (lorawan_ring_init(&psRing->sRing, ui32Slots))
+    {
+        return -1;
+    }
+
+    psRing->psSlots = psSlots;
+    memset(&psRing->sStats, 0, sizeof(lorawan_downlink_ring_stats_t));
+
+    return 0;
+}
+
+lorawan_downlink_t *lorawan_downlink_ring_reserve(lorawan_downlink_ring_t *psRing)
+{
+    if (lorawan_ring_space(&psRing->sRing) == 0)
+    {
+        psRing->sStats.ui32Overflows++;
+        return NULL;
+    }
+
+    return &psRing->psSlots[lorawan_ring_offset(&psRing->sRing, lorawan_ring_head(&psRing->sRing))];
+}
+
+void lorawan_downlink_ring_commit(lorawan_downlink_ring_t *psRing)
+{
+    uint32_t ui32Used = lorawan_ring_produce(&psRing->sRing, 1);
+
+    psRing->sStats.ui32Received++;
+    if (ui32Used > psRing->sStats.ui32HighWater)
+    {
+        psRing->sStats.ui32HighWater = ui32Used;
+    }
+}
+
+void lorawan_downlink_copy(lorawan_downlink_t *psDownlink,
+                          const LmHandlerAppData_t *psData,
+                          const LmHandlerRxParams_t *psParams)
+{
+    psDownlink->ui32Counter = psParams->DownlinkCounter;
+    psDownlink->ui32Port = psData->Port;
+    psDownlink->i32Slot = psParams->RxSlot;
+    psDownlink->i32Datarate = psParams->Datarate;
+    psDownlink->i32Rssi = psParams->Rssi;
+    psDownlink->i32Snr = psParams->Snr;
+    psDownlink->ui32Size = psData->BufferSize;
+    memcpy(psDownlink->pui8Payload, psData->Buffer, psData->BufferSize);
+}
+
+bool lorawan_downlink_ring_push(lorawan_downlink_ring_t *psRing,
+                                const LmHandlerAppData_t *psData,
+                                const LmHandlerRxParams_t *psParams)
+{
+    if (psData->BufferSize > LORAWAN_DOWNLINK_PAYLOAD_MAX)
+    {
+        psRing->sStats.ui32Oversize++;
+        return false;
+    }
+
+    lorawan_downlink_t *psSlot = lorawan_downlink_ring_reserve(psRing);
+    if (psSlot == NULL)
+    {
+        return false;
+    }
+
+    lorawan_downlink_copy(psSlot, psData, psParams);
+    lorawan_downlink_ring_commit(psRing);
+
+    return true;
+}
+
+lorawan_downlink_t *lorawan_downlink_ring_peek(lorawan_downlink_ring_t *psRing)
+{
+    if (lorawan_ring_available(&psRing->sRing) == 0)
+    {
+        return NULL;
+    }
+
+    return &psRing->psSlots[lorawan_ring_offset(&psRing->sRing, lorawan_ring_tail(&psRing->sRing))];
+}
+
+void lorawan_downlink_ring_release(lorawan_downlink_ring_t *psRing)
+{
+    lorawan_ring_consume(&psRing->sRing, 1);
+    psRing->sStats.ui32Consumed++;
+}
+
+uint32_t lorawan_downlink_ring_count(lorawan_downlink_ring_t *psRing)
+{
+    return lorawan_ring_count(&psRing->sRing);
+}
+
+void lorawan_downlink_ring_stats_get(lorawan_downlink_ring_t *psRing,
+                                     lorawan_downlink_ring_stats_t *psStats)
+{
+    memcpy(psStats, &psRing->sStats, sizeof(lorawan_downlink_ring_stats_t));
+}
+
+void lorawan_downlink_ring_stats_reset(lorawan_downlink_ring_t *psRing)
+{
+    memset(&psRing->sStats, 0, sizeof(lorawan_downlink_ring_stats_t));
+}
@@ -0,0 +1,140 @@
+/*
+ * BSD 3-Clause License
+ *
+ * Copyright (c) 2024, Northern Mechatronics, Inc.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its
+ *    contributors may be used to endorse or promote products derived from
+ *    this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+#ifndef _LORAWAN_DOWNLINK_RING_H_
+#define _LORAWAN_DOWNLINK_RING_H_
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include <LmHandler.h>
+
+#include "lorawan_ring.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#ifndef LORAWAN_DOWNLINK_PAYLOAD_MAX
+#define LORAWAN_DOWNLINK_PAYLOAD_MAX (242)
+#endif
+
+typedef struct
+{
+    uint32_t ui32Counter; ///< downlink frame counter
+    uint32_t ui32Port;
+    int32_t i32Slot;      ///< receive slot, see LoRaMacRxSlot_t
+    int32_t i32Datarate;
+    int32_t i32Rssi;
+    int32_t i32Snr;
+    uint32_t ui32Size;
+    uint8_t pui8Payload[LORAWAN_DOWNLINK_PAYLOAD_MAX];
+} lorawan_downlink_t;
+
+typedef struct
+{
+    uint32_t ui32Received;  ///< downlinks committed to the ring
+    uint32_t ui32Consumed;  ///< slots released by the consumer
+    uint32_t ui32Overflows; ///< downlinks dropped because every slot was in use
+    uint32_t ui32Oversize;  ///< downlinks dropped because they exceed a slot
+    uint32_t ui32HighWater; ///< most slots in use at once
+} lorawan_downlink_ring_stats_t;
+
+/**
+ * @brief Single producer, single consumer ring of downlink slots.
+ *
+ * The producer (the LoRaWAN task) fills a slot in place and commits it,
+ * the consumer processes the slot in place and releases it.  Neither side
+ * takes a lock, see lorawan_ring_t.
+ */
+typedef struct
+{
+    lorawan_downlink_t *psSlots;
+    lorawan_ring_t sRing;
+    lorawan_downlink_ring_stats_t sStats;
+} lorawan_downlink_ring_t;
+
+/**
+ * @brief Set up a ring over an array of slots.
+ *
+ * @param ui32Slots  Number of slots, a power of two.
+ *
+ * @return 0 on success, -1 if the number of slots is not a power of two.
+ */
+extern int32_t lorawan_downlink_ring_init(lorawan_downlink_ring_t *psRing,
+                                          lorawan_downlink_t *psSlots,
+                                          uint32_t ui32Slots);
+
+/**
+ * @brief Producer: get the next free slot, NULL if the ring is full.
+ *
+ * The slot is not visible to the consumer until it is committed.
+ */
+extern lorawan_downlink_t *lorawan_downlink_ring_reserve(lorawan_downlink_ring_t *psRing);
+extern void lorawan_downlink_ring_commit(lorawan_downlink_ring_t *psRing);
+
+/**
+ * @brief Copy a downlink received by LmHandler and its metadata.
+ *
+ * The payload must fit LORAWAN_DOWNLINK_PAYLOAD_MAX.
+ */
+extern void lorawan_downlink_copy(lorawan_downlink_t *psDownlink,
+                                  const LmHandlerAppData_t *psData,
+                                  const LmHandlerRxParams_t *psParams);
+
+/**
+ * @brief Producer: copy a downlink received by LmHandler into the ring.
+ *
+ * @return true if the downlink was queued, false if it was dropped.
+ */
+extern bool lorawan_downlink_ring_push(lorawan_downlink_ring_t *psRing,
+                                       const LmHandlerAppData_t *psData,
+                                       const LmHandlerRxParams_t *psParams);
+
+/**
+ * @brief Consumer: get the oldest committed slot, NULL if the ring is empty.
+ *
+ * The slot stays valid until it is released.
+ */
+extern lorawan_downlink_t *lorawan_downlink_ring_peek(lorawan_downlink_ring_t *psRing);
+extern void lorawan_downlink_ring_release(lorawan_downlink_ring_t *psRing);
+
+extern uint32_t lorawan_downlink_ring_count(lorawan_downlink_ring_t *psRing);
+
+extern void lorawan_downlink_ring_stats_get(lorawan_downlink_ring_t *psRing,
+                                            lorawan_downlink_ring_stats_t *psStats);
+extern void lorawan_downlink_ring_stats_reset(lorawan_downlink_ring_t *psRing);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,249 @@
+/*
+ * BSD 3-Clause License
+ *
+ * Copyright (c) 2024, Northern Mechatronics, Inc.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its
+ *    contributors may be used to endorse or promote products derived from
+ *    this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+
+#include <FreeRTOS.h>
+#include <task.h>
+
+#include <LmHandler.h>
+
+#include "lorawan.h"
+#include "lorawan_event_bus.h"
+#include "lorawan_ring.h"
+
+typedef struct
+{
+    lorawan_event_subscriber_t pfnSubscriber;
+    void *pvContext;
+} lorawan_event_subscription_t;
+
+static const char *const lorawan_event_names[LORAWAN_EVENTS] = {
+    "mac process",
+    "nvm change",
+    "network parameters",
+    "mcps request",
+    "mlme request",
+    "join",
+    "tx data",
+    "rx data",
+    "class change",
+    "beacon status",
+    "time update",
+    "sleep",
+    "wake",
+};
+
+static lorawan_event_subscription_t lorawan_event_subscriptions[LORAWAN_EVENTS]
+                                                               [LORAWAN_EVENT_BUS_SUBSCRIBERS];
+static uint32_t lorawan_event_subscribers[LORAWAN_EVENTS];
+
+//
+// Single producer (the LoRaWAN task), single consumer (the dispatcher)
+// ring of event slots.
+//
+static lorawan_bus_event_t lorawan_event_slots[LORAWAN_EVENT_BUS_SLOTS];
+static lorawan_ring_t lorawan_event_ring = {.ui32Size = LORAWAN_EVENT_BUS_SLOTS};
+
+static TaskHandle_t lorawan_event_bus_handle;
+static lorawan_event_bus_stats_t lorawan_event_bus_stats;
+
+static bool lorawan_event_bus_subscribable(lorawan_event_e eEvent)
+{
+    return (eEvent < LORAWAN_EVENTS) && (eEvent != LORAWAN_EVENT_MAC_PROCESS) &&
+           (eEvent != LORAWAN_EVENT_SLEEP) && (eEvent != LORAWAN_EVENT_WAKE);
+}
+
+static void lorawan_event_bus_deliver(lorawan_bus_event_t *psEvent)
+{
+    lorawan_event_subscription_t psSubscriptions[LORAWAN_EVENT_BUS_SUBSCRIBERS];
+    lorawan_event_bus_counters_t *psCounters = &lorawan_event_bus_stats.sEvents[psEvent->eEvent];
+
+    taskENTER_CRITICAL();
+    memcpy(psSubscriptions,
+           lorawan_event_subscriptions[psEvent->eEvent],
+           sizeof(psSubscriptions));
+    taskEXIT_CRITICAL();
+
+    uint32_t ui32Latency = (xTaskGetTickCount() - psEvent->ui32Timestamp) * portTICK_PERIOD_MS;
+    psCounters->ui32LatencyTotal += ui32Latency;
+    if (ui32Latency > psCounters->ui32LatencyMax)
+    {
+        psCounters->ui32LatencyMax = ui32Latency;
+    }
+
+    for (uint32_t i = 0; i < LORAWAN_EVENT_BUS_SUBSCRIBERS; i++)
+    {
+        if (psSubscriptions[i].pfnSubscriber)
+        {
+            psSubscriptions[i].pfnSubscriber(psEvent, psSubscriptions[i].pvContext);
+            psCounters->ui32Deliveries++;
+        }
+    }
+}
+
+static void lorawan_event_bus_task(void *pvParameters)
+{
+    while (1)
+    {
+        ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+
+        while (lorawan_ring_available(&lorawan_event_ring))
+        {
+            uint32_t ui32Tail = lorawan_ring_tail(&lorawan_event_ring);
+            lorawan_event_bus_deliver(
+                &lorawan_event_slots[lorawan_ring_offset(&lorawan_event_ring, ui32Tail)]);
+            lorawan_ring_consume(&lorawan_event_ring, 1);
+        }
+    }
+}
+
+int32_t lorawan_event_subscribe(lorawan_event_e eEvent,
+                                lorawan_event_subscriber_t pfnSubscriber,
+                                void *pvContext)
+{
+    if (!lorawan_event_bus_subscribable(eEvent) || (pfnSubscriber == NULL))
+    {
+        return -1;
+    }
+
+    if (lorawan_event_bus_handle == NULL)
+    {
+        if (xTaskCreate(lorawan_event_bus_task,
+                        "lorawan events",
+                        LORAWAN_EVENT_BUS_STACK,
+                        0,
+                        LORAWAN_EVENT_BUS_PRIORITY,
+                        &lorawan_event_bus_handle) != pdPASS)
+        {
+            lorawan_event_bus_handle = NULL;
+            return -1;
+        }
+    }
+
+    int32_t i32Status = -1;
+    taskENTER_CRITICAL();
+    for (uint32_t i = 0; i < LORAWAN_EVENT_BUS_SUBSCRIBERS; i++)
+    {
+        lorawan_event_subscription_t *psSubscription = &lorawan_event_subscriptions[eEvent][i];
+        if (psSubscription->pfnSubscriber == NULL)
+        {
+            psSubscription->pfnSubscriber = pfnSubscriber;
+            psSubscription->pvContext = pvContext;
+            lorawan_event_subscribers[eEvent]++;
+            i32Status = 0;
+            break;
+        }
+    }
+    taskEXIT_CRITICAL();
+
+    return i32Status;
+}
+
+void lorawan_event_unsubscribe(lorawan_event_e eEvent,
+                               lorawan_event_subscriber_t pfnSubscriber,
+                               void *pvContext)
+{
+    if (eEvent >= LORAWAN_EVENTS)
+    {
+        return;
+    }
+
+    taskENTER_CRITICAL();
+    for (uint32_t i = 0; i < LORAWAN_EVENT_BUS_SUBSCRIBERS; i++)
+    {
+        lorawan_event_subscription_t *psSubscription = &lorawan_event_subscriptions[eEvent][i];
+        if ((psSubscription->pfnSubscriber == pfnSubscriber) &&
+            (psSubscription->pvContext == pvContext))
+        {
+            psSubscription->pfnSubscriber = NULL;
+            psSubscription->pvContext = NULL;
+            lorawan_event_subscribers[eEvent]--;
+        }
+    }
+    taskEXIT_CRITICAL();
+}
+
+lorawan_bus_event_t *lorawan_event_bus_reserve(lorawan_event_e eEvent)
+{
+    if ((eEvent >= LORAWAN_EVENTS) || (lorawan_event_subscribers[eEvent] == 0))
+    {
+        return NULL;
+    }
+
+    if (lorawan_ring_space(&lorawan_event_ring) == 0)
+    {
+        lorawan_event_bus_stats.sEvents[eEvent].ui32Overflows++;
+        return NULL;
+    }
+
+    uint32_t ui32Head = lorawan_ring_head(&lorawan_event_ring);
+    lorawan_bus_event_t *psEvent =
+        &lorawan_event_slots[lorawan_ring_offset(&lorawan_event_ring, ui32Head)];
+    psEvent->eEvent = eEvent;
+    psEvent->ui32Timestamp = xTaskGetTickCount();
+
+    return psEvent;
+}
+
+void lorawan_event_bus_commit()
+{
+    uint32_t ui32Head = lorawan_ring_head(&lorawan_event_ring);
+    lorawan_event_e eEvent =
+        lorawan_event_slots[lorawan_ring_offset(&lorawan_event_ring, ui32Head)].eEvent;
+
+    uint32_t ui32Waiting = lorawan_ring_produce(&lorawan_event_ring, 1);
+
+    lorawan_event_bus_stats.sEvents[eEvent].ui32Published++;
+    if (ui32Waiting > lorawan_event_bus_stats.ui32HighWater)
+    {
+        lorawan_event_bus_stats.ui32HighWater = ui32Waiting;
+    }
+
+    xTaskNotifyGive(lorawan_event_bus_handle);
+}
+
+const char *lorawan_event_name(lorawan_event_e eEvent)
+{
+    return (eEvent < LORAWAN_EVENTS) ? lorawan_event_names[eEvent] : "";
+}
+
+void lorawan_event_bus_stats_get(lorawan_event_bus_stats_t *psStats)
+{
+    memcpy(psStats, &lorawan_event_bus_stats, sizeof(lorawan_event_bus_stats_t));
+}
+
+void lorawan_event_bus_stats_reset()
+{
+    memset(&lorawan_event_bus_stats, 0, sizeof(lorawan_event_bus_stats_t));
+}
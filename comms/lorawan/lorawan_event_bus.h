@@ -0,0 +1,192 @@
+/*
+ * BSD 3-Clause License
+ *
+ * Copyright (c) 2024, Northern Mechatronics, Inc.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its
+ *    contributors may be used to endorse or promote products derived from
+ *    this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+#ifndef _LORAWAN_EVENT_BUS_H_
+#define _LORAWAN_EVENT_BUS_H_
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include <LmHandler.h>
+
+#include "lorawan.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief Events waiting for the dispatcher task.  Must be a power of two.
+ */
+#ifndef LORAWAN_EVENT_BUS_SLOTS
+#define LORAWAN_EVENT_BUS_SLOTS (16)
+#endif
+
+/**
+ * @brief Subscribers per event.
+ */
+#ifndef LORAWAN_EVENT_BUS_SUBSCRIBERS
+#define LORAWAN_EVENT_BUS_SUBSCRIBERS (4)
+#endif
+
+/**
+ * @brief Downlink payload bytes copied into an event.  Longer payloads are
+ * truncated, use a port handler to receive them whole.
+ */
+#ifndef LORAWAN_EVENT_BUS_PAYLOAD_MAX
+#define LORAWAN_EVENT_BUS_PAYLOAD_MAX (64)
+#endif
+
+/**
+ * @brief Priority of the dispatcher task, below the LoRaWAN task.
+ */
+#ifndef LORAWAN_EVENT_BUS_PRIORITY
+#define LORAWAN_EVENT_BUS_PRIORITY (tskIDLE_PRIORITY + 3)
+#endif
+
+#ifndef LORAWAN_EVENT_BUS_STACK
+#define LORAWAN_EVENT_BUS_STACK (512)
+#endif
+
+/**
+ * @brief Copy of a MAC event.
+ *
+ * Pointers inside the copied LoRaMac structures refer to MAC buffers and
+ * are not valid by the time the event is delivered.
+ */
+typedef struct
+{
+    lorawan_event_e eEvent;
+    uint32_t ui32Timestamp; ///< tick count when the MAC raised the event
+    union
+    {
+        struct
+        {
+            LmHandlerNvmContextStates_t eState;
+            uint16_t ui16Size;
+        } sNvm;
+        CommissioningParams_t sNetwork;
+        struct
+        {
+            LoRaMacStatus_t eStatus;
+            McpsReq_t sRequest;
+            TimerTime_t ui32NextTxDelay;
+        } sMcps;
+        struct
+        {
+            LoRaMacStatus_t eStatus;
+            MlmeReq_t sRequest;
+            TimerTime_t ui32NextTxDelay;
+        } sMlme;
+        LmHandlerJoinParams_t sJoin;
+        LmHandlerTxParams_t sTx;
+        struct
+        {
+            LmHandlerRxParams_t sParams;
+            uint8_t ui8Port;
+            uint8_t ui8Size;      ///< size of the downlink payload
+            uint8_t ui8Truncated; ///< payload longer than LORAWAN_EVENT_BUS_PAYLOAD_MAX
+            uint8_t pui8Payload[LORAWAN_EVENT_BUS_PAYLOAD_MAX];
+        } sRx;
+        DeviceClass_t eClass;
+        LoRaMacHandlerBeaconParams_t sBeacon;
+        struct
+        {
+            bool bSynchronized;
+            int32_t i32Correction;
+        } sTime;
+    } uData;
+} lorawan_bus_event_t;
+
+typedef void (*lorawan_event_subscriber_t)(const lorawan_bus_event_t *psEvent, void *pvContext);
+
+typedef struct
+{
+    uint32_t ui32Published;    ///< events queued for the dispatcher
+    uint32_t ui32Overflows;    ///< events lost to a full ring
+    uint32_t ui32Deliveries;   ///< subscriber calls
+    uint32_t ui32LatencyTotal; ///< ms from the MAC callback to the delivery, summed
+    uint32_t ui32LatencyMax;   ///< ms
+} lorawan_event_bus_counters_t;
+
+typedef struct
+{
+    uint32_t ui32HighWater; ///< most events waiting at once
+    lorawan_event_bus_counters_t sEvents[LORAWAN_EVENTS];
+} lorawan_event_bus_stats_t;
+
+/**
+ * @brief Deliver an event to a subscriber in the dispatcher task.
+ *
+ * @param eEvent  Any event raised by LmHandler.  LORAWAN_EVENT_MAC_PROCESS,
+ *  LORAWAN_EVENT_SLEEP and LORAWAN_EVENT_WAKE are raised from interrupts or
+ *  must act before the stack goes on, they are only available through
+ *  lorawan_event_callback_register.
+ * @param pfnSubscriber  Called with a copy of the event.
+ * @param pvContext  Passed to the subscriber.
+ *
+ * @return 0 on success, -1 if the event cannot be subscribed to or all
+ *  LORAWAN_EVENT_BUS_SUBSCRIBERS slots of the event are taken.
+ *
+ * @remarks Subscribers run one after the other in a task below the
+ * LoRaWAN task priority, so they may block without delaying the receive
+ * windows.  The callback registered with lorawan_event_callback_register
+ * is still called synchronously.  The dispatcher task is created on the
+ * first subscription.
+ */
+extern int32_t lorawan_event_subscribe(lorawan_event_e eEvent,
+                                       lorawan_event_subscriber_t pfnSubscriber,
+                                       void *pvContext);
+
+extern void lorawan_event_unsubscribe(lorawan_event_e eEvent,
+                                      lorawan_event_subscriber_t pfnSubscriber,
+                                      void *pvContext);
+
+/**
+ * @brief Get a slot for an event raised by the MAC, NULL if the event has
+ * no subscriber or the ring is full.
+ *
+ * Called from the LoRaWAN task only; the slot is published by
+ * lorawan_event_bus_commit.
+ */
+extern lorawan_bus_event_t *lorawan_event_bus_reserve(lorawan_event_e eEvent);
+extern void lorawan_event_bus_commit();
+
+extern const char *lorawan_event_name(lorawan_event_e eEvent);
+
+extern void lorawan_event_bus_stats_get(lorawan_event_bus_stats_t *psStats);
+extern void lorawan_event_bus_stats_reset();
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,90 @@
+/*
+ * BSD 3-Clause License
+ *
+ * Copyright (c) 2024, Northern Mechatronics, Inc.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its
+ *    contributors may be used to endorse or promote products derived from
+ *    this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+#ifndef _LORAWAN_FLASH_H_
+#define _LORAWAN_FLASH_H_
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief Flash region holding the image rebuilt by the fragmentation
+ * decoder.
+ *
+ * Offsets are relative to the start of the region.  Programming can only
+ * clear bits, a page must be erased before its words are programmed again.
+ * Every operation reports the time it kept the flash busy in us, measured
+ * on the target and taken from a timing model on the host, so that the
+ * callers can account for it the same way on both.
+ */
+typedef struct
+{
+    uint32_t ui32Size;       ///< region size in bytes, a multiple of the page size
+    uint32_t ui32PageSize;   ///< erase unit in bytes
+    const uint8_t *pui8Base; ///< region contents, readable in place
+
+    /**
+     * Program ui32Words words at a word aligned offset.  Returns 0 on
+     * success.  Safe to call from a critical section.
+     */
+    int32_t (*pfnProgram)(uint32_t ui32Offset,
+                          const uint32_t *pui32Data,
+                          uint32_t ui32Words,
+                          uint32_t *pui32Time);
+
+    /**
+     * Erase a page to 0xFF.  Returns 0 on success.  Safe to call from a
+     * critical section.
+     */
+    int32_t (*pfnErase)(uint32_t ui32Page, uint32_t *pui32Time);
+
+    /**
+     * Copy data out of the region.  Returns 0 on success.
+     */
+    int32_t (*pfnRead)(uint32_t ui32Offset, uint8_t *pui8Data, uint32_t ui32Size);
+} lorawan_flash_t;
+
+/**
+ * @brief The OTA image region of the platform.
+ *
+ * Provided by lorawan_flash_apollo3.c on the target and by the host
+ * simulation, which backs it with a memory mapped file.
+ */
+extern const lorawan_flash_t *lorawan_flash_ota(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
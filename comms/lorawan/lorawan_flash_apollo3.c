@@ -0,0 +1,113 @@
+/*
+ * BSD 3-Clause License
+ *
+ * Copyright (c) 2024, Northern Mechatronics, Inc.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its
+ *    contributors may be used to endorse or promote products derived from
+ *    this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+#include <stdint.h>
+#include <string.h>
+
+#include <am_mcu_apollo.h>
+#include <am_util.h>
+
+#include "ota_config.h"
+
+#include "lorawan_flash.h"
+
+#define STIMER_HZ (32768)
+
+static int32_t apollo3_program(uint32_t ui32Offset,
+                               const uint32_t *pui32Data,
+                               uint32_t ui32Words,
+                               uint32_t *pui32Time);
+static int32_t apollo3_erase(uint32_t ui32Page, uint32_t *pui32Time);
+static int32_t apollo3_read(uint32_t ui32Offset, uint8_t *pui8Data, uint32_t ui32Size);
+
+static const lorawan_flash_t apollo3_ota = {
+    OTA_FLASH_MAX_SIZE,
+    AM_HAL_FLASH_PAGE_SIZE,
+    (const uint8_t *)OTA_FLASH_ADDRESS,
+    apollo3_program,
+    apollo3_erase,
+    apollo3_read,
+};
+
+static uint32_t apollo3_elapsed(uint32_t ui32Start)
+{
+    uint32_t ui32Ticks = am_hal_stimer_counter_get() - ui32Start;
+
+    return (uint32_t)(((uint64_t)ui32Ticks * 1000000) / STIMER_HZ);
+}
+
+static int32_t apollo3_program(uint32_t ui32Offset,
+                               const uint32_t *pui32Data,
+                               uint32_t ui32Words,
+                               uint32_t *pui32Time)
+{
+    uint32_t ui32Start;
+    int32_t i32Status;
+
+    AM_CRITICAL_BEGIN
+    ui32Start = am_hal_stimer_counter_get();
+    i32Status = am_hal_flash_program_main(AM_HAL_FLASH_PROGRAM_KEY,
+                                          (uint32_t *)pui32Data,
+                                          (uint32_t *)(OTA_FLASH_ADDRESS + ui32Offset),
+                                          ui32Words);
+    *pui32Time = apollo3_elapsed(ui32Start);
+    AM_CRITICAL_END
+
+    return i32Status;
+}
+
+static int32_t apollo3_erase(uint32_t ui32Page, uint32_t *pui32Time)
+{
+    uint32_t ui32Address = OTA_FLASH_ADDRESS + ui32Page * AM_HAL_FLASH_PAGE_SIZE;
+    uint32_t ui32Start;
+    int32_t i32Status;
+
+    AM_CRITICAL_BEGIN
+    ui32Start = am_hal_stimer_counter_get();
+    i32Status = am_hal_flash_page_erase(AM_HAL_FLASH_PROGRAM_KEY,
+                                        AM_HAL_FLASH_ADDR2INST(ui32Address),
+                                        AM_HAL_FLASH_ADDR2PAGE(ui32Address));
+    *pui32Time = apollo3_elapsed(ui32Start);
+    AM_CRITICAL_END
+
+    return i32Status;
+}
+
+static int32_t apollo3_read(uint32_t ui32Offset, uint8_t *pui8Data, uint32_t ui32Size)
+{
+    memcpy(pui8Data, (uint8_t *)(OTA_FLASH_ADDRESS + ui32Offset), ui32Size);
+    return 0;
+}
+
+const lorawan_flash_t *lorawan_flash_ota(void)
+{
+    return &apollo3_ota;
+}
@@ -0,0 +1,581 @@
+/*
+ * BSD 3-Clause License
+ *
+ * Copyright (c) 2024, Northern Mechatronics, Inc.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its
+ *    contributors may be used to endorse or promote products derived from
+ *    this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+
+#include <am_mcu_apollo.h>
+#include <am_util.h>
+
+#include <FreeRTOS.h>
+#include <task.h>
+
+#include "lorawan_flash.h"
+#include "lorawan_frag_store.h"
+
+#define PAGE_WORDS (LORAWAN_FRAG_STORE_PAGE_SIZE / 4)
+#define PAGE_NONE  (UINT32_MAX)
+
+#define WORD_WRITTEN (0xF)
+
+// A word written in part, held back until the rest of it is written.
+typedef struct
+{
+    uint32_t ui32Offset;
+    uint32_t ui32Data;
+    uint32_t ui32Written; ///< bytes of ui32Data written, one bit each
+} frag_store_partial_t;
+
+static uint32_t frag_store_image[PAGE_WORDS];
+static uint32_t frag_store_written[LORAWAN_FRAG_STORE_PAGE_SIZE / 32];
+static uint32_t frag_store_programmed[PAGE_WORDS / 32];
+static uint32_t frag_store_page = PAGE_NONE;
+
+static frag_store_partial_t frag_store_partial[LORAWAN_FRAG_STORE_PARTIAL_MAX];
+static uint32_t frag_store_partials;
+
+// Pages of the image area erased since the session was opened.  Only
+// changed with interrupts disabled, together with the erase itself.
+static uint32_t frag_store_erased[(LORAWAN_FRAG_STORE_PAGES_MAX + 31) / 32];
+static uint32_t frag_store_pages;
+static uint32_t frag_store_cursor;
+
+static TaskHandle_t frag_store_erase_task_handle;
+
+static lorawan_frag_store_stats_t frag_store_stats;
+
+/**
+ * Bytes of a word of the page image written since the page was loaded,
+ * one bit each.
+ */
+static uint32_t frag_store_written_get(uint32_t ui32Word)
+{
+    return (frag_store_written[ui32Word >> 3] >> ((ui32Word & 7) * 4)) & WORD_WRITTEN;
+}
+
+static void frag_store_written_set(uint32_t ui32Word, uint32_t ui32Written)
+{
+    frag_store_written[ui32Word >> 3] &= ~(WORD_WRITTEN << ((ui32Word & 7) * 4));
+    frag_store_written[ui32Word >> 3] |= ui32Written << ((ui32Word & 7) * 4);
+}
+
+static void frag_store_written_add(uint32_t ui32First, uint32_t ui32Last)
+{
+    for (uint32_t i = ui32First; i <= ui32Last; i++)
+    {
+        frag_store_written[i >> 5] |= 1u << (i & 31);
+    }
+}
+
+static bool frag_store_programmed_get(uint32_t ui32Word)
+{
+    return (frag_store_programmed[ui32Word >> 5] >> (ui32Word & 31)) & 1;
+}
+
+static bool frag_store_erased_get(uint32_t ui32Page)
+{
+    return (frag_store_erased[ui32Page >> 5] >> (ui32Page & 31)) & 1;
+}
+
+static uint32_t frag_store_page_size(void)
+{
+    return lorawan_flash_ota()->ui32PageSize;
+}
+
+static void frag_store_critical_account(uint32_t ui32Time)
+{
+    frag_store_stats.ui32Critical += ui32Time;
+    if (ui32Time > frag_store_stats.ui32CriticalMax)
+    {
+        frag_store_stats.ui32CriticalMax = ui32Time;
+    }
+}
+
+/**
+ * Erase a page unless it already is.  The test and the erase share one
+ * critical section so that the writer and the erase task never both erase
+ * a page, nor erase one that has been programmed since.
+ */
+static bool frag_store_erase(uint32_t ui32Page, bool bInline)
+{
+    uint32_t ui32Time = 0;
+    int32_t i32Status = 0;
+    bool bErased = false;
+
+    AM_CRITICAL_BEGIN
+    if ((ui32Page < frag_store_pages) && !frag_store_erased_get(ui32Page))
+    {
+        i32Status = lorawan_flash_ota()->pfnErase(ui32Page, &ui32Time);
+
+        frag_store_erased[ui32Page >> 5] |= 1u << (ui32Page & 31);
+        frag_store_stats.ui32ErasePending--;
+        if (bInline)
+        {
+            frag_store_stats.ui32ErasesInline++;
+        }
+        else
+        {
+            frag_store_stats.ui32Erases++;
+        }
+        if (i32Status)
+        {
+            frag_store_stats.ui32Errors++;
+        }
+        frag_store_critical_account(ui32Time);
+        bErased = true;
+    }
+    AM_CRITICAL_END
+
+    return bErased;
+}
+
+/**
+ * Erase the first pending page of the window ahead of the write cursor.
+ */
+static bool frag_store_erase_next(void)
+{
+    uint32_t ui32Cursor = frag_store_cursor;
+
+    for (uint32_t i = 0; i < LORAWAN_FRAG_STORE_ERASE_AHEAD; i++)
+    {
+        uint32_t ui32Page = ui32Cursor + i;
+        if (ui32Page >= frag_store_pages)
+        {
+            break;
+        }
+
+        if (!frag_store_erased_get(ui32Page))
+        {
+            frag_store_erase(ui32Page, false);
+            return true;
+        }
+    }
+
+    return false;
+}
+
+static void frag_store_erase_task(void *pvParameter)
+{
+    while (1)
+    {
+        ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+
+        while (frag_store_erase_next())
+        {
+            taskYIELD();
+        }
+    }
+}
+
+static int8_t frag_store_program(uint32_t ui32Word, uint32_t ui32Words)
+{
+    uint32_t ui32Offset = frag_store_page * frag_store_page_size() + ui32Word * 4;
+    uint32_t ui32Time = 0;
+    int32_t i32Status;
+
+    i32Status = lorawan_flash_ota()->pfnProgram(ui32Offset,
+                                                &frag_store_image[ui32Word],
+                                                ui32Words,
+                                                &ui32Time);
+
+    AM_CRITICAL_BEGIN
+    frag_store_stats.ui32Programs++;
+    frag_store_stats.ui32Words += ui32Words;
+    frag_store_critical_account(ui32Time);
+    AM_CRITICAL_END
+
+    for (uint32_t i = ui32Word; i < ui32Word + ui32Words; i++)
+    {
+        if (frag_store_programmed_get(i))
+        {
+            frag_store_stats.ui32Reprograms++;
+        }
+    }
+
+    if (i32Status)
+    {
+        frag_store_stats.ui32Errors++;
+        return -1;
+    }
+
+    return 0;
+}
+
+/**
+ * Hold back a word written in part until the rest of it is written, so
+ * that it is programmed once.  Returns false when there is no room left.
+ */
+static bool frag_store_partial_hold(uint32_t ui32Word, uint32_t ui32Written)
+{
+    if (frag_store_partials == LORAWAN_FRAG_STORE_PARTIAL_MAX)
+    {
+        return false;
+    }
+
+    frag_store_partial_t *psPartial = &frag_store_partial[frag_store_partials++];
+    psPartial->ui32Offset = frag_store_page * frag_store_page_size() + ui32Word * 4;
+    psPartial->ui32Data = frag_store_image[ui32Word];
+    psPartial->ui32Written = ui32Written;
+    frag_store_stats.ui32Partials++;
+
+    return true;
+}
+
+/**
+ * Return the words of a page held back to its image.
+ */
+static void frag_store_partial_restore(uint32_t ui32Page)
+{
+    uint32_t ui32PageSize = frag_store_page_size();
+
+    uint32_t i = 0;
+    while (i < frag_store_partials)
+    {
+        frag_store_partial_t *psPartial = &frag_store_partial[i];
+
+        if (psPartial->ui32Offset / ui32PageSize != ui32Page)
+        {
+            i++;
+            continue;
+        }
+
+        uint32_t ui32Word = (psPartial->ui32Offset % ui32PageSize) / 4;
+        frag_store_image[ui32Word] = psPartial->ui32Data;
+        frag_store_written_set(ui32Word, psPartial->ui32Written);
+
+        *psPartial = frag_store_partial[--frag_store_partials];
+    }
+}
+
+/**
+ * Copy the bytes held back into data read from the flash.
+ */
+static void frag_store_partial_read(uint32_t ui32Offset, uint8_t *pui8Data, uint32_t ui32Size)
+{
+    for (uint32_t i = 0; i < frag_store_partials; i++)
+    {
+        frag_store_partial_t *psPartial = &frag_store_partial[i];
+        const uint8_t *pui8Partial = (const uint8_t *)&psPartial->ui32Data;
+
+        for (uint32_t j = 0; j < 4; j++)
+        {
+            uint32_t ui32Byte = psPartial->ui32Offset + j;
+
+            if (((psPartial->ui32Written >> j) & 1) && (ui32Byte >= ui32Offset) &&
+                (ui32Byte < ui32Offset + ui32Size))
+            {
+                pui8Data[ui32Byte - ui32Offset] = pui8Partial[j];
+            }
+        }
+    }
+}
+
+/**
+ * Program the words of the page image written since it was loaded.  Words
+ * shared with data not written yet, that of a lost fragment recovered at
+ * the end of the session, are held back unless bFinal is set.
+ */
+static int8_t frag_store_page_flush(bool bFinal)
+{
+    uint32_t ui32PageWords = frag_store_page_size() / 4;
+    int8_t i8Status = 0;
+    bool bProgrammed = false;
+
+    if (frag_store_page == PAGE_NONE)
+    {
+        return 0;
+    }
+
+    frag_store_erase(frag_store_page, true);
+
+    uint32_t i = 0;
+    while (i < ui32PageWords)
+    {
+        uint32_t ui32Written = frag_store_written_get(i);
+
+        if ((ui32Written == 0) ||
+            ((ui32Written != WORD_WRITTEN) && !bFinal && frag_store_partial_hold(i, ui32Written)))
+        {
+            i++;
+            continue;
+        }
+
+        uint32_t ui32Run = 1;
+        while ((i + ui32Run < ui32PageWords) && (ui32Run < LORAWAN_FRAG_STORE_PROGRAM_WORDS) &&
+               (bFinal ? frag_store_written_get(i + ui32Run) != 0
+                       : frag_store_written_get(i + ui32Run) == WORD_WRITTEN))
+        {
+            ui32Run++;
+        }
+
+        if (frag_store_program(i, ui32Run))
+        {
+            i8Status = -1;
+        }
+        bProgrammed = true;
+        i += ui32Run;
+    }
+
+    if (bProgrammed)
+    {
+        frag_store_stats.ui32Pages++;
+    }
+
+    memset(frag_store_written, 0, sizeof(frag_store_written));
+    frag_store_page = PAGE_NONE;
+
+    return i8Status;
+}
+
+static int8_t frag_store_load(uint32_t ui32Page)
+{
+    uint32_t ui32PageSize = frag_store_page_size();
+    int8_t i8Status = frag_store_page_flush(false);
+
+    // Start from the flash contents so that partly written words keep the
+    // bytes already programmed and the others erased.  A page still to be
+    // erased holds data of a previous image.
+    memset(frag_store_programmed, 0, sizeof(frag_store_programmed));
+    if (frag_store_erased_get(ui32Page))
+    {
+        lorawan_flash_ota()->pfnRead(ui32Page * ui32PageSize,
+                                     (uint8_t *)frag_store_image,
+                                     ui32PageSize);
+
+        for (uint32_t i = 0; i < ui32PageSize / 4; i++)
+        {
+            if (frag_store_image[i] != UINT32_MAX)
+            {
+                frag_store_programmed[i >> 5] |= 1u << (i & 31);
+            }
+        }
+    }
+    else
+    {
+        memset(frag_store_image, 0xFF, ui32PageSize);
+    }
+    frag_store_page = ui32Page;
+
+    frag_store_partial_restore(ui32Page);
+
+    return i8Status;
+}
+
+int8_t lorawan_frag_store_flush(void)
+{
+    int8_t i8Status = frag_store_page_flush(true);
+
+    // What is still held back will not be completed any more.
+    while (frag_store_partials)
+    {
+        uint32_t ui32Page = frag_store_partial[0].ui32Offset / frag_store_page_size();
+
+        if (frag_store_load(ui32Page) || frag_store_page_flush(true))
+        {
+            i8Status = -1;
+        }
+    }
+
+    return i8Status;
+}
+
+void lorawan_frag_store_open(uint32_t ui32Size)
+{
+    const lorawan_flash_t *psFlash = lorawan_flash_ota();
+    uint32_t ui32Pages = (ui32Size + psFlash->ui32PageSize - 1) / psFlash->ui32PageSize;
+
+    if (ui32Pages > psFlash->ui32Size / psFlash->ui32PageSize)
+    {
+        ui32Pages = psFlash->ui32Size / psFlash->ui32PageSize;
+    }
+
+    if (ui32Pages > LORAWAN_FRAG_STORE_PAGES_MAX)
+    {
+        ui32Pages = LORAWAN_FRAG_STORE_PAGES_MAX;
+    }
+
+    memset(frag_store_written, 0, sizeof(frag_store_written));
+    frag_store_page = PAGE_NONE;
+    frag_store_partials = 0;
+
+    AM_CRITICAL_BEGIN
+    memset(frag_store_erased, 0, sizeof(frag_store_erased));
+    frag_store_pages = ui32Pages;
+    frag_store_cursor = 0;
+    frag_store_stats.ui32ErasePending = frag_store_pages;
+    AM_CRITICAL_END
+
+    if (frag_store_erase_task_handle == NULL)
+    {
+        xTaskCreate(frag_store_erase_task,
+                    "frag erase",
+                    256,
+                    0,
+                    LORAWAN_FRAG_STORE_ERASE_PRIORITY,
+                    &frag_store_erase_task_handle);
+    }
+    xTaskNotifyGive(frag_store_erase_task_handle);
+}
+
+int8_t lorawan_frag_store_write(uint32_t ui32Offset, uint8_t *pui8Data, uint32_t ui32Size)
+{
+    int8_t i8Status = 0;
+
+    const lorawan_flash_t *psFlash = lorawan_flash_ota();
+    uint32_t ui32PageSize = psFlash->ui32PageSize;
+
+    // Only the pages opened for the session are erased before they are
+    // programmed.
+    uint32_t ui32ImageSize = frag_store_pages * ui32PageSize;
+
+    if ((ui32Offset >= ui32ImageSize) || (ui32Size > ui32ImageSize - ui32Offset) ||
+        (ui32PageSize > LORAWAN_FRAG_STORE_PAGE_SIZE))
+    {
+        return -1;
+    }
+
+    frag_store_stats.ui32Writes++;
+    frag_store_stats.ui32Bytes += ui32Size;
+
+    while (ui32Size)
+    {
+        uint32_t ui32Page = ui32Offset / ui32PageSize;
+        uint32_t ui32Start = ui32Offset % ui32PageSize;
+        uint32_t ui32Length = ui32PageSize - ui32Start;
+
+        if (ui32Length > ui32Size)
+        {
+            ui32Length = ui32Size;
+        }
+
+        if ((ui32Page != frag_store_page) && frag_store_load(ui32Page))
+        {
+            i8Status = -1;
+        }
+        // Move the erase window along with the writes.
+        if (ui32Page != frag_store_cursor)
+        {
+            frag_store_cursor = ui32Page;
+            xTaskNotifyGive(frag_store_erase_task_handle);
+        }
+
+        memcpy((uint8_t *)frag_store_image + ui32Start, pui8Data, ui32Length);
+        frag_store_written_add(ui32Start, ui32Start + ui32Length - 1);
+
+        // The decoder fills the image in order, barring lost fragments
+        // recovered at the end, so a page is complete once its last byte
+        // has been written.
+        if ((ui32Start + ui32Length == ui32PageSize) && frag_store_page_flush(false))
+        {
+            i8Status = -1;
+        }
+
+        ui32Offset += ui32Length;
+        pui8Data += ui32Length;
+        ui32Size -= ui32Length;
+    }
+
+    return i8Status;
+}
+
+int8_t lorawan_frag_store_read(uint32_t ui32Offset, uint8_t *pui8Data, uint32_t ui32Size)
+{
+    bool bStaged = false;
+
+    const lorawan_flash_t *psFlash = lorawan_flash_ota();
+    uint32_t ui32PageSize = psFlash->ui32PageSize;
+
+    if ((ui32Offset > psFlash->ui32Size) || (ui32Size > psFlash->ui32Size - ui32Offset) ||
+        (ui32PageSize > LORAWAN_FRAG_STORE_PAGE_SIZE))
+    {
+        return -1;
+    }
+
+    frag_store_stats.ui32Reads++;
+
+    while (ui32Size)
+    {
+        uint32_t ui32Page = ui32Offset / ui32PageSize;
+        uint32_t ui32Start = ui32Offset % ui32PageSize;
+        uint32_t ui32Length = ui32PageSize - ui32Start;
+
+        if (ui32Length > ui32Size)
+        {
+            ui32Length = ui32Size;
+        }
+
+        if (ui32Page == frag_store_page)
+        {
+            memcpy(pui8Data, (uint8_t *)frag_store_image + ui32Start, ui32Length);
+            bStaged = true;
+        }
+        else
+        {
+            if (!frag_store_erased_get(ui32Page))
+            {
+                memset(pui8Data, 0xFF, ui32Length);
+            }
+            else
+            {
+                psFlash->pfnRead(ui32Offset, pui8Data, ui32Length);
+            }
+            frag_store_partial_read(ui32Offset, pui8Data, ui32Length);
+        }
+
+        ui32Offset += ui32Length;
+        pui8Data += ui32Length;
+        ui32Size -= ui32Length;
+    }
+
+    if (bStaged)
+    {
+        frag_store_stats.ui32StagedReads++;
+    }
+
+    return 0;
+}
+
+void lorawan_frag_store_stats_get(lorawan_frag_store_stats_t *psStats)
+{
+    AM_CRITICAL_BEGIN
+    memcpy(psStats, &frag_store_stats, sizeof(lorawan_frag_store_stats_t));
+    AM_CRITICAL_END
+}
+
+void lorawan_frag_store_stats_reset(void)
+{
+    AM_CRITICAL_BEGIN
+    uint32_t ui32Pending = frag_store_stats.ui32ErasePending;
+    memset(&frag_store_stats, 0, sizeof(lorawan_frag_store_stats_t));
+    frag_store_stats.ui32ErasePending = ui32Pending;
+    AM_CRITICAL_END
+}
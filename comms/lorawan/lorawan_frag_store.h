@@ -0,0 +1,166 @@
+/*
+ * BSD 3-Clause License
+ *
+ * Copyright (c) 2024, Northern Mechatronics, Inc.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its
+ *    contributors may be used to endorse or promote products derived from
+ *    this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+#ifndef _LORAWAN_FRAG_STORE_H_
+#define _LORAWAN_FRAG_STORE_H_
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief Size of the RAM page image, at least the flash page size.
+ */
+#ifndef LORAWAN_FRAG_STORE_PAGE_SIZE
+#define LORAWAN_FRAG_STORE_PAGE_SIZE (8192)
+#endif
+
+/**
+ * @brief Most flash pages an image may span.
+ */
+#ifndef LORAWAN_FRAG_STORE_PAGES_MAX
+#define LORAWAN_FRAG_STORE_PAGES_MAX (64)
+#endif
+
+/**
+ * @brief Words programmed with interrupts disabled at a time.  Bounds the
+ * interrupt latency seen by the radio during class C reception.
+ */
+#ifndef LORAWAN_FRAG_STORE_PROGRAM_WORDS
+#define LORAWAN_FRAG_STORE_PROGRAM_WORDS (128)
+#endif
+
+/**
+ * @brief Most words held back at a time because they share bytes with
+ * data not written yet, two for each lost fragment of a page already
+ * programmed.  Beyond that they are programmed at once and programmed
+ * again when the rest arrives.  The decoder recovers at most
+ * FRAG_MAX_REDUNDANCY lost fragments.
+ */
+#ifndef LORAWAN_FRAG_STORE_PARTIAL_MAX
+#ifdef FRAG_MAX_REDUNDANCY
+#define LORAWAN_FRAG_STORE_PARTIAL_MAX (2 * FRAG_MAX_REDUNDANCY)
+#else
+#define LORAWAN_FRAG_STORE_PARTIAL_MAX (128)
+#endif
+#endif
+
+/**
+ * @brief Pages kept erased from the one being written on.  The decoder
+ * writes in order, so the writer only waits for an erase when it moves
+ * past the window, or goes back to a page for a lost fragment.
+ */
+#ifndef LORAWAN_FRAG_STORE_ERASE_AHEAD
+#define LORAWAN_FRAG_STORE_ERASE_AHEAD (2)
+#endif
+
+/**
+ * @brief Priority of the task erasing the image area ahead of the writes.
+ */
+#ifndef LORAWAN_FRAG_STORE_ERASE_PRIORITY
+#define LORAWAN_FRAG_STORE_ERASE_PRIORITY (1)
+#endif
+
+typedef struct
+{
+    uint32_t ui32Writes;       ///< fragment writes from the decoder
+    uint32_t ui32Bytes;        ///< bytes written by the decoder
+    uint32_t ui32Reads;        ///< reads from the decoder
+    uint32_t ui32StagedReads;  ///< reads served at least in part from the page image
+    uint32_t ui32Pages;        ///< page images written back to flash
+    uint32_t ui32Programs;     ///< flash program operations
+    uint32_t ui32Words;        ///< words programmed
+    uint32_t ui32Partials;     ///< words held back until the rest of them was written
+    uint32_t ui32Reprograms;   ///< words programmed a second time, should be zero
+    uint32_t ui32Errors;       ///< failed program and erase operations
+    uint32_t ui32Erases;       ///< pages erased in the background
+    uint32_t ui32ErasesInline; ///< pages the writer had to erase itself
+    uint32_t ui32ErasePending; ///< pages of the current image not erased yet
+    uint32_t ui32Critical;     ///< us the flash was busy, with interrupts disabled on the target
+    uint32_t ui32CriticalMax;  ///< longest single flash operation in us
+} lorawan_frag_store_stats_t;
+
+/**
+ * @brief Prepare the image area for a new session.
+ *
+ * Returns at once.  A low priority task keeps the
+ * LORAWAN_FRAG_STORE_ERASE_AHEAD pages from the one being written on
+ * erased, one at a time, so the previous image is only erased as the new
+ * one replaces it.  A page still pending when it is about to be
+ * programmed is erased then.  Reads of pages not erased yet return 0xFF.
+ *
+ * @param ui32Size  Image size in bytes.
+ */
+extern void lorawan_frag_store_open(uint32_t ui32Size);
+
+/**
+ * @brief Write decoded data into the image area.
+ *
+ * Data is gathered in a RAM image of one flash page.  The page is
+ * programmed when a write reaches its end, when a write falls into another
+ * page, and on lorawan_frag_store_flush().  Only the words written since
+ * the image was loaded are programmed, in runs of up to
+ * LORAWAN_FRAG_STORE_PROGRAM_WORDS words per critical section.  A word
+ * only written in part, next to a lost fragment, is held back until the
+ * fragment is recovered, so that every word is programmed once as long as
+ * no more than LORAWAN_FRAG_STORE_PARTIAL_MAX are held at a time.
+ *
+ * @param ui32Offset  Byte offset in the OTA region of lorawan_flash.h, any
+ *  alignment.
+ * @param pui8Data  Data to write.
+ * @param ui32Size  Bytes to write, any length.
+ *
+ * @return 0 on success, -1 when outside the pages opened by
+ *  lorawan_frag_store_open() or on a program error.
+ */
+extern int8_t lorawan_frag_store_write(uint32_t ui32Offset, uint8_t *pui8Data, uint32_t ui32Size);
+
+/**
+ * @brief Read back the image, including data still in the page image.
+ */
+extern int8_t lorawan_frag_store_read(uint32_t ui32Offset, uint8_t *pui8Data, uint32_t ui32Size);
+
+/**
+ * @brief Program what is left in the page image and the words held back,
+ * at the end of a session.
+ */
+extern int8_t lorawan_frag_store_flush(void);
+
+extern void lorawan_frag_store_stats_get(lorawan_frag_store_stats_t *psStats);
+extern void lorawan_frag_store_stats_reset(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
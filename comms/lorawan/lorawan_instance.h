@@ -0,0 +1,142 @@
+/*
+ * BSD 3-Clause License
+ *
+ * Copyright (c) 2024, Northern Mechatronics, Inc.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its
+ *    contributors may be used to endorse or promote products derived from
+ *    this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+#ifndef _LORAWAN_INSTANCE_H_
+#define _LORAWAN_INSTANCE_H_
+
+#include <stdint.h>
+
+#include <FreeRTOS.h>
+#include <queue.h>
+
+#include <LmHandler.h>
+#include <LmhpFragmentation.h>
+#include <secure-element-nvm.h>
+#include <timer.h>
+
+#include "lorawan.h"
+#include "lorawan_port.h"
+#include "lorawan_task.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define LORAWAN_DATA_BUFFER_SIZE (242)
+
+typedef struct
+{
+    LmHandlerMsgTypes_t tType;
+    uint32_t ui32Port;
+    uint32_t ui32Length;
+    uint8_t *pui8Data;
+    TickType_t tEnqueued;
+    uint32_t ui32TimeToLive;
+    uint32_t ui32Urgent;
+} lorawan_tx_packet_t;
+
+//
+// Uplink being sent in segments.  It leaves the transmit queue when its
+// first segment is sent and holds back the queue until its last one is.
+//
+typedef struct
+{
+    lorawan_tx_packet_t sPacket;
+    uint32_t ui32Active;
+    uint32_t ui32Offset; ///< bytes of the uplink already sent
+    uint8_t ui8Index;    ///< index of the next segment
+    uint8_t ui8Id;       ///< message id of the uplink
+} lorawan_segment_state_t;
+
+//
+// Join retry scheduler.  The retries run on the MAC timer so that they
+// follow the same clock as the duty cycle restrictions.
+//
+typedef struct
+{
+    TimerEvent_t sTimer;
+    volatile uint32_t ui32Due;       ///< retry timer expired
+    volatile uint32_t ui32Requested; ///< join asked for by an uplink while unjoined
+    uint32_t ui32InFlight;           ///< join request handed to the MAC
+    uint32_t ui32Consecutive;        ///< failures since the last join start
+    TimerTime_t tNext;               ///< time of the scheduled retry
+    uint32_t ui32Window;             ///< backoff window, see lorawan_join_windows
+    uint32_t ui32WindowValid;
+    TimerTime_t tWindowStart;
+    uint32_t ui32WindowAirtime;      ///< join request airtime in the window (ms)
+} lorawan_join_state_t;
+
+typedef struct
+{
+    volatile lorawan_stack_state_e eStackState;
+    uint32_t ui32RadioPortPowered;
+    uint32_t ui32MulticastPreempt;
+    uint32_t ui32MulticastHeld; ///< uplinks held in the current multicast session
+    uint32_t ui32Segmentation;
+    uint32_t ui32FastBoot;
+
+    LmHandlerParams_t sParameters;
+    LmHandlerCallbacks_t sCallbacks;
+    LmhpFragmentationParams_t sFragmentationParameters;
+    lorawan_event_callback_t pfnEventCallbacks[LORAWAN_EVENTS];
+    SecureElementNvmData_t sSecureElement;
+
+    QueueHandle_t xTransmitQueue;
+    lorawan_transmit_stats_t sTransmitStats;
+    lorawan_join_stats_t sJoinStats;
+    lorawan_join_state_t sJoin;
+    lorawan_segment_state_t sSegment;
+    lorawan_port_state_t sPort;
+
+    uint8_t pui8DataBuffer[LORAWAN_DATA_BUFFER_SIZE];
+} lorawan_instance_t;
+
+//
+// The device context.  There is exactly one per process: LoRaMac-node
+// keeps the MAC state in file scope variables, so a second context could
+// never have its stack started.  It is addressed statically, the generated
+// code is the same as with plain globals.
+//
+extern lorawan_instance_t lorawan_instance;
+#define LORAWAN_INSTANCE (&lorawan_instance)
+
+static inline lorawan_event_callback_t lorawan_event_callback(lorawan_event_e eEvent)
+{
+    return LORAWAN_INSTANCE->pfnEventCallbacks[eEvent];
+}
+
+extern void lorawan_se_init(SecureElementNvmData_t *psSecureElement);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,264 @@
+/*
+ * BSD 3-Clause License
+ *
+ * Copyright (c) 2024, Northern Mechatronics, Inc.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its
+ *    contributors may be used to endorse or promote products derived from
+ *    this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+
+#include <FreeRTOS.h>
+#include <task.h>
+
+#include "lorawan_latency.h"
+
+typedef struct
+{
+    bool bActive;
+    bool bSent;
+    bool bFinal;
+    volatile bool bTxDone;
+    uint32_t ui32Port;
+    uint32_t ui32Urgent;
+    TickType_t tEnqueued;
+    TickType_t tDequeued;
+    TickType_t tSent;
+    volatile TickType_t tTxDone;
+} lorawan_latency_inflight_t;
+
+static const char *const lorawan_latency_stage_names[LORAWAN_LATENCY_STAGES] = {
+    "queue",
+    "send",
+    "tx",
+    "rx",
+    "total",
+};
+
+static lorawan_latency_inflight_t lorawan_latency_inflight;
+static lorawan_latency_stats_t lorawan_latency_sets[LORAWAN_LATENCY_CLASSES + 1];
+static bool lorawan_latency_used[LORAWAN_LATENCY_CLASSES + 1];
+
+static lorawan_latency_stats_t *lorawan_latency_set(uint32_t ui32Port, uint32_t ui32Urgent)
+{
+    for (uint32_t i = 0; i < LORAWAN_LATENCY_CLASSES; i++)
+    {
+        lorawan_latency_stats_t *psSet = &lorawan_latency_sets[i];
+
+        if (!lorawan_latency_used[i])
+        {
+            lorawan_latency_used[i] = true;
+            psSet->ui32Port = ui32Port;
+            psSet->ui32Urgent = ui32Urgent;
+            return psSet;
+        }
+
+        if ((psSet->ui32Port == ui32Port) && (psSet->ui32Urgent == ui32Urgent))
+        {
+            return psSet;
+        }
+    }
+
+    lorawan_latency_used[LORAWAN_LATENCY_CLASSES] = true;
+    return &lorawan_latency_sets[LORAWAN_LATENCY_CLASSES];
+}
+
+static void lorawan_latency_add(lorawan_latency_stats_t *psSet,
+                                lorawan_latency_stage_e eStage,
+                                TickType_t tFrom,
+                                TickType_t tTo)
+{
+    uint32_t ui32Latency = (tTo - tFrom) * portTICK_PERIOD_MS;
+    uint32_t ui32Bucket = 0;
+
+    if (ui32Latency)
+    {
+        ui32Bucket = 32 - __builtin_clz(ui32Latency);
+        if (ui32Bucket >= LORAWAN_LATENCY_BUCKETS)
+        {
+            ui32Bucket = LORAWAN_LATENCY_BUCKETS - 1;
+        }
+    }
+
+    psSet->pui32Histogram[eStage][ui32Bucket]++;
+    if (ui32Latency > psSet->pui32Max[eStage])
+    {
+        psSet->pui32Max[eStage] = ui32Latency;
+    }
+}
+
+void lorawan_latency_dequeue(uint32_t ui32Port, uint32_t ui32Urgent, TickType_t tEnqueued)
+{
+    lorawan_latency_inflight_t *psInflight = &lorawan_latency_inflight;
+
+    psInflight->bActive = true;
+    psInflight->bSent = false;
+    psInflight->bFinal = false;
+    psInflight->bTxDone = false;
+    psInflight->ui32Port = ui32Port;
+    psInflight->ui32Urgent = ui32Urgent;
+    psInflight->tEnqueued = tEnqueued;
+    psInflight->tDequeued = xTaskGetTickCount();
+}
+
+void lorawan_latency_sent(bool bFinal)
+{
+    lorawan_latency_inflight_t *psInflight = &lorawan_latency_inflight;
+
+    if (!psInflight->bActive)
+    {
+        return;
+    }
+
+    // The stages of a segmented uplink run from its first frame to the
+    // confirmation of its last one.
+    if (!psInflight->bSent)
+    {
+        psInflight->tSent = xTaskGetTickCount();
+        psInflight->bSent = true;
+    }
+    psInflight->bFinal = bFinal;
+    psInflight->bTxDone = false;
+}
+
+void lorawan_latency_tx_done_from_isr()
+{
+    lorawan_latency_inflight_t *psInflight = &lorawan_latency_inflight;
+
+    if (psInflight->bSent && !psInflight->bTxDone)
+    {
+        psInflight->tTxDone = xTaskGetTickCountFromISR();
+        psInflight->bTxDone = true;
+    }
+}
+
+void lorawan_latency_confirm()
+{
+    lorawan_latency_inflight_t *psInflight = &lorawan_latency_inflight;
+
+    if (!psInflight->bActive || !psInflight->bSent || !psInflight->bFinal)
+    {
+        return;
+    }
+
+    TickType_t tConfirmed = xTaskGetTickCount();
+    TickType_t tTxDone = psInflight->bTxDone ? psInflight->tTxDone : tConfirmed;
+
+    taskENTER_CRITICAL();
+    lorawan_latency_stats_t *psSet =
+        lorawan_latency_set(psInflight->ui32Port, psInflight->ui32Urgent);
+    lorawan_latency_add(psSet, LORAWAN_LATENCY_QUEUE, psInflight->tEnqueued, psInflight->tDequeued);
+    lorawan_latency_add(psSet, LORAWAN_LATENCY_SEND, psInflight->tDequeued, psInflight->tSent);
+    lorawan_latency_add(psSet, LORAWAN_LATENCY_TX, psInflight->tSent, tTxDone);
+    lorawan_latency_add(psSet, LORAWAN_LATENCY_RX, tTxDone, tConfirmed);
+    lorawan_latency_add(psSet, LORAWAN_LATENCY_TOTAL, psInflight->tEnqueued, tConfirmed);
+    psSet->ui32Count++;
+    taskEXIT_CRITICAL();
+
+    psInflight->bActive = false;
+}
+
+void lorawan_latency_abort()
+{
+    lorawan_latency_inflight_t *psInflight = &lorawan_latency_inflight;
+
+    if (!psInflight->bActive)
+    {
+        return;
+    }
+
+    taskENTER_CRITICAL();
+    lorawan_latency_set(psInflight->ui32Port, psInflight->ui32Urgent)->ui32Aborted++;
+    taskEXIT_CRITICAL();
+
+    psInflight->bActive = false;
+}
+
+bool lorawan_latency_stats_get(uint32_t ui32Index, lorawan_latency_stats_t *psStats)
+{
+    bool bUsed = false;
+
+    if (ui32Index > LORAWAN_LATENCY_CLASSES)
+    {
+        return false;
+    }
+
+    taskENTER_CRITICAL();
+    if (lorawan_latency_used[ui32Index])
+    {
+        memcpy(psStats, &lorawan_latency_sets[ui32Index], sizeof(lorawan_latency_stats_t));
+        bUsed = true;
+    }
+    taskEXIT_CRITICAL();
+
+    return bUsed;
+}
+
+void lorawan_latency_stats_reset()
+{
+    taskENTER_CRITICAL();
+    memset(lorawan_latency_sets, 0, sizeof(lorawan_latency_sets));
+    memset(lorawan_latency_used, 0, sizeof(lorawan_latency_used));
+    taskEXIT_CRITICAL();
+}
+
+const char *lorawan_latency_stage_name(lorawan_latency_stage_e eStage)
+{
+    return (eStage < LORAWAN_LATENCY_STAGES) ? lorawan_latency_stage_names[eStage] : "";
+}
+
+uint32_t lorawan_latency_percentile(const lorawan_latency_stats_t *psStats,
+                                    lorawan_latency_stage_e eStage,
+                                    uint32_t ui32Permille)
+{
+    uint32_t ui32Total = 0;
+
+    for (uint32_t i = 0; i < LORAWAN_LATENCY_BUCKETS; i++)
+    {
+        ui32Total += psStats->pui32Histogram[eStage][i];
+    }
+
+    if (ui32Total == 0)
+    {
+        return 0;
+    }
+
+    uint32_t ui32Rank = (uint32_t)(((uint64_t)ui32Total * ui32Permille + 999) / 1000);
+    uint32_t ui32Count = 0;
+    for (uint32_t i = 0; i < LORAWAN_LATENCY_BUCKETS - 1; i++)
+    {
+        ui32Count += psStats->pui32Histogram[eStage][i];
+        if (ui32Count >= ui32Rank)
+        {
+            uint32_t ui32Bound = (i == 0) ? 0 : ((1u << i) - 1);
+            return (ui32Bound < psStats->pui32Max[eStage]) ? ui32Bound : psStats->pui32Max[eStage];
+        }
+    }
+
+    return psStats->pui32Max[eStage];
+}
@@ -0,0 +1,127 @@
+/*
+ * BSD 3-Clause License
+ *
+ * Copyright (c) 2024, Northern Mechatronics, Inc.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its
+ *    contributors may be used to endorse or promote products derived from
+ *    this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+#ifndef _LORAWAN_LATENCY_H_
+#define _LORAWAN_LATENCY_H_
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include <FreeRTOS.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief Histogram sets, one per priority and port pair seen.  Uplinks of
+ * further pairs are accounted in an extra set with port 0.
+ */
+#ifndef LORAWAN_LATENCY_CLASSES
+#define LORAWAN_LATENCY_CLASSES (4)
+#endif
+
+/**
+ * @brief Bucket 0 counts 0 ms, bucket n counts [2^(n-1), 2^n) ms and the
+ * last bucket everything above.
+ */
+#define LORAWAN_LATENCY_BUCKETS (18)
+
+typedef enum
+{
+    LORAWAN_LATENCY_QUEUE = 0, ///< lorawan_transmit to the uplink leaving the transmit queue
+    LORAWAN_LATENCY_SEND,      ///< leaving the queue to LmHandlerSend accepting the frame
+    LORAWAN_LATENCY_TX,        ///< LmHandlerSend to the radio TX done interrupt
+    LORAWAN_LATENCY_RX,        ///< TX done to the transmit confirmation, after the receive windows
+    LORAWAN_LATENCY_TOTAL,     ///< lorawan_transmit to the transmit confirmation
+    LORAWAN_LATENCY_STAGES
+} lorawan_latency_stage_e;
+
+typedef struct
+{
+    uint32_t ui32Port;   ///< 0 for the set collecting the pairs that did not get their own
+    uint32_t ui32Urgent;
+    uint32_t ui32Count;  ///< uplinks completed
+    uint32_t ui32Aborted;
+    uint32_t pui32Max[LORAWAN_LATENCY_STAGES]; ///< ms
+    uint32_t pui32Histogram[LORAWAN_LATENCY_STAGES][LORAWAN_LATENCY_BUCKETS];
+} lorawan_latency_stats_t;
+
+/**
+ * @brief Timestamps taken by the LoRaWAN task along the uplink path.
+ *
+ * One uplink is in flight at a time.  lorawan_latency_dequeue starts it,
+ * lorawan_latency_sent is called for every frame handed to the MAC, the
+ * last frame of a segmented uplink with bFinal set, and
+ * lorawan_latency_confirm closes it.
+ */
+extern void lorawan_latency_dequeue(uint32_t ui32Port, uint32_t ui32Urgent, TickType_t tEnqueued);
+extern void lorawan_latency_sent(bool bFinal);
+extern void lorawan_latency_confirm();
+extern void lorawan_latency_abort();
+
+/**
+ * @brief Radio interrupt raised while transmitting, called from the ISR.
+ */
+extern void lorawan_latency_tx_done_from_isr();
+
+/**
+ * @brief Read a histogram set.
+ *
+ * @param ui32Index  0 to LORAWAN_LATENCY_CLASSES, the last index is the
+ *  set collecting the remaining pairs.
+ * @param psStats  Filled with the set.
+ *
+ * @return false if the set is not in use.
+ */
+extern bool lorawan_latency_stats_get(uint32_t ui32Index, lorawan_latency_stats_t *psStats);
+extern void lorawan_latency_stats_reset();
+
+extern const char *lorawan_latency_stage_name(lorawan_latency_stage_e eStage);
+
+/**
+ * @brief Latency below which a fraction of the uplinks completed a stage.
+ *
+ * @param psStats  Histogram set.
+ * @param eStage  Stage.
+ * @param ui32Permille  Fraction of the uplinks, in permille.
+ *
+ * @return Upper bound of the bucket holding the percentile, in ms.
+ */
+extern uint32_t lorawan_latency_percentile(const lorawan_latency_stats_t *psStats,
+                                           lorawan_latency_stage_e eStage,
+                                           uint32_t ui32Permille);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,798 @@
+/*
+ * BSD 3-Clause License
+ *
+ * Copyright (c) 2024, Northern Mechatronics, Inc.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its
+ *    contributors may be used to endorse or promote products derived from
+ *    this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+#include <am_mcu_apollo.h>
+
+#include <FreeRTOS.h>
+#include <task.h>
+#include <timers.h>
+
+#include <LoRaMac.h>
+#include <NvmDataMgmt.h>
+#include <nvmm.h>
+#include <utilities.h>
+
+#include "lorawan_nvm.h"
+#include "lorawan_task.h"
+
+//
+// This module replaces NvmDataMgmt.c of the LoRaMac-node applications.
+//
+// The emulated EEPROM holds the context image, laid out as the SDK
+// stores it, followed by the journal.  The journal starts with its
+// generation and is filled with delta records, each flush closed by a
+// commit record carrying a running CRC seeded with the generation.
+// Records of a previous generation or of an interrupted flush fail the
+// commit check and end the replay.
+//
+#define NVM_IMAGE_SIZE     (sizeof(LoRaMacNvmData_t))
+#define NVM_JOURNAL_OFFSET ((NVM_IMAGE_SIZE + 3) & ~3)
+#define NVM_RECORDS_OFFSET (NVM_JOURNAL_OFFSET + sizeof(uint32_t))
+#define NVM_RECORDS_END    (NVM_JOURNAL_OFFSET + LORAWAN_NVM_JOURNAL_SIZE)
+
+#define NVM_RECORD_DELTA  (0xD5)
+#define NVM_RECORD_COMMIT (0xC3)
+#define NVM_RECORD_MAX    (64)
+#define NVM_COMMIT_SIZE   (sizeof(nvm_record_t) + sizeof(uint32_t))
+
+#define NVM_FLAGS_ALL (0x7F)
+
+// The uplink counter of the crypto group is stored as its reserved
+// ceiling and never forces a flush.  The downlink counters do, a stale one
+// would accept a replay of the downlinks received since.
+#define NVM_FCNT_UP_OFFSET (offsetof(LoRaMacNvmData_t, Crypto.FCntList.FCntUp))
+
+typedef struct
+{
+    uint16_t ui16Offset;
+    uint8_t ui8Length;
+    uint8_t ui8Type;
+} nvm_record_t;
+
+typedef struct
+{
+    uint16_t ui16Offset;
+    uint16_t ui16Size;
+    uint16_t ui16Flag;
+    uint16_t ui16Critical;
+} nvm_group_t;
+
+typedef uint32_t (*nvm_run_t)(uint32_t ui32Offset, const uint8_t *pui8Data, uint32_t ui32Length);
+
+#define NVM_GROUP(member, flag, critical)                                                          \
+    {                                                                                              \
+        offsetof(LoRaMacNvmData_t, member), sizeof(((LoRaMacNvmData_t *)0)->member), flag, critical \
+    }
+
+// Every group ends with the CRC of its content.
+static const nvm_group_t nvm_groups[] = {
+    NVM_GROUP(Crypto, LORAMAC_NVM_NOTIFY_FLAG_CRYPTO, true),
+    NVM_GROUP(MacGroup1, LORAMAC_NVM_NOTIFY_FLAG_MAC_GROUP1, false),
+    NVM_GROUP(MacGroup2, LORAMAC_NVM_NOTIFY_FLAG_MAC_GROUP2, true),
+    NVM_GROUP(SecureElement, LORAMAC_NVM_NOTIFY_FLAG_SECURE_ELEMENT, true),
+    NVM_GROUP(RegionGroup1, LORAMAC_NVM_NOTIFY_FLAG_REGION_GROUP1, false),
+    NVM_GROUP(RegionGroup2, LORAMAC_NVM_NOTIFY_FLAG_REGION_GROUP2, true),
+    NVM_GROUP(ClassB, LORAMAC_NVM_NOTIFY_FLAG_CLASS_B, false),
+};
+
+#define NVM_GROUPS (sizeof(nvm_groups) / sizeof(nvm_group_t))
+
+// Image as stored, the context image with the committed journal applied.
+static LoRaMacNvmData_t nvm_shadow;
+static uint32_t nvm_shadow_valid;
+static LoRaMacCryptoNvmData_t nvm_crypto;
+
+static uint32_t nvm_generation;
+static uint32_t nvm_journal_end;
+static uint32_t nvm_crc;
+
+static uint16_t nvm_notify_flags;
+static uint16_t nvm_pending_flags;
+static uint32_t nvm_pending_critical;
+static TickType_t nvm_pending_since;
+static uint32_t nvm_window;
+static TimerHandle_t nvm_window_timer;
+static volatile uint32_t nvm_compact_requested;
+
+static uint32_t nvm_fcnt_ceiling;
+static uint32_t nvm_fcnt_last;
+
+static lorawan_nvm_stats_t nvm_stats;
+static TickType_t nvm_stats_start;
+
+static uint32_t nvm_crc32(uint32_t ui32Crc, const uint8_t *pui8Data, uint32_t ui32Length)
+{
+    while (ui32Length--)
+    {
+        ui32Crc ^= *pui8Data++;
+        for (uint32_t i = 0; i < 8; i++)
+        {
+            ui32Crc = (ui32Crc >> 1) ^ (0xEDB88320 & -(ui32Crc & 1));
+        }
+    }
+
+    return ui32Crc;
+}
+
+static uint32_t nvm_crc_seed(uint32_t ui32Generation)
+{
+    return ~ui32Generation;
+}
+
+static uint32_t nvm_ticks_to_ms(TickType_t ticks)
+{
+    return (uint32_t)(((uint64_t)ticks * 1000) / configTICK_RATE_HZ);
+}
+
+static LoRaMacNvmData_t *nvm_contexts()
+{
+    MibRequestConfirm_t mibReq;
+
+    mibReq.Type = MIB_NVM_CTXS;
+    LoRaMacMibGetRequestConfirm(&mibReq);
+    return mibReq.Param.Contexts;
+}
+
+static uint32_t nvm_write(const uint8_t *pui8Data, uint32_t ui32Length, uint32_t ui32Offset)
+{
+    NvmmWrite((uint8_t *)pui8Data, ui32Length, ui32Offset);
+    nvm_stats.ui32Words += (ui32Length + 3) / 4;
+    return ui32Length;
+}
+
+static bool nvm_word_differs(const uint8_t *pui8Target, uint32_t ui32Offset, uint32_t ui32Position,
+                             uint32_t ui32Size)
+{
+    const uint8_t *pui8Shadow = (const uint8_t *)&nvm_shadow + ui32Offset;
+    uint32_t ui32Length = ui32Size - ui32Position;
+
+    if (ui32Length > sizeof(uint32_t))
+    {
+        ui32Length = sizeof(uint32_t);
+    }
+
+    return memcmp(&pui8Target[ui32Position], &pui8Shadow[ui32Position], ui32Length) != 0;
+}
+
+//
+// The group as it is to be stored.  The uplink counter is replaced by
+// its reserved ceiling.
+//
+static const uint8_t *nvm_group_target(const nvm_group_t *psGroup, LoRaMacNvmData_t *psNvm)
+{
+    if (psGroup->ui16Offset != offsetof(LoRaMacNvmData_t, Crypto))
+    {
+        return (const uint8_t *)psNvm + psGroup->ui16Offset;
+    }
+
+    memcpy(&nvm_crypto, &psNvm->Crypto, sizeof(LoRaMacCryptoNvmData_t));
+    nvm_crypto.FCntList.FCntUp = nvm_fcnt_ceiling;
+    nvm_crypto.Crc32 = Crc32((uint8_t *)&nvm_crypto, sizeof(LoRaMacCryptoNvmData_t) - 4);
+
+    return (const uint8_t *)&nvm_crypto;
+}
+
+//
+// Calls pfnRun for every run of words where the target differs from the
+// shadow.  Runs separated by a single equal word are merged as a record
+// header costs a word as well.
+//
+static uint32_t nvm_group_diff(const nvm_group_t *psGroup, const uint8_t *pui8Target, nvm_run_t pfnRun)
+{
+    uint32_t ui32Size = psGroup->ui16Size;
+    uint32_t ui32Total = 0;
+    uint32_t i = 0;
+
+    while (i < ui32Size)
+    {
+        if (!nvm_word_differs(pui8Target, psGroup->ui16Offset, i, ui32Size))
+        {
+            i += 4;
+            continue;
+        }
+
+        uint32_t ui32End = i + 4;
+        while ((ui32End < ui32Size) && ((ui32End + 4 - i) <= NVM_RECORD_MAX))
+        {
+            if (nvm_word_differs(pui8Target, psGroup->ui16Offset, ui32End, ui32Size))
+            {
+                ui32End += 4;
+            }
+            else if (((ui32End + 4) < ui32Size) && ((ui32End + 8 - i) <= NVM_RECORD_MAX) &&
+                     nvm_word_differs(pui8Target, psGroup->ui16Offset, ui32End + 4, ui32Size))
+            {
+                ui32End += 8;
+            }
+            else
+            {
+                break;
+            }
+        }
+
+        if (ui32End > ui32Size)
+        {
+            ui32End = ui32Size;
+        }
+
+        ui32Total += pfnRun(psGroup->ui16Offset + i, &pui8Target[i], ui32End - i);
+        i = ui32End;
+    }
+
+    return ui32Total;
+}
+
+static bool nvm_group_critical(const nvm_group_t *psGroup, const uint8_t *pui8Target)
+{
+    if (!psGroup->ui16Critical)
+    {
+        return false;
+    }
+
+    // The trailing CRC only follows the content.
+    for (uint32_t i = 0; i < (psGroup->ui16Size - sizeof(uint32_t)); i += 4)
+    {
+        uint32_t ui32Offset = psGroup->ui16Offset + i;
+        if (ui32Offset == NVM_FCNT_UP_OFFSET)
+        {
+            continue;
+        }
+
+        if (nvm_word_differs(pui8Target, psGroup->ui16Offset, i, psGroup->ui16Size))
+        {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+static uint32_t nvm_record_size(uint32_t ui32Offset, const uint8_t *pui8Data, uint32_t ui32Length)
+{
+    return sizeof(nvm_record_t) + ((ui32Length + 3) & ~3);
+}
+
+static uint32_t nvm_record_write(uint32_t ui32Offset, const uint8_t *pui8Data, uint32_t ui32Length)
+{
+    uint32_t pui32Record[(sizeof(nvm_record_t) + NVM_RECORD_MAX) / sizeof(uint32_t)];
+    uint8_t *pui8Record = (uint8_t *)pui32Record;
+    nvm_record_t *psRecord = (nvm_record_t *)pui32Record;
+    uint32_t ui32Size = nvm_record_size(ui32Offset, pui8Data, ui32Length);
+
+    memset(pui8Record, 0, ui32Size);
+    psRecord->ui16Offset = ui32Offset;
+    psRecord->ui8Length = ui32Length;
+    psRecord->ui8Type = NVM_RECORD_DELTA;
+    memcpy(&pui8Record[sizeof(nvm_record_t)], pui8Data, ui32Length);
+
+    nvm_write(pui8Record, ui32Size, nvm_journal_end);
+    nvm_crc = nvm_crc32(nvm_crc, pui8Record, ui32Size);
+    nvm_journal_end += ui32Size;
+
+    memcpy((uint8_t *)&nvm_shadow + ui32Offset, pui8Data, ui32Length);
+    nvm_stats.ui32Records++;
+
+    return ui32Size;
+}
+
+static uint32_t nvm_commit_write()
+{
+    uint32_t pui32Record[NVM_COMMIT_SIZE / sizeof(uint32_t)];
+    uint8_t *pui8Record = (uint8_t *)pui32Record;
+    nvm_record_t *psRecord = (nvm_record_t *)pui32Record;
+
+    psRecord->ui16Offset = 0;
+    psRecord->ui8Length = sizeof(uint32_t);
+    psRecord->ui8Type = NVM_RECORD_COMMIT;
+    memcpy(&pui8Record[sizeof(nvm_record_t)], &nvm_crc, sizeof(uint32_t));
+
+    nvm_write(pui8Record, NVM_COMMIT_SIZE, nvm_journal_end);
+    nvm_journal_end += NVM_COMMIT_SIZE;
+    nvm_stats.ui32Commits++;
+
+    return NVM_COMMIT_SIZE;
+}
+
+static bool nvm_record_valid(const nvm_record_t *psRecord, uint32_t ui32Position)
+{
+    if ((psRecord->ui8Length == 0) || (psRecord->ui8Length > NVM_RECORD_MAX))
+    {
+        return false;
+    }
+
+    if (((uint32_t)psRecord->ui16Offset + psRecord->ui8Length) > NVM_IMAGE_SIZE)
+    {
+        return false;
+    }
+
+    return (ui32Position + nvm_record_size(0, NULL, psRecord->ui8Length)) <= NVM_RECORDS_END;
+}
+
+//
+// Applies the committed records to the shadow and positions the journal
+// after the last commit.
+//
+static void nvm_journal_replay()
+{
+    uint8_t pui8Data[NVM_RECORD_MAX];
+    nvm_record_t sRecord;
+    uint32_t ui32Position = NVM_RECORDS_OFFSET;
+    uint32_t ui32Crc = nvm_crc_seed(nvm_generation);
+    uint32_t ui32Committed = ui32Crc;
+    uint32_t ui32End = ui32Position;
+
+    while ((ui32Position + NVM_COMMIT_SIZE) <= NVM_RECORDS_END)
+    {
+        NvmmRead((uint8_t *)&sRecord, sizeof(nvm_record_t), ui32Position);
+
+        if (sRecord.ui8Type == NVM_RECORD_DELTA)
+        {
+            if (!nvm_record_valid(&sRecord, ui32Position))
+            {
+                break;
+            }
+
+            uint32_t ui32Length = nvm_record_size(0, NULL, sRecord.ui8Length) - sizeof(nvm_record_t);
+            NvmmRead(pui8Data, ui32Length, ui32Position + sizeof(nvm_record_t));
+            ui32Crc = nvm_crc32(ui32Crc, (uint8_t *)&sRecord, sizeof(nvm_record_t));
+            ui32Crc = nvm_crc32(ui32Crc, pui8Data, ui32Length);
+            ui32Position += sizeof(nvm_record_t) + ui32Length;
+        }
+        else if ((sRecord.ui8Type == NVM_RECORD_COMMIT) &&
+                 (sRecord.ui8Length == sizeof(uint32_t)))
+        {
+            uint32_t ui32Check;
+            NvmmRead((uint8_t *)&ui32Check, sizeof(uint32_t), ui32Position + sizeof(nvm_record_t));
+            if (ui32Check != ui32Crc)
+            {
+                break;
+            }
+
+            ui32Position += NVM_COMMIT_SIZE;
+            ui32End = ui32Position;
+            ui32Committed = ui32Crc;
+        }
+        else
+        {
+            break;
+        }
+    }
+
+    ui32Position = NVM_RECORDS_OFFSET;
+    while (ui32Position < ui32End)
+    {
+        NvmmRead((uint8_t *)&sRecord, sizeof(nvm_record_t), ui32Position);
+        if (sRecord.ui8Type == NVM_RECORD_DELTA)
+        {
+            NvmmRead((uint8_t *)&nvm_shadow + sRecord.ui16Offset,
+                     sRecord.ui8Length,
+                     ui32Position + sizeof(nvm_record_t));
+        }
+        ui32Position += nvm_record_size(0, NULL, sRecord.ui8Length);
+    }
+
+    nvm_journal_end = ui32End;
+    nvm_crc = ui32Committed;
+}
+
+static void nvm_journal_reset()
+{
+    uint32_t ui32Stored;
+
+    // Before the restore, nvm_generation does not reflect the journal in
+    // the EEPROM.  Move past the stored generation so that no record left
+    // from it passes the commit check of the new one.
+    NvmmRead((uint8_t *)&ui32Stored, sizeof(uint32_t), NVM_JOURNAL_OFFSET);
+    if (ui32Stored > nvm_generation)
+    {
+        nvm_generation = ui32Stored;
+    }
+
+    nvm_generation++;
+    nvm_write((uint8_t *)&nvm_generation, sizeof(uint32_t), NVM_JOURNAL_OFFSET);
+    nvm_journal_end = NVM_RECORDS_OFFSET;
+    nvm_crc = nvm_crc_seed(nvm_generation);
+}
+
+//
+// Folds the shadow into the context image.  Only the words that differ
+// from the stored image are written.  An interrupted compaction is
+// recovered by replaying the journal over the partially written image.
+//
+static uint32_t nvm_image_write()
+{
+    uint8_t pui8Stored[NVM_RECORD_MAX];
+    const uint8_t *pui8Shadow = (const uint8_t *)&nvm_shadow;
+    uint32_t ui32Written = 0;
+
+    for (uint32_t ui32Offset = 0; ui32Offset < NVM_IMAGE_SIZE; ui32Offset += NVM_RECORD_MAX)
+    {
+        uint32_t ui32Length = NVM_IMAGE_SIZE - ui32Offset;
+        if (ui32Length > NVM_RECORD_MAX)
+        {
+            ui32Length = NVM_RECORD_MAX;
+        }
+
+        NvmmRead(pui8Stored, ui32Length, ui32Offset);
+
+        uint32_t i = 0;
+        while (i < ui32Length)
+        {
+            uint32_t ui32Start = i;
+            while ((i < ui32Length) && (pui8Stored[i] != pui8Shadow[ui32Offset + i]))
+            {
+                i++;
+            }
+
+            if (i > ui32Start)
+            {
+                // keep the writes word aligned
+                ui32Start &= ~3;
+                i = (i + 3) & ~3;
+                if (i > ui32Length)
+                {
+                    i = ui32Length;
+                }
+                ui32Written += nvm_write(&pui8Shadow[ui32Offset + ui32Start],
+                                         i - ui32Start,
+                                         ui32Offset + ui32Start);
+            }
+            else
+            {
+                i++;
+            }
+        }
+    }
+
+    nvm_journal_reset();
+    nvm_stats.ui32Compactions++;
+
+    return ui32Written + sizeof(uint32_t);
+}
+
+//
+// Moves the uplink counter ceiling ahead once the live counter reaches
+// it or a new session restarted the counter.
+//
+static bool nvm_fcnt_update(LoRaMacNvmData_t *psNvm)
+{
+    uint32_t ui32FCnt = psNvm->Crypto.FCntList.FCntUp;
+    bool bReserve = false;
+
+    if (ui32FCnt < nvm_fcnt_last)
+    {
+        bReserve = true;
+    }
+    else
+    {
+        nvm_stats.ui32Uplinks += ui32FCnt - nvm_fcnt_last;
+        bReserve = (ui32FCnt >= nvm_fcnt_ceiling);
+    }
+    nvm_fcnt_last = ui32FCnt;
+
+    if (bReserve)
+    {
+        nvm_fcnt_ceiling = ui32FCnt + LORAWAN_NVM_FCNT_RESERVE;
+        nvm_stats.ui32Reservations++;
+    }
+
+    return bReserve;
+}
+
+static uint32_t nvm_commit(LoRaMacNvmData_t *psNvm, uint16_t ui16Flags)
+{
+    uint32_t ui32Needed = 0;
+
+    if (!nvm_shadow_valid)
+    {
+        ui16Flags = NVM_FLAGS_ALL;
+    }
+
+    for (uint32_t i = 0; i < NVM_GROUPS; i++)
+    {
+        if (ui16Flags & nvm_groups[i].ui16Flag)
+        {
+            ui32Needed += nvm_group_diff(&nvm_groups[i],
+                                         nvm_group_target(&nvm_groups[i], psNvm),
+                                         nvm_record_size);
+        }
+    }
+
+    if (ui32Needed == 0)
+    {
+        return 0;
+    }
+
+    if (!nvm_shadow_valid || ((nvm_journal_end + ui32Needed + NVM_COMMIT_SIZE) > NVM_RECORDS_END))
+    {
+        for (uint32_t i = 0; i < NVM_GROUPS; i++)
+        {
+            if (ui16Flags & nvm_groups[i].ui16Flag)
+            {
+                memcpy((uint8_t *)&nvm_shadow + nvm_groups[i].ui16Offset,
+                       nvm_group_target(&nvm_groups[i], psNvm),
+                       nvm_groups[i].ui16Size);
+            }
+        }
+        nvm_shadow_valid = 1;
+
+        return nvm_image_write();
+    }
+
+    uint32_t ui32Written = 0;
+    for (uint32_t i = 0; i < NVM_GROUPS; i++)
+    {
+        if (ui16Flags & nvm_groups[i].ui16Flag)
+        {
+            ui32Written += nvm_group_diff(&nvm_groups[i],
+                                          nvm_group_target(&nvm_groups[i], psNvm),
+                                          nvm_record_write);
+        }
+    }
+
+    return ui32Written + nvm_commit_write();
+}
+
+static void nvm_window_expired(TimerHandle_t timer)
+{
+    lorawan_task_wake(LORAWAN_WAKE_NVM);
+}
+
+void NvmDataMgmtEvent(uint16_t notifyFlags)
+{
+    nvm_notify_flags |= notifyFlags;
+    nvm_stats.ui32Changes++;
+}
+
+uint16_t NvmDataMgmtStore(void)
+{
+#if (CONTEXT_MANAGEMENT_ENABLED == 1)
+    LoRaMacNvmData_t *psNvm = nvm_contexts();
+
+    if (nvm_notify_flags != LORAMAC_NVM_NOTIFY_FLAG_NONE)
+    {
+        if (nvm_notify_flags & LORAMAC_NVM_NOTIFY_FLAG_CRYPTO)
+        {
+            nvm_pending_critical |= nvm_fcnt_update(psNvm);
+        }
+
+        for (uint32_t i = 0; (i < NVM_GROUPS) && !nvm_pending_critical; i++)
+        {
+            if (nvm_notify_flags & nvm_groups[i].ui16Flag)
+            {
+                nvm_pending_critical =
+                    nvm_group_critical(&nvm_groups[i], nvm_group_target(&nvm_groups[i], psNvm));
+            }
+        }
+
+        if (nvm_pending_flags == LORAMAC_NVM_NOTIFY_FLAG_NONE)
+        {
+            nvm_pending_since = xTaskGetTickCount();
+        }
+        nvm_pending_flags |= nvm_notify_flags;
+        nvm_notify_flags = LORAMAC_NVM_NOTIFY_FLAG_NONE;
+    }
+
+    if (nvm_pending_flags == LORAMAC_NVM_NOTIFY_FLAG_NONE)
+    {
+        return 0;
+    }
+
+    if (!nvm_pending_critical && nvm_shadow_valid &&
+        (nvm_ticks_to_ms(xTaskGetTickCount() - nvm_pending_since) < nvm_window))
+    {
+        if (xTimerIsTimerActive(nvm_window_timer) == pdFALSE)
+        {
+            TickType_t remaining =
+                pdMS_TO_TICKS(nvm_window) - (xTaskGetTickCount() - nvm_pending_since);
+            xTimerChangePeriod(nvm_window_timer, remaining > 0 ? remaining : 1, 0);
+        }
+        nvm_stats.ui32Coalesced++;
+        return 0;
+    }
+
+    // The MAC must not change the context while it is written.
+    if (LoRaMacStop() != LORAMAC_STATUS_OK)
+    {
+        return 0;
+    }
+
+    uint32_t ui32Written = nvm_commit(psNvm, nvm_pending_flags);
+    nvm_pending_flags = LORAMAC_NVM_NOTIFY_FLAG_NONE;
+    nvm_pending_critical = 0;
+    xTimerStop(nvm_window_timer, 0);
+
+    LoRaMacStart();
+    return ui32Written;
+#else
+    return 0;
+#endif
+}
+
+uint16_t NvmDataMgmtRestore(void)
+{
+#if (CONTEXT_MANAGEMENT_ENABLED == 1)
+    LoRaMacNvmData_t *psNvm = nvm_contexts();
+
+    nvm_shadow_valid = 0;
+    nvm_notify_flags = LORAMAC_NVM_NOTIFY_FLAG_NONE;
+    nvm_pending_flags = LORAMAC_NVM_NOTIFY_FLAG_NONE;
+    nvm_pending_critical = 0;
+
+    NvmmRead((uint8_t *)&nvm_shadow, NVM_IMAGE_SIZE, 0);
+    NvmmRead((uint8_t *)&nvm_generation, sizeof(uint32_t), NVM_JOURNAL_OFFSET);
+    nvm_journal_replay();
+
+    for (uint32_t i = 0; i < NVM_GROUPS; i++)
+    {
+        uint8_t *pui8Group = (uint8_t *)&nvm_shadow + nvm_groups[i].ui16Offset;
+        uint32_t ui32Length = nvm_groups[i].ui16Size - sizeof(uint32_t);
+        uint32_t ui32Crc;
+
+        memcpy(&ui32Crc, &pui8Group[ui32Length], sizeof(uint32_t));
+        if (Crc32(pui8Group, ui32Length) != ui32Crc)
+        {
+            nvm_fcnt_ceiling = 0;
+            nvm_fcnt_last = psNvm->Crypto.FCntList.FCntUp;
+            return 0;
+        }
+    }
+
+    memcpy(psNvm, &nvm_shadow, NVM_IMAGE_SIZE);
+    nvm_shadow_valid = 1;
+
+    // The stored counter is a ceiling, resume from it and reserve the
+    // next range before the first uplink.
+    nvm_fcnt_ceiling = psNvm->Crypto.FCntList.FCntUp;
+    nvm_fcnt_last = nvm_fcnt_ceiling;
+    nvm_fcnt_update(psNvm);
+    nvm_commit(psNvm, LORAMAC_NVM_NOTIFY_FLAG_CRYPTO);
+
+    return NVM_IMAGE_SIZE;
+#else
+    return 0;
+#endif
+}
+
+bool NvmDataMgmtFactoryReset(void)
+{
+#if (CONTEXT_MANAGEMENT_ENABLED == 1)
+    for (uint32_t i = 0; i < NVM_GROUPS; i++)
+    {
+        if (NvmmReset(nvm_groups[i].ui16Size, nvm_groups[i].ui16Offset) == false)
+        {
+            return false;
+        }
+    }
+
+    // The journal would otherwise restore the group CRCs.
+    nvm_journal_reset();
+    nvm_shadow_valid = 0;
+#endif
+    return true;
+}
+
+void lorawan_nvm_init()
+{
+    nvm_window = LORAWAN_NVM_COALESCE_WINDOW;
+    nvm_shadow_valid = 0;
+    nvm_compact_requested = 0;
+
+    nvm_window_timer = xTimerCreate("LoRaWAN NVM Window Timer",
+                                    pdMS_TO_TICKS(LORAWAN_NVM_COALESCE_WINDOW),
+                                    pdFALSE,
+                                    NULL,
+                                    nvm_window_expired);
+
+    lorawan_nvm_stats_reset();
+}
+
+void lorawan_nvm_flush()
+{
+    if ((nvm_notify_flags | nvm_pending_flags) != LORAMAC_NVM_NOTIFY_FLAG_NONE)
+    {
+        nvm_pending_critical = 1;
+        NvmDataMgmtStore();
+    }
+}
+
+void lorawan_nvm_idle()
+{
+    if (!nvm_shadow_valid || (nvm_pending_flags != LORAMAC_NVM_NOTIFY_FLAG_NONE) ||
+        (nvm_journal_end == NVM_RECORDS_OFFSET))
+    {
+        return;
+    }
+
+    uint32_t ui32Used = nvm_journal_end - NVM_RECORDS_OFFSET;
+    if (nvm_compact_requested ||
+        ((ui32Used * 100) >= (LORAWAN_NVM_JOURNAL_SIZE * LORAWAN_NVM_COMPACT_THRESHOLD)))
+    {
+        nvm_compact_requested = 0;
+        nvm_image_write();
+    }
+}
+
+void lorawan_nvm_compact()
+{
+    nvm_compact_requested = 1;
+    lorawan_task_wake(LORAWAN_WAKE_NVM);
+}
+
+void lorawan_nvm_window_set(uint32_t ui32Window)
+{
+    nvm_window = ui32Window;
+}
+
+void lorawan_nvm_stats_get(lorawan_nvm_stats_t *psStats)
+{
+    TickType_t now = xTaskGetTickCount();
+
+    taskENTER_CRITICAL();
+    memcpy(psStats, &nvm_stats, sizeof(lorawan_nvm_stats_t));
+    taskEXIT_CRITICAL();
+
+    psStats->ui32Uptime = nvm_ticks_to_ms(now - nvm_stats_start);
+    psStats->ui32Window = nvm_window;
+    psStats->ui32Reserve = LORAWAN_NVM_FCNT_RESERVE;
+    psStats->ui32JournalUsed = nvm_journal_end - NVM_RECORDS_OFFSET;
+    psStats->ui32JournalSize = LORAWAN_NVM_JOURNAL_SIZE - sizeof(uint32_t);
+
+    psStats->ui32WordsPerKUplink = 0;
+    if (psStats->ui32Uplinks > 0)
+    {
+        psStats->ui32WordsPerKUplink =
+            (uint32_t)(((uint64_t)psStats->ui32Words * 1000) / psStats->ui32Uplinks);
+    }
+
+    // Days until the flash behind the emulated EEPROM reaches its
+    // endurance at the write rate observed since the reset.
+    psStats->ui32LifetimeDays = 0;
+    if (psStats->ui32Words > 0)
+    {
+        uint64_t ui64Budget = (uint64_t)LORAWAN_NVM_FLASH_SIZE * LORAWAN_NVM_FLASH_ENDURANCE;
+        uint64_t ui64Days = (ui64Budget * psStats->ui32Uptime) /
+                            ((uint64_t)psStats->ui32Words * LORAWAN_NVM_FLASH_WORD_COST * 86400000);
+        psStats->ui32LifetimeDays = ui64Days > UINT32_MAX ? UINT32_MAX : (uint32_t)ui64Days;
+    }
+}
+
+void lorawan_nvm_stats_reset()
+{
+    taskENTER_CRITICAL();
+    memset(&nvm_stats, 0, sizeof(lorawan_nvm_stats_t));
+    nvm_stats_start = xTaskGetTickCount();
+    taskEXIT_CRITICAL();
+}
@@ -0,0 +1,151 @@
+/*
+ * BSD 3-Clause License
+ *
+ * Copyright (c) 2024, Northern Mechatronics, Inc.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its
+ *    contributors may be used to endorse or promote products derived from
+ *    this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+#ifndef _LORAWAN_NVM_H_
+#define _LORAWAN_NVM_H_
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief Size of the delta journal that follows the context image
+ * in the emulated EEPROM.
+ */
+#ifndef LORAWAN_NVM_JOURNAL_SIZE
+#define LORAWAN_NVM_JOURNAL_SIZE (1024)
+#endif
+
+/**
+ * @brief Default time non-critical context changes are held in RAM
+ * before they are journaled.
+ *
+ * The ADR and duty cycle bookkeeping is coalesced.  Join, key,
+ * activation, channel plan and downlink frame counter changes are
+ * journaled right away, so a restored device never accepts a replay of
+ * a downlink it already received.  The uplink frame counter is covered by
+ * LORAWAN_NVM_FCNT_RESERVE.
+ */
+#ifndef LORAWAN_NVM_COALESCE_WINDOW
+#define LORAWAN_NVM_COALESCE_WINDOW (60000)
+#endif
+
+/**
+ * @brief Number of uplink frame counter values reserved ahead of use.
+ *
+ * The stored uplink counter is a ceiling that is only rewritten once
+ * the live counter reaches it.  A restored device resumes from the
+ * ceiling so a counter value is never used twice.
+ */
+#ifndef LORAWAN_NVM_FCNT_RESERVE
+#define LORAWAN_NVM_FCNT_RESERVE (64)
+#endif
+
+/**
+ * @brief Journal fill level (percent) above which it is compacted
+ * while the stack is idle.
+ */
+#ifndef LORAWAN_NVM_COMPACT_THRESHOLD
+#define LORAWAN_NVM_COMPACT_THRESHOLD (50)
+#endif
+
+/**
+ * @brief Flash backing the emulated EEPROM, used for the lifetime
+ * projection.
+ */
+#ifndef LORAWAN_NVM_FLASH_SIZE
+#define LORAWAN_NVM_FLASH_SIZE (16384)
+#endif
+
+#ifndef LORAWAN_NVM_FLASH_ENDURANCE
+#define LORAWAN_NVM_FLASH_ENDURANCE (10000)
+#endif
+
+/**
+ * @brief Flash consumed by one emulated EEPROM word write (address
+ * and data).
+ */
+#define LORAWAN_NVM_FLASH_WORD_COST (8)
+
+typedef struct
+{
+    uint32_t ui32Uptime;           ///< ms since the statistics were reset
+    uint32_t ui32Window;           ///< coalescing window (ms)
+    uint32_t ui32Reserve;          ///< uplink counter values reserved ahead
+    uint32_t ui32JournalUsed;      ///< bytes
+    uint32_t ui32JournalSize;      ///< bytes
+    uint32_t ui32Uplinks;          ///< uplink counter advances observed
+    uint32_t ui32Changes;          ///< context change notifications from the MAC
+    uint32_t ui32Coalesced;        ///< store requests absorbed by the window
+    uint32_t ui32Commits;
+    uint32_t ui32Records;          ///< delta records written
+    uint32_t ui32Reservations;     ///< uplink counter ceilings written
+    uint32_t ui32Compactions;
+    uint32_t ui32Words;            ///< words written to the emulated EEPROM
+    uint32_t ui32WordsPerKUplink;  ///< words written per 1000 uplinks
+    uint32_t ui32LifetimeDays;     ///< projected flash lifetime, 0 if unknown
+} lorawan_nvm_stats_t;
+
+extern void lorawan_nvm_init();
+
+/**
+ * @brief Journal the pending context changes regardless of the window.
+ *
+ * Must be called from the LoRaWAN task.
+ */
+extern void lorawan_nvm_flush();
+
+/**
+ * @brief Compact the journal into the context image if it is filled
+ * beyond the threshold.
+ *
+ * Called from the LoRaWAN task when it is about to sleep.
+ */
+extern void lorawan_nvm_idle();
+
+/**
+ * @brief Request the journal to be folded into the context image the
+ * next time the LoRaWAN task is idle.
+ */
+extern void lorawan_nvm_compact();
+
+extern void lorawan_nvm_window_set(uint32_t ui32Window);
+
+extern void lorawan_nvm_stats_get(lorawan_nvm_stats_t *psStats);
+extern void lorawan_nvm_stats_reset();
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,215 @@
+/*
+ * BSD 3-Clause License
+ *
+ * Copyright (c) 2024, Northern Mechatronics, Inc.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its
+ *    contributors may be used to endorse or promote products derived from
+ *    this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+
+#include <FreeRTOS.h>
+#include <task.h>
+
+#include <LmHandler.h>
+
+#include "lorawan_downlink_ring.h"
+#include "lorawan_instance.h"
+#include "lorawan_port.h"
+
+static void lorawan_port_worker(void *pvParameters)
+{
+    lorawan_port_state_t *psPort = pvParameters;
+
+    while (1)
+    {
+        ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+
+        lorawan_downlink_t *psDownlink;
+        while ((psDownlink = lorawan_downlink_ring_peek(&psPort->sRing)) != NULL)
+        {
+            // The handler may have been removed since the downlink was
+            // queued.
+            lorawan_port_entry_t sEntry;
+            taskENTER_CRITICAL();
+            sEntry = psPort->sTable[psDownlink->ui32Port];
+            taskEXIT_CRITICAL();
+            if (sEntry.pfnHandler)
+            {
+                sEntry.pfnHandler(psDownlink, sEntry.pvContext);
+            }
+            lorawan_downlink_ring_release(&psPort->sRing);
+            psPort->sStats.ui32Deferred++;
+        }
+    }
+}
+
+static int32_t lorawan_port_set(uint32_t ui32Port,
+                                lorawan_port_handler_t pfnHandler,
+                                void *pvContext,
+                                bool bDeferred)
+{
+    lorawan_port_state_t *psPort = &LORAWAN_INSTANCE->sPort;
+
+    if ((ui32Port == 0) || (ui32Port >= LORAWAN_PORT_HANDLERS))
+    {
+        return -1;
+    }
+
+    if (bDeferred && pfnHandler && (psPort->xWorker == NULL))
+    {
+        lorawan_downlink_ring_init(&psPort->sRing,
+                                   psPort->sSlots,
+                                   LORAWAN_PORT_DEFERRED_SLOTS);
+        if (xTaskCreate(lorawan_port_worker,
+                        "lorawan port",
+                        LORAWAN_PORT_WORKER_STACK,
+                        psPort,
+                        LORAWAN_PORT_WORKER_PRIORITY,
+                        &psPort->xWorker) != pdPASS)
+        {
+            psPort->xWorker = NULL;
+            return -1;
+        }
+    }
+
+    lorawan_port_entry_t *psEntry = &psPort->sTable[ui32Port];
+
+    // The LoRaWAN task reads the entry, clear the handler while the
+    // other fields change.
+    taskENTER_CRITICAL();
+    if ((psEntry->pfnHandler == NULL) && pfnHandler)
+    {
+        psPort->sStats.ui32Handlers++;
+    }
+    else if (psEntry->pfnHandler && (pfnHandler == NULL))
+    {
+        psPort->sStats.ui32Handlers--;
+    }
+    psEntry->pvContext = pvContext;
+    psEntry->bDeferred = bDeferred;
+    psEntry->pfnHandler = pfnHandler;
+    taskEXIT_CRITICAL();
+
+    return 0;
+}
+
+int32_t lorawan_port_handler_register(uint32_t ui32Port,
+                                      lorawan_port_handler_t pfnHandler,
+                                      void *pvContext)
+{
+    return lorawan_port_set(ui32Port, pfnHandler, pvContext, false);
+}
+
+int32_t lorawan_port_handler_register_deferred(uint32_t ui32Port,
+                                               lorawan_port_handler_t pfnHandler,
+                                               void *pvContext)
+{
+    return lorawan_port_set(ui32Port, pfnHandler, pvContext, true);
+}
+
+bool lorawan_port_dispatch(LmHandlerAppData_t *psData, LmHandlerRxParams_t *psParams)
+{
+    lorawan_port_state_t *psPort = &LORAWAN_INSTANCE->sPort;
+
+    if ((psData == NULL) || (psData->Port >= LORAWAN_PORT_HANDLERS))
+    {
+        return false;
+    }
+
+    // A higher priority task may change the entry, work on a copy.
+    lorawan_port_entry_t sEntry;
+    taskENTER_CRITICAL();
+    sEntry = psPort->sTable[psData->Port];
+    taskEXIT_CRITICAL();
+
+    if (sEntry.pfnHandler == NULL)
+    {
+        psPort->sStats.ui32Unhandled++;
+        return false;
+    }
+
+    if (psData->BufferSize > LORAWAN_DOWNLINK_PAYLOAD_MAX)
+    {
+        psPort->sStats.ui32Dropped++;
+        return true;
+    }
+
+    if (!sEntry.bDeferred)
+    {
+        lorawan_downlink_copy(&psPort->sDownlink, psData, psParams);
+        sEntry.pfnHandler(&psPort->sDownlink, sEntry.pvContext);
+        psPort->sStats.ui32Dispatched++;
+        return true;
+    }
+
+    if (!lorawan_downlink_ring_push(&psPort->sRing, psData, psParams))
+    {
+        psPort->sStats.ui32Dropped++;
+        return true;
+    }
+
+    uint32_t ui32Waiting = lorawan_downlink_ring_count(&psPort->sRing);
+    if (ui32Waiting > psPort->sStats.ui32HighWater)
+    {
+        psPort->sStats.ui32HighWater = ui32Waiting;
+    }
+    xTaskNotifyGive(psPort->xWorker);
+
+    return true;
+}
+
+bool lorawan_port_handler_get(uint32_t ui32Port, bool *pbDeferred)
+{
+    lorawan_port_state_t *psPort = &LORAWAN_INSTANCE->sPort;
+
+    if (ui32Port >= LORAWAN_PORT_HANDLERS)
+    {
+        return false;
+    }
+
+    *pbDeferred = psPort->sTable[ui32Port].bDeferred;
+    return psPort->sTable[ui32Port].pfnHandler != NULL;
+}
+
+void lorawan_port_stats_get(lorawan_port_stats_t *psStats)
+{
+    lorawan_port_state_t *psPort = &LORAWAN_INSTANCE->sPort;
+
+    memcpy(psStats, &psPort->sStats, sizeof(lorawan_port_stats_t));
+}
+
+void lorawan_port_stats_reset()
+{
+    lorawan_port_state_t *psPort = &LORAWAN_INSTANCE->sPort;
+
+    uint32_t ui32Handlers = psPort->sStats.ui32Handlers;
+
+    memset(&psPort->sStats, 0, sizeof(lorawan_port_stats_t));
+    psPort->sStats.ui32Handlers = ui32Handlers;
+}
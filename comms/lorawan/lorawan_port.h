@@ -0,0 +1,163 @@
+/*
+ * BSD 3-Clause License
+ *
+ * Copyright (c) 2024, Northern Mechatronics, Inc.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its
+ *    contributors may be used to endorse or promote products derived from
+ *    this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+#ifndef _LORAWAN_PORT_H_
+#define _LORAWAN_PORT_H_
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include <FreeRTOS.h>
+#include <task.h>
+
+#include <LmHandler.h>
+
+#include "lorawan_downlink_ring.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief Application ports with a handler slot, 1 to 223.  Port 0 carries
+ * MAC commands and port 224 is reserved for the compliance test.
+ */
+#define LORAWAN_PORT_HANDLERS (224)
+
+/**
+ * @brief Downlinks waiting for the deferred delivery worker.  Must be a
+ * power of two.
+ */
+#ifndef LORAWAN_PORT_DEFERRED_SLOTS
+#define LORAWAN_PORT_DEFERRED_SLOTS (4)
+#endif
+
+#ifndef LORAWAN_PORT_WORKER_PRIORITY
+#define LORAWAN_PORT_WORKER_PRIORITY (tskIDLE_PRIORITY + 1)
+#endif
+
+#ifndef LORAWAN_PORT_WORKER_STACK
+#define LORAWAN_PORT_WORKER_STACK (384)
+#endif
+
+/**
+ * @brief Port handler.
+ *
+ * @param psDownlink  Payload and metadata of the downlink, valid until the
+ *  handler returns.
+ * @param pvContext  Context given at registration.
+ */
+typedef void (*lorawan_port_handler_t)(const lorawan_downlink_t *psDownlink, void *pvContext);
+
+typedef struct
+{
+    lorawan_port_handler_t pfnHandler;
+    void *pvContext;
+    bool bDeferred;
+} lorawan_port_entry_t;
+
+typedef struct
+{
+    uint32_t ui32Handlers;   ///< ports with a handler
+    uint32_t ui32Dispatched; ///< downlinks handled in the LoRaWAN task
+    uint32_t ui32Deferred;   ///< downlinks handled by the worker
+    uint32_t ui32Unhandled;  ///< downlinks passed on to LORAWAN_EVENT_RX_DATA
+    uint32_t ui32Dropped;    ///< deferred downlinks lost to a full ring
+    uint32_t ui32HighWater;  ///< most deferred downlinks waiting at once
+} lorawan_port_stats_t;
+
+//
+// Port handlers and deferred downlinks of a device, held in its
+// lorawan_instance_t.
+//
+typedef struct
+{
+    // Indexed by the port, a lookup is a single load.
+    lorawan_port_entry_t sTable[LORAWAN_PORT_HANDLERS];
+
+    // Handlers in the MAC context read the downlink from here; the payload
+    // in the MAC buffer is not guaranteed to outlive the indication.
+    lorawan_downlink_t sDownlink;
+
+    lorawan_downlink_t sSlots[LORAWAN_PORT_DEFERRED_SLOTS];
+    lorawan_downlink_ring_t sRing;
+    TaskHandle_t xWorker;
+
+    lorawan_port_stats_t sStats;
+} lorawan_port_state_t;
+
+/**
+ * @brief Handle the downlinks of a port in the LoRaWAN task.
+ *
+ * @param ui32Port  1 to 223.
+ * @param pfnHandler  Set to NULL to remove the handler of the port.
+ * @param pvContext  Passed to the handler.
+ *
+ * @return 0 on success, -1 for an invalid port.
+ *
+ * @remarks The handler runs in the MAC context and must not block.
+ * Downlinks of a port with a handler are not passed on to the
+ * LORAWAN_EVENT_RX_DATA callback, the other ports still are.
+ */
+extern int32_t lorawan_port_handler_register(uint32_t ui32Port,
+                                             lorawan_port_handler_t pfnHandler,
+                                             void *pvContext);
+
+/**
+ * @brief Handle the downlinks of a port in a worker task.
+ *
+ * @remarks Use it for handlers that take time, e.g. configuration updates
+ * or firmware update control.  The downlink is copied into one of
+ * LORAWAN_PORT_DEFERRED_SLOTS slots; downlinks arriving while every slot
+ * is taken are dropped and counted.  The worker task is created on the
+ * first deferred registration.
+ */
+extern int32_t lorawan_port_handler_register_deferred(uint32_t ui32Port,
+                                                      lorawan_port_handler_t pfnHandler,
+                                                      void *pvContext);
+
+/**
+ * @brief Deliver a downlink to the handler of its port.
+ *
+ * @return true if a handler took the downlink.
+ */
+extern bool lorawan_port_dispatch(LmHandlerAppData_t *psData, LmHandlerRxParams_t *psParams);
+
+extern bool lorawan_port_handler_get(uint32_t ui32Port, bool *pbDeferred);
+
+extern void lorawan_port_stats_get(lorawan_port_stats_t *psStats);
+extern void lorawan_port_stats_reset();
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
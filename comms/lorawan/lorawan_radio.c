@@ -0,0 +1,175 @@
+/*
+ * BSD 3-Clause License
+ *
+ * Copyright (c) 2024, Northern Mechatronics, Inc.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its
+ *    contributors may be used to endorse or promote products derived from
+ *    this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+#include <stdint.h>
+#include <string.h>
+
+#include <am_mcu_apollo.h>
+
+#include <FreeRTOS.h>
+#include <task.h>
+
+#include <LoRaMac.h>
+#include <radio.h>
+
+#include "energy.h"
+#include "lorawan.h"
+#include "lorawan_radio.h"
+
+// SX126x transactions issued by a public network MIB set:
+// SetPacketType followed by the two sync word register writes.
+#define RADIO_PUBLIC_NETWORK_SPI_TRANSACTIONS (3)
+
+typedef struct
+{
+    uint32_t ui32Mask;
+    uint32_t ui32SpiTransactions;
+    void (*pfnReplay)(void);
+} radio_shadow_entry_t;
+
+static void replay_public_network(void)
+{
+    // The radio looses the public network value across power cycles.
+    // The value can be retrieved from the MIB.  An MIB Set will
+    // trigger a write to the public network register in the radio.
+    MibRequestConfirm_t mibReq;
+    mibReq.Type = MIB_PUBLIC_NETWORK;
+    LoRaMacMibGetRequestConfirm(&mibReq);
+    LoRaMacMibSetRequestConfirm(&mibReq);
+}
+
+static const radio_shadow_entry_t radio_shadow_table[] = {
+    {LORAWAN_RADIO_REG_PUBLIC_NETWORK, RADIO_PUBLIC_NETWORK_SPI_TRANSACTIONS, replay_public_network},
+};
+
+#define RADIO_SHADOW_ENTRIES (sizeof(radio_shadow_table) / sizeof(radio_shadow_entry_t))
+
+static volatile uint32_t radio_shadow_lost;
+static lorawan_radio_stats_t radio_stats;
+static TickType_t radio_stats_start;
+
+void lorawan_radio_shadow_init()
+{
+    // The radio content is unknown until the MAC programs it.
+    radio_shadow_lost = LORAWAN_RADIO_REG_ALL;
+    lorawan_radio_stats_reset();
+}
+
+void lorawan_radio_shadow_sync(uint32_t ui32Mask)
+{
+    AM_CRITICAL_BEGIN
+    radio_shadow_lost &= ~ui32Mask;
+    AM_CRITICAL_END
+}
+
+void lorawan_radio_shadow_invalidate(uint32_t ui32Mask)
+{
+    AM_CRITICAL_BEGIN
+    radio_shadow_lost |= ui32Mask;
+    AM_CRITICAL_END
+}
+
+void lorawan_radio_shadow_restore()
+{
+    uint32_t ui32Lost;
+
+    AM_CRITICAL_BEGIN
+    ui32Lost = radio_shadow_lost;
+    radio_shadow_lost = 0;
+    AM_CRITICAL_END
+
+    for (uint32_t i = 0; i < RADIO_SHADOW_ENTRIES; i++)
+    {
+        const radio_shadow_entry_t *psEntry = &radio_shadow_table[i];
+
+        if (ui32Lost & psEntry->ui32Mask)
+        {
+            psEntry->pfnReplay();
+            radio_stats.ui32Replays++;
+            radio_stats.ui32SpiWrites += psEntry->ui32SpiTransactions;
+        }
+        else
+        {
+            radio_stats.ui32ReplaysSkipped++;
+            radio_stats.ui32SpiSaved += psEntry->ui32SpiTransactions;
+        }
+    }
+}
+
+void lorawan_radio_power_lost()
+{
+    lorawan_radio_shadow_invalidate(LORAWAN_RADIO_REG_ALL);
+    radio_stats.ui32RadioPowerCycles++;
+    energy_state_set(ENERGY_DOMAIN_RADIO, ENERGY_STATE_RADIO_OFF);
+}
+
+void lorawan_radio_state_update(uint32_t ui32Idle)
+{
+    energy_state_e eState;
+
+    switch (Radio.GetStatus())
+    {
+    case RF_TX_RUNNING:
+        eState = ENERGY_STATE_RADIO_TX;
+        break;
+    case RF_RX_RUNNING:
+    case RF_CAD:
+        eState = ENERGY_STATE_RADIO_RX;
+        break;
+    default:
+        eState = ui32Idle ? ENERGY_STATE_RADIO_SLEEP : ENERGY_STATE_RADIO_STANDBY;
+        break;
+    }
+
+    energy_state_set(ENERGY_DOMAIN_RADIO, eState);
+}
+
+void lorawan_radio_stats_get(lorawan_radio_stats_t *psStats)
+{
+    memcpy(psStats, &radio_stats, sizeof(lorawan_radio_stats_t));
+
+    psStats->ui32Uptime = (xTaskGetTickCount() - radio_stats_start) / configTICK_RATE_HZ;
+    if (psStats->ui32Uptime > 0)
+    {
+        psStats->ui32SpiSavedPerHour =
+            (uint32_t)(((uint64_t)psStats->ui32SpiSaved * 3600) / psStats->ui32Uptime);
+    }
+    else
+    {
+        psStats->ui32SpiSavedPerHour = 0;
+    }
+}
+
+void lorawan_radio_stats_reset()
+{
+    memset(&radio_stats, 0, sizeof(lorawan_radio_stats_t));
+    radio_stats_start = xTaskGetTickCount();
+}
@@ -0,0 +1,131 @@
+/*
+ * BSD 3-Clause License
+ *
+ * Copyright (c) 2024, Northern Mechatronics, Inc.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its
+ *    contributors may be used to endorse or promote products derived from
+ *    this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+#ifndef _LORAWAN_RADIO_H_
+#define _LORAWAN_RADIO_H_
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief Radio register groups kept in the shadow.
+ *
+ * Each group is a set of radio registers that is written once by the
+ * MAC and is not reprogrammed on every TX/RX.  These are the registers
+ * that must be replayed when the radio supply has been removed.
+ */
+typedef enum
+{
+    LORAWAN_RADIO_REG_PUBLIC_NETWORK = (1 << 0),
+    LORAWAN_RADIO_REG_ALL            = (LORAWAN_RADIO_REG_PUBLIC_NETWORK),
+} lorawan_radio_reg_e;
+
+typedef struct
+{
+    uint32_t ui32Uptime;           ///< seconds since the statistics were reset
+    uint32_t ui32RadioPowerCycles; ///< radio supply removals (nLORA_EN)
+    uint32_t ui32Replays;          ///< register groups replayed
+    uint32_t ui32ReplaysSkipped;   ///< register groups found valid on wake
+    uint32_t ui32SpiWrites;        ///< SPI transactions spent on replays
+    uint32_t ui32SpiSaved;         ///< SPI transactions avoided
+    uint32_t ui32SpiSavedPerHour;
+} lorawan_radio_stats_t;
+
+extern void lorawan_radio_shadow_init();
+
+/**
+ * @brief Mark register groups as programmed in the radio.
+ *
+ * Called once the MAC has configured the radio, e.g. after LmHandlerInit.
+ */
+extern void lorawan_radio_shadow_sync(uint32_t ui32Mask);
+
+/**
+ * @brief Mark register groups as lost.
+ */
+extern void lorawan_radio_shadow_invalidate(uint32_t ui32Mask);
+
+/**
+ * @brief Write back the register groups that were lost.
+ *
+ * Register groups that are still valid are skipped and accounted
+ * for in the statistics.
+ */
+extern void lorawan_radio_shadow_restore();
+
+/**
+ * @brief Sample the radio state for energy accounting.
+ *
+ * @param ui32Idle  non-zero when the LoRaWAN task is about to sleep.  An
+ *  idle radio is then accounted as sleeping, otherwise as in standby.
+ */
+extern void lorawan_radio_state_update(uint32_t ui32Idle);
+
+/**
+ * @brief Outcome of a receive window.
+ */
+typedef enum
+{
+    LORAWAN_RADIO_RX_NONE,    ///< no receive interrupt pending
+    LORAWAN_RADIO_RX_DONE,    ///< frame received
+    LORAWAN_RADIO_RX_TIMEOUT, ///< window closed without a preamble
+    LORAWAN_RADIO_RX_ERROR,   ///< header or CRC error
+} lorawan_radio_rx_e;
+
+#define LORAWAN_RADIO_RX_PAYLOAD_MAX (255)
+
+/**
+ * @brief Read the outcome of a receive interrupt the driver has not
+ * serviced yet.
+ *
+ * @param pui8Payload  Receives the frame of LORAWAN_RADIO_RX_DONE, room
+ *  for LORAWAN_RADIO_RX_PAYLOAD_MAX bytes.
+ * @param pui32Size  Receives the size of the frame, 0 for the other
+ *  outcomes.
+ *
+ * @remarks Implemented by the radio driver port,
+ * lorawan_radio_sx126x.c on the target and the simulated radio on the
+ * host.  Call from the LoRaWAN task before the stack processes the
+ * interrupt, the status is cleared once it has.
+ */
+extern lorawan_radio_rx_e lorawan_radio_rx_pending_get(uint8_t *pui8Payload, uint32_t *pui32Size);
+
+extern void lorawan_radio_stats_get(lorawan_radio_stats_t *psStats);
+extern void lorawan_radio_stats_reset();
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
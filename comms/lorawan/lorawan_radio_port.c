@@ -0,0 +1,264 @@
+/*
+ * BSD 3-Clause License
+ *
+ * Copyright (c) 2024, Northern Mechatronics, Inc.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its
+ *    contributors may be used to endorse or promote products derived from
+ *    this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+#include <stdint.h>
+#include <string.h>
+
+#include <am_mcu_apollo.h>
+
+#include <FreeRTOS.h>
+#include <task.h>
+
+#include "energy.h"
+#include "lorawan_radio_port.h"
+
+// Idle intervals are learned in log2 buckets of milliseconds,
+// bucket i holds [2^i, 2^(i+1)) and the last bucket is open ended.
+#define RADIO_PORT_BUCKETS     (18)
+#define RADIO_PORT_MIN_SAMPLES (8)
+#define RADIO_PORT_AGING       (64)
+
+static lorawan_radio_port_mode_e radio_port_mode;
+static uint32_t radio_port_fixed_timeout;
+static uint32_t radio_port_adaptive_timeout;
+static uint32_t radio_port_break_even;
+
+static uint16_t radio_port_histogram[RADIO_PORT_BUCKETS];
+static uint32_t radio_port_histogram_samples;
+static uint32_t radio_port_aging;
+
+static uint32_t radio_port_idle;
+static TickType_t radio_port_idle_start;
+static uint32_t radio_port_on;
+static TickType_t radio_port_on_since;
+
+static lorawan_radio_port_stats_t radio_port_stats;
+static TickType_t radio_port_stats_start;
+
+static TickType_t radio_port_ticks(void)
+{
+    if (xPortIsInsideInterrupt() == pdTRUE)
+    {
+        return xTaskGetTickCountFromISR();
+    }
+
+    return xTaskGetTickCount();
+}
+
+static uint32_t radio_port_ticks_to_ms(TickType_t ticks)
+{
+    return (uint32_t)(((uint64_t)ticks * 1000) / configTICK_RATE_HZ);
+}
+
+static uint32_t radio_port_bucket(uint32_t ui32Interval)
+{
+    uint32_t i = 0;
+
+    while ((ui32Interval >>= 1) && (i < (RADIO_PORT_BUCKETS - 1)))
+    {
+        i++;
+    }
+
+    return i;
+}
+
+static void radio_port_timeout_update(void)
+{
+    uint64_t ui64BestCost = UINT64_MAX;
+    uint32_t ui32BestTimeout = radio_port_fixed_timeout;
+
+    // Candidate timeouts are zero and the bucket upper bounds.  An interval
+    // shorter than the timeout costs its own duration of on-time, a longer
+    // one costs the full timeout plus a power cycle.  The open ended bucket
+    // always incurs a power cycle.
+    for (int32_t j = -1; j < (RADIO_PORT_BUCKETS - 1); j++)
+    {
+        uint32_t ui32Timeout = (j < 0) ? 0 : (2u << j);
+        uint64_t ui64Cost = 0;
+
+        for (int32_t k = 0; k < RADIO_PORT_BUCKETS; k++)
+        {
+            uint32_t ui32Interval = (3u << k) >> 1;
+
+            if ((k <= j) && (k < (RADIO_PORT_BUCKETS - 1)))
+            {
+                ui64Cost += (uint64_t)radio_port_histogram[k] * ui32Interval;
+            }
+            else
+            {
+                ui64Cost += (uint64_t)radio_port_histogram[k] * (ui32Timeout + radio_port_break_even);
+            }
+        }
+
+        if (ui64Cost < ui64BestCost)
+        {
+            ui64BestCost = ui64Cost;
+            ui32BestTimeout = ui32Timeout;
+        }
+    }
+
+    radio_port_adaptive_timeout = ui32BestTimeout;
+}
+
+static void radio_port_learn(uint32_t ui32Interval)
+{
+    radio_port_histogram[radio_port_bucket(ui32Interval)]++;
+    radio_port_histogram_samples++;
+    radio_port_stats.ui32Samples++;
+
+    // Age the histogram so that the controller follows changes
+    // in the application traffic pattern.
+    radio_port_aging++;
+    if (radio_port_aging >= RADIO_PORT_AGING)
+    {
+        radio_port_aging = 0;
+        for (uint32_t i = 0; i < RADIO_PORT_BUCKETS; i++)
+        {
+            radio_port_histogram[i] >>= 1;
+        }
+    }
+
+    radio_port_timeout_update();
+}
+
+void lorawan_radio_port_init()
+{
+    radio_port_mode = LORAWAN_RADIO_PORT_TIMEOUT_ADAPTIVE;
+    radio_port_fixed_timeout = LORAWAN_SPI_PORT_TIMEOUT;
+    radio_port_adaptive_timeout = LORAWAN_SPI_PORT_TIMEOUT;
+    radio_port_break_even = LORAWAN_SPI_PORT_BREAK_EVEN;
+
+    memset(radio_port_histogram, 0, sizeof(radio_port_histogram));
+    radio_port_histogram_samples = 0;
+    radio_port_aging = 0;
+
+    radio_port_idle = 0;
+    radio_port_on = 0;
+
+    lorawan_radio_port_stats_reset();
+}
+
+void lorawan_radio_port_power_set(uint32_t ui32Powered)
+{
+    TickType_t now = radio_port_ticks();
+
+    AM_CRITICAL_BEGIN
+    if (ui32Powered && !radio_port_on)
+    {
+        radio_port_on = 1;
+        radio_port_on_since = now;
+        radio_port_stats.ui32PowerUps++;
+        energy_state_set(ENERGY_DOMAIN_RADIO_PORT, ENERGY_STATE_RADIO_PORT_ON);
+    }
+    else if (!ui32Powered && radio_port_on)
+    {
+        radio_port_on = 0;
+        radio_port_stats.ui32OnTime += radio_port_ticks_to_ms(now - radio_port_on_since);
+        radio_port_stats.ui32PowerDowns++;
+        energy_state_set(ENERGY_DOMAIN_RADIO_PORT, ENERGY_STATE_RADIO_PORT_OFF);
+    }
+    AM_CRITICAL_END
+}
+
+uint32_t lorawan_radio_port_idle()
+{
+    radio_port_idle = 1;
+    radio_port_idle_start = xTaskGetTickCount();
+
+    if ((radio_port_mode == LORAWAN_RADIO_PORT_TIMEOUT_ADAPTIVE) &&
+        (radio_port_histogram_samples >= RADIO_PORT_MIN_SAMPLES))
+    {
+        return radio_port_adaptive_timeout;
+    }
+
+    return radio_port_fixed_timeout;
+}
+
+void lorawan_radio_port_active()
+{
+    if (radio_port_idle)
+    {
+        radio_port_idle = 0;
+        radio_port_learn(radio_port_ticks_to_ms(xTaskGetTickCount() - radio_port_idle_start));
+    }
+}
+
+void lorawan_radio_port_mode_set(lorawan_radio_port_mode_e eMode, uint32_t ui32Timeout)
+{
+    radio_port_mode = eMode;
+    if (eMode == LORAWAN_RADIO_PORT_TIMEOUT_FIXED)
+    {
+        radio_port_fixed_timeout = ui32Timeout;
+    }
+}
+
+void lorawan_radio_port_break_even_set(uint32_t ui32BreakEven)
+{
+    radio_port_break_even = ui32BreakEven;
+    radio_port_timeout_update();
+}
+
+void lorawan_radio_port_stats_get(lorawan_radio_port_stats_t *psStats)
+{
+    TickType_t now = xTaskGetTickCount();
+
+    AM_CRITICAL_BEGIN
+    memcpy(psStats, &radio_port_stats, sizeof(lorawan_radio_port_stats_t));
+    if (radio_port_on)
+    {
+        psStats->ui32OnTime += radio_port_ticks_to_ms(now - radio_port_on_since);
+    }
+    AM_CRITICAL_END
+
+    psStats->eMode = radio_port_mode;
+    psStats->ui32BreakEven = radio_port_break_even;
+    psStats->ui32Uptime = radio_port_ticks_to_ms(now - radio_port_stats_start);
+    if ((radio_port_mode == LORAWAN_RADIO_PORT_TIMEOUT_ADAPTIVE) &&
+        (radio_port_histogram_samples >= RADIO_PORT_MIN_SAMPLES))
+    {
+        psStats->ui32Timeout = radio_port_adaptive_timeout;
+    }
+    else
+    {
+        psStats->ui32Timeout = radio_port_fixed_timeout;
+    }
+}
+
+void lorawan_radio_port_stats_reset()
+{
+    TickType_t now = xTaskGetTickCount();
+
+    AM_CRITICAL_BEGIN
+    memset(&radio_port_stats, 0, sizeof(lorawan_radio_port_stats_t));
+    radio_port_stats_start = now;
+    radio_port_on_since = now;
+    AM_CRITICAL_END
+}
@@ -0,0 +1,105 @@
+/*
+ * BSD 3-Clause License
+ *
+ * Copyright (c) 2024, Northern Mechatronics, Inc.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its
+ *    contributors may be used to endorse or promote products derived from
+ *    this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+#ifndef _LORAWAN_RADIO_PORT_H_
+#define _LORAWAN_RADIO_PORT_H_
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief Default fixed timeout before the radio SPI port is powered down.
+ *
+ * The eight second timeout exceeds the longest delay after transmit
+ * (join accept delay 2).  It is also used in adaptive mode until
+ * enough idle intervals have been observed.
+ */
+#define LORAWAN_SPI_PORT_TIMEOUT (8000)
+
+/**
+ * @brief Energy of one port power cycle expressed as the time the port
+ * can stay powered for the same energy.
+ */
+#define LORAWAN_SPI_PORT_BREAK_EVEN (50)
+
+typedef enum
+{
+    LORAWAN_RADIO_PORT_TIMEOUT_FIXED,
+    LORAWAN_RADIO_PORT_TIMEOUT_ADAPTIVE,
+} lorawan_radio_port_mode_e;
+
+typedef struct
+{
+    lorawan_radio_port_mode_e eMode;
+    uint32_t ui32Timeout;    ///< timeout currently applied (ms)
+    uint32_t ui32BreakEven;  ///< power cycle cost (ms of on-time)
+    uint32_t ui32Uptime;     ///< ms since the statistics were reset
+    uint32_t ui32OnTime;     ///< ms the port was powered
+    uint32_t ui32PowerUps;
+    uint32_t ui32PowerDowns;
+    uint32_t ui32Samples;    ///< idle intervals learned
+} lorawan_radio_port_stats_t;
+
+extern void lorawan_radio_port_init();
+
+/**
+ * @brief Record a change of the SPI port power state.
+ *
+ * May be called from an ISR.
+ */
+extern void lorawan_radio_port_power_set(uint32_t ui32Powered);
+
+/**
+ * @brief Mark the start of an idle period.
+ *
+ * @return timeout in ms before the port should be powered down.
+ */
+extern uint32_t lorawan_radio_port_idle();
+
+/**
+ * @brief Mark the end of an idle period and learn its duration.
+ */
+extern void lorawan_radio_port_active();
+
+extern void lorawan_radio_port_mode_set(lorawan_radio_port_mode_e eMode, uint32_t ui32Timeout);
+extern void lorawan_radio_port_break_even_set(uint32_t ui32BreakEven);
+
+extern void lorawan_radio_port_stats_get(lorawan_radio_port_stats_t *psStats);
+extern void lorawan_radio_port_stats_reset();
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
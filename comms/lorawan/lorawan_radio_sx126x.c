@@ -0,0 +1,67 @@
+/*
+ * BSD 3-Clause License
+ *
+ * Copyright (c) 2024, Northern Mechatronics, Inc.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its
+ *    contributors may be used to endorse or promote products derived from
+ *    this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+#include <stdint.h>
+
+#include <radio.h>
+#include <sx126x.h>
+
+#include "lorawan_radio.h"
+
+lorawan_radio_rx_e lorawan_radio_rx_pending_get(uint8_t *pui8Payload, uint32_t *pui32Size)
+{
+    uint16_t ui16Irq = SX126xGetIrqStatus();
+
+    *pui32Size = 0;
+
+    if (ui16Irq & (IRQ_CRC_ERROR | IRQ_HEADER_ERROR))
+    {
+        return LORAWAN_RADIO_RX_ERROR;
+    }
+
+    if (ui16Irq & IRQ_RX_DONE)
+    {
+        uint8_t ui8Size;
+        uint8_t ui8Offset;
+
+        SX126xGetRxBufferStatus(&ui8Size, &ui8Offset);
+        SX126xReadBuffer(ui8Offset, pui8Payload, ui8Size);
+        *pui32Size = ui8Size;
+        return LORAWAN_RADIO_RX_DONE;
+    }
+
+    if (ui16Irq & IRQ_RX_TX_TIMEOUT)
+    {
+        return LORAWAN_RADIO_RX_TIMEOUT;
+    }
+
+    return LORAWAN_RADIO_RX_NONE;
+}
@@ -0,0 +1,163 @@
+/*
+ * BSD 3-Clause License
+ *
+ * Copyright (c) 2024, Northern Mechatronics, Inc.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its
+ *    contributors may be used to endorse or promote products derived from
+ *    this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+
+#include <am_mcu_apollo.h>
+
+#include <timer.h>
+
+#include "lorawan_record.h"
+
+//
+// Fixed size records, written with the interrupts masked from tasks and
+// interrupts alike.  The head counts every record written since the
+// start, the buffer holds the last LORAWAN_RECORD_COUNT of them when
+// wrapping and the first ones otherwise.
+//
+static uint8_t lorawan_record_buffer[LORAWAN_RECORD_COUNT * LORAWAN_RECORD_SIZE];
+static uint32_t lorawan_record_head;
+static volatile uint32_t lorawan_record_active;
+static uint32_t lorawan_record_wrap;
+static uint32_t lorawan_record_dropped;
+
+void lorawan_record_start(bool bWrap)
+{
+    AM_CRITICAL_BEGIN
+    lorawan_record_head = 0;
+    lorawan_record_dropped = 0;
+    lorawan_record_wrap = bWrap;
+    lorawan_record_active = 1;
+    AM_CRITICAL_END
+}
+
+void lorawan_record_stop()
+{
+    lorawan_record_active = 0;
+}
+
+void lorawan_record(lorawan_record_e eType, uint32_t ui32Argument, uint32_t ui32Value)
+{
+    if (!lorawan_record_active)
+    {
+        return;
+    }
+
+    uint32_t ui32Time = TimerGetCurrentTime();
+
+    AM_CRITICAL_BEGIN
+    if (!lorawan_record_wrap && (lorawan_record_head >= LORAWAN_RECORD_COUNT))
+    {
+        lorawan_record_dropped++;
+    }
+    else
+    {
+        uint32_t ui32Slot = lorawan_record_head & (LORAWAN_RECORD_COUNT - 1);
+        uint8_t *pui8Record = &lorawan_record_buffer[ui32Slot * LORAWAN_RECORD_SIZE];
+
+        pui8Record[0] = eType;
+        pui8Record[1] = ui32Argument;
+        pui8Record[2] = ui32Value;
+        pui8Record[3] = ui32Value >> 8;
+        pui8Record[4] = ui32Time;
+        pui8Record[5] = ui32Time >> 8;
+        pui8Record[6] = ui32Time >> 16;
+        pui8Record[7] = ui32Time >> 24;
+
+        if (lorawan_record_head >= LORAWAN_RECORD_COUNT)
+        {
+            lorawan_record_dropped++;
+        }
+        lorawan_record_head++;
+    }
+    AM_CRITICAL_END
+}
+
+void lorawan_record_rx(uint32_t ui32Result, const uint8_t *pui8Payload, uint32_t ui32Size)
+{
+    lorawan_record(LORAWAN_RECORD_RX, ui32Result, ui32Size);
+
+    for (uint32_t i = 0; i < ui32Size; i += 3)
+    {
+        uint32_t ui32Value = 0;
+
+        if ((i + 1) < ui32Size)
+        {
+            ui32Value |= pui8Payload[i + 1];
+        }
+        if ((i + 2) < ui32Size)
+        {
+            ui32Value |= pui8Payload[i + 2] << 8;
+        }
+        lorawan_record(LORAWAN_RECORD_RX_DATA, pui8Payload[i], ui32Value);
+    }
+}
+
+bool lorawan_record_is_active()
+{
+    return lorawan_record_active != 0;
+}
+
+uint32_t lorawan_record_read(uint32_t ui32Index, uint8_t *pui8Records, uint32_t ui32Count)
+{
+    uint32_t ui32Copied = 0;
+
+    AM_CRITICAL_BEGIN
+    uint32_t ui32Held = (lorawan_record_head < LORAWAN_RECORD_COUNT) ? lorawan_record_head
+                                                                     : LORAWAN_RECORD_COUNT;
+    uint32_t ui32Oldest = lorawan_record_head - ui32Held;
+
+    while ((ui32Index < ui32Held) && (ui32Copied < ui32Count))
+    {
+        uint32_t ui32Slot = (ui32Oldest + ui32Index) & (LORAWAN_RECORD_COUNT - 1);
+
+        memcpy(&pui8Records[ui32Copied * LORAWAN_RECORD_SIZE],
+               &lorawan_record_buffer[ui32Slot * LORAWAN_RECORD_SIZE],
+               LORAWAN_RECORD_SIZE);
+        ui32Index++;
+        ui32Copied++;
+    }
+    AM_CRITICAL_END
+
+    return ui32Copied;
+}
+
+void lorawan_record_stats_get(lorawan_record_stats_t *psStats)
+{
+    AM_CRITICAL_BEGIN
+    psStats->ui32Active = lorawan_record_active;
+    psStats->ui32Wrap = lorawan_record_wrap;
+    psStats->ui32Records = lorawan_record_head + (lorawan_record_wrap ? 0 : lorawan_record_dropped);
+    psStats->ui32Dropped = lorawan_record_dropped;
+    AM_CRITICAL_END
+}
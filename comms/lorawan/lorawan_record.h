@@ -0,0 +1,149 @@
+/*
+ * BSD 3-Clause License
+ *
+ * Copyright (c) 2024, Northern Mechatronics, Inc.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its
+ *    contributors may be used to endorse or promote products derived from
+ *    this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+#ifndef _LORAWAN_RECORD_H_
+#define _LORAWAN_RECORD_H_
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief Records held in RAM.  Must be a power of two.
+ */
+#ifndef LORAWAN_RECORD_COUNT
+#define LORAWAN_RECORD_COUNT (512)
+#endif
+
+#define LORAWAN_RECORD_LINE_PREFIX "@R"
+
+/**
+ * Record layout, little endian:
+ *
+ *   type       u8
+ *   argument   u8
+ *   value      u16
+ *   timestamp  u32, LoRaMac timer milliseconds
+ *
+ * The argument and value of each type are listed next to it.  The
+ * timestamps share the time base of the LoRaMac timers so that the host
+ * simulation can replay the records on its virtual clock, see
+ * doc/host_simulation.md.
+ */
+#define LORAWAN_RECORD_SIZE (8)
+
+typedef enum
+{
+    LORAWAN_RECORD_START = 1,     ///< stack started
+    LORAWAN_RECORD_STOP,          ///< stack stopped
+    LORAWAN_RECORD_RADIO_IRQ,     ///< argument: radio state when the interrupt was raised
+    LORAWAN_RECORD_TIMER_IRQ,     ///< LoRaMac timer alarm expired
+    LORAWAN_RECORD_WAKE,          ///< argument: lorawan_wake_e
+    LORAWAN_RECORD_COMMAND,       ///< argument: lorawan_command_e, value: class of a class change
+    LORAWAN_RECORD_QUEUE_SEND,    ///< argument: port, value: size and LORAWAN_RECORD_QUEUE_* flags
+    LORAWAN_RECORD_QUEUE_DROP,    ///< argument: port, value: size, transmit queue full
+    LORAWAN_RECORD_QUEUE_RECEIVE, ///< argument: port, value: size, uplink handed to the MAC
+    LORAWAN_RECORD_QUEUE_EXPIRE,  ///< argument: port, value: size, time to live elapsed
+    LORAWAN_RECORD_RX,            ///< argument: lorawan_radio_rx_e, value: frame size
+    LORAWAN_RECORD_RX_DATA,       ///< argument, value: next three bytes of the received frame
+} lorawan_record_e;
+
+#define LORAWAN_RECORD_QUEUE_CONFIRMED (1 << 8)
+#define LORAWAN_RECORD_QUEUE_URGENT    (1 << 9)
+
+typedef struct
+{
+    uint32_t ui32Active;
+    uint32_t ui32Wrap;    ///< oldest records are overwritten once the buffer is full
+    uint32_t ui32Records; ///< records raised since the start, dropped ones included
+    uint32_t ui32Dropped; ///< records lost to a full buffer, or overwritten when wrapping
+} lorawan_record_stats_t;
+
+/**
+ * @brief Clear the buffer and start recording.
+ *
+ * @param bWrap  Keep the most recent records once the buffer is full
+ *  instead of the first ones.
+ *
+ * @remarks A log replayed on the host must cover the stack start, start
+ * the recording before `lorawan start` and without wrapping.
+ */
+extern void lorawan_record_start(bool bWrap);
+extern void lorawan_record_stop();
+
+/**
+ * @brief Append a record.
+ *
+ * @param eType  Record type.
+ * @param ui32Argument  Type specific, 8 bits.
+ * @param ui32Value  Type specific, 16 bits.
+ *
+ * @remarks Safe from interrupts.  Returns at once while the recorder is
+ * stopped.
+ */
+extern void lorawan_record(lorawan_record_e eType, uint32_t ui32Argument, uint32_t ui32Value);
+
+/**
+ * @brief Append the outcome of a receive window.
+ *
+ * @param ui32Result  lorawan_radio_rx_e.
+ * @param pui8Payload  Received frame.
+ * @param ui32Size  Frame size, 0 if none was received.
+ *
+ * @remarks The frame follows in LORAWAN_RECORD_RX_DATA records, three
+ * bytes each, the last one padded with zeros.  A replay hands the frame
+ * to the stack as it was received.
+ */
+extern void lorawan_record_rx(uint32_t ui32Result, const uint8_t *pui8Payload, uint32_t ui32Size);
+
+extern bool lorawan_record_is_active();
+
+/**
+ * @brief Copy records out of the buffer, oldest first.
+ *
+ * @param ui32Index  First record to copy, 0 being the oldest one held.
+ * @param pui8Records  Receives ui32Count records of LORAWAN_RECORD_SIZE bytes.
+ * @param ui32Count  Records to copy at most.
+ *
+ * @return Records copied.
+ */
+extern uint32_t lorawan_record_read(uint32_t ui32Index, uint8_t *pui8Records, uint32_t ui32Count);
+
+extern void lorawan_record_stats_get(lorawan_record_stats_t *psStats);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
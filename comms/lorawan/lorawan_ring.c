@@ -0,0 +1,95 @@
+/*
+ * BSD 3-Clause License
+ *
+ * Copyright (c) 2024, Northern Mechatronics, Inc.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its
+ *    contributors may be used to endorse or promote products derived from
+ *    this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+#include <stdint.h>
+
+#include "lorawan_ring.h"
+
+#define RING_LOAD(x)     __atomic_load_n(&(x), __ATOMIC_ACQUIRE)
+#define RING_STORE(x, v) __atomic_store_n(&(x), (v), __ATOMIC_RELEASE)
+
+int32_t lorawan_ring_init(lorawan_ring_t *psRing, uint32_t ui32Size)
+{
+    if ((ui32Size == 0) || (ui32Size & (ui32Size - 1)))
+    {
+        return -1;
+    }
+
+    psRing->ui32Size = ui32Size;
+    psRing->ui32Head = 0;
+    psRing->ui32Tail = 0;
+
+    return 0;
+}
+
+uint32_t lorawan_ring_offset(const lorawan_ring_t *psRing, uint32_t ui32Index)
+{
+    return ui32Index & (psRing->ui32Size - 1);
+}
+
+uint32_t lorawan_ring_head(const lorawan_ring_t *psRing)
+{
+    return psRing->ui32Head;
+}
+
+uint32_t lorawan_ring_space(lorawan_ring_t *psRing)
+{
+    return psRing->ui32Size - (psRing->ui32Head - RING_LOAD(psRing->ui32Tail));
+}
+
+uint32_t lorawan_ring_produce(lorawan_ring_t *psRing, uint32_t ui32Count)
+{
+    uint32_t ui32Head = psRing->ui32Head + ui32Count;
+
+    RING_STORE(psRing->ui32Head, ui32Head);
+
+    return ui32Head - RING_LOAD(psRing->ui32Tail);
+}
+
+uint32_t lorawan_ring_tail(const lorawan_ring_t *psRing)
+{
+    return psRing->ui32Tail;
+}
+
+uint32_t lorawan_ring_available(lorawan_ring_t *psRing)
+{
+    return RING_LOAD(psRing->ui32Head) - psRing->ui32Tail;
+}
+
+void lorawan_ring_consume(lorawan_ring_t *psRing, uint32_t ui32Count)
+{
+    RING_STORE(psRing->ui32Tail, psRing->ui32Tail + ui32Count);
+}
+
+uint32_t lorawan_ring_count(lorawan_ring_t *psRing)
+{
+    return RING_LOAD(psRing->ui32Head) - RING_LOAD(psRing->ui32Tail);
+}
@@ -0,0 +1,107 @@
+/*
+ * BSD 3-Clause License
+ *
+ * Copyright (c) 2024, Northern Mechatronics, Inc.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its
+ *    contributors may be used to endorse or promote products derived from
+ *    this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+#ifndef _LORAWAN_RING_H_
+#define _LORAWAN_RING_H_
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief Indices of a single producer, single consumer ring.
+ *
+ * The ring only keeps the indices, the caller owns the storage and
+ * decides what an element is (a slot, a byte).  Both indices run freely
+ * and wrap at 2^32, the number of elements in use is always head - tail.
+ * The head is only written by the producer and the tail only by the
+ * consumer.  Each side loads the index of the other side with acquire
+ * semantics and publishes its own with release semantics, so an element
+ * is fully written before the consumer sees it and fully processed
+ * before the producer reuses it.
+ */
+typedef struct
+{
+    uint32_t ui32Size; ///< number of elements, a power of two
+    uint32_t ui32Head; ///< elements produced, free running
+    uint32_t ui32Tail; ///< elements consumed, free running
+} lorawan_ring_t;
+
+/**
+ * @brief Set up an empty ring.
+ *
+ * @return 0 on success, -1 if the size is not a power of two.
+ */
+extern int32_t lorawan_ring_init(lorawan_ring_t *psRing, uint32_t ui32Size);
+
+/**
+ * @brief Position of a free running index in the caller's storage.
+ */
+extern uint32_t lorawan_ring_offset(const lorawan_ring_t *psRing, uint32_t ui32Index);
+
+/**
+ * @brief Producer: index of the next element to write and the number of
+ * free elements from there.
+ */
+extern uint32_t lorawan_ring_head(const lorawan_ring_t *psRing);
+extern uint32_t lorawan_ring_space(lorawan_ring_t *psRing);
+
+/**
+ * @brief Producer: publish the next ui32Count elements to the consumer.
+ *
+ * @return elements in use once they are published.
+ */
+extern uint32_t lorawan_ring_produce(lorawan_ring_t *psRing, uint32_t ui32Count);
+
+/**
+ * @brief Consumer: index of the oldest element and the number of
+ * elements published from there.
+ */
+extern uint32_t lorawan_ring_tail(const lorawan_ring_t *psRing);
+extern uint32_t lorawan_ring_available(lorawan_ring_t *psRing);
+
+/**
+ * @brief Consumer: hand the oldest ui32Count elements back to the producer.
+ */
+extern void lorawan_ring_consume(lorawan_ring_t *psRing, uint32_t ui32Count);
+
+/**
+ * @brief Elements in use, from either side or a third party.
+ */
+extern uint32_t lorawan_ring_count(lorawan_ring_t *psRing);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -32,35 +32,42 @@
 #include <string.h>
 
 #include "lorawan.h"
+#include "lorawan_instance.h"
 
-SecureElementNvmData_t gsLoRaWANSecureElement = {.DevEui = {0},
-                                                 .JoinEui = {0},
-                                                 .Pin = {0},
-                                                 .KeyList = {
-                                                     {.KeyID = APP_KEY, .KeyValue = {0}},
-                                                     {.KeyID = NWK_KEY, .KeyValue = {0}},
-                                                     {.KeyID = J_S_INT_KEY, .KeyValue = {0}},
-                                                     {.KeyID = J_S_ENC_KEY, .KeyValue = {0}},
-                                                     {.KeyID = F_NWK_S_INT_KEY, .KeyValue = {0}},
-                                                     {.KeyID = S_NWK_S_INT_KEY, .KeyValue = {0}},
-                                                     {.KeyID = NWK_S_ENC_KEY, .KeyValue = {0}},
-                                                     {.KeyID = APP_S_KEY, .KeyValue = {0}},
-                                                     {.KeyID = MC_ROOT_KEY, .KeyValue = {0}},
-                                                     {.KeyID = MC_KE_KEY, .KeyValue = {0}},
-                                                     {.KeyID = MC_KEY_0, .KeyValue = {0}},
-                                                     {.KeyID = MC_APP_S_KEY_0, .KeyValue = {0}},
-                                                     {.KeyID = MC_NWK_S_KEY_0, .KeyValue = {0}},
-                                                     {.KeyID = MC_KEY_1, .KeyValue = {0}},
-                                                     {.KeyID = MC_APP_S_KEY_1, .KeyValue = {0}},
-                                                     {.KeyID = MC_NWK_S_KEY_1, .KeyValue = {0}},
-                                                     {.KeyID = MC_KEY_2, .KeyValue = {0}},
-                                                     {.KeyID = MC_APP_S_KEY_2, .KeyValue = {0}},
-                                                     {.KeyID = MC_NWK_S_KEY_2, .KeyValue = {0}},
-                                                     {.KeyID = MC_KEY_3, .KeyValue = {0}},
-                                                     {.KeyID = MC_APP_S_KEY_3, .KeyValue = {0}},
-                                                     {.KeyID = MC_NWK_S_KEY_3, .KeyValue = {0}},
-                                                     {.KeyID = SLOT_RAND_ZERO_KEY, .KeyValue = {0}},
-                                                 }};
+static const SecureElementNvmData_t lorawan_se_default = {
+    .DevEui = {0},
+    .JoinEui = {0},
+    .Pin = {0},
+    .KeyList = {
+        {.KeyID = APP_KEY, .KeyValue = {0}},
+        {.KeyID = NWK_KEY, .KeyValue = {0}},
+        {.KeyID = J_S_INT_KEY, .KeyValue = {0}},
+        {.KeyID = J_S_ENC_KEY, .KeyValue = {0}},
+        {.KeyID = F_NWK_S_INT_KEY, .KeyValue = {0}},
+        {.KeyID = S_NWK_S_INT_KEY, .KeyValue = {0}},
+        {.KeyID = NWK_S_ENC_KEY, .KeyValue = {0}},
+        {.KeyID = APP_S_KEY, .KeyValue = {0}},
+        {.KeyID = MC_ROOT_KEY, .KeyValue = {0}},
+        {.KeyID = MC_KE_KEY, .KeyValue = {0}},
+        {.KeyID = MC_KEY_0, .KeyValue = {0}},
+        {.KeyID = MC_APP_S_KEY_0, .KeyValue = {0}},
+        {.KeyID = MC_NWK_S_KEY_0, .KeyValue = {0}},
+        {.KeyID = MC_KEY_1, .KeyValue = {0}},
+        {.KeyID = MC_APP_S_KEY_1, .KeyValue = {0}},
+        {.KeyID = MC_NWK_S_KEY_1, .KeyValue = {0}},
+        {.KeyID = MC_KEY_2, .KeyValue = {0}},
+        {.KeyID = MC_APP_S_KEY_2, .KeyValue = {0}},
+        {.KeyID = MC_NWK_S_KEY_2, .KeyValue = {0}},
+        {.KeyID = MC_KEY_3, .KeyValue = {0}},
+        {.KeyID = MC_APP_S_KEY_3, .KeyValue = {0}},
+        {.KeyID = MC_NWK_S_KEY_3, .KeyValue = {0}},
+        {.KeyID = SLOT_RAND_ZERO_KEY, .KeyValue = {0}},
+    }};
+
+void lorawan_se_init(SecureElementNvmData_t *psSecureElement)
+{
+    memcpy(psSecureElement, &lorawan_se_default, sizeof(SecureElementNvmData_t));
+}
 
 static uint8_t hex_char(const char ch)
 {
@@ -105,11 +112,11 @@ void lorawan_key_set_by_str(lorawan_key_e eKey, const char *pcKey)
     switch (eKey)
     {
     case LORAWAN_KEY_DEV_EUI:
-        hex_to_bin(pcKey, gsLoRaWANSecureElement.DevEui);
+        hex_to_bin(pcKey, LORAWAN_INSTANCE->sSecureElement.DevEui);
         return;
 
     case LORAWAN_KEY_JOIN_EUI:
-        hex_to_bin(pcKey, gsLoRaWANSecureElement.JoinEui);
+        hex_to_bin(pcKey, LORAWAN_INSTANCE->sSecureElement.JoinEui);
         return;
 
     default:
@@ -143,9 +150,9 @@ void lorawan_key_set_by_str(lorawan_key_e eKey, const char *pcKey)
 
     for (int i = 0; i < NUM_OF_KEYS; i++)
     {
-        if (gsLoRaWANSecureElement.KeyList[i].KeyID == keyIdentifier)
+        if (LORAWAN_INSTANCE->sSecureElement.KeyList[i].KeyID == keyIdentifier)
         {
-            hex_to_bin(pcKey, gsLoRaWANSecureElement.KeyList[i].KeyValue);
+            hex_to_bin(pcKey, LORAWAN_INSTANCE->sSecureElement.KeyList[i].KeyValue);
             return;
         }
     }
@@ -156,11 +163,11 @@ void lorawan_key_set_by_bytes(lorawan_key_e eKey, const uint8_t *pui8Key)
     switch (eKey)
     {
     case LORAWAN_KEY_DEV_EUI:
-        memcpy(gsLoRaWANSecureElement.DevEui, pui8Key, SE_EUI_SIZE);
+        memcpy(LORAWAN_INSTANCE->sSecureElement.DevEui, pui8Key, SE_EUI_SIZE);
         return;
 
     case LORAWAN_KEY_JOIN_EUI:
-        memcpy(gsLoRaWANSecureElement.JoinEui, pui8Key, SE_EUI_SIZE);
+        memcpy(LORAWAN_INSTANCE->sSecureElement.JoinEui, pui8Key, SE_EUI_SIZE);
         return;
 
     default:
@@ -194,9 +201,9 @@ void lorawan_key_set_by_bytes(lorawan_key_e eKey, const uint8_t *pui8Key)
 
     for (int i = 0; i < NUM_OF_KEYS; i++)
     {
-        if (gsLoRaWANSecureElement.KeyList[i].KeyID == keyIdentifier)
+        if (LORAWAN_INSTANCE->sSecureElement.KeyList[i].KeyID == keyIdentifier)
         {
-            memcpy(gsLoRaWANSecureElement.KeyList[i].KeyValue, pui8Key, SE_KEY_SIZE);
+            memcpy(LORAWAN_INSTANCE->sSecureElement.KeyList[i].KeyValue, pui8Key, SE_KEY_SIZE);
             return;
         }
     }
@@ -207,11 +214,11 @@ void lorawan_key_get(lorawan_key_e eKey, uint8_t *pui8Key)
     switch (eKey)
     {
     case LORAWAN_KEY_DEV_EUI:
-        memcpy(pui8Key, gsLoRaWANSecureElement.DevEui, SE_EUI_SIZE);
+        memcpy(pui8Key, LORAWAN_INSTANCE->sSecureElement.DevEui, SE_EUI_SIZE);
         return;
         
     case LORAWAN_KEY_JOIN_EUI:
-        memcpy(pui8Key, gsLoRaWANSecureElement.JoinEui, SE_EUI_SIZE);
+        memcpy(pui8Key, LORAWAN_INSTANCE->sSecureElement.JoinEui, SE_EUI_SIZE);
         return;
 
     default:
@@ -245,9 +252,9 @@ void lorawan_key_get(lorawan_key_e eKey, uint8_t *pui8Key)
 
     for (int i = 0; i < NUM_OF_KEYS; i++)
     {
-        if (gsLoRaWANSecureElement.KeyList[i].KeyID == keyIdentifier)
+        if (LORAWAN_INSTANCE->sSecureElement.KeyList[i].KeyID == keyIdentifier)
         {
-            memcpy(pui8Key, gsLoRaWANSecureElement.KeyList[i].KeyValue, SE_KEY_SIZE);
+            memcpy(pui8Key, LORAWAN_INSTANCE->sSecureElement.KeyList[i].KeyValue, SE_KEY_SIZE);
             return;
         }
     }
@@ -52,10 +52,18 @@
 #include <LmhpRemoteMcastSetup.h>
 #include <board.h>
 #include <radio.h>
+#include <timer.h>
+#include <utilities.h>
 
 #include "lorawan.h"
 #include "lorawan_config.h"
 
+#include "lorawan_instance.h"
+#include "lorawan_latency.h"
+#include "lorawan_nvm.h"
+#include "lorawan_radio.h"
+#include "lorawan_radio_port.h"
+#include "lorawan_record.h"
 #include "lorawan_task.h"
 #include "lorawan_task_cli.h"
 
@@ -63,39 +71,85 @@ extern void *SX126xHandle;
 extern CommissioningParams_t CommissioningParams;
 extern uint32_t LmAbpLrWanVersion;
 
-volatile lorawan_stack_state_e lorawan_stack_state;
 uint32_t lorawan_tracing_enabled;
 
-#define LORAWAN_SPI_PORT_TIMEOUT 8000
-#define LM_BUFFER_SIZE           242
-static uint8_t psLmDataBuffer[LM_BUFFER_SIZE];
+lorawan_instance_t lorawan_instance;
 
+// Margin added to the remaining multicast session time before the
+// held uplinks are flushed.
+#define LORAWAN_MULTICAST_FLUSH_MARGIN 100
+
+#ifndef LORAWAN_FAST_BOOT_DEFAULT
+#define LORAWAN_FAST_BOOT_DEFAULT 0
+#endif
+
+// Start up work postponed by the fast boot mode.
+#define LORAWAN_BOOT_DEFER_PACKAGES (1 << 0)
+#define LORAWAN_BOOT_DEFER_TIME     (1 << 1)
+
+// Aggregated join request airtime allowed by the retransmission backoff
+// rules, counted from the first join request after the stack start.  The
+// last window repeats.
 typedef struct
 {
-    LmHandlerMsgTypes_t tType;
-    uint32_t ui32Port;
-    uint32_t ui32Length;
-    uint8_t *pui8Data;
-} lorawan_tx_packet_t;
+    uint32_t ui32Period; ///< ms
+    uint32_t ui32Budget; ///< ms of airtime within the period
+} lorawan_join_window_t;
+
+static const lorawan_join_window_t lorawan_join_windows[] = {
+    { 3600000, 36000 },  // first hour, 1%
+    { 36000000, 36000 }, // next 10 hours, 0.1%
+    { 86400000, 8700 },  // every following day, 0.01%
+};
+
+#define LORAWAN_JOIN_WINDOWS (sizeof(lorawan_join_windows) / sizeof(lorawan_join_window_t))
+
+// MHDR, JoinEUI, DevEUI, DevNonce and MIC.
+#define LORAWAN_JOIN_REQUEST_SIZE (23)
 
-static uint32_t radio_port_powered;
 static uint32_t lorawan_mac_pending;
 
+// A receive interrupt is waiting for its outcome to be recorded.
+static volatile uint32_t lorawan_rx_record_pending;
+
 static TaskHandle_t lorawan_task_handle;
 static QueueHandle_t command_queue;
-static QueueHandle_t transmit_queue;
 static TimerHandle_t radio_port_timer;
+static TimerHandle_t multicast_flush_timer;
+static TimerHandle_t segment_retry_timer;
+
+static lorawan_boot_stats_t lorawan_boot_stats;
+static uint32_t lorawan_boot_deferred;
+
+static const char *const lorawan_boot_phase_names[LORAWAN_BOOT_PHASES] = {
+    "start",
+    "board",
+    "mac",
+    "packages",
+    "ready",
+    "uplink",
+    "deferred",
+    "confirm",
+};
+
+// Segment header: message id, index with the last flag, then the port and
+// the length of the message in the first segment only.
+#define LORAWAN_SEGMENT_HEADER       (2)
+#define LORAWAN_SEGMENT_FIRST_HEADER (4)
+#define LORAWAN_SEGMENT_LAST         (0x80)
+
+
+// The compliance package keeps a pointer to its parameters.
+static LmhpComplianceParams_t lmhp_compliance_parameters;
 
-static LmHandlerParams_t lmh_parameters;
-static LmHandlerCallbacks_t lmh_callbacks;
-static LmhpFragmentationParams_t lmhp_fragmentation_parameters;
 
 static void radio_port_shutdown(TimerHandle_t timer)
 {
-    if (radio_port_powered)
+    if (LORAWAN_INSTANCE->ui32RadioPortPowered)
     {
         am_hal_iom_power_ctrl(SX126xHandle, AM_HAL_SYSCTRL_DEEPSLEEP, true);
-        radio_port_powered = false;
+        LORAWAN_INSTANCE->ui32RadioPortPowered = false;
+        lorawan_radio_port_power_set(false);
     }
 }
 
@@ -103,64 +157,83 @@ static void lorawan_task_on_sleep()
 {
     if (Radio.GetStatus() == RF_IDLE)
     {
+        lorawan_radio_state_update(true);
+
         typedef void (*callback_t)(void);
-        callback_t callback = (callback_t)lorawan_event_callback_list[LORAWAN_EVENT_SLEEP];
+        callback_t callback = (callback_t)lorawan_event_callback(LORAWAN_EVENT_SLEEP);
         if (callback)
         {
             callback();
         }
 
-        xTimerChangePeriod(radio_port_timer, pdMS_TO_TICKS(LORAWAN_SPI_PORT_TIMEOUT), 0);
+        if (LORAWAN_INSTANCE->eStackState == LORAWAN_STACK_STARTED)
+        {
+            lorawan_nvm_idle();
+        }
+
+        TickType_t timeout = pdMS_TO_TICKS(lorawan_radio_port_idle());
+        if (timeout > 0)
+        {
+            xTimerChangePeriod(radio_port_timer, timeout, 0);
+        }
+        else
+        {
+            radio_port_shutdown(radio_port_timer);
+        }
     }
 }
 
 static void lorawan_task_on_wake()
 {
     xTimerStop(radio_port_timer, 0);
+    lorawan_radio_port_active();
 
     // turn on the radio immediately as the stack may require access to the radio
     // hardware upon wake
     typedef void (*callback_t)(void);
-    callback_t callback = (callback_t)lorawan_event_callback_list[LORAWAN_EVENT_WAKE];
+    callback_t callback = (callback_t)lorawan_event_callback(LORAWAN_EVENT_WAKE);
     if (callback)
     {
         callback();
     }
 
-    if (radio_port_powered == false)
+    if (LORAWAN_INSTANCE->ui32RadioPortPowered == false)
     {
         am_hal_iom_power_ctrl(SX126xHandle, AM_HAL_SYSCTRL_WAKE, true);
-        radio_port_powered = true;
+        LORAWAN_INSTANCE->ui32RadioPortPowered = true;
+        lorawan_radio_port_power_set(true);
     }
 
-    // The radio looses the public network value across power cycles.
-    // The value can be retrieved from the MIB.  An MIB Set will
-    // trigger a write to the public network register in the radio.
-    MibRequestConfirm_t mibReq;
-    mibReq.Type = MIB_PUBLIC_NETWORK;
-    LoRaMacMibGetRequestConfirm(&mibReq);
-    LoRaMacMibSetRequestConfirm(&mibReq);
+    // Only write back the radio registers that were lost while the
+    // radio was powered down.  Waking the SPI port alone does not
+    // affect the radio content.
+    if (LORAWAN_INSTANCE->eStackState == LORAWAN_STACK_STARTED)
+    {
+        lorawan_radio_shadow_restore();
+    }
 }
 
-void lorawan_task_wake()
+void lorawan_task_wake(lorawan_wake_e eCause)
 {
     BaseType_t xHigherPriorityTaskWoken;
 
     lorawan_mac_pending = 1;
+    lorawan_record(LORAWAN_RECORD_WAKE, eCause, 0);
 
     // we power up the radio here as the LoRaWAN stack performs chip access
     // within an IRQ.
     typedef void (*callback_t)(void);
-    callback_t callback = (callback_t)lorawan_event_callback_list[LORAWAN_EVENT_WAKE];
+    callback_t callback = (callback_t)lorawan_event_callback(LORAWAN_EVENT_WAKE);
     if (callback)
     {
         callback();
     }
 
-    if (radio_port_powered == false)
+    if (LORAWAN_INSTANCE->ui32RadioPortPowered == false)
     {
         am_hal_iom_power_ctrl(SX126xHandle, AM_HAL_SYSCTRL_WAKE, true);
-        radio_port_powered = true;
+        LORAWAN_INSTANCE->ui32RadioPortPowered = true;
+        lorawan_radio_port_power_set(true);
     }
 
     if (lorawan_task_handle == NULL)
@@ -182,12 +255,48 @@ void lorawan_task_wake()
 
 void lorawan_wake_on_radio_irq()
 {
-    lorawan_task_wake();
+    RadioState_t eState = Radio.GetStatus();
+
+    lorawan_record(LORAWAN_RECORD_RADIO_IRQ, eState, 0);
+    if ((eState == RF_RX_RUNNING) && lorawan_record_is_active())
+    {
+        lorawan_rx_record_pending = 1;
+    }
+
+    // The radio leaves the transmit mode when the interrupt is processed by
+    // the stack, an interrupt raised while transmitting is the TX done.
+    if (eState == RF_TX_RUNNING)
+    {
+        lorawan_latency_tx_done_from_isr();
+    }
+
+    lorawan_task_wake(LORAWAN_WAKE_RADIO);
+    lorawan_radio_state_update(false);
 }
 
 void lorawan_wake_on_timer_irq()
 {
-    lorawan_task_wake();
+    lorawan_record(LORAWAN_RECORD_TIMER_IRQ, 0, 0);
+    lorawan_task_wake(LORAWAN_WAKE_TIMER);
+    lorawan_radio_state_update(false);
+}
+
+//
+// Record the outcome of the receive window and the frame, read from the
+// radio before the stack processes the interrupt and clears it.
+//
+static void lorawan_task_record_rx()
+{
+    static uint8_t pui8Payload[LORAWAN_RADIO_RX_PAYLOAD_MAX];
+    uint32_t ui32Size;
+
+    lorawan_rx_record_pending = 0;
+
+    lorawan_radio_rx_e eResult = lorawan_radio_rx_pending_get(pui8Payload, &ui32Size);
+    if (eResult != LORAWAN_RADIO_RX_NONE)
+    {
+        lorawan_record_rx(eResult, pui8Payload, ui32Size);
+    }
 }
 
 static void on_mac_process_notify()
@@ -195,6 +304,228 @@ static void on_mac_process_notify()
     lorawan_mac_pending = 1;
 }
 
+static void lorawan_join_expired(void *pvContext)
+{
+    LORAWAN_INSTANCE->sJoin.ui32Due = 1;
+    lorawan_task_wake(LORAWAN_WAKE_JOIN);
+}
+
+//
+// Time on air (ms) of a join request at a data rate, from the spreading
+// factor and bandwidth the region assigns to it.
+//
+static uint32_t lorawan_join_time_on_air(LoRaMacRegion_t eRegion, int32_t i32Datarate)
+{
+    int32_t i32SpreadingFactor;
+    uint32_t ui32Bandwidth = 0; // 125 kHz
+
+    switch (eRegion)
+    {
+    case LORAMAC_REGION_US915:
+        if (i32Datarate == 4)
+        {
+            i32SpreadingFactor = 8;
+            ui32Bandwidth = 2;
+        }
+        else if (i32Datarate >= 8)
+        {
+            i32SpreadingFactor = 20 - i32Datarate;
+            ui32Bandwidth = 2;
+        }
+        else
+        {
+            i32SpreadingFactor = 10 - i32Datarate;
+        }
+        break;
+
+    case LORAMAC_REGION_AU915:
+        if (i32Datarate == 6)
+        {
+            i32SpreadingFactor = 8;
+            ui32Bandwidth = 2;
+        }
+        else if (i32Datarate >= 8)
+        {
+            i32SpreadingFactor = 20 - i32Datarate;
+            ui32Bandwidth = 2;
+        }
+        else
+        {
+            i32SpreadingFactor = 12 - i32Datarate;
+        }
+        break;
+
+    default:
+        if (i32Datarate == 7)
+        {
+            return Radio.TimeOnAir(MODEM_FSK, 50000, 50000, 0, 5, false,
+                                   LORAWAN_JOIN_REQUEST_SIZE, true);
+        }
+        if (i32Datarate == 6)
+        {
+            i32SpreadingFactor = 7;
+            ui32Bandwidth = 1;
+        }
+        else
+        {
+            i32SpreadingFactor = 12 - i32Datarate;
+        }
+        break;
+    }
+
+    if ((i32SpreadingFactor < 7) || (i32SpreadingFactor > 12))
+    {
+        i32SpreadingFactor = 12;
+    }
+
+    return Radio.TimeOnAir(MODEM_LORA, ui32Bandwidth, i32SpreadingFactor, 1, 8, false,
+                           LORAWAN_JOIN_REQUEST_SIZE, true);
+}
+
+static void lorawan_join_window_update(TimerTime_t tNow)
+{
+    lorawan_join_state_t *psJoin = &LORAWAN_INSTANCE->sJoin;
+
+    if (!psJoin->ui32WindowValid)
+    {
+        psJoin->ui32WindowValid = 1;
+        psJoin->ui32Window = 0;
+        psJoin->tWindowStart = tNow;
+        psJoin->ui32WindowAirtime = 0;
+        return;
+    }
+
+    while ((tNow - psJoin->tWindowStart) >= lorawan_join_windows[psJoin->ui32Window].ui32Period)
+    {
+        psJoin->tWindowStart += lorawan_join_windows[psJoin->ui32Window].ui32Period;
+        psJoin->ui32WindowAirtime = 0;
+        if (psJoin->ui32Window < (LORAWAN_JOIN_WINDOWS - 1))
+        {
+            psJoin->ui32Window++;
+        }
+    }
+}
+
+//
+// Time until the airtime budget of the current window admits another
+// join request at the configured data rate.
+//
+static uint32_t lorawan_join_budget_wait(TimerTime_t tNow)
+{
+    lorawan_join_state_t *psJoin = &LORAWAN_INSTANCE->sJoin;
+    const lorawan_join_window_t *psWindow;
+    uint32_t ui32Airtime = lorawan_join_time_on_air(LORAWAN_INSTANCE->sParameters.Region,
+                                                    LORAWAN_INSTANCE->sParameters.TxDatarate);
+
+    lorawan_join_window_update(tNow);
+    psWindow = &lorawan_join_windows[psJoin->ui32Window];
+
+    if ((psJoin->ui32WindowAirtime + ui32Airtime) <= psWindow->ui32Budget)
+    {
+        return 0;
+    }
+
+    return psWindow->ui32Period - (tNow - psJoin->tWindowStart);
+}
+
+static uint32_t lorawan_join_backoff(uint32_t ui32Failures)
+{
+    uint32_t ui32Backoff = LORAWAN_JOIN_BACKOFF_MAX;
+
+    if ((ui32Failures > 0) && (ui32Failures < 32))
+    {
+        uint64_t ui64Backoff = (uint64_t)LORAWAN_JOIN_BACKOFF_MIN << (ui32Failures - 1);
+        if (ui64Backoff < LORAWAN_JOIN_BACKOFF_MAX)
+        {
+            ui32Backoff = (uint32_t)ui64Backoff;
+        }
+    }
+
+    // Half of the delay is random so that a fleet that lost its gateway
+    // does not retry in lockstep once it is back.
+    return (ui32Backoff / 2) + randr(0, ui32Backoff / 2);
+}
+
+static void lorawan_join_schedule(uint32_t ui32Delay)
+{
+    lorawan_join_state_t *psJoin = &LORAWAN_INSTANCE->sJoin;
+    TimerTime_t tNow = TimerGetCurrentTime();
+    uint32_t ui32Wait = lorawan_join_budget_wait(tNow);
+
+    if (ui32Wait > ui32Delay)
+    {
+        ui32Delay = ui32Wait;
+    }
+
+    LORAWAN_INSTANCE->sJoinStats.ui32Backoff = ui32Delay;
+    psJoin->tNext = tNow + ui32Delay;
+
+    TimerStop(&psJoin->sTimer);
+    TimerSetValue(&psJoin->sTimer, ui32Delay > 0 ? ui32Delay : 1);
+    TimerStart(&psJoin->sTimer);
+}
+
+static void lorawan_join_attempt()
+{
+    uint32_t ui32Wait = lorawan_join_budget_wait(TimerGetCurrentTime());
+
+    if (ui32Wait > 0)
+    {
+        lorawan_join_schedule(ui32Wait);
+        return;
+    }
+
+    LORAWAN_INSTANCE->sJoin.ui32InFlight = 1;
+    LORAWAN_INSTANCE->sJoinStats.ui32Attempts++;
+
+    LmHandlerJoin();
+    if (CommissioningParams.IsOtaaActivation)
+    {
+        lorawan_boot_mark(LORAWAN_BOOT_UPLINK);
+    }
+}
+
+static void lorawan_join_start()
+{
+    lorawan_join_state_t *psJoin = &LORAWAN_INSTANCE->sJoin;
+
+    // A join already under way keeps its schedule and its failure count.
+    // Every uplink queued while unjoined asks for a join, restarting the
+    // backoff on each of them would bring a fleet back into lockstep.
+    if (LORAWAN_INSTANCE->sJoinStats.ui32Active)
+    {
+        if (psJoin->ui32InFlight || psJoin->ui32Due || TimerIsStarted(&psJoin->sTimer))
+        {
+            return;
+        }
+    }
+    else
+    {
+        LORAWAN_INSTANCE->sJoinStats.ui32Active = 1;
+        psJoin->ui32Consecutive = 0;
+    }
+
+    if (psJoin->ui32InFlight)
+    {
+        return;
+    }
+
+    TimerStop(&psJoin->sTimer);
+    psJoin->ui32Due = 0;
+    lorawan_join_attempt();
+}
+
+static void lorawan_join_cancel()
+{
+    lorawan_join_state_t *psJoin = &LORAWAN_INSTANCE->sJoin;
+
+    TimerStop(&psJoin->sTimer);
+    psJoin->ui32Due = 0;
+    psJoin->ui32Requested = 0;
+    psJoin->ui32InFlight = 0;
+    LORAWAN_INSTANCE->sJoinStats.ui32Active = 0;
+}
+
 static void lorawan_task_handle_command()
 {
     lorawan_command_t command;
@@ -211,7 +542,7 @@ static void lorawan_task_handle_command()
             return;
         }
 
-        if (lorawan_stack_state == LORAWAN_STACK_STARTED)
+        if (LORAWAN_INSTANCE->eStackState == LORAWAN_STACK_STARTED)
         {
             switch (command.eCommand)
             {
@@ -219,7 +550,7 @@ static void lorawan_task_handle_command()
                 lorawan_stack_state_set(LORAWAN_STACK_STOPPED);
                 break;
             case LORAWAN_JOIN:
-                LmHandlerJoin();
+                lorawan_join_start();
                 break;
             case LORAWAN_SYNC_APP:
                 LmhpClockSyncAppTimeReq();
@@ -237,55 +568,366 @@ static void lorawan_task_handle_command()
     }
 }
 
+static void multicast_flush(TimerHandle_t timer)
+{
+    lorawan_task_wake(LORAWAN_WAKE_MULTICAST);
+}
+
+static void lorawan_task_multicast_defer()
+{
+    if (xTimerIsTimerActive(multicast_flush_timer) == pdTRUE)
+    {
+        return;
+    }
+
+    // Wake up right after the session ends to flush the held uplinks.
+    // The timer is armed again if the session turns out to last longer.
+    uint32_t ui32Remaining = LmhpRemoteMcastSessionRemainingTime();
+    xTimerChangePeriod(multicast_flush_timer,
+                       pdMS_TO_TICKS(ui32Remaining + LORAWAN_MULTICAST_FLUSH_MARGIN),
+                       0);
+
+    if (!LORAWAN_INSTANCE->ui32MulticastHeld)
+    {
+        LORAWAN_INSTANCE->ui32MulticastHeld = true;
+        LORAWAN_INSTANCE->sTransmitStats.ui32Deferred++;
+    }
+}
+
+// Uplinks held during a multicast session pile up for as long as the
+// session lasts.  Once the queue is full, the oldest held packet makes room
+// for the newest one so that the readings sent after the session are the
+// most recent ones.  Urgent packets are never displaced.  Must be called
+// with the scheduler suspended, see lorawan_task_handle_uplink.
+static void lorawan_transmit_displace()
+{
+    lorawan_tx_packet_t packet;
+
+    if (!LORAWAN_INSTANCE->ui32MulticastHeld)
+    {
+        return;
+    }
+
+    if ((xQueuePeek(LORAWAN_INSTANCE->xTransmitQueue, &packet, 0) != pdPASS) || packet.ui32Urgent)
+    {
+        return;
+    }
+
+    xQueueReceive(LORAWAN_INSTANCE->xTransmitQueue, &packet, 0);
+    lorawan_record(LORAWAN_RECORD_QUEUE_DROP, packet.ui32Port, packet.ui32Length);
+    if (packet.pui8Data != NULL)
+    {
+        vPortFree(packet.pui8Data);
+    }
+    LORAWAN_INSTANCE->sTransmitStats.ui32Displaced++;
+}
+
+static bool lorawan_tx_packet_expired(lorawan_tx_packet_t *psPacket)
+{
+    if (psPacket->ui32TimeToLive == 0)
+    {
+        return false;
+    }
+
+    return (xTaskGetTickCount() - psPacket->tEnqueued) >= pdMS_TO_TICKS(psPacket->ui32TimeToLive);
+}
+
+static bool lorawan_task_uplink_hold(lorawan_tx_packet_t *psPacket, bool *pbPreempt)
+{
+    // The LoRaWAN spec does not prevent the user from
+    // transmitting during a multicast session.  However,
+    // doing so will impact downlink messages from the LNS
+    // during a multicast.  We hold the uplinks in the queue
+    // until the session ends unless urgent packets are
+    // allowed to preempt the session.
+    *pbPreempt = false;
+    if (LmhpRemoteMcastSessionStateStarted())
+    {
+        if (!(psPacket->ui32Urgent && LORAWAN_INSTANCE->ui32MulticastPreempt))
+        {
+            lorawan_task_multicast_defer();
+            return true;
+        }
+        *pbPreempt = true;
+    }
+
+    return LmHandlerIsBusy();
+}
+
+static void segment_retry(TimerHandle_t timer)
+{
+    lorawan_task_wake(LORAWAN_WAKE_SEGMENT);
+}
+
+static bool lorawan_segment_required(lorawan_tx_packet_t *psPacket)
+{
+    LoRaMacTxInfo_t info;
+
+    if (LoRaMacQueryTxPossible(psPacket->ui32Length, &info) == LORAMAC_STATUS_OK)
+    {
+        return false;
+    }
+
+    // Pending MAC commands also shrink the payload, LmHandlerSend flushes
+    // them and the uplink fits into the next frame.
+    return psPacket->ui32Length > info.MaxPossibleApplicationDataSize;
+}
+
+static void lorawan_segment_done()
+{
+    lorawan_segment_state_t *psSegment = &LORAWAN_INSTANCE->sSegment;
+
+    if (psSegment->sPacket.pui8Data != NULL)
+    {
+        vPortFree(psSegment->sPacket.pui8Data);
+        psSegment->sPacket.pui8Data = NULL;
+    }
+    psSegment->ui32Active = 0;
+    xTimerStop(segment_retry_timer, 0);
+}
+
+static void lorawan_segment_start(lorawan_tx_packet_t *psPacket)
+{
+    lorawan_segment_state_t *psSegment = &LORAWAN_INSTANCE->sSegment;
+
+    memcpy(&psSegment->sPacket, psPacket, sizeof(lorawan_tx_packet_t));
+    psSegment->ui32Active = 1;
+    psSegment->ui32Offset = 0;
+    psSegment->ui8Index = 0;
+    psSegment->ui8Id++;
+    LORAWAN_INSTANCE->sTransmitStats.ui32Segmented++;
+}
+
+static void lorawan_segment_send(bool bPreempt)
+{
+    lorawan_segment_state_t *psSegment = &LORAWAN_INSTANCE->sSegment;
+    lorawan_tx_packet_t *psPacket = &psSegment->sPacket;
+    uint8_t *pui8Buffer = LORAWAN_INSTANCE->pui8DataBuffer;
+    uint32_t ui32Header =
+        (psSegment->ui8Index == 0) ? LORAWAN_SEGMENT_FIRST_HEADER : LORAWAN_SEGMENT_HEADER;
+    LoRaMacTxInfo_t info;
+
+    // The data rate may have changed since the last segment, the size of
+    // every segment is derived from the limits in force when it is sent.
+    LoRaMacQueryTxPossible(ui32Header, &info);
+    if (info.MaxPossibleApplicationDataSize <= ui32Header)
+    {
+        LORAWAN_INSTANCE->sTransmitStats.ui32Dropped++;
+        lorawan_latency_abort();
+        lorawan_segment_done();
+        return;
+    }
+
+    LmHandlerAppData_t app_data;
+    app_data.Port = LORAWAN_SEGMENT_PORT;
+    app_data.Buffer = pui8Buffer;
+
+    // Without room for a segment next to the pending MAC commands, they
+    // are sent on their own and the segment follows in the next frame.
+    if (info.CurrentPossiblePayloadSize <= ui32Header)
+    {
+        app_data.BufferSize = 0;
+        if (LmHandlerSend(&app_data, LORAMAC_HANDLER_UNCONFIRMED_MSG) != LORAMAC_HANDLER_SUCCESS)
+        {
+            xTimerChangePeriod(segment_retry_timer, pdMS_TO_TICKS(LORAWAN_SEGMENT_RETRY_DELAY), 0);
+        }
+        return;
+    }
+
+    uint32_t ui32Chunk = psPacket->ui32Length - psSegment->ui32Offset;
+    bool bLast = true;
+    if (ui32Chunk > info.CurrentPossiblePayloadSize - ui32Header)
+    {
+        ui32Chunk = info.CurrentPossiblePayloadSize - ui32Header;
+        bLast = false;
+    }
+
+    pui8Buffer[0] = psSegment->ui8Id;
+    pui8Buffer[1] = psSegment->ui8Index | (bLast ? LORAWAN_SEGMENT_LAST : 0);
+    if (psSegment->ui8Index == 0)
+    {
+        pui8Buffer[2] = (uint8_t)psPacket->ui32Port;
+        pui8Buffer[3] = (uint8_t)psPacket->ui32Length;
+    }
+    memcpy(&pui8Buffer[ui32Header], &psPacket->pui8Data[psSegment->ui32Offset], ui32Chunk);
+    app_data.BufferSize = ui32Header + ui32Chunk;
+
+    if (LmHandlerSend(&app_data, psPacket->tType) != LORAMAC_HANDLER_SUCCESS)
+    {
+        xTimerChangePeriod(segment_retry_timer, pdMS_TO_TICKS(LORAWAN_SEGMENT_RETRY_DELAY), 0);
+        return;
+    }
+
+    lorawan_boot_mark(LORAWAN_BOOT_UPLINK);
+    lorawan_latency_sent(bLast);
+
+    if (bPreempt)
+    {
+        LORAWAN_INSTANCE->sTransmitStats.ui32Preempted++;
+    }
+    LORAWAN_INSTANCE->sTransmitStats.ui32Segments++;
+
+    psSegment->ui32Offset += ui32Chunk;
+    psSegment->ui8Index++;
+    if (bLast)
+    {
+        lorawan_segment_done();
+    }
+}
+
 static void lorawan_task_handle_uplink()
 {
     lorawan_tx_packet_t packet;
-    if (xQueuePeek(transmit_queue, &packet, 0) == pdPASS)
+    bool bPreempt;
+
+    if (LORAWAN_INSTANCE->sSegment.ui32Active)
     {
-        if (LmHandlerIsBusy() == true)
+        if (!lorawan_task_uplink_hold(&LORAWAN_INSTANCE->sSegment.sPacket, &bPreempt))
         {
+            lorawan_segment_send(bPreempt);
+        }
+        return;
+    }
+
+    if (!LmhpRemoteMcastSessionStateStarted())
+    {
+        LORAWAN_INSTANCE->ui32MulticastHeld = false;
+    }
+
+    while (1)
+    {
+        // lorawan_transmit may displace the oldest packet while uplinks are
+        // held, keep it out from the peek to the receive of that packet.
+        vTaskSuspendAll();
+
+        if (xQueuePeek(LORAWAN_INSTANCE->xTransmitQueue, &packet, 0) != pdPASS)
+        {
+            xTaskResumeAll();
+            return;
+        }
+
+        if (lorawan_tx_packet_expired(&packet))
+        {
+            xQueueReceive(LORAWAN_INSTANCE->xTransmitQueue, &packet, 0);
+            xTaskResumeAll();
+            lorawan_record(LORAWAN_RECORD_QUEUE_EXPIRE, packet.ui32Port, packet.ui32Length);
+            if (packet.pui8Data != NULL)
+            {
+                vPortFree(packet.pui8Data);
+            }
+            LORAWAN_INSTANCE->sTransmitStats.ui32Expired++;
+            continue;
+        }
+
+        if (lorawan_task_uplink_hold(&packet, &bPreempt))
+        {
+            xTaskResumeAll();
             return;
         }
 
-        xQueueReceive(transmit_queue, &packet, 0);
+        xQueueReceive(LORAWAN_INSTANCE->xTransmitQueue, &packet, 0);
+        xTaskResumeAll();
+        lorawan_record(LORAWAN_RECORD_QUEUE_RECEIVE, packet.ui32Port, packet.ui32Length);
+        lorawan_latency_dequeue(packet.ui32Port, packet.ui32Urgent, packet.tEnqueued);
+
+        if (LORAWAN_INSTANCE->ui32Segmentation && lorawan_segment_required(&packet))
+        {
+            lorawan_segment_start(&packet);
+            lorawan_segment_send(bPreempt);
+            return;
+        }
 
         LmHandlerAppData_t app_data;
 
         if (packet.ui32Length > 0)
         {
-            memcpy(psLmDataBuffer, packet.pui8Data, packet.ui32Length);
+            memcpy(LORAWAN_INSTANCE->pui8DataBuffer, packet.pui8Data, packet.ui32Length);
             vPortFree(packet.pui8Data);
         }
         app_data.Port = packet.ui32Port;
         app_data.BufferSize = packet.ui32Length;
-        app_data.Buffer = psLmDataBuffer;
+        app_data.Buffer = LORAWAN_INSTANCE->pui8DataBuffer;
 
-        // The LoRaWAN spec does not prevent the user from 
-        // transmitting during a multicast session.  However,
-        // doing so will impact downlink messages from the LNS
-        // during a multicast.  We default to dequeue and return
-        // if we are in a multicast session.
-        if (LmhpRemoteMcastSessionStateStarted())
+        if (bPreempt)
         {
-            return;
+            LORAWAN_INSTANCE->sTransmitStats.ui32Preempted++;
+        }
+
+        if (LmHandlerSend(&app_data, packet.tType) == LORAMAC_HANDLER_SUCCESS)
+        {
+            lorawan_boot_mark(LORAWAN_BOOT_UPLINK);
+            lorawan_latency_sent(true);
+        }
+        else
+        {
+            lorawan_latency_abort();
         }
+        return;
+    }
+}
+
+static void lorawan_packages_deferred_register()
+{
+    LmHandlerPackageRegister(PACKAGE_ID_COMPLIANCE, &lmhp_compliance_parameters);
+
+    lmhp_fragmentation_setup(&LORAWAN_INSTANCE->sFragmentationParameters);
+    LmHandlerPackageRegister(PACKAGE_ID_FRAGMENTATION, &LORAWAN_INSTANCE->sFragmentationParameters);
+}
+
+static void lorawan_boot_deferred_run()
+{
+    // The packages must be in place before the receive windows of the
+    // first uplink open.
+    if ((lorawan_boot_deferred & LORAWAN_BOOT_DEFER_PACKAGES) &&
+        (lorawan_boot_stats.ui32Reached & (1 << LORAWAN_BOOT_UPLINK)))
+    {
+        lorawan_boot_deferred &= ~LORAWAN_BOOT_DEFER_PACKAGES;
+        lorawan_packages_deferred_register();
+    }
 
-        LmHandlerSend(&app_data, packet.tType);
+    // The MAC rejects requests while the uplink is in progress.
+    if ((lorawan_boot_deferred == LORAWAN_BOOT_DEFER_TIME) && (LmHandlerIsBusy() == false))
+    {
+        lorawan_boot_deferred = 0;
+        if (LmHandlerJoinStatus() == LORAMAC_HANDLER_SET)
+        {
+            LmHandlerDeviceTimeReq();
+        }
+        lorawan_boot_mark(LORAWAN_BOOT_DEFERRED);
     }
 }
 
 static void lorawan_task(void *pvParameters)
 {
     lorawan_mac_pending = 0;
-    lorawan_stack_state = LORAWAN_STACK_STOPPED;
+    LORAWAN_INSTANCE->eStackState = LORAWAN_STACK_STOPPED;
     lorawan_task_cli_register();
 
     while (1)
     {
-        if (lorawan_stack_state == LORAWAN_STACK_STARTED)
+        if (LORAWAN_INSTANCE->eStackState == LORAWAN_STACK_STARTED)
         {
+            if (lorawan_rx_record_pending)
+            {
+                lorawan_task_record_rx();
+            }
             LmHandlerProcess();
+            if (LORAWAN_INSTANCE->sJoin.ui32Requested)
+            {
+                LORAWAN_INSTANCE->sJoin.ui32Requested = 0;
+                lorawan_join_start();
+            }
+            if (LORAWAN_INSTANCE->sJoin.ui32Due)
+            {
+                LORAWAN_INSTANCE->sJoin.ui32Due = 0;
+                lorawan_join_attempt();
+            }
             lorawan_task_handle_uplink();
+            if (lorawan_boot_deferred)
+            {
+                lorawan_boot_deferred_run();
+            }
+            lorawan_radio_state_update(false);
         }
 
         lorawan_task_handle_command();
@@ -346,10 +988,10 @@ void lorawan_network_config(lorawan_region_e eRegion,
         return;
     }
 
-    lmh_parameters.Region = region;
-    lmh_parameters.AdrEnable = i8ADR;
-    lmh_parameters.TxDatarate = eDataRate;
-    lmh_parameters.PublicNetworkEnable = i8PublicNetwork;
+    LORAWAN_INSTANCE->sParameters.Region = region;
+    LORAWAN_INSTANCE->sParameters.AdrEnable = i8ADR;
+    LORAWAN_INSTANCE->sParameters.TxDatarate = eDataRate;
+    LORAWAN_INSTANCE->sParameters.PublicNetworkEnable = i8PublicNetwork;
 }
 
 void lorawan_activation_config(lorawan_activation_type_e sType,
@@ -377,66 +1019,100 @@ void lorawan_stack_state_set(lorawan_stack_state_e eState)
     switch (eState)
     {
     case LORAWAN_STACK_STARTED:
-        if (lorawan_stack_state == LORAWAN_STACK_STOPPED)
+        if (LORAWAN_INSTANCE->eStackState == LORAWAN_STACK_STOPPED)
         {
+            memset(&lorawan_boot_stats, 0, sizeof(lorawan_boot_stats));
+            lorawan_boot_stats.ui32FastBoot = LORAWAN_INSTANCE->ui32FastBoot;
+            lorawan_boot_mark(LORAWAN_BOOT_START);
+
             lorawan_task_on_wake();
             BoardInitMcu();
             BoardInitPeriph();
+            lorawan_boot_mark(LORAWAN_BOOT_BOARD);
+            lorawan_record(LORAWAN_RECORD_START, 0, 0);
 
-            lmh_parameters.DataBufferMaxSize = LM_BUFFER_SIZE;
-            lmh_parameters.DataBuffer = psLmDataBuffer;
+            LORAWAN_INSTANCE->sParameters.DataBufferMaxSize = LORAWAN_DATA_BUFFER_SIZE;
+            LORAWAN_INSTANCE->sParameters.DataBuffer = LORAWAN_INSTANCE->pui8DataBuffer;
 
-            switch (lmh_parameters.Region)
+            switch (LORAWAN_INSTANCE->sParameters.Region)
             {
             case LORAMAC_REGION_EU868:
             case LORAMAC_REGION_RU864:
             case LORAMAC_REGION_CN779:
-                lmh_parameters.DutyCycleEnabled = true;
+                LORAWAN_INSTANCE->sParameters.DutyCycleEnabled = true;
                 break;
             default:
-                lmh_parameters.DutyCycleEnabled = false;
+                LORAWAN_INSTANCE->sParameters.DutyCycleEnabled = false;
                 break;
             }
 
-            lmh_callbacks_setup(&lmh_callbacks);
-            lmh_callbacks.OnMacProcess = on_mac_process_notify;
+            lmh_callbacks_setup(&LORAWAN_INSTANCE->sCallbacks);
+            LORAWAN_INSTANCE->sCallbacks.OnMacProcess = on_mac_process_notify;
 
-            LmHandlerInit(&lmh_callbacks, &lmh_parameters);
+            LmHandlerInit(&LORAWAN_INSTANCE->sCallbacks, &LORAWAN_INSTANCE->sParameters);
+            TimerInit(&LORAWAN_INSTANCE->sJoin.sTimer, lorawan_join_expired);
+            LORAWAN_INSTANCE->sJoin.ui32WindowValid = 0;
             LmHandlerSetSystemMaxRxError(20);
+            lorawan_radio_shadow_sync(LORAWAN_RADIO_REG_ALL);
+            lorawan_boot_mark(LORAWAN_BOOT_MAC);
 
-            LmhpComplianceParams_t lmhp_compliance_parameters;
-            LmHandlerPackageRegister(PACKAGE_ID_COMPLIANCE, &lmhp_compliance_parameters);
+            // The clock sync and multicast setup packages are cheap to
+            // register and the uplink path queries the multicast state.
             LmHandlerPackageRegister(PACKAGE_ID_CLOCK_SYNC, NULL);
             LmHandlerPackageRegister(PACKAGE_ID_REMOTE_MCAST_SETUP, NULL);
 
-            lmhp_fragmentation_setup(&lmhp_fragmentation_parameters);
-            LmHandlerPackageRegister(PACKAGE_ID_FRAGMENTATION, &lmhp_fragmentation_parameters);
+            lorawan_boot_deferred = 0;
+            if (LORAWAN_INSTANCE->ui32FastBoot)
+            {
+                lorawan_boot_deferred = LORAWAN_BOOT_DEFER_PACKAGES | LORAWAN_BOOT_DEFER_TIME;
+            }
+            else
+            {
+                lorawan_packages_deferred_register();
+            }
+            lorawan_boot_mark(LORAWAN_BOOT_PACKAGES);
 
-            lorawan_stack_state = LORAWAN_STACK_STARTED;
-            if (LmHandlerJoinStatus() == LORAMAC_HANDLER_SET)
+            LORAWAN_INSTANCE->eStackState = LORAWAN_STACK_STARTED;
+            if (!LORAWAN_INSTANCE->ui32FastBoot && (LmHandlerJoinStatus() == LORAMAC_HANDLER_SET))
             {
                 LmHandlerDeviceTimeReq();
             }
             Radio.Sleep();
 
-            radio_port_powered = true;
-            lorawan_task_wake();
+            LORAWAN_INSTANCE->ui32RadioPortPowered = true;
+            lorawan_radio_port_power_set(true);
+            lorawan_task_wake(LORAWAN_WAKE_STACK);
+            lorawan_boot_mark(LORAWAN_BOOT_READY);
         }
         break;
 
     case LORAWAN_STACK_STOPPED:
-        if (lorawan_stack_state == LORAWAN_STACK_STARTED)
+        if (LORAWAN_INSTANCE->eStackState == LORAWAN_STACK_STARTED)
         {
+            lorawan_nvm_flush();
+            lorawan_join_cancel();
             LoRaMacStop();
             LoRaMacDeInitialization();
             BoardDeInitMcu();
+            lorawan_radio_shadow_invalidate(LORAWAN_RADIO_REG_ALL);
             lorawan_task_on_sleep();
-            xQueueReset(transmit_queue);
+            xTimerStop(multicast_flush_timer, 0);
+            xQueueReset(LORAWAN_INSTANCE->xTransmitQueue);
+            LORAWAN_INSTANCE->ui32MulticastHeld = false;
+            if (LORAWAN_INSTANCE->sSegment.ui32Active)
+            {
+                LORAWAN_INSTANCE->sTransmitStats.ui32Dropped++;
+                lorawan_segment_done();
+            }
+            lorawan_latency_abort();
+            lorawan_boot_deferred = 0;
 
-            lorawan_stack_state = LORAWAN_STACK_STOPPED;
-            radio_port_powered = false;
+            LORAWAN_INSTANCE->eStackState = LORAWAN_STACK_STOPPED;
+            LORAWAN_INSTANCE->ui32RadioPortPowered = false;
+            lorawan_radio_port_power_set(false);
 
-            lorawan_task_wake();
+            lorawan_record(LORAWAN_RECORD_STOP, 0, 0);
+            lorawan_task_wake(LORAWAN_WAKE_STACK);
         }
         break;
 
@@ -447,7 +1123,7 @@ void lorawan_stack_state_set(lorawan_stack_state_e eState)
 
 void lorawan_stack_state_get(lorawan_stack_state_e *peState)
 {
-    *peState = lorawan_stack_state;
+    *peState = LORAWAN_INSTANCE->eStackState;
 }
 
 void lorawan_join()
@@ -456,6 +1132,97 @@ void lorawan_join()
     lorawan_send_command(&command);
 }
 
+void lorawan_join_request_status(LoRaMacStatus_t eStatus, TimerTime_t ui32DutyCycleWait)
+{
+    lorawan_join_state_t *psJoin = &LORAWAN_INSTANCE->sJoin;
+
+    if (!psJoin->ui32InFlight || (eStatus == LORAMAC_STATUS_OK))
+    {
+        return;
+    }
+
+    // The request never left the device, no join callback follows.
+    psJoin->ui32InFlight = 0;
+    psJoin->ui32Consecutive++;
+    LORAWAN_INSTANCE->sJoinStats.ui32Rejected++;
+
+    if (LORAWAN_INSTANCE->sJoinStats.ui32Active)
+    {
+        uint32_t ui32Delay = lorawan_join_backoff(psJoin->ui32Consecutive);
+        lorawan_join_schedule(ui32DutyCycleWait > ui32Delay ? ui32DutyCycleWait : ui32Delay);
+    }
+}
+
+void lorawan_join_result(LmHandlerJoinParams_t *psParams)
+{
+    lorawan_join_state_t *psJoin = &LORAWAN_INSTANCE->sJoin;
+
+    if (psJoin->ui32InFlight)
+    {
+        uint32_t ui32Airtime =
+            lorawan_join_time_on_air(LORAWAN_INSTANCE->sParameters.Region, psParams->Datarate);
+
+        psJoin->ui32InFlight = 0;
+        psJoin->ui32WindowAirtime += ui32Airtime;
+        LORAWAN_INSTANCE->sJoinStats.ui32Airtime += ui32Airtime;
+    }
+
+    if (psParams->Status == LORAMAC_HANDLER_SUCCESS)
+    {
+        TimerStop(&psJoin->sTimer);
+        psJoin->ui32Consecutive = 0;
+        LORAWAN_INSTANCE->sJoinStats.ui32Active = 0;
+        LORAWAN_INSTANCE->sJoinStats.ui32Joins++;
+        return;
+    }
+
+    psJoin->ui32Consecutive++;
+    LORAWAN_INSTANCE->sJoinStats.ui32Failures++;
+    if (LORAWAN_INSTANCE->sJoinStats.ui32Active)
+    {
+        lorawan_join_schedule(lorawan_join_backoff(psJoin->ui32Consecutive));
+    }
+}
+
+uint32_t lorawan_transmit_size_max_get()
+{
+    LoRaMacTxInfo_t info;
+
+    LoRaMacQueryTxPossible(0, &info);
+
+    return info.MaxPossibleApplicationDataSize;
+}
+
+uint32_t lorawan_join_next_attempt_get()
+{
+    lorawan_join_state_t *psJoin = &LORAWAN_INSTANCE->sJoin;
+
+    if (!LORAWAN_INSTANCE->sJoinStats.ui32Active || psJoin->ui32InFlight ||
+        !TimerIsStarted(&psJoin->sTimer))
+    {
+        return 0;
+    }
+
+    TimerTime_t tNow = TimerGetCurrentTime();
+    if ((int32_t)(psJoin->tNext - tNow) <= 0)
+    {
+        return 0;
+    }
+
+    return psJoin->tNext - tNow;
+}
+
+void lorawan_join_stats_get(lorawan_join_stats_t *psStats)
+{
+    lorawan_join_state_t *psJoin = &LORAWAN_INSTANCE->sJoin;
+
+    memcpy(psStats, &LORAWAN_INSTANCE->sJoinStats, sizeof(lorawan_join_stats_t));
+
+    psStats->ui32WindowAirtime = psJoin->ui32WindowAirtime;
+    psStats->ui32WindowBudget = lorawan_join_windows[psJoin->ui32Window].ui32Budget;
+    psStats->ui32NextAttempt = lorawan_join_next_attempt_get();
+}
+
 uint32_t lorawan_get_join_state()
 {
     if (LmHandlerJoinStatus() == LORAMAC_HANDLER_SET)
@@ -514,24 +1281,46 @@ void lorawan_request_time_sync()
 
 void lorawan_send_command(lorawan_command_t *psCommand)
 {
+    lorawan_record(LORAWAN_RECORD_COMMAND,
+                   psCommand->eCommand,
+                   (uint32_t)(uintptr_t)psCommand->pvParameters);
     xQueueSend(command_queue, psCommand, 0);
-    lorawan_task_wake();
+    lorawan_task_wake(LORAWAN_WAKE_COMMAND);
 }
 
 void lorawan_transmit(uint32_t ui32Port, uint32_t ui32Ack, uint32_t ui32Length, uint8_t *pui8Data)
+{
+    lorawan_transmit_with_options(ui32Port, ui32Ack, ui32Length, pui8Data, NULL);
+}
+
+void lorawan_transmit_with_options(uint32_t ui32Port,
+                                   uint32_t ui32Ack,
+                                   uint32_t ui32Length,
+                                   uint8_t *pui8Data,
+                                   const lorawan_transmit_options_t *psOptions)
 {
     lorawan_tx_packet_t packet;
 
+    // The join scheduler keeps the backoff of a join already under way.
     if (LmHandlerJoinStatus() != LORAMAC_HANDLER_SET)
     {
-        lorawan_join();
+        LORAWAN_INSTANCE->sJoin.ui32Requested = 1;
+        lorawan_task_wake(LORAWAN_WAKE_JOIN);
         return;
     }
 
+    lorawan_record(LORAWAN_RECORD_QUEUE_SEND,
+                   ui32Port,
+                   ui32Length | (ui32Ack ? LORAWAN_RECORD_QUEUE_CONFIRMED : 0) |
+                       ((psOptions && psOptions->ui32Urgent) ? LORAWAN_RECORD_QUEUE_URGENT : 0));
+
     packet.tType = ui32Ack ? LORAMAC_HANDLER_CONFIRMED_MSG : LORAMAC_HANDLER_UNCONFIRMED_MSG;
     packet.ui32Port = ui32Port;
     packet.ui32Length = ui32Length;
     packet.pui8Data = NULL;
+    packet.tEnqueued = xTaskGetTickCount();
+    packet.ui32TimeToLive = psOptions ? psOptions->ui32TimeToLive : 0;
+    packet.ui32Urgent = psOptions ? psOptions->ui32Urgent : 0;
 
     if (ui32Length > 0)
     {
@@ -543,13 +1332,31 @@ void lorawan_transmit(uint32_t ui32Port, uint32_t ui32Ack, uint32_t ui32Length,
         packet.pui8Data = NULL;
     }
 
-    BaseType_t status = xQueueSend(transmit_queue, &packet, 0);
+    BaseType_t status;
+    vTaskSuspendAll();
+    if (uxQueueSpacesAvailable(LORAWAN_INSTANCE->xTransmitQueue) == 0)
+    {
+        lorawan_transmit_displace();
+    }
+    if (packet.ui32Urgent)
+    {
+        status = xQueueSendToFront(LORAWAN_INSTANCE->xTransmitQueue, &packet, 0);
+    }
+    else
+    {
+        status = xQueueSend(LORAWAN_INSTANCE->xTransmitQueue, &packet, 0);
+    }
+    xTaskResumeAll();
+
     if (status == pdTRUE)
     {
-        lorawan_task_wake();
+        LORAWAN_INSTANCE->sTransmitStats.ui32Queued++;
+        lorawan_task_wake(LORAWAN_WAKE_TRANSMIT);
     }
     else
     {
+        lorawan_record(LORAWAN_RECORD_QUEUE_DROP, ui32Port, ui32Length);
+        LORAWAN_INSTANCE->sTransmitStats.ui32Dropped++;
         if (packet.pui8Data != NULL)
         {
             vPortFree(packet.pui8Data);
@@ -557,12 +1364,73 @@ void lorawan_transmit(uint32_t ui32Port, uint32_t ui32Ack, uint32_t ui32Length,
     }
 }
 
+void lorawan_multicast_preempt_set(uint32_t ui32Enabled)
+{
+    LORAWAN_INSTANCE->ui32MulticastPreempt = ui32Enabled;
+}
+
+void lorawan_segmentation_set(uint32_t ui32Enabled)
+{
+    LORAWAN_INSTANCE->ui32Segmentation = ui32Enabled;
+}
+
+void lorawan_fast_boot_set(uint32_t ui32Enabled)
+{
+    LORAWAN_INSTANCE->ui32FastBoot = ui32Enabled;
+}
+
+void lorawan_boot_mark(lorawan_boot_phase_e ePhase)
+{
+    if (!(lorawan_boot_stats.ui32Reached & (1 << ePhase)))
+    {
+        lorawan_boot_stats.pui32Timestamp[ePhase] = am_hal_stimer_counter_get();
+        lorawan_boot_stats.ui32Reached |= 1 << ePhase;
+    }
+}
+
+void lorawan_boot_stats_get(lorawan_boot_stats_t *psStats)
+{
+    memcpy(psStats, &lorawan_boot_stats, sizeof(lorawan_boot_stats_t));
+}
+
+const char *lorawan_boot_phase_name(lorawan_boot_phase_e ePhase)
+{
+    return (ePhase < LORAWAN_BOOT_PHASES) ? lorawan_boot_phase_names[ePhase] : "";
+}
+
+void lorawan_transmit_stats_get(lorawan_transmit_stats_t *psStats)
+{
+    memcpy(psStats, &LORAWAN_INSTANCE->sTransmitStats, sizeof(lorawan_transmit_stats_t));
+}
+
+void lorawan_transmit_stats_reset()
+{
+    memset(&LORAWAN_INSTANCE->sTransmitStats, 0, sizeof(lorawan_transmit_stats_t));
+}
+
+static void lorawan_instance_init(lorawan_instance_t *psInstance)
+{
+    psInstance->eStackState = LORAWAN_STACK_STOPPED;
+    psInstance->ui32RadioPortPowered = false;
+    psInstance->ui32MulticastPreempt = 0;
+    psInstance->ui32Segmentation = LORAWAN_SEGMENTATION_DEFAULT;
+    psInstance->ui32FastBoot = LORAWAN_FAST_BOOT_DEFAULT;
+    psInstance->xTransmitQueue =
+        xQueueCreate(LORAWAN_TRANSMIT_QUEUE_MAX_SIZE, sizeof(lorawan_tx_packet_t));
+
+    memset(&psInstance->sCallbacks, 0, sizeof(LmHandlerCallbacks_t));
+    memset(&psInstance->sTransmitStats, 0, sizeof(lorawan_transmit_stats_t));
+    memset(&psInstance->sJoinStats, 0, sizeof(lorawan_join_stats_t));
+    lorawan_se_init(&psInstance->sSecureElement);
+}
+
 void lorawan_task_create(uint32_t ui32Priority)
 {
     xTaskCreate(lorawan_task, "lorawan", 512, 0, ui32Priority, &lorawan_task_handle);
 
     command_queue = xQueueCreate(LORAWAN_COMMAND_QUEUE_MAX_SIZE, sizeof(lorawan_command_t));
-    transmit_queue = xQueueCreate(LORAWAN_TRANSMIT_QUEUE_MAX_SIZE, sizeof(lorawan_tx_packet_t));
+
+    lorawan_instance_init(&lorawan_instance);
 
     radio_port_timer = xTimerCreate("LoRaWAN Port Timer",
                                     pdMS_TO_TICKS(LORAWAN_SPI_PORT_TIMEOUT),
@@ -570,6 +1438,21 @@ void lorawan_task_create(uint32_t ui32Priority)
                                     NULL,
                                     radio_port_shutdown);
 
-    memset(&lmh_callbacks, 0, sizeof(LmHandlerCallbacks_t));
+    multicast_flush_timer = xTimerCreate("LoRaWAN Multicast Flush Timer",
+                                         pdMS_TO_TICKS(LORAWAN_MULTICAST_FLUSH_MARGIN),
+                                         pdFALSE,
+                                         NULL,
+                                         multicast_flush);
+
+    segment_retry_timer = xTimerCreate("LoRaWAN Segment Retry Timer",
+                                       pdMS_TO_TICKS(LORAWAN_SEGMENT_RETRY_DELAY),
+                                       pdFALSE,
+                                       NULL,
+                                       segment_retry);
+
     lorawan_tracing_enabled = 0;
+
+    lorawan_radio_shadow_init();
+    lorawan_radio_port_init();
+    lorawan_nvm_init();
 }
\ No newline at end of file
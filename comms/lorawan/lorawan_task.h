@@ -43,6 +43,35 @@ extern "C" {
 #define LORAWAN_COMMAND_QUEUE_MAX_SIZE  (8)
 #define LORAWAN_TRANSMIT_QUEUE_MAX_SIZE (8)
 
+// Clock of the boot phase timestamps (STIMER).
+#ifndef LORAWAN_BOOT_TIMER_HZ
+#define LORAWAN_BOOT_TIMER_HZ (32768)
+#endif
+
+// Delay before the first join retry, doubled after every failure.
+#ifndef LORAWAN_JOIN_BACKOFF_MIN
+#define LORAWAN_JOIN_BACKOFF_MIN (15000)
+#endif
+
+#ifndef LORAWAN_JOIN_BACKOFF_MAX
+#define LORAWAN_JOIN_BACKOFF_MAX (3600000)
+#endif
+
+// Application port carrying the segments of uplinks larger than the
+// payload limit of the current data rate.
+#ifndef LORAWAN_SEGMENT_PORT
+#define LORAWAN_SEGMENT_PORT (199)
+#endif
+
+#ifndef LORAWAN_SEGMENTATION_DEFAULT
+#define LORAWAN_SEGMENTATION_DEFAULT 0
+#endif
+
+// Delay before a segment refused by the MAC (duty cycle) is offered again.
+#ifndef LORAWAN_SEGMENT_RETRY_DELAY
+#define LORAWAN_SEGMENT_RETRY_DELAY (1000)
+#endif
+
 typedef enum
 {
     LORAWAN_START,
@@ -59,17 +88,88 @@ typedef struct
     void *pvParameters;
 } lorawan_command_t;
 
-extern lorawan_event_callback_t lorawan_event_callback_list[LORAWAN_EVENTS];
+// Reason the LoRaWAN task is woken, kept by the event recorder.
+typedef enum
+{
+    LORAWAN_WAKE_RADIO,     ///< radio interrupt
+    LORAWAN_WAKE_TIMER,     ///< LoRaMac timer alarm
+    LORAWAN_WAKE_MAC,       ///< processing requested by the MAC
+    LORAWAN_WAKE_STACK,     ///< stack started or stopped
+    LORAWAN_WAKE_COMMAND,   ///< command queued
+    LORAWAN_WAKE_TRANSMIT,  ///< uplink queued
+    LORAWAN_WAKE_JOIN,      ///< join retry due
+    LORAWAN_WAKE_MULTICAST, ///< uplinks held during a multicast session released
+    LORAWAN_WAKE_SEGMENT,   ///< segment refused by the MAC offered again
+    LORAWAN_WAKE_NVM,       ///< context write due
+} lorawan_wake_e;
+
+typedef struct
+{
+    uint32_t ui32Queued;
+    uint32_t ui32Dropped;   ///< transmit queue full
+    uint32_t ui32Expired;   ///< time to live elapsed while queued
+    uint32_t ui32Deferred;  ///< multicast sessions during which uplinks were held
+    uint32_t ui32Displaced; ///< held uplinks dropped to make room for newer ones
+    uint32_t ui32Preempted; ///< urgent uplinks sent during a multicast session
+    uint32_t ui32Segmented; ///< uplinks split over several frames
+    uint32_t ui32Segments;  ///< segment frames handed to the MAC
+} lorawan_transmit_stats_t;
+
+typedef struct
+{
+    uint32_t ui32Active;        ///< failed joins are retried
+    uint32_t ui32Attempts;      ///< join requests handed to the MAC
+    uint32_t ui32Rejected;      ///< requests refused by the MAC (duty cycle, busy)
+    uint32_t ui32Failures;      ///< join requests left without a join accept
+    uint32_t ui32Joins;
+    uint32_t ui32Airtime;       ///< aggregated join request airtime (ms)
+    uint32_t ui32WindowAirtime; ///< airtime in the current backoff window (ms)
+    uint32_t ui32WindowBudget;  ///< airtime allowed in the current backoff window (ms)
+    uint32_t ui32Backoff;       ///< delay of the last scheduled retry (ms)
+    uint32_t ui32NextAttempt;   ///< ms until the next attempt, 0 if none is scheduled
+} lorawan_join_stats_t;
+
+typedef enum
+{
+    LORAWAN_BOOT_START,    ///< stack start requested
+    LORAWAN_BOOT_BOARD,    ///< MCU port and radio initialized
+    LORAWAN_BOOT_MAC,      ///< LmHandlerInit returned, includes the NVM context restore
+    LORAWAN_BOOT_PACKAGES, ///< packages needed at boot registered
+    LORAWAN_BOOT_READY,    ///< stack started, uplinks are accepted
+    LORAWAN_BOOT_UPLINK,   ///< first frame (join request or data) handed to the MAC
+    LORAWAN_BOOT_DEFERRED, ///< deferred packages and time request issued (fast boot)
+    LORAWAN_BOOT_CONFIRM,  ///< first transmit confirmation
+    LORAWAN_BOOT_PHASES
+} lorawan_boot_phase_e;
+
+typedef struct
+{
+    uint32_t ui32FastBoot;
+    uint32_t ui32Reached;                         ///< bit mask of the phases reached
+    uint32_t pui32Timestamp[LORAWAN_BOOT_PHASES]; ///< STIMER counter at each phase
+} lorawan_boot_stats_t;
+
 extern uint32_t lorawan_tracing_enabled;
 
 extern void lorawan_task_create(uint32_t ui32Priority);
-extern void lorawan_task_wake();
+extern void lorawan_task_wake(lorawan_wake_e eCause);
 
 extern void lmh_callbacks_setup(LmHandlerCallbacks_t *cb);
 extern void lmhp_fragmentation_setup(LmhpFragmentationParams_t *parameters);
 
 extern void lorawan_send_command(lorawan_command_t *psCommand);
 
+extern void lorawan_transmit_stats_get(lorawan_transmit_stats_t *psStats);
+extern void lorawan_transmit_stats_reset();
+
+extern void lorawan_join_stats_get(lorawan_join_stats_t *psStats);
+extern void lorawan_join_request_status(LoRaMacStatus_t eStatus, TimerTime_t ui32DutyCycleWait);
+extern void lorawan_join_result(LmHandlerJoinParams_t *psParams);
+
+extern void lorawan_boot_mark(lorawan_boot_phase_e ePhase);
+extern void lorawan_boot_stats_get(lorawan_boot_stats_t *psStats);
+extern const char *lorawan_boot_phase_name(lorawan_boot_phase_e ePhase);
+
 #ifdef __cplusplus
 }
 #endif
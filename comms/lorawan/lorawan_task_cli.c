@@ -53,8 +53,18 @@
 #include "lorawan_config.h"
 
 #include "lorawan.h"
+#include "lorawan_event_bus.h"
+#include "lorawan_frag_store.h"
+#include "lorawan_latency.h"
+#include "lorawan_radio.h"
+#include "lorawan_nvm.h"
+#include "lorawan_port.h"
+#include "lorawan_radio_port.h"
+#include "lorawan_record.h"
 #include "lorawan_task.h"
 #include "lorawan_task_cli.h"
+#include "lorawan_trace.h"
+#include "lorawan_traffic.h"
 
 #define COMMAND_LINE_BUFFER_MAX     (128)
 
@@ -151,18 +161,89 @@ static void lorawan_task_cli_help(char *pui8OutBuffer, size_t argc, char **argv)
     am_util_stdio_printf("  start      start the LoRaWAN stack\r\n");
     am_util_stdio_printf("  stop       stop the LoRaWAN stack\r\n");
     am_util_stdio_printf("\r\n");
+    am_util_stdio_printf("  boot       time of each stack start phase\r\n");
+    am_util_stdio_printf("             fast <enable|disable> defer packages to the first uplink\r\n");
     am_util_stdio_printf("  class      <get|set> LoRaWAN class\r\n");
     am_util_stdio_printf("  clear      clear and reformat eeprom\r\n");
     am_util_stdio_printf("  datetime   <get|set|sync> network time\r\n");
-    am_util_stdio_printf("  join       initiate a join\r\n");
+    am_util_stdio_printf("  events     [reset] event bus delivery statistics\r\n");
+    am_util_stdio_printf("  frag       [reset] FUOTA image flash writes\r\n");
+    am_util_stdio_printf("  join       initiate a join, failed joins are retried\r\n");
+    am_util_stdio_printf("             status join scheduler state\r\n");
     am_util_stdio_printf("  keys       display security keys\r\n");
+    am_util_stdio_printf("  nvm        [reset] context persistence statistics\r\n");
+    am_util_stdio_printf("             compact fold the journal into the context image\r\n");
+    am_util_stdio_printf("             window <ms> coalescing window of non-critical changes\r\n");
     am_util_stdio_printf("  periodic   <start|stop> [period]\r\n");
     am_util_stdio_printf("             periodically transmit an incrementing counter\r\n");
+    am_util_stdio_printf("  ports      [reset] downlink port handlers and dispatch statistics\r\n");
+    am_util_stdio_printf("  preempt    <enable|disable> urgent uplinks during multicast\r\n");
     am_util_stdio_printf("  port       <start|stop> manual SPI port control\r\n");
+    am_util_stdio_printf("             <stats|reset> SPI port power statistics\r\n");
+    am_util_stdio_printf("             timeout <adaptive|ms> SPI port shutdown timeout\r\n");
+    am_util_stdio_printf("             breakeven <ms> SPI port power cycle cost\r\n");
+    am_util_stdio_printf("  radio      [reset] radio power and register shadow statistics\r\n");
+    am_util_stdio_printf("  record     [start [wrap]|stop] radio, timer and queue events\r\n");
+    am_util_stdio_printf("             dump print the records, decode with lorawan_record.py\r\n");
+    am_util_stdio_printf("  segment    <enable|disable> split oversized uplinks\r\n");
     am_util_stdio_printf("  send       [port] [ack] <payload>\r\n");
     am_util_stdio_printf("             transmit a packet\r\n");
+    am_util_stdio_printf("  stats      [reset] uplink latency histograms per port and priority\r\n");
     am_util_stdio_printf("  status     display stack status\r\n");
     am_util_stdio_printf("  trace      <enable|disable> debug messages\r\n");
+    am_util_stdio_printf("             binary compact records, decode with lorawan_trace.py\r\n");
+    am_util_stdio_printf("             <stats|reset> binary trace buffer statistics\r\n");
+    am_util_stdio_printf("  traffic    [start [s]|stop] uplink load generator and its counters\r\n");
+    am_util_stdio_printf("             interval <fixed|uniform|exp> <ms> [max ms]\r\n");
+    am_util_stdio_printf("             size <min> [max] payload bytes\r\n");
+    am_util_stdio_printf("             confirmed <percent> share of confirmed uplinks\r\n");
+    am_util_stdio_printf("             ports <port[:weight],...> port mix\r\n");
+    am_util_stdio_printf("             report <s> live counters period, 0 to disable\r\n");
+}
+
+static void lorawan_task_cli_boot(char *pui8OutBuffer, size_t argc, char **argv)
+{
+    lorawan_boot_stats_t stats;
+
+    if ((argc == 4) && (strcmp(argv[2], "fast") == 0))
+    {
+        if (strcmp(argv[3], "enable") == 0)
+        {
+            lorawan_fast_boot_set(1);
+        }
+        else if (strcmp(argv[3], "disable") == 0)
+        {
+            lorawan_fast_boot_set(0);
+        }
+        return;
+    }
+
+    lorawan_boot_stats_get(&stats);
+
+    am_util_stdio_printf("\n\r");
+    am_util_stdio_printf("Fast Boot  : %s\n\r", stats.ui32FastBoot ? "enabled" : "disabled");
+    am_util_stdio_printf("Phase        Since Boot   Since Start   Step\n\r");
+
+    uint32_t ui32Start = stats.pui32Timestamp[LORAWAN_BOOT_START];
+    uint32_t ui32Previous = ui32Start;
+    for (uint32_t i = 0; i < LORAWAN_BOOT_PHASES; i++)
+    {
+        if (!(stats.ui32Reached & (1 << i)))
+        {
+            am_util_stdio_printf("%-10s   -\n\r", lorawan_boot_phase_name(i));
+            continue;
+        }
+
+        uint32_t ui32Time = stats.pui32Timestamp[i];
+        am_util_stdio_printf("%-10s   %7u us   %8u us   %7u us\n\r",
+                             lorawan_boot_phase_name(i),
+                             (uint32_t)(((uint64_t)ui32Time * 1000000) / LORAWAN_BOOT_TIMER_HZ),
+                             (uint32_t)(((uint64_t)(ui32Time - ui32Start) * 1000000) /
+                                        LORAWAN_BOOT_TIMER_HZ),
+                             (uint32_t)(((uint64_t)(ui32Time - ui32Previous) * 1000000) /
+                                        LORAWAN_BOOT_TIMER_HZ));
+        ui32Previous = ui32Time;
+    }
 }
 
 static void lorawan_task_cli_class(char *pui8OutBuffer, size_t argc, char **argv)
@@ -259,6 +340,110 @@ static void lorawan_task_cli_datetime(char *pui8OutBuffer, size_t argc, char **a
     }
 }
 
+static void lorawan_task_cli_join(char *pui8OutBuffer, size_t argc, char **argv)
+{
+    if ((argc < 3) || (strcmp(argv[2], "status") != 0))
+    {
+        lorawan_join();
+        return;
+    }
+
+    lorawan_join_stats_t stats;
+    lorawan_join_stats_get(&stats);
+
+    am_util_stdio_printf("\n\r");
+    am_util_stdio_printf("Joined       : %s\n\r", lorawan_get_join_state() ? "yes" : "no");
+    am_util_stdio_printf("Retrying     : %s\n\r", stats.ui32Active ? "yes" : "no");
+    am_util_stdio_printf("Attempts     : %u\n\r", stats.ui32Attempts);
+    am_util_stdio_printf("Rejected     : %u\n\r", stats.ui32Rejected);
+    am_util_stdio_printf("Failures     : %u\n\r", stats.ui32Failures);
+    am_util_stdio_printf("Joins        : %u\n\r", stats.ui32Joins);
+    am_util_stdio_printf("Airtime      : %u (ms)\n\r", stats.ui32Airtime);
+    am_util_stdio_printf("Budget       : %u / %u (ms)\n\r",
+                         stats.ui32WindowAirtime,
+                         stats.ui32WindowBudget);
+    am_util_stdio_printf("Backoff      : %u (ms)\n\r", stats.ui32Backoff);
+    am_util_stdio_printf("Next Attempt : %u (ms)\n\r", stats.ui32NextAttempt);
+}
+
+static void lorawan_task_cli_nvm(char *pui8OutBuffer, size_t argc, char **argv)
+{
+    if (argc == 3)
+    {
+        if (strcmp(argv[2], "reset") == 0)
+        {
+            lorawan_nvm_stats_reset();
+        }
+        else if (strcmp(argv[2], "compact") == 0)
+        {
+            lorawan_nvm_compact();
+        }
+        return;
+    }
+
+    if ((argc == 4) && (strcmp(argv[2], "window") == 0))
+    {
+        lorawan_nvm_window_set(strtol(argv[3], NULL, 10));
+        return;
+    }
+
+    lorawan_nvm_stats_t stats;
+    lorawan_nvm_stats_get(&stats);
+
+    am_util_stdio_printf("\n\r");
+    am_util_stdio_printf("Window       : %u (ms)\n\r", stats.ui32Window);
+    am_util_stdio_printf("FCnt Reserve : %u\n\r", stats.ui32Reserve);
+    am_util_stdio_printf("Journal      : %u / %u (bytes)\n\r",
+                         stats.ui32JournalUsed,
+                         stats.ui32JournalSize);
+    am_util_stdio_printf("Uptime       : %u (ms)\n\r", stats.ui32Uptime);
+    am_util_stdio_printf("Uplinks      : %u\n\r", stats.ui32Uplinks);
+    am_util_stdio_printf("Changes      : %u\n\r", stats.ui32Changes);
+    am_util_stdio_printf("Coalesced    : %u\n\r", stats.ui32Coalesced);
+    am_util_stdio_printf("Commits      : %u\n\r", stats.ui32Commits);
+    am_util_stdio_printf("Records      : %u\n\r", stats.ui32Records);
+    am_util_stdio_printf("Reservations : %u\n\r", stats.ui32Reservations);
+    am_util_stdio_printf("Compactions  : %u\n\r", stats.ui32Compactions);
+    am_util_stdio_printf("Words        : %u\n\r", stats.ui32Words);
+    am_util_stdio_printf("Per Uplink   : %u.%03u (words)\n\r",
+                         stats.ui32WordsPerKUplink / 1000,
+                         stats.ui32WordsPerKUplink % 1000);
+    if (stats.ui32LifetimeDays > 0)
+    {
+        am_util_stdio_printf("Lifetime     : %u (days)\n\r", stats.ui32LifetimeDays);
+    }
+    else
+    {
+        am_util_stdio_printf("Lifetime     : n/a\n\r");
+    }
+}
+
+static void lorawan_task_cli_port_stats(char *pui8OutBuffer, size_t argc, char **argv)
+{
+    lorawan_radio_port_stats_t stats;
+    lorawan_radio_port_stats_get(&stats);
+
+    uint32_t ui32OnRatio = 0;
+    if (stats.ui32Uptime > 0)
+    {
+        ui32OnRatio = (uint32_t)(((uint64_t)stats.ui32OnTime * 1000) / stats.ui32Uptime);
+    }
+
+    am_util_stdio_printf("\n\r");
+    am_util_stdio_printf("Timeout Mode : %s\n\r",
+                         stats.eMode == LORAWAN_RADIO_PORT_TIMEOUT_ADAPTIVE ? "adaptive" : "fixed");
+    am_util_stdio_printf("Timeout      : %u (ms)\n\r", stats.ui32Timeout);
+    am_util_stdio_printf("Break Even   : %u (ms)\n\r", stats.ui32BreakEven);
+    am_util_stdio_printf("Samples      : %u\n\r", stats.ui32Samples);
+    am_util_stdio_printf("Uptime       : %u (ms)\n\r", stats.ui32Uptime);
+    am_util_stdio_printf("On Time      : %u (ms) %u.%u%%\n\r",
+                         stats.ui32OnTime,
+                         ui32OnRatio / 10,
+                         ui32OnRatio % 10);
+    am_util_stdio_printf("Power Ups    : %u\n\r", stats.ui32PowerUps);
+    am_util_stdio_printf("Power Downs  : %u\n\r", stats.ui32PowerDowns);
+}
+
 static void lorawan_task_cli_port(char *pui8OutBuffer, size_t argc, char **argv)
 {
     if (argc < 3)
@@ -274,6 +459,254 @@ static void lorawan_task_cli_port(char *pui8OutBuffer, size_t argc, char **argv)
     {
         BoardInitMcu();
     }
+    else if (strcmp(argv[2], "stats") == 0)
+    {
+        lorawan_task_cli_port_stats(pui8OutBuffer, argc, argv);
+    }
+    else if (strcmp(argv[2], "reset") == 0)
+    {
+        lorawan_radio_port_stats_reset();
+    }
+    else if ((strcmp(argv[2], "timeout") == 0) && (argc == 4))
+    {
+        if (strcmp(argv[3], "adaptive") == 0)
+        {
+            lorawan_radio_port_mode_set(LORAWAN_RADIO_PORT_TIMEOUT_ADAPTIVE, 0);
+        }
+        else
+        {
+            lorawan_radio_port_mode_set(LORAWAN_RADIO_PORT_TIMEOUT_FIXED,
+                                        strtol(argv[3], NULL, 10));
+        }
+    }
+    else if ((strcmp(argv[2], "breakeven") == 0) && (argc == 4))
+    {
+        lorawan_radio_port_break_even_set(strtol(argv[3], NULL, 10));
+    }
+}
+
+static void lorawan_task_cli_radio(char *pui8OutBuffer, size_t argc, char **argv)
+{
+    lorawan_radio_stats_t stats;
+
+    if (argc == 3)
+    {
+        if (strcmp(argv[2], "reset") == 0)
+        {
+            lorawan_radio_stats_reset();
+        }
+        return;
+    }
+
+    lorawan_radio_stats_get(&stats);
+
+    am_util_stdio_printf("\n\r");
+    am_util_stdio_printf("Uptime             : %u (s)\n\r", stats.ui32Uptime);
+    am_util_stdio_printf("Radio Power Cycles : %u\n\r", stats.ui32RadioPowerCycles);
+    am_util_stdio_printf("Register Replays   : %u\n\r", stats.ui32Replays);
+    am_util_stdio_printf("Replays Skipped    : %u\n\r", stats.ui32ReplaysSkipped);
+    am_util_stdio_printf("SPI Writes         : %u\n\r", stats.ui32SpiWrites);
+    am_util_stdio_printf("SPI Saved          : %u (%u per hour)\n\r",
+                         stats.ui32SpiSaved,
+                         stats.ui32SpiSavedPerHour);
+}
+
+static void lorawan_task_cli_events(char *pui8OutBuffer, size_t argc, char **argv)
+{
+    if ((argc == 3) && (strcmp(argv[2], "reset") == 0))
+    {
+        lorawan_event_bus_stats_reset();
+        return;
+    }
+
+    lorawan_event_bus_stats_t stats;
+    lorawan_event_bus_stats_get(&stats);
+
+    am_util_stdio_printf("\n\r%-20s %9s %9s %10s %8s %8s\n\r",
+                         "Event", "Published", "Overflows", "Deliveries", "Avg ms", "Max ms");
+    for (uint32_t i = 0; i < LORAWAN_EVENTS; i++)
+    {
+        lorawan_event_bus_counters_t *psCounters = &stats.sEvents[i];
+        if ((psCounters->ui32Published == 0) && (psCounters->ui32Overflows == 0))
+        {
+            continue;
+        }
+        am_util_stdio_printf("%-20s %9u %9u %10u %8u %8u\n\r",
+                             lorawan_event_name(i),
+                             psCounters->ui32Published,
+                             psCounters->ui32Overflows,
+                             psCounters->ui32Deliveries,
+                             psCounters->ui32Published
+                                 ? psCounters->ui32LatencyTotal / psCounters->ui32Published
+                                 : 0,
+                             psCounters->ui32LatencyMax);
+    }
+    am_util_stdio_printf("High Water : %u of %u\n\r", stats.ui32HighWater, LORAWAN_EVENT_BUS_SLOTS);
+}
+
+static void lorawan_task_cli_frag(char *pui8OutBuffer, size_t argc, char **argv)
+{
+    if ((argc == 3) && (strcmp(argv[2], "reset") == 0))
+    {
+        lorawan_frag_store_stats_reset();
+        return;
+    }
+
+    lorawan_frag_store_stats_t stats;
+    lorawan_frag_store_stats_get(&stats);
+
+    am_util_stdio_printf("\n\r");
+    am_util_stdio_printf("Writes        : %u (%u bytes)\n\r", stats.ui32Writes, stats.ui32Bytes);
+    am_util_stdio_printf("Reads         : %u (%u staged)\n\r",
+                         stats.ui32Reads,
+                         stats.ui32StagedReads);
+    am_util_stdio_printf("Pages         : %u\n\r", stats.ui32Pages);
+    am_util_stdio_printf("Programs      : %u (%u words)\n\r", stats.ui32Programs, stats.ui32Words);
+    am_util_stdio_printf("Partial Words : %u (%u programmed twice)\n\r",
+                         stats.ui32Partials,
+                         stats.ui32Reprograms);
+    am_util_stdio_printf("Erases        : %u (%u inline, %u pending)\n\r",
+                         stats.ui32Erases + stats.ui32ErasesInline,
+                         stats.ui32ErasesInline,
+                         stats.ui32ErasePending);
+    am_util_stdio_printf("Errors        : %u\n\r", stats.ui32Errors);
+    am_util_stdio_printf("Critical      : %u (us)\n\r", stats.ui32Critical);
+    am_util_stdio_printf("Critical Max  : %u (us)\n\r", stats.ui32CriticalMax);
+}
+
+static void lorawan_task_cli_ports(char *pui8OutBuffer, size_t argc, char **argv)
+{
+    if ((argc == 3) && (strcmp(argv[2], "reset") == 0))
+    {
+        lorawan_port_stats_reset();
+        return;
+    }
+
+    am_util_stdio_printf("\n\rPort Handlers:");
+    for (uint32_t i = 1; i < LORAWAN_PORT_HANDLERS; i++)
+    {
+        bool bDeferred;
+        if (lorawan_port_handler_get(i, &bDeferred))
+        {
+            am_util_stdio_printf(" %u%s", i, bDeferred ? "(deferred)" : "");
+        }
+    }
+    am_util_stdio_printf("\n\r");
+
+    lorawan_port_stats_t stats;
+    lorawan_port_stats_get(&stats);
+    am_util_stdio_printf("Handlers   : %u\n\r", stats.ui32Handlers);
+    am_util_stdio_printf("Dispatched : %u\n\r", stats.ui32Dispatched);
+    am_util_stdio_printf("Deferred   : %u\n\r", stats.ui32Deferred);
+    am_util_stdio_printf("Unhandled  : %u\n\r", stats.ui32Unhandled);
+    am_util_stdio_printf("Dropped    : %u\n\r", stats.ui32Dropped);
+    am_util_stdio_printf("High Water : %u\n\r", stats.ui32HighWater);
+}
+
+static void lorawan_task_cli_preempt(char *pui8OutBuffer, size_t argc, char **argv)
+{
+    if (argc < 3)
+    {
+        return;
+    }
+
+    if (strcmp(argv[2], "enable") == 0)
+    {
+        lorawan_multicast_preempt_set(1);
+    }
+    else if (strcmp(argv[2], "disable") == 0)
+    {
+        lorawan_multicast_preempt_set(0);
+    }
+}
+
+static void lorawan_task_cli_segment(char *pui8OutBuffer, size_t argc, char **argv)
+{
+    if (argc < 3)
+    {
+        return;
+    }
+
+    if (strcmp(argv[2], "enable") == 0)
+    {
+        lorawan_segmentation_set(1);
+    }
+    else if (strcmp(argv[2], "disable") == 0)
+    {
+        lorawan_segmentation_set(0);
+    }
+}
+
+static void lorawan_task_cli_stats(char *pui8OutBuffer, size_t argc, char **argv)
+{
+    if ((argc == 3) && (strcmp(argv[2], "reset") == 0))
+    {
+        lorawan_latency_stats_reset();
+        return;
+    }
+
+    lorawan_latency_stats_t stats;
+    for (uint32_t i = 0; i <= LORAWAN_LATENCY_CLASSES; i++)
+    {
+        if (!lorawan_latency_stats_get(i, &stats))
+        {
+            continue;
+        }
+
+        if (stats.ui32Port)
+        {
+            am_util_stdio_printf("\n\rPort %u %s: ",
+                                 stats.ui32Port,
+                                 stats.ui32Urgent ? "urgent" : "normal");
+        }
+        else
+        {
+            am_util_stdio_printf("\n\rOther ports: ");
+        }
+        am_util_stdio_printf("%u uplinks, %u aborted\n\r", stats.ui32Count, stats.ui32Aborted);
+
+        uint32_t ui32Buckets = 1;
+        for (uint32_t j = 0; j < LORAWAN_LATENCY_STAGES; j++)
+        {
+            for (uint32_t k = ui32Buckets; k < LORAWAN_LATENCY_BUCKETS; k++)
+            {
+                if (stats.pui32Histogram[j][k])
+                {
+                    ui32Buckets = k + 1;
+                }
+            }
+        }
+
+        am_util_stdio_printf("%-6s %7s %7s %7s %7s  ms >=", "Stage", "p50", "p90", "p99", "max");
+        for (uint32_t k = 0; k < ui32Buckets; k++)
+        {
+            uint32_t ui32Bound = k ? (1u << (k - 1)) : 0;
+            if (ui32Bound >= 1024)
+            {
+                am_util_stdio_printf(" %4uk", ui32Bound / 1024);
+            }
+            else
+            {
+                am_util_stdio_printf(" %5u", ui32Bound);
+            }
+        }
+        am_util_stdio_printf("\n\r");
+
+        for (uint32_t j = 0; j < LORAWAN_LATENCY_STAGES; j++)
+        {
+            am_util_stdio_printf("%-6s %7u %7u %7u %7u       ",
+                                 lorawan_latency_stage_name(j),
+                                 lorawan_latency_percentile(&stats, j, 500),
+                                 lorawan_latency_percentile(&stats, j, 900),
+                                 lorawan_latency_percentile(&stats, j, 990),
+                                 stats.pui32Max[j]);
+            for (uint32_t k = 0; k < ui32Buckets; k++)
+            {
+                am_util_stdio_printf(" %5u", stats.pui32Histogram[j][k]);
+            }
+            am_util_stdio_printf("\n\r");
+        }
+    }
 }
 
 static void lorawan_task_cli_trace(char *pui8OutBuffer, size_t argc, char **argv)
@@ -285,11 +718,176 @@ static void lorawan_task_cli_trace(char *pui8OutBuffer, size_t argc, char **argv
 
     if (strcmp(argv[2], "enable") == 0)
     {
-        lorawan_tracing_set(1);
+        lorawan_tracing_set(LORAWAN_TRACING_TEXT);
+    }
+    else if (strcmp(argv[2], "binary") == 0)
+    {
+        lorawan_tracing_set(LORAWAN_TRACING_BINARY);
     }
     else if (strcmp(argv[2], "disable") == 0)
     {
-        lorawan_tracing_set(0);
+        lorawan_tracing_set(LORAWAN_TRACING_OFF);
+    }
+    else if (strcmp(argv[2], "stats") == 0)
+    {
+        lorawan_trace_stats_t stats;
+        lorawan_trace_stats_get(&stats);
+
+        am_util_stdio_printf("\n\rRecords    : %u\n\r", stats.ui32Records);
+        am_util_stdio_printf("Bytes      : %u\n\r", stats.ui32Bytes);
+        am_util_stdio_printf("Dropped    : %u\n\r", stats.ui32Dropped);
+        am_util_stdio_printf("High Water : %u of %u\n\r",
+                             stats.ui32HighWater,
+                             LORAWAN_TRACE_BUFFER_SIZE);
+    }
+    else if (strcmp(argv[2], "reset") == 0)
+    {
+        lorawan_trace_stats_reset();
+    }
+}
+
+static void lorawan_task_cli_record(char *pui8OutBuffer, size_t argc, char **argv)
+{
+    if (argc == 2)
+    {
+        lorawan_record_stats_t stats;
+        lorawan_record_stats_get(&stats);
+
+        am_util_stdio_printf("\n\rRecording : %s%s\n\r",
+                             stats.ui32Active ? "on" : "off",
+                             stats.ui32Wrap ? " (wrap)" : "");
+        am_util_stdio_printf("Records   : %u\n\r", stats.ui32Records);
+        am_util_stdio_printf("Dropped   : %u\n\r", stats.ui32Dropped);
+        am_util_stdio_printf("Capacity  : %u\n\r", LORAWAN_RECORD_COUNT);
+    }
+    else if (strcmp(argv[2], "start") == 0)
+    {
+        lorawan_record_start((argc == 4) && (strcmp(argv[3], "wrap") == 0));
+    }
+    else if (strcmp(argv[2], "stop") == 0)
+    {
+        lorawan_record_stop();
+    }
+    else if (strcmp(argv[2], "dump") == 0)
+    {
+        uint8_t pui8Record[LORAWAN_RECORD_SIZE];
+
+        am_util_stdio_printf("\n\r");
+        for (uint32_t i = 0; lorawan_record_read(i, pui8Record, 1) == 1; i++)
+        {
+            am_util_stdio_printf(LORAWAN_RECORD_LINE_PREFIX " ");
+            print_hex_array(pui8OutBuffer, pui8Record, LORAWAN_RECORD_SIZE, false);
+            am_util_stdio_printf("\n\r");
+        }
+    }
+}
+
+static void lorawan_task_cli_traffic_ports(lorawan_traffic_config_t *psConfig, char *pcList)
+{
+    psConfig->ui32Ports = 0;
+    while (*pcList && (psConfig->ui32Ports < LORAWAN_TRAFFIC_PORTS_MAX))
+    {
+        lorawan_traffic_port_t *psPort = &psConfig->psPorts[psConfig->ui32Ports++];
+
+        psPort->ui8Port = strtol(pcList, &pcList, 10);
+        psPort->ui8Weight = 1;
+        if (*pcList == ':')
+        {
+            psPort->ui8Weight = strtol(pcList + 1, &pcList, 10);
+        }
+        if (*pcList == ',')
+        {
+            pcList++;
+        }
+    }
+}
+
+static void lorawan_task_cli_traffic(char *pui8OutBuffer, size_t argc, char **argv)
+{
+    static const char *const distributions[] = {"fixed", "uniform", "exp"};
+    lorawan_traffic_config_t config;
+    lorawan_traffic_config_get(&config);
+
+    if (argc == 2)
+    {
+        am_util_stdio_printf("\n\rInterval  : %s %u", distributions[config.eInterval],
+                             config.ui32IntervalMin);
+        if (config.eInterval == LORAWAN_TRAFFIC_UNIFORM)
+        {
+            am_util_stdio_printf(" to %u", config.ui32IntervalMax);
+        }
+        am_util_stdio_printf(" (ms)\n\r");
+        am_util_stdio_printf("Size      : %u to %u (bytes)\n\r", config.ui32SizeMin,
+                             config.ui32SizeMax);
+        am_util_stdio_printf("Confirmed : %u%%\n\r", config.ui32Confirmed);
+        am_util_stdio_printf("Ports     :");
+        for (uint32_t i = 0; i < config.ui32Ports; i++)
+        {
+            am_util_stdio_printf(" %u:%u", config.psPorts[i].ui8Port, config.psPorts[i].ui8Weight);
+        }
+        am_util_stdio_printf("\n\rDuration  : %u (s)\n\r", config.ui32Duration);
+        am_util_stdio_printf("Report    : %u (s)\n\r", config.ui32Report);
+        lorawan_traffic_report(false);
+        return;
+    }
+
+    if (strcmp(argv[2], "start") == 0)
+    {
+        if (argc == 4)
+        {
+            config.ui32Duration = strtol(argv[3], NULL, 10);
+            lorawan_traffic_config_set(&config);
+        }
+        if (lorawan_traffic_start() != 0)
+        {
+            am_util_stdio_printf("\n\rtraffic generator already running\n\r");
+        }
+        return;
+    }
+
+    if (strcmp(argv[2], "stop") == 0)
+    {
+        lorawan_traffic_stop();
+        return;
+    }
+
+    if ((strcmp(argv[2], "interval") == 0) && (argc >= 5))
+    {
+        for (uint32_t i = 0; i < sizeof(distributions) / sizeof(distributions[0]); i++)
+        {
+            if (strcmp(argv[3], distributions[i]) == 0)
+            {
+                config.eInterval = (lorawan_traffic_distribution_e)i;
+            }
+        }
+        config.ui32IntervalMin = strtol(argv[4], NULL, 10);
+        config.ui32IntervalMax = (argc == 6) ? strtol(argv[5], NULL, 10) : config.ui32IntervalMin;
+    }
+    else if ((strcmp(argv[2], "size") == 0) && (argc >= 4))
+    {
+        config.ui32SizeMin = strtol(argv[3], NULL, 10);
+        config.ui32SizeMax = (argc == 5) ? strtol(argv[4], NULL, 10) : config.ui32SizeMin;
+    }
+    else if ((strcmp(argv[2], "confirmed") == 0) && (argc == 4))
+    {
+        config.ui32Confirmed = strtol(argv[3], NULL, 10);
+    }
+    else if ((strcmp(argv[2], "ports") == 0) && (argc == 4))
+    {
+        lorawan_task_cli_traffic_ports(&config, argv[3]);
+    }
+    else if ((strcmp(argv[2], "report") == 0) && (argc == 4))
+    {
+        config.ui32Report = strtol(argv[3], NULL, 10);
+    }
+    else
+    {
+        return;
+    }
+
+    if (lorawan_traffic_config_set(&config) != 0)
+    {
+        am_util_stdio_printf("\n\rinvalid traffic profile or generator running\n\r");
     }
 }
 
@@ -366,7 +964,8 @@ static void lorawan_task_cli_periodic(char *pui8OutBuffer, size_t argc, char **a
         }
         else
         {
-            xTimerChangePeriod(periodic_transmit_timer, pdMS_TO_TICKS(ui32Period), portMAX_DELAY);
+            xTimerChangePeriod(
+                periodic_transmit_timer, pdMS_TO_TICKS(ui32Period * 1000), portMAX_DELAY);
         }
         periodic_transmit_callback(periodic_transmit_timer);
     }
@@ -428,6 +1027,18 @@ static void lorawan_task_cli_status(char *pui8OutBuffer, size_t argc, char **arg
     {
         am_util_stdio_printf("none\n\r");
     }
+
+    lorawan_transmit_stats_t stats;
+    lorawan_transmit_stats_get(&stats);
+    am_util_stdio_printf("Uplinks Queued: %u\n\r", stats.ui32Queued);
+    am_util_stdio_printf("Uplinks Dropped: %u\n\r", stats.ui32Dropped);
+    am_util_stdio_printf("Uplinks Expired: %u\n\r", stats.ui32Expired);
+    am_util_stdio_printf("Multicast Deferrals: %u\n\r", stats.ui32Deferred);
+    am_util_stdio_printf("Multicast Displaced: %u\n\r", stats.ui32Displaced);
+    am_util_stdio_printf("Multicast Preemptions: %u\n\r", stats.ui32Preempted);
+    am_util_stdio_printf("Uplinks Segmented: %u (%u segments)\n\r",
+                         stats.ui32Segmented,
+                         stats.ui32Segments);
  }
 
 static portBASE_TYPE
@@ -455,6 +1066,10 @@ lorawan_task_cli_entry(char *pui8OutBuffer, size_t ui32OutBufferLength, const ch
         command.eCommand = LORAWAN_STOP;
         lorawan_send_command(&command);
     }
+    else if (strcmp(argv[1], "boot") == 0)
+    {
+        lorawan_task_cli_boot(pui8OutBuffer, argc, argv);
+    }
     else if (strcmp(argv[1], "class") == 0)
     {
         lorawan_task_cli_class(pui8OutBuffer, argc, argv);
@@ -469,12 +1084,16 @@ lorawan_task_cli_entry(char *pui8OutBuffer, size_t ui32OutBufferLength, const ch
     }
     else if (strcmp(argv[1], "join") == 0)
     {
-        lorawan_join();
+        lorawan_task_cli_join(pui8OutBuffer, argc, argv);
     }
     else if (strcmp(argv[1], "keys") == 0)
     {
         lorawan_task_cli_keys(pui8OutBuffer, argc, argv);
     }
+    else if (strcmp(argv[1], "nvm") == 0)
+    {
+        lorawan_task_cli_nvm(pui8OutBuffer, argc, argv);
+    }
     else if (strcmp(argv[1], "periodic") == 0)
     {
         lorawan_task_cli_periodic(pui8OutBuffer, argc, argv);
@@ -483,14 +1102,50 @@ lorawan_task_cli_entry(char *pui8OutBuffer, size_t ui32OutBufferLength, const ch
     {
         lorawan_task_cli_send(pui8OutBuffer, argc, argv);
     }
+    else if (strcmp(argv[1], "events") == 0)
+    {
+        lorawan_task_cli_events(pui8OutBuffer, argc, argv);
+    }
+    else if (strcmp(argv[1], "frag") == 0)
+    {
+        lorawan_task_cli_frag(pui8OutBuffer, argc, argv);
+    }
+    else if (strcmp(argv[1], "ports") == 0)
+    {
+        lorawan_task_cli_ports(pui8OutBuffer, argc, argv);
+    }
+    else if (strcmp(argv[1], "preempt") == 0)
+    {
+        lorawan_task_cli_preempt(pui8OutBuffer, argc, argv);
+    }
     else if (strcmp(argv[1], "port") == 0)
     {
         lorawan_task_cli_port(pui8OutBuffer, argc, argv);
     }
+    else if (strcmp(argv[1], "radio") == 0)
+    {
+        lorawan_task_cli_radio(pui8OutBuffer, argc, argv);
+    }
+    else if (strcmp(argv[1], "record") == 0)
+    {
+        lorawan_task_cli_record(pui8OutBuffer, argc, argv);
+    }
+    else if (strcmp(argv[1], "segment") == 0)
+    {
+        lorawan_task_cli_segment(pui8OutBuffer, argc, argv);
+    }
+    else if (strcmp(argv[1], "stats") == 0)
+    {
+        lorawan_task_cli_stats(pui8OutBuffer, argc, argv);
+    }
     else if (strcmp(argv[1], "trace") == 0)
     {
         lorawan_task_cli_trace(pui8OutBuffer, argc, argv);
     }
+    else if (strcmp(argv[1], "traffic") == 0)
+    {
+        lorawan_task_cli_traffic(pui8OutBuffer, argc, argv);
+    }
     else if (strcmp(argv[1], "status") == 0)
     {
         lorawan_task_cli_status(pui8OutBuffer, argc, argv);
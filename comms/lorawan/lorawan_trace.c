@@ -0,0 +1,463 @@
+/*
+ * BSD 3-Clause License
+ *
+ * Copyright (c) 2024, Northern Mechatronics, Inc.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its
+ *    contributors may be used to endorse or promote products derived from
+ *    this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+
+#include <am_mcu_apollo.h>
+#include <am_util.h>
+
+#include <FreeRTOS.h>
+#include <task.h>
+
+#include <LmHandler.h>
+
+#include "lorawan_ring.h"
+#include "lorawan_trace.h"
+
+#if defined(LORAWAN_TRACE_RTT_CHANNEL)
+#include "SEGGER_RTT.h"
+#endif
+
+#define LORAWAN_TRACE_RECORD_MAX (LORAWAN_TRACE_HEADER_SIZE + 255)
+
+//
+// Records are appended under a critical section so that any task may
+// trace, and read back by the output task alone.  The ring counts bytes,
+// the head is published once the record is complete.
+//
+static uint8_t lorawan_trace_buffer[LORAWAN_TRACE_BUFFER_SIZE];
+static lorawan_ring_t lorawan_trace_ring = {.ui32Size = LORAWAN_TRACE_BUFFER_SIZE};
+static uint16_t lorawan_trace_sequence;
+static uint32_t lorawan_trace_lost;
+
+static TaskHandle_t lorawan_trace_handle;
+static lorawan_trace_stats_t lorawan_trace_stats;
+
+#if defined(LORAWAN_TRACE_RTT_CHANNEL)
+static uint8_t lorawan_trace_rtt_buffer[LORAWAN_TRACE_BUFFER_SIZE];
+#else
+static char
+    lorawan_trace_line[sizeof(LORAWAN_TRACE_LINE_PREFIX) + 1 + 2 * LORAWAN_TRACE_RECORD_MAX];
+#endif
+
+static uint8_t *lorawan_trace_put_u8(uint8_t *pui8Data, uint32_t ui32Value)
+{
+    *pui8Data++ = ui32Value;
+    return pui8Data;
+}
+
+static uint8_t *lorawan_trace_put_u16(uint8_t *pui8Data, uint32_t ui32Value)
+{
+    *pui8Data++ = ui32Value;
+    *pui8Data++ = ui32Value >> 8;
+    return pui8Data;
+}
+
+static uint8_t *lorawan_trace_put_u32(uint8_t *pui8Data, uint32_t ui32Value)
+{
+    *pui8Data++ = ui32Value;
+    *pui8Data++ = ui32Value >> 8;
+    *pui8Data++ = ui32Value >> 16;
+    *pui8Data++ = ui32Value >> 24;
+    return pui8Data;
+}
+
+static void lorawan_trace_copy_in(uint32_t ui32Index, const uint8_t *pui8Data, uint32_t ui32Size)
+{
+    for (uint32_t i = 0; i < ui32Size; i++)
+    {
+        lorawan_trace_buffer[lorawan_ring_offset(&lorawan_trace_ring, ui32Index + i)] = pui8Data[i];
+    }
+}
+
+static void lorawan_trace_copy_out(uint32_t ui32Index, uint8_t *pui8Data, uint32_t ui32Size)
+{
+    for (uint32_t i = 0; i < ui32Size; i++)
+    {
+        pui8Data[i] = lorawan_trace_buffer[lorawan_ring_offset(&lorawan_trace_ring, ui32Index + i)];
+    }
+}
+
+static uint32_t lorawan_trace_append(uint32_t ui32Head,
+                                     lorawan_trace_e eType,
+                                     const uint8_t *pui8Payload,
+                                     uint32_t ui32Size)
+{
+    uint8_t pui8Header[LORAWAN_TRACE_HEADER_SIZE];
+    uint8_t *pui8Data = pui8Header;
+
+    pui8Data = lorawan_trace_put_u8(pui8Data, eType);
+    pui8Data = lorawan_trace_put_u8(pui8Data, ui32Size);
+    pui8Data = lorawan_trace_put_u16(pui8Data, lorawan_trace_sequence++);
+    pui8Data = lorawan_trace_put_u32(pui8Data, xTaskGetTickCount());
+
+    lorawan_trace_copy_in(ui32Head, pui8Header, LORAWAN_TRACE_HEADER_SIZE);
+    lorawan_trace_copy_in(ui32Head + LORAWAN_TRACE_HEADER_SIZE, pui8Payload, ui32Size);
+
+    lorawan_trace_stats.ui32Records++;
+    lorawan_trace_stats.ui32Bytes += LORAWAN_TRACE_HEADER_SIZE + ui32Size;
+
+    return ui32Head + LORAWAN_TRACE_HEADER_SIZE + ui32Size;
+}
+
+static void lorawan_trace_output(uint8_t *pui8Record, uint32_t ui32Size)
+{
+#if defined(LORAWAN_TRACE_RTT_CHANNEL)
+    SEGGER_RTT_Write(LORAWAN_TRACE_RTT_CHANNEL, pui8Record, ui32Size);
+#else
+    static const char pcHex[] = "0123456789abcdef";
+    char *pcLine = lorawan_trace_line;
+
+    strcpy(pcLine, LORAWAN_TRACE_LINE_PREFIX " ");
+    pcLine += sizeof(LORAWAN_TRACE_LINE_PREFIX);
+    for (uint32_t i = 0; i < ui32Size; i++)
+    {
+        *pcLine++ = pcHex[pui8Record[i] >> 4];
+        *pcLine++ = pcHex[pui8Record[i] & 0x0F];
+    }
+    *pcLine = '\0';
+
+    am_util_stdio_printf("%s\r\n", lorawan_trace_line);
+#endif
+}
+
+static void lorawan_trace_task(void *pvParameters)
+{
+    uint8_t pui8Record[LORAWAN_TRACE_RECORD_MAX];
+
+    while (1)
+    {
+        ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+
+        while (lorawan_ring_available(&lorawan_trace_ring))
+        {
+            uint32_t ui32Tail = lorawan_ring_tail(&lorawan_trace_ring);
+            lorawan_trace_copy_out(ui32Tail, pui8Record, LORAWAN_TRACE_HEADER_SIZE);
+            uint32_t ui32Size = LORAWAN_TRACE_HEADER_SIZE + pui8Record[1];
+            lorawan_trace_copy_out(ui32Tail + LORAWAN_TRACE_HEADER_SIZE,
+                                   pui8Record + LORAWAN_TRACE_HEADER_SIZE,
+                                   pui8Record[1]);
+
+            // The slot is free once copied, the output may take a while.
+            lorawan_ring_consume(&lorawan_trace_ring, ui32Size);
+
+            lorawan_trace_output(pui8Record, ui32Size);
+        }
+    }
+}
+
+void lorawan_trace_start()
+{
+    if (lorawan_trace_handle)
+    {
+        return;
+    }
+
+#if defined(LORAWAN_TRACE_RTT_CHANNEL)
+    SEGGER_RTT_ConfigUpBuffer(LORAWAN_TRACE_RTT_CHANNEL,
+                              "lorawan trace",
+                              lorawan_trace_rtt_buffer,
+                              sizeof(lorawan_trace_rtt_buffer),
+                              SEGGER_RTT_MODE_NO_BLOCK_SKIP);
+#endif
+
+    xTaskCreate(lorawan_trace_task,
+                "lorawan trace",
+                LORAWAN_TRACE_STACK,
+                0,
+                LORAWAN_TRACE_PRIORITY,
+                &lorawan_trace_handle);
+}
+
+void lorawan_trace_record(lorawan_trace_e eType, const uint8_t *pui8Payload, uint32_t ui32Size)
+{
+    uint8_t pui8Lost[4];
+    uint32_t ui32Length = LORAWAN_TRACE_HEADER_SIZE + ui32Size;
+
+    taskENTER_CRITICAL();
+
+    uint32_t ui32Head = lorawan_ring_head(&lorawan_trace_ring);
+    uint32_t ui32Used = LORAWAN_TRACE_BUFFER_SIZE - lorawan_ring_space(&lorawan_trace_ring);
+
+    // Report the records lost since the last one that fit, ahead of the
+    // next record so that the loss shows in order.
+    if (lorawan_trace_lost)
+    {
+        ui32Length += LORAWAN_TRACE_HEADER_SIZE + sizeof(pui8Lost);
+    }
+
+    if (ui32Used + ui32Length > LORAWAN_TRACE_BUFFER_SIZE)
+    {
+        lorawan_trace_sequence++;
+        lorawan_trace_lost++;
+        lorawan_trace_stats.ui32Dropped++;
+        taskEXIT_CRITICAL();
+        return;
+    }
+
+    if (lorawan_trace_lost)
+    {
+        lorawan_trace_put_u32(pui8Lost, lorawan_trace_lost);
+        ui32Head = lorawan_trace_append(ui32Head, LORAWAN_TRACE_LOST, pui8Lost, sizeof(pui8Lost));
+        lorawan_trace_lost = 0;
+    }
+    lorawan_trace_append(ui32Head, eType, pui8Payload, ui32Size);
+
+    lorawan_ring_produce(&lorawan_trace_ring, ui32Length);
+
+    if (ui32Used + ui32Length > lorawan_trace_stats.ui32HighWater)
+    {
+        lorawan_trace_stats.ui32HighWater = ui32Used + ui32Length;
+    }
+
+    taskEXIT_CRITICAL();
+
+    if (lorawan_trace_handle)
+    {
+        xTaskNotifyGive(lorawan_trace_handle);
+    }
+}
+
+void lorawan_trace_nvm_data_change(LmHandlerNvmContextStates_t eState, uint16_t ui16Size)
+{
+    uint8_t pui8Payload[3];
+    uint8_t *pui8Data = pui8Payload;
+
+    pui8Data = lorawan_trace_put_u8(pui8Data, eState);
+    pui8Data = lorawan_trace_put_u16(pui8Data, ui16Size);
+
+    lorawan_trace_record(LORAWAN_TRACE_NVM, pui8Payload, pui8Data - pui8Payload);
+}
+
+void lorawan_trace_network_parameters(CommissioningParams_t *psParams)
+{
+    uint8_t pui8Payload[16];
+
+    memcpy(pui8Payload, psParams->DevEui, 8);
+    memcpy(pui8Payload + 8, psParams->JoinEui, 8);
+
+    lorawan_trace_record(LORAWAN_TRACE_NETWORK, pui8Payload, sizeof(pui8Payload));
+}
+
+void lorawan_trace_mcps_request(LoRaMacStatus_t eStatus,
+                                McpsReq_t *psMcpsReq,
+                                TimerTime_t ui32NextTxDelay)
+{
+    uint8_t pui8Payload[6];
+    uint8_t *pui8Data = pui8Payload;
+
+    pui8Data = lorawan_trace_put_u8(pui8Data, eStatus);
+    pui8Data = lorawan_trace_put_u8(pui8Data, psMcpsReq->Type);
+    pui8Data = lorawan_trace_put_u32(pui8Data, ui32NextTxDelay);
+
+    lorawan_trace_record(LORAWAN_TRACE_MCPS_REQUEST, pui8Payload, pui8Data - pui8Payload);
+}
+
+void lorawan_trace_mlme_request(LoRaMacStatus_t eStatus,
+                                MlmeReq_t *psMlmeReq,
+                                TimerTime_t ui32NextTxDelay)
+{
+    uint8_t pui8Payload[6];
+    uint8_t *pui8Data = pui8Payload;
+
+    pui8Data = lorawan_trace_put_u8(pui8Data, eStatus);
+    pui8Data = lorawan_trace_put_u8(pui8Data, psMlmeReq->Type);
+    pui8Data = lorawan_trace_put_u32(pui8Data, ui32NextTxDelay);
+
+    lorawan_trace_record(LORAWAN_TRACE_MLME_REQUEST, pui8Payload, pui8Data - pui8Payload);
+}
+
+void lorawan_trace_join(LmHandlerJoinParams_t *psParams)
+{
+    uint8_t pui8Payload[2];
+    uint8_t *pui8Data = pui8Payload;
+
+    pui8Data = lorawan_trace_put_u8(pui8Data, psParams->Status);
+    pui8Data = lorawan_trace_put_u8(pui8Data, psParams->Datarate);
+
+    lorawan_trace_record(LORAWAN_TRACE_JOIN, pui8Payload, pui8Data - pui8Payload);
+}
+
+void lorawan_trace_tx(LmHandlerTxParams_t *psParams)
+{
+    uint8_t pui8Payload[12 + LORAWAN_TRACE_DATA_MAX];
+    uint8_t *pui8Data = pui8Payload;
+    uint32_t ui32Size = psParams->AppData.BufferSize;
+
+    if (ui32Size > LORAWAN_TRACE_DATA_MAX)
+    {
+        ui32Size = LORAWAN_TRACE_DATA_MAX;
+    }
+
+    pui8Data = lorawan_trace_put_u8(pui8Data, psParams->Status);
+    pui8Data = lorawan_trace_put_u8(pui8Data, psParams->MsgType);
+    pui8Data = lorawan_trace_put_u8(pui8Data, psParams->AppData.Port);
+    pui8Data = lorawan_trace_put_u8(pui8Data, psParams->Datarate);
+    pui8Data = lorawan_trace_put_u8(pui8Data, psParams->TxPower);
+    pui8Data = lorawan_trace_put_u8(pui8Data, psParams->Channel);
+    pui8Data = lorawan_trace_put_u8(pui8Data, psParams->AckReceived);
+    pui8Data = lorawan_trace_put_u32(pui8Data, psParams->UplinkCounter);
+    pui8Data = lorawan_trace_put_u8(pui8Data, psParams->AppData.BufferSize);
+    if (ui32Size)
+    {
+        memcpy(pui8Data, psParams->AppData.Buffer, ui32Size);
+        pui8Data += ui32Size;
+    }
+
+    lorawan_trace_record(LORAWAN_TRACE_TX, pui8Payload, pui8Data - pui8Payload);
+}
+
+void lorawan_trace_rx(LmHandlerAppData_t *psAppData, LmHandlerRxParams_t *psParams)
+{
+    uint8_t pui8Payload[12 + LORAWAN_TRACE_DATA_MAX];
+    uint8_t *pui8Data = pui8Payload;
+    uint32_t ui32Size = psAppData ? psAppData->BufferSize : 0;
+
+    if (ui32Size > LORAWAN_TRACE_DATA_MAX)
+    {
+        ui32Size = LORAWAN_TRACE_DATA_MAX;
+    }
+
+    pui8Data = lorawan_trace_put_u8(pui8Data, psParams->Status);
+    pui8Data = lorawan_trace_put_u8(pui8Data, psAppData ? psAppData->Port : 0);
+    pui8Data = lorawan_trace_put_u8(pui8Data, psParams->RxSlot);
+    pui8Data = lorawan_trace_put_u8(pui8Data, psParams->Datarate);
+    pui8Data = lorawan_trace_put_u16(pui8Data, psParams->Rssi);
+    pui8Data = lorawan_trace_put_u8(pui8Data, psParams->Snr);
+    pui8Data = lorawan_trace_put_u32(pui8Data, psParams->DownlinkCounter);
+    pui8Data = lorawan_trace_put_u8(pui8Data, psAppData ? psAppData->BufferSize : 0);
+    if (ui32Size)
+    {
+        memcpy(pui8Data, psAppData->Buffer, ui32Size);
+        pui8Data += ui32Size;
+    }
+
+    lorawan_trace_record(LORAWAN_TRACE_RX, pui8Payload, pui8Data - pui8Payload);
+}
+
+void lorawan_trace_class(DeviceClass_t eDeviceClass)
+{
+    uint8_t ui8Class = eDeviceClass;
+
+    lorawan_trace_record(LORAWAN_TRACE_CLASS, &ui8Class, sizeof(ui8Class));
+}
+
+void lorawan_trace_beacon(LoRaMacHandlerBeaconParams_t *psParams)
+{
+    uint8_t pui8Payload[13];
+    uint8_t *pui8Data = pui8Payload;
+
+    pui8Data = lorawan_trace_put_u8(pui8Data, psParams->State);
+    pui8Data = lorawan_trace_put_u32(pui8Data, psParams->Info.Frequency);
+    pui8Data = lorawan_trace_put_u8(pui8Data, psParams->Info.Datarate);
+    pui8Data = lorawan_trace_put_u16(pui8Data, psParams->Info.Rssi);
+    pui8Data = lorawan_trace_put_u8(pui8Data, psParams->Info.Snr);
+    pui8Data = lorawan_trace_put_u32(pui8Data, psParams->Info.Time.Seconds);
+
+    lorawan_trace_record(LORAWAN_TRACE_BEACON, pui8Payload, pui8Data - pui8Payload);
+}
+
+void lorawan_trace_time(bool bSynchronized, int32_t i32Correction)
+{
+    uint8_t pui8Payload[5];
+    uint8_t *pui8Data = pui8Payload;
+
+    pui8Data = lorawan_trace_put_u8(pui8Data, bSynchronized);
+    pui8Data = lorawan_trace_put_u32(pui8Data, i32Correction);
+
+    lorawan_trace_record(LORAWAN_TRACE_TIME, pui8Payload, pui8Data - pui8Payload);
+}
+
+void lorawan_trace_frag_progress(uint16_t ui16Counter,
+                                 uint16_t ui16Blocks,
+                                 uint8_t ui8Size,
+                                 uint16_t ui16Lost)
+{
+    uint8_t pui8Payload[7];
+    uint8_t *pui8Data = pui8Payload;
+
+    pui8Data = lorawan_trace_put_u16(pui8Data, ui16Counter);
+    pui8Data = lorawan_trace_put_u16(pui8Data, ui16Blocks);
+    pui8Data = lorawan_trace_put_u8(pui8Data, ui8Size);
+    pui8Data = lorawan_trace_put_u16(pui8Data, ui16Lost);
+
+    lorawan_trace_record(LORAWAN_TRACE_FRAG_PROGRESS, pui8Payload, pui8Data - pui8Payload);
+}
+
+void lorawan_trace_frag_done(int32_t i32Status, uint32_t ui32Size, uint32_t ui32Crc)
+{
+    uint8_t pui8Payload[12];
+    uint8_t *pui8Data = pui8Payload;
+
+    pui8Data = lorawan_trace_put_u32(pui8Data, i32Status);
+    pui8Data = lorawan_trace_put_u32(pui8Data, ui32Size);
+    pui8Data = lorawan_trace_put_u32(pui8Data, ui32Crc);
+
+    lorawan_trace_record(LORAWAN_TRACE_FRAG_DONE, pui8Payload, pui8Data - pui8Payload);
+}
+
+void lorawan_trace_frag_write(uint32_t ui32Offset, uint32_t ui32Words)
+{
+    uint8_t pui8Payload[8];
+    uint8_t *pui8Data = pui8Payload;
+
+    pui8Data = lorawan_trace_put_u32(pui8Data, ui32Offset);
+    pui8Data = lorawan_trace_put_u32(pui8Data, ui32Words);
+
+    lorawan_trace_record(LORAWAN_TRACE_FRAG_WRITE, pui8Payload, pui8Data - pui8Payload);
+}
+
+void lorawan_trace_frag_erase(uint32_t ui32Offset, uint32_t ui32Pages)
+{
+    uint8_t pui8Payload[8];
+    uint8_t *pui8Data = pui8Payload;
+
+    pui8Data = lorawan_trace_put_u32(pui8Data, ui32Offset);
+    pui8Data = lorawan_trace_put_u32(pui8Data, ui32Pages);
+
+    lorawan_trace_record(LORAWAN_TRACE_FRAG_ERASE, pui8Payload, pui8Data - pui8Payload);
+}
+
+void lorawan_trace_stats_get(lorawan_trace_stats_t *psStats)
+{
+    taskENTER_CRITICAL();
+    memcpy(psStats, &lorawan_trace_stats, sizeof(lorawan_trace_stats_t));
+    taskEXIT_CRITICAL();
+}
+
+void lorawan_trace_stats_reset()
+{
+    taskENTER_CRITICAL();
+    memset(&lorawan_trace_stats, 0, sizeof(lorawan_trace_stats_t));
+    taskEXIT_CRITICAL();
+}
@@ -0,0 +1,170 @@
+/*
+ * BSD 3-Clause License
+ *
+ * Copyright (c) 2024, Northern Mechatronics, Inc.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its
+ *    contributors may be used to endorse or promote products derived from
+ *    this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+#ifndef _LORAWAN_TRACE_H_
+#define _LORAWAN_TRACE_H_
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include <LmHandler.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief Bytes of trace records held in RAM.  Must be a power of two.
+ */
+#ifndef LORAWAN_TRACE_BUFFER_SIZE
+#define LORAWAN_TRACE_BUFFER_SIZE (2048)
+#endif
+
+/**
+ * @brief Payload bytes of an uplink or downlink copied into its record.
+ */
+#ifndef LORAWAN_TRACE_DATA_MAX
+#define LORAWAN_TRACE_DATA_MAX (16)
+#endif
+
+#ifndef LORAWAN_TRACE_PRIORITY
+#define LORAWAN_TRACE_PRIORITY (tskIDLE_PRIORITY + 1)
+#endif
+
+#ifndef LORAWAN_TRACE_STACK
+#define LORAWAN_TRACE_STACK (256)
+#endif
+
+/**
+ * @brief RTT up buffer receiving the raw records.  When undefined the
+ * records are printed on the console as hexadecimal lines starting with
+ * LORAWAN_TRACE_LINE_PREFIX.
+ */
+// #define LORAWAN_TRACE_RTT_CHANNEL (1)
+
+#define LORAWAN_TRACE_LINE_PREFIX "@T"
+
+/**
+ * Record layout, little endian:
+ *
+ *   type       u8
+ *   length     u8, payload bytes following the header
+ *   sequence   u16, incremented for every record, dropped ones included
+ *   timestamp  u32, RTOS ticks
+ *   payload
+ *
+ * The payload of each type is listed next to it.  tools/lorawan_trace.py
+ * decodes the records back into the text trace.
+ */
+#define LORAWAN_TRACE_HEADER_SIZE (8)
+
+typedef enum
+{
+    LORAWAN_TRACE_NVM = 1,        ///< u8 state, u16 size
+    LORAWAN_TRACE_NETWORK,        ///< u8 DevEui[8], u8 JoinEui[8]
+    LORAWAN_TRACE_MCPS_REQUEST,   ///< u8 status, u8 type, u32 next tx delay
+    LORAWAN_TRACE_MLME_REQUEST,   ///< u8 status, u8 type, u32 next tx delay
+    LORAWAN_TRACE_JOIN,           ///< i8 status, i8 datarate
+    LORAWAN_TRACE_TX,             ///< u8 status, u8 type, u8 port, i8 datarate, i8 power,
+                                  ///< u8 channel, u8 ack, u32 counter, u8 size, data
+    LORAWAN_TRACE_RX,             ///< u8 status, u8 port, i8 slot, i8 datarate, i16 rssi,
+                                  ///< i8 snr, u32 counter, u8 size, data
+    LORAWAN_TRACE_CLASS,          ///< u8 class
+    LORAWAN_TRACE_BEACON,         ///< u8 state, u32 frequency, u8 datarate, i16 rssi,
+                                  ///< i8 snr, u32 time
+    LORAWAN_TRACE_TIME,           ///< u8 synchronized, i32 correction
+    LORAWAN_TRACE_FRAG_PROGRESS,  ///< u16 received, u16 blocks, u8 size, u16 lost
+    LORAWAN_TRACE_FRAG_DONE,      ///< i32 status, u32 size, u32 crc
+    LORAWAN_TRACE_FRAG_WRITE,     ///< u32 offset in the OTA region, u32 words
+    LORAWAN_TRACE_FRAG_ERASE,     ///< u32 offset in the OTA region, u32 pages
+    LORAWAN_TRACE_LOST = 0xFF,    ///< u32 records dropped since the previous LOST record
+} lorawan_trace_e;
+
+typedef struct
+{
+    uint32_t ui32Records;   ///< records written to the buffer
+    uint32_t ui32Bytes;     ///< bytes written to the buffer
+    uint32_t ui32Dropped;   ///< records lost to a full buffer
+    uint32_t ui32HighWater; ///< most bytes waiting at once
+} lorawan_trace_stats_t;
+
+/**
+ * @brief Start the task writing the records out.
+ *
+ * @remarks Called by lorawan_tracing_set when binary tracing is selected.
+ */
+extern void lorawan_trace_start();
+
+/**
+ * @brief Copy a record into the trace buffer.
+ *
+ * @param eType  Record type.
+ * @param pui8Payload  Encoded payload.
+ * @param ui32Size  Payload size, up to 255 bytes.
+ *
+ * @remarks Only the copy is done in the caller context, the output is
+ * left to a low priority task.  A record that does not fit is dropped
+ * and reported by a LORAWAN_TRACE_LOST record once there is room.
+ */
+extern void lorawan_trace_record(lorawan_trace_e eType,
+                                 const uint8_t *pui8Payload,
+                                 uint32_t ui32Size);
+
+extern void lorawan_trace_nvm_data_change(LmHandlerNvmContextStates_t eState, uint16_t ui16Size);
+extern void lorawan_trace_network_parameters(CommissioningParams_t *psParams);
+extern void lorawan_trace_mcps_request(LoRaMacStatus_t eStatus,
+                                       McpsReq_t *psMcpsReq,
+                                       TimerTime_t ui32NextTxDelay);
+extern void lorawan_trace_mlme_request(LoRaMacStatus_t eStatus,
+                                       MlmeReq_t *psMlmeReq,
+                                       TimerTime_t ui32NextTxDelay);
+extern void lorawan_trace_join(LmHandlerJoinParams_t *psParams);
+extern void lorawan_trace_tx(LmHandlerTxParams_t *psParams);
+extern void lorawan_trace_rx(LmHandlerAppData_t *psAppData, LmHandlerRxParams_t *psParams);
+extern void lorawan_trace_class(DeviceClass_t eDeviceClass);
+extern void lorawan_trace_beacon(LoRaMacHandlerBeaconParams_t *psParams);
+extern void lorawan_trace_time(bool bSynchronized, int32_t i32Correction);
+extern void lorawan_trace_frag_progress(uint16_t ui16Counter,
+                                       uint16_t ui16Blocks,
+                                       uint8_t ui8Size,
+                                       uint16_t ui16Lost);
+extern void lorawan_trace_frag_done(int32_t i32Status, uint32_t ui32Size, uint32_t ui32Crc);
+extern void lorawan_trace_frag_write(uint32_t ui32Offset, uint32_t ui32Words);
+extern void lorawan_trace_frag_erase(uint32_t ui32Offset, uint32_t ui32Pages);
+
+extern void lorawan_trace_stats_get(lorawan_trace_stats_t *psStats);
+extern void lorawan_trace_stats_reset();
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,382 @@
+/*
+ * BSD 3-Clause License
+ *
+ * Copyright (c) 2024, Northern Mechatronics, Inc.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its
+ *    contributors may be used to endorse or promote products derived from
+ *    this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+
+#include <am_mcu_apollo.h>
+#include <am_util.h>
+
+#include <FreeRTOS.h>
+#include <task.h>
+#include <timers.h>
+
+#include <LmHandler.h>
+#include <utilities.h>
+
+#include "lorawan.h"
+#include "lorawan_event_bus.h"
+#include "lorawan_latency.h"
+#include "lorawan_task.h"
+#include "lorawan_traffic.h"
+
+#define LORAWAN_TRAFFIC_PAYLOAD_MAX (242)
+
+static lorawan_traffic_config_t lorawan_traffic_config = {
+    .eInterval = LORAWAN_TRAFFIC_FIXED,
+    .ui32IntervalMin = 60000,
+    .ui32IntervalMax = 60000,
+    .ui32SizeMin = 8,
+    .ui32SizeMax = 8,
+    .ui32Confirmed = 0,
+    .ui32Ports = 1,
+    .psPorts = {{1, 1}},
+    .ui32Duration = 0,
+    .ui32Report = 60,
+};
+
+static lorawan_traffic_stats_t lorawan_traffic_stats;
+static lorawan_transmit_stats_t lorawan_traffic_baseline;
+static TimerHandle_t lorawan_traffic_timer;
+static TickType_t lorawan_traffic_started;
+static TickType_t lorawan_traffic_reported;
+static bool lorawan_traffic_subscribed;
+static uint8_t lorawan_traffic_payload[LORAWAN_TRAFFIC_PAYLOAD_MAX];
+
+static bool lorawan_traffic_port_used(uint32_t ui32Port)
+{
+    for (uint32_t i = 0; i < lorawan_traffic_config.ui32Ports; i++)
+    {
+        if (lorawan_traffic_config.psPorts[i].ui8Port == ui32Port)
+        {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+static void lorawan_traffic_on_event(const lorawan_bus_event_t *psEvent, void *pvContext)
+{
+    if (psEvent->eEvent == LORAWAN_EVENT_MAC_MCPS_REQUEST)
+    {
+        if ((psEvent->uData.sMcps.eStatus == LORAMAC_STATUS_DUTYCYCLE_RESTRICTED) &&
+            lorawan_traffic_port_used(psEvent->uData.sMcps.sRequest.Req.Unconfirmed.fPort))
+        {
+            lorawan_traffic_stats.ui32Blocked++;
+        }
+        return;
+    }
+
+    const LmHandlerTxParams_t *psParams = &psEvent->uData.sTx;
+    if (!psParams->IsMcpsConfirm || !lorawan_traffic_port_used(psParams->AppData.Port))
+    {
+        return;
+    }
+
+    lorawan_traffic_stats.ui32Sent++;
+    if (psParams->Status != LORAMAC_EVENT_INFO_STATUS_OK)
+    {
+        lorawan_traffic_stats.ui32Failed++;
+    }
+    if (psParams->MsgType == LORAMAC_HANDLER_CONFIRMED_MSG)
+    {
+        lorawan_traffic_stats.ui32Confirmed++;
+        if (psParams->AckReceived)
+        {
+            lorawan_traffic_stats.ui32Acked++;
+        }
+    }
+}
+
+// -ln(u) for u uniform in (0, 1) is exponentially distributed with a mean
+// of one.  The logarithm is taken in base two, from the position of the
+// leading bit and a quadratic fit of the mantissa, in Q16.
+static uint32_t lorawan_traffic_exponential(uint32_t ui32Mean)
+{
+    uint32_t ui32U = randr(1, 65535);
+    uint32_t ui32Exponent = 31 - __builtin_clz(ui32U);
+    uint32_t ui32Mantissa = ((ui32U << 16) >> ui32Exponent) - 65536;
+    uint32_t ui32Log2 = (ui32Exponent << 16) + ui32Mantissa +
+                        ((((ui32Mantissa * (65536 - ui32Mantissa)) >> 16) * 22487) >> 16);
+    uint32_t ui32Ln = (((16 << 16) - ui32Log2) * 45426ULL) >> 16;
+
+    return (uint32_t)(((uint64_t)ui32Mean * ui32Ln) >> 16);
+}
+
+static uint32_t lorawan_traffic_interval()
+{
+    lorawan_traffic_config_t *psConfig = &lorawan_traffic_config;
+
+    switch (psConfig->eInterval)
+    {
+    case LORAWAN_TRAFFIC_UNIFORM:
+        return randr(psConfig->ui32IntervalMin, psConfig->ui32IntervalMax);
+    case LORAWAN_TRAFFIC_EXPONENTIAL:
+        return lorawan_traffic_exponential(psConfig->ui32IntervalMin);
+    default:
+        return psConfig->ui32IntervalMin;
+    }
+}
+
+static void lorawan_traffic_send()
+{
+    lorawan_traffic_config_t *psConfig = &lorawan_traffic_config;
+    uint32_t ui32Weights = 0;
+
+    for (uint32_t i = 0; i < psConfig->ui32Ports; i++)
+    {
+        ui32Weights += psConfig->psPorts[i].ui8Weight;
+    }
+
+    uint32_t ui32Pick = randr(0, ui32Weights - 1);
+    uint32_t ui32Port = psConfig->psPorts[0].ui8Port;
+    for (uint32_t i = 0; i < psConfig->ui32Ports; i++)
+    {
+        if (ui32Pick < psConfig->psPorts[i].ui8Weight)
+        {
+            ui32Port = psConfig->psPorts[i].ui8Port;
+            break;
+        }
+        ui32Pick -= psConfig->psPorts[i].ui8Weight;
+    }
+
+    uint32_t ui32Size = randr(psConfig->ui32SizeMin, psConfig->ui32SizeMax);
+    uint32_t ui32Sequence = lorawan_traffic_stats.ui32Requested;
+    for (uint32_t i = 0; i < ui32Size; i++)
+    {
+        lorawan_traffic_payload[i] = (i < LORAWAN_TRAFFIC_SEQUENCE_SIZE)
+                                         ? (uint8_t)(ui32Sequence >> (8 * i))
+                                         : (uint8_t)(ui32Sequence + i);
+    }
+
+    uint32_t ui32Confirmed = (uint32_t)randr(0, 99) < psConfig->ui32Confirmed;
+
+    lorawan_traffic_stats.ui32Requested++;
+    lorawan_transmit(ui32Port, ui32Confirmed, ui32Size, lorawan_traffic_payload);
+}
+
+static void lorawan_traffic_finish(TickType_t tBlock)
+{
+    if (!lorawan_traffic_stats.ui32Running)
+    {
+        return;
+    }
+
+    xTimerStop(lorawan_traffic_timer, tBlock);
+    lorawan_traffic_stats.ui32Elapsed =
+        (xTaskGetTickCount() - lorawan_traffic_started) * portTICK_PERIOD_MS;
+    lorawan_traffic_stats.ui32Running = 0;
+
+    lorawan_traffic_report(true);
+}
+
+static void lorawan_traffic_callback(TimerHandle_t xTimer)
+{
+    TickType_t tNow = xTaskGetTickCount();
+    TickType_t tElapsed = tNow - lorawan_traffic_started;
+    TickType_t tDuration = pdMS_TO_TICKS(lorawan_traffic_config.ui32Duration * 1000);
+
+    if (!lorawan_traffic_stats.ui32Running)
+    {
+        return;
+    }
+
+    if (tDuration && (tElapsed >= tDuration))
+    {
+        lorawan_traffic_finish(0);
+        return;
+    }
+
+    lorawan_traffic_send();
+
+    if (lorawan_traffic_config.ui32Report &&
+        ((tNow - lorawan_traffic_reported) >=
+         pdMS_TO_TICKS(lorawan_traffic_config.ui32Report * 1000)))
+    {
+        lorawan_traffic_reported = tNow;
+        lorawan_traffic_report(false);
+    }
+
+    // The last interval is cut short so that the run ends on time.
+    TickType_t tNext = pdMS_TO_TICKS(lorawan_traffic_interval());
+    if (tDuration && (tNext > tDuration - tElapsed))
+    {
+        tNext = tDuration - tElapsed;
+    }
+    xTimerChangePeriod(xTimer, tNext ? tNext : 1, 0);
+}
+
+void lorawan_traffic_config_get(lorawan_traffic_config_t *psConfig)
+{
+    memcpy(psConfig, &lorawan_traffic_config, sizeof(lorawan_traffic_config_t));
+}
+
+int32_t lorawan_traffic_config_set(const lorawan_traffic_config_t *psConfig)
+{
+    if (lorawan_traffic_stats.ui32Running)
+    {
+        return -1;
+    }
+
+    if ((psConfig->ui32IntervalMin == 0) ||
+        ((psConfig->eInterval == LORAWAN_TRAFFIC_UNIFORM) &&
+         (psConfig->ui32IntervalMax < psConfig->ui32IntervalMin)) ||
+        (psConfig->eInterval > LORAWAN_TRAFFIC_EXPONENTIAL))
+    {
+        return -1;
+    }
+
+    if ((psConfig->ui32SizeMax < psConfig->ui32SizeMin) ||
+        (psConfig->ui32SizeMax > LORAWAN_TRAFFIC_PAYLOAD_MAX) || (psConfig->ui32Confirmed > 100))
+    {
+        return -1;
+    }
+
+    if ((psConfig->ui32Ports == 0) || (psConfig->ui32Ports > LORAWAN_TRAFFIC_PORTS_MAX))
+    {
+        return -1;
+    }
+
+    for (uint32_t i = 0; i < psConfig->ui32Ports; i++)
+    {
+        if ((psConfig->psPorts[i].ui8Port == 0) || (psConfig->psPorts[i].ui8Port > 223) ||
+            (psConfig->psPorts[i].ui8Weight == 0))
+        {
+            return -1;
+        }
+    }
+
+    memcpy(&lorawan_traffic_config, psConfig, sizeof(lorawan_traffic_config_t));
+    return 0;
+}
+
+int32_t lorawan_traffic_start()
+{
+    if (lorawan_traffic_stats.ui32Running)
+    {
+        return -1;
+    }
+
+    if (lorawan_traffic_timer == NULL)
+    {
+        lorawan_traffic_timer =
+            xTimerCreate("lorawan traffic", 1, pdFALSE, NULL, lorawan_traffic_callback);
+    }
+
+    // The subscriptions stay in place after the run so that the uplinks
+    // still in flight when it ends are accounted.
+    if (!lorawan_traffic_subscribed)
+    {
+        lorawan_event_subscribe(LORAWAN_EVENT_MAC_MCPS_REQUEST, lorawan_traffic_on_event, NULL);
+        lorawan_event_subscribe(LORAWAN_EVENT_TX_DATA, lorawan_traffic_on_event, NULL);
+        lorawan_traffic_subscribed = true;
+    }
+
+    memset(&lorawan_traffic_stats, 0, sizeof(lorawan_traffic_stats_t));
+    lorawan_transmit_stats_get(&lorawan_traffic_baseline);
+    lorawan_latency_stats_reset();
+
+    lorawan_traffic_started = xTaskGetTickCount();
+    lorawan_traffic_reported = lorawan_traffic_started;
+    lorawan_traffic_stats.ui32Running = 1;
+
+    // The first uplink goes out right away.
+    xTimerChangePeriod(lorawan_traffic_timer, 1, portMAX_DELAY);
+
+    return 0;
+}
+
+void lorawan_traffic_stop()
+{
+    lorawan_traffic_finish(portMAX_DELAY);
+}
+
+void lorawan_traffic_stats_get(lorawan_traffic_stats_t *psStats)
+{
+    lorawan_transmit_stats_t sTransmit;
+
+    lorawan_transmit_stats_get(&sTransmit);
+    memcpy(psStats, &lorawan_traffic_stats, sizeof(lorawan_traffic_stats_t));
+
+    psStats->ui32Queued = sTransmit.ui32Queued - lorawan_traffic_baseline.ui32Queued;
+    psStats->ui32Dropped = (sTransmit.ui32Dropped - lorawan_traffic_baseline.ui32Dropped) +
+                           (sTransmit.ui32Expired - lorawan_traffic_baseline.ui32Expired);
+    if (psStats->ui32Running)
+    {
+        psStats->ui32Elapsed = (xTaskGetTickCount() - lorawan_traffic_started) * portTICK_PERIOD_MS;
+    }
+}
+
+void lorawan_traffic_report(bool bFinal)
+{
+    lorawan_traffic_stats_t stats;
+    lorawan_traffic_stats_get(&stats);
+
+    am_util_stdio_printf("\n\rtraffic %s %u s: requested %u queued %u dropped %u blocked %u "
+                         "sent %u failed %u confirmed %u acked %u\n\r",
+                         stats.ui32Running ? "running" : "stopped",
+                         stats.ui32Elapsed / 1000,
+                         stats.ui32Requested,
+                         stats.ui32Queued,
+                         stats.ui32Dropped,
+                         stats.ui32Blocked,
+                         stats.ui32Sent,
+                         stats.ui32Failed,
+                         stats.ui32Confirmed,
+                         stats.ui32Acked);
+
+    if (!bFinal)
+    {
+        return;
+    }
+
+    lorawan_latency_stats_t latency;
+    am_util_stdio_printf("%-4s %-6s %7s %7s %7s %7s %7s  total ms\n\r",
+                         "Port", "Prio", "Count", "p50", "p90", "p99", "max");
+    for (uint32_t i = 0; i < LORAWAN_LATENCY_CLASSES; i++)
+    {
+        if (!lorawan_latency_stats_get(i, &latency) || !lorawan_traffic_port_used(latency.ui32Port))
+        {
+            continue;
+        }
+
+        am_util_stdio_printf("%-4u %-6s %7u %7u %7u %7u %7u\n\r",
+                             latency.ui32Port,
+                             latency.ui32Urgent ? "urgent" : "normal",
+                             latency.ui32Count,
+                             lorawan_latency_percentile(&latency, LORAWAN_LATENCY_TOTAL, 500),
+                             lorawan_latency_percentile(&latency, LORAWAN_LATENCY_TOTAL, 900),
+                             lorawan_latency_percentile(&latency, LORAWAN_LATENCY_TOTAL, 990),
+                             latency.pui32Max[LORAWAN_LATENCY_TOTAL]);
+    }
+}
@@ -0,0 +1,143 @@
+/*
+ * BSD 3-Clause License
+ *
+ * Copyright (c) 2024, Northern Mechatronics, Inc.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its
+ *    contributors may be used to endorse or promote products derived from
+ *    this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+#ifndef _LORAWAN_TRAFFIC_H_
+#define _LORAWAN_TRAFFIC_H_
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief Application ports the generator spreads its uplinks over.
+ */
+#ifndef LORAWAN_TRAFFIC_PORTS_MAX
+#define LORAWAN_TRAFFIC_PORTS_MAX (4)
+#endif
+
+/**
+ * @brief Sequence number, little endian, at the start of every payload of
+ * at least this size so that the backend can count the lost uplinks.
+ */
+#define LORAWAN_TRAFFIC_SEQUENCE_SIZE (4)
+
+typedef enum
+{
+    LORAWAN_TRAFFIC_FIXED = 0,   ///< every ui32IntervalMin ms
+    LORAWAN_TRAFFIC_UNIFORM,     ///< uniform between ui32IntervalMin and ui32IntervalMax ms
+    LORAWAN_TRAFFIC_EXPONENTIAL, ///< Poisson arrivals, ui32IntervalMin ms apart on average
+} lorawan_traffic_distribution_e;
+
+typedef struct
+{
+    uint8_t ui8Port;
+    uint8_t ui8Weight; ///< relative share of the uplinks
+} lorawan_traffic_port_t;
+
+typedef struct
+{
+    lorawan_traffic_distribution_e eInterval;
+    uint32_t ui32IntervalMin; ///< ms
+    uint32_t ui32IntervalMax; ///< ms, uniform distribution only
+    uint32_t ui32SizeMin;     ///< payload bytes, uniform between min and max
+    uint32_t ui32SizeMax;
+    uint32_t ui32Confirmed;   ///< percent of the uplinks sent confirmed
+    uint32_t ui32Ports;
+    lorawan_traffic_port_t psPorts[LORAWAN_TRAFFIC_PORTS_MAX];
+    uint32_t ui32Duration;    ///< s, 0 to run until stopped
+    uint32_t ui32Report;      ///< s between live counter lines, 0 for none
+} lorawan_traffic_config_t;
+
+typedef struct
+{
+    uint32_t ui32Running;
+    uint32_t ui32Elapsed;   ///< ms since the start
+    uint32_t ui32Requested; ///< uplinks generated
+    uint32_t ui32Queued;    ///< accepted by the transmit queue
+    uint32_t ui32Dropped;   ///< transmit queue full or time to live elapsed
+    uint32_t ui32Blocked;   ///< rejected by the MAC, duty cycle restricted
+    uint32_t ui32Sent;      ///< transmit confirmations
+    uint32_t ui32Failed;    ///< confirmations with an error status
+    uint32_t ui32Confirmed; ///< confirmed uplinks sent
+    uint32_t ui32Acked;     ///< confirmed uplinks acknowledged by the network
+} lorawan_traffic_stats_t;
+
+/**
+ * @brief Uplink load generator for load and soak tests.
+ *
+ * A software timer queues uplinks with lorawan_transmit at intervals drawn
+ * from the configured distribution, on a port drawn from the weighted port
+ * mix, with a random payload size and a share of confirmed uplinks.  The
+ * MAC outcome of each uplink is collected from the event bus.  The queued
+ * and dropped counts are taken from the transmit statistics and include
+ * uplinks of the application sent during the run.
+ *
+ * Starting the generator clears the latency histograms, the report at the
+ * end of the run lists the percentiles of the ports in the mix.
+ */
+extern void lorawan_traffic_config_get(lorawan_traffic_config_t *psConfig);
+
+/**
+ * @brief Set the load profile.
+ *
+ * @return 0 on success, -1 if the profile is invalid or the generator is
+ *  running.
+ */
+extern int32_t lorawan_traffic_config_set(const lorawan_traffic_config_t *psConfig);
+
+/**
+ * @brief Start a run, the counters of the previous run are cleared.
+ *
+ * @return 0 on success, -1 if the generator is already running.
+ */
+extern int32_t lorawan_traffic_start();
+
+/**
+ * @brief Stop the run and print the report.
+ */
+extern void lorawan_traffic_stop();
+
+extern void lorawan_traffic_stats_get(lorawan_traffic_stats_t *psStats);
+
+/**
+ * @brief Print the counters and, at the end of a run, the latency
+ * percentiles.
+ */
+extern void lorawan_traffic_report(bool bFinal);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
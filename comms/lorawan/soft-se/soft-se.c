@@ -38,15 +38,17 @@
 #include "secure-element.h"
 #include "secure-element-nvm.h"
 
-extern SecureElementNvmData_t gsLoRaWANSecureElement;
+#include "lorawan_instance.h"
+
 static SecureElementNvmData_t* SeNvm;
 
 static void SecureElementSetDeviceEUI()
 {
+    SecureElementNvmData_t *psIdentity = &LORAWAN_INSTANCE->sSecureElement;
     uint8_t isEmpty = true;
     for (int i = 0; i < SE_EUI_SIZE; i++)
     {
-        if (gsLoRaWANSecureElement.DevEui[i] != 0x00)
+        if (psIdentity->DevEui[i] != 0x00)
         {
             isEmpty = false;
             break;
@@ -58,14 +60,14 @@ static void SecureElementSetDeviceEUI()
         am_util_id_t id;
         am_util_id_device(&id);
 
-        gsLoRaWANSecureElement.DevEui[0] = (uint8_t)(id.sMcuCtrlDevice.ui32ChipID0);
-        gsLoRaWANSecureElement.DevEui[1] = (uint8_t)(id.sMcuCtrlDevice.ui32ChipID0 >> 8);
-        gsLoRaWANSecureElement.DevEui[2] = (uint8_t)(id.sMcuCtrlDevice.ui32ChipID0 >> 16);
-        gsLoRaWANSecureElement.DevEui[3] = (uint8_t)(id.sMcuCtrlDevice.ui32ChipID0 >> 24);
-        gsLoRaWANSecureElement.DevEui[4] = (uint8_t)(id.sMcuCtrlDevice.ui32ChipID1);
-        gsLoRaWANSecureElement.DevEui[5] = (uint8_t)(id.sMcuCtrlDevice.ui32ChipID1 >> 8);
-        gsLoRaWANSecureElement.DevEui[6] = (uint8_t)(id.sMcuCtrlDevice.ui32ChipID1 >> 16);
-        gsLoRaWANSecureElement.DevEui[7] = (uint8_t)(id.sMcuCtrlDevice.ui32ChipID1 >> 24);
+        psIdentity->DevEui[0] = (uint8_t)(id.sMcuCtrlDevice.ui32ChipID0);
+        psIdentity->DevEui[1] = (uint8_t)(id.sMcuCtrlDevice.ui32ChipID0 >> 8);
+        psIdentity->DevEui[2] = (uint8_t)(id.sMcuCtrlDevice.ui32ChipID0 >> 16);
+        psIdentity->DevEui[3] = (uint8_t)(id.sMcuCtrlDevice.ui32ChipID0 >> 24);
+        psIdentity->DevEui[4] = (uint8_t)(id.sMcuCtrlDevice.ui32ChipID1);
+        psIdentity->DevEui[5] = (uint8_t)(id.sMcuCtrlDevice.ui32ChipID1 >> 8);
+        psIdentity->DevEui[6] = (uint8_t)(id.sMcuCtrlDevice.ui32ChipID1 >> 16);
+        psIdentity->DevEui[7] = (uint8_t)(id.sMcuCtrlDevice.ui32ChipID1 >> 24);
     }
 }
 
@@ -156,7 +158,8 @@ SecureElementStatus_t SecureElementInit( SecureElementNvmData_t* nvm )
     SecureElementSetDeviceEUI();
 
     // Initialize data
-    memcpy1( ( uint8_t* )SeNvm, ( uint8_t* )&gsLoRaWANSecureElement, sizeof( gsLoRaWANSecureElement ) );
+    memcpy1( ( uint8_t* )SeNvm, ( uint8_t* )&LORAWAN_INSTANCE->sSecureElement,
+             sizeof( SecureElementNvmData_t ) );
 
 
     return SECURE_ELEMENT_SUCCESS;
@@ -0,0 +1,257 @@
+/*
+ * BSD 3-Clause License
+ *
+ * Copyright (c) 2024, Northern Mechatronics, Inc.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its
+ *    contributors may be used to endorse or promote products derived from
+ *    this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+#include <stdint.h>
+#include <string.h>
+
+#include <am_mcu_apollo.h>
+#include <am_util.h>
+
+#include <FreeRTOS.h>
+#include <timers.h>
+
+#include "lorawan.h"
+
+#include "energy.h"
+
+typedef struct
+{
+    energy_domain_e eDomain;
+    const char *pcName;
+    uint32_t ui32Current;
+} energy_state_info_t;
+
+// Default supply currents in uA.  These are typical datasheet figures for
+// the Apollo3 and the SX1262 and should be calibrated for each board.
+static const energy_state_info_t energy_state_info[ENERGY_STATES] = {
+    {ENERGY_DOMAIN_MCU, "mcu active", 1200},
+    {ENERGY_DOMAIN_MCU, "mcu sleep", 500},
+    {ENERGY_DOMAIN_MCU, "mcu deep sleep", 3},
+    {ENERGY_DOMAIN_RADIO, "radio off", 0},
+    {ENERGY_DOMAIN_RADIO, "radio sleep", 1},
+    {ENERGY_DOMAIN_RADIO, "radio standby", 600},
+    {ENERGY_DOMAIN_RADIO, "radio rx", 4600},
+    {ENERGY_DOMAIN_RADIO, "radio tx", 118000},
+    {ENERGY_DOMAIN_RADIO_PORT, "port off", 0},
+    {ENERGY_DOMAIN_RADIO_PORT, "port on", 50},
+};
+
+static uint32_t energy_current[ENERGY_STATES];
+static uint64_t energy_residency[ENERGY_STATES];
+static uint32_t energy_transitions[ENERGY_STATES];
+
+static energy_state_e energy_domain_state[ENERGY_DOMAINS];
+static uint32_t energy_domain_since[ENERGY_DOMAINS];
+
+static TimerHandle_t energy_uplink_timer;
+static uint32_t energy_uplink_port;
+static uint64_t energy_uplink_charge[ENERGY_DOMAINS];
+static uint64_t energy_uplink_tx;
+
+static void energy_fold(uint32_t ui32Now)
+{
+    for (uint32_t i = 0; i < ENERGY_DOMAINS; i++)
+    {
+        energy_residency[energy_domain_state[i]] += (uint32_t)(ui32Now - energy_domain_since[i]);
+        energy_domain_since[i] = ui32Now;
+    }
+}
+
+static uint64_t energy_charge(energy_state_e eState, uint64_t ui64Residency)
+{
+    // uA.s first to keep the intermediate product within 64 bits
+    uint64_t ui64Charge = (ui64Residency * energy_current[eState]) / ENERGY_TIMER_HZ;
+    return (ui64Charge * 10) / 36;
+}
+
+void energy_init(void)
+{
+    for (uint32_t i = 0; i < ENERGY_STATES; i++)
+    {
+        energy_current[i] = energy_state_info[i].ui32Current;
+    }
+
+    energy_domain_state[ENERGY_DOMAIN_MCU] = ENERGY_STATE_MCU_ACTIVE;
+    energy_domain_state[ENERGY_DOMAIN_RADIO] = ENERGY_STATE_RADIO_OFF;
+    energy_domain_state[ENERGY_DOMAIN_RADIO_PORT] = ENERGY_STATE_RADIO_PORT_OFF;
+
+    energy_uplink_timer = NULL;
+
+    energy_stats_reset();
+}
+
+void energy_state_set(energy_domain_e eDomain, energy_state_e eState)
+{
+    uint32_t ui32Now = am_hal_stimer_counter_get();
+
+    AM_CRITICAL_BEGIN
+    energy_state_e ePrevious = energy_domain_state[eDomain];
+    if (ePrevious != eState)
+    {
+        energy_residency[ePrevious] += (uint32_t)(ui32Now - energy_domain_since[eDomain]);
+        energy_domain_since[eDomain] = ui32Now;
+        energy_domain_state[eDomain] = eState;
+        energy_transitions[eState]++;
+    }
+    AM_CRITICAL_END
+}
+
+energy_state_e energy_state_get(energy_domain_e eDomain)
+{
+    return energy_domain_state[eDomain];
+}
+
+const char *energy_state_name(energy_state_e eState)
+{
+    return energy_state_info[eState].pcName;
+}
+
+energy_domain_e energy_state_domain(energy_state_e eState)
+{
+    return energy_state_info[eState].eDomain;
+}
+
+void energy_current_set(energy_state_e eState, uint32_t ui32Current)
+{
+    if (eState < ENERGY_STATES)
+    {
+        energy_current[eState] = ui32Current;
+    }
+}
+
+uint32_t energy_current_get(energy_state_e eState)
+{
+    return energy_current[eState];
+}
+
+void energy_stats_get(energy_stats_t *psStats)
+{
+    uint32_t ui32Now = am_hal_stimer_counter_get();
+
+    AM_CRITICAL_BEGIN
+    energy_fold(ui32Now);
+    memcpy(psStats->ui64Residency, energy_residency, sizeof(energy_residency));
+    memcpy(psStats->ui32Transitions, energy_transitions, sizeof(energy_transitions));
+    AM_CRITICAL_END
+
+    memset(psStats->ui64DomainCharge, 0, sizeof(psStats->ui64DomainCharge));
+    psStats->ui64Elapsed = 0;
+    for (uint32_t i = 0; i < ENERGY_STATES; i++)
+    {
+        psStats->ui64Charge[i] = energy_charge(i, psStats->ui64Residency[i]);
+        psStats->ui64DomainCharge[energy_state_info[i].eDomain] += psStats->ui64Charge[i];
+
+        // The MCU is always in exactly one state.
+        if (energy_state_info[i].eDomain == ENERGY_DOMAIN_MCU)
+        {
+            psStats->ui64Elapsed += psStats->ui64Residency[i];
+        }
+    }
+}
+
+void energy_stats_reset(void)
+{
+    uint32_t ui32Now = am_hal_stimer_counter_get();
+
+    AM_CRITICAL_BEGIN
+    memset(energy_residency, 0, sizeof(energy_residency));
+    memset(energy_transitions, 0, sizeof(energy_transitions));
+    for (uint32_t i = 0; i < ENERGY_DOMAINS; i++)
+    {
+        energy_domain_since[i] = ui32Now;
+    }
+    AM_CRITICAL_END
+
+    memset(energy_uplink_charge, 0, sizeof(energy_uplink_charge));
+    energy_uplink_tx = 0;
+}
+
+static uint16_t energy_saturate(uint64_t ui64Value)
+{
+    return (ui64Value > UINT16_MAX) ? UINT16_MAX : (uint16_t)ui64Value;
+}
+
+static void energy_uplink_callback(TimerHandle_t handle)
+{
+    energy_stats_t stats;
+    uint8_t pui8Payload[9];
+    uint32_t ui32Index = 0;
+
+    energy_stats_get(&stats);
+
+    pui8Payload[ui32Index++] = ENERGY_UPLINK_FORMAT_VERSION;
+    for (uint32_t i = 0; i < ENERGY_DOMAINS; i++)
+    {
+        uint64_t ui64Charge = stats.ui64DomainCharge[i];
+        uint16_t ui16Charge = energy_saturate((ui64Charge - energy_uplink_charge[i]) / 1000);
+        pui8Payload[ui32Index++] = ui16Charge & 0xFF;
+        pui8Payload[ui32Index++] = (ui16Charge >> 8) & 0xFF;
+        energy_uplink_charge[i] = ui64Charge;
+    }
+
+    uint64_t ui64Tx = stats.ui64Residency[ENERGY_STATE_RADIO_TX];
+    uint16_t ui16Tx = energy_saturate(((ui64Tx - energy_uplink_tx) * 1000) / ENERGY_TIMER_HZ);
+    pui8Payload[ui32Index++] = ui16Tx & 0xFF;
+    pui8Payload[ui32Index++] = (ui16Tx >> 8) & 0xFF;
+    energy_uplink_tx = ui64Tx;
+
+    lorawan_transmit(energy_uplink_port, 0, ui32Index, pui8Payload);
+}
+
+void energy_uplink_set(uint32_t ui32Period, uint32_t ui32Port)
+{
+    if (ui32Period == 0)
+    {
+        if (energy_uplink_timer)
+        {
+            xTimerStop(energy_uplink_timer, portMAX_DELAY);
+            xTimerDelete(energy_uplink_timer, portMAX_DELAY);
+            energy_uplink_timer = NULL;
+        }
+        return;
+    }
+
+    energy_uplink_port = ui32Port;
+
+    if (energy_uplink_timer == NULL)
+    {
+        energy_uplink_timer = xTimerCreate("energy uplink",
+                                           pdMS_TO_TICKS(ui32Period * 1000),
+                                           pdTRUE,
+                                           NULL,
+                                           energy_uplink_callback);
+        xTimerStart(energy_uplink_timer, portMAX_DELAY);
+    }
+    else
+    {
+        xTimerChangePeriod(energy_uplink_timer, pdMS_TO_TICKS(ui32Period * 1000), portMAX_DELAY);
+    }
+}
@@ -0,0 +1,124 @@
+/*
+ * BSD 3-Clause License
+ *
+ * Copyright (c) 2024, Northern Mechatronics, Inc.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its
+ *    contributors may be used to endorse or promote products derived from
+ *    this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+#ifndef _ENERGY_H_
+#define _ENERGY_H_
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief Residency timestamps are taken from the STIMER which also drives
+ * the FreeRTOS tickless idle.
+ */
+#ifndef ENERGY_TIMER_HZ
+#define ENERGY_TIMER_HZ (32768)
+#endif
+
+#define ENERGY_UPLINK_FORMAT_VERSION (1)
+
+typedef enum
+{
+    ENERGY_DOMAIN_MCU,
+    ENERGY_DOMAIN_RADIO,
+    ENERGY_DOMAIN_RADIO_PORT,
+    ENERGY_DOMAINS
+} energy_domain_e;
+
+typedef enum
+{
+    ENERGY_STATE_MCU_ACTIVE,
+    ENERGY_STATE_MCU_SLEEP,
+    ENERGY_STATE_MCU_DEEP_SLEEP,
+    ENERGY_STATE_RADIO_OFF,
+    ENERGY_STATE_RADIO_SLEEP,
+    ENERGY_STATE_RADIO_STANDBY,
+    ENERGY_STATE_RADIO_RX,
+    ENERGY_STATE_RADIO_TX,
+    ENERGY_STATE_RADIO_PORT_OFF,
+    ENERGY_STATE_RADIO_PORT_ON,
+    ENERGY_STATES
+} energy_state_e;
+
+typedef struct
+{
+    uint64_t ui64Residency[ENERGY_STATES]; ///< timer ticks spent in each state
+    uint32_t ui32Transitions[ENERGY_STATES];
+    uint64_t ui64Charge[ENERGY_STATES];    ///< nAh consumed in each state
+    uint64_t ui64DomainCharge[ENERGY_DOMAINS];
+    uint64_t ui64Elapsed;                  ///< timer ticks since reset
+} energy_stats_t;
+
+extern void energy_init(void);
+
+/**
+ * @brief Record a state transition of a domain.
+ *
+ * Safe to call from an ISR and from am_freertos_sleep.
+ */
+extern void energy_state_set(energy_domain_e eDomain, energy_state_e eState);
+extern energy_state_e energy_state_get(energy_domain_e eDomain);
+
+extern const char *energy_state_name(energy_state_e eState);
+extern energy_domain_e energy_state_domain(energy_state_e eState);
+
+/**
+ * @brief Set the supply current drawn in a state, in uA.
+ */
+extern void energy_current_set(energy_state_e eState, uint32_t ui32Current);
+extern uint32_t energy_current_get(energy_state_e eState);
+
+extern void energy_stats_get(energy_stats_t *psStats);
+extern void energy_stats_reset(void);
+
+/**
+ * @brief Periodically transmit a compact energy report.
+ *
+ * The payload is:
+ *   byte 0      format version
+ *   bytes 1-6   MCU, radio and radio port charge since the last report
+ *               in uAh, uint16 little endian, saturated
+ *   bytes 7-8   radio TX time since the last report in ms, uint16
+ *               little endian, saturated
+ *
+ * @param ui32Period  report period in seconds, 0 to stop.
+ * @param ui32Port    LoRaWAN port to report on.
+ */
+extern void energy_uplink_set(uint32_t ui32Period, uint32_t ui32Port);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,278 @@
+/*
+ * BSD 3-Clause License
+ *
+ * Copyright (c) 2024, Northern Mechatronics, Inc.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its
+ *    contributors may be used to endorse or promote products derived from
+ *    this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <am_mcu_apollo.h>
+#include <am_util.h>
+
+#include <FreeRTOS.h>
+#include <FreeRTOS_CLI.h>
+
+#include "energy.h"
+#include "sleep_policy.h"
+#include "energy_cli.h"
+
+#define COMMAND_LINE_BUFFER_MAX     (128)
+
+static portBASE_TYPE energy_cli_entry(char *pui8OutBuffer,
+                                      size_t ui32OutBufferLength,
+                                      const char *pui8Command);
+
+static CLI_Command_Definition_t energy_cli_definition = {
+    (const char *const) "energy",
+    (const char *const) "energy :  energy accounting\r\n",
+    energy_cli_entry,
+    -1};
+
+static size_t argc;
+static char *argv[8];
+static char argz[COMMAND_LINE_BUFFER_MAX];
+
+static const char *energy_domain_name[ENERGY_DOMAINS] = {"mcu", "radio", "port"};
+
+void energy_cli_register(void)
+{
+    FreeRTOS_CLIRegisterCommand(&energy_cli_definition);
+    argc = 0;
+}
+
+static void help(char *pui8OutBuffer, size_t argc, char **argv)
+{
+    am_util_stdio_printf("\r\nusage: energy <command>\r\n");
+    am_util_stdio_printf("\r\n");
+    am_util_stdio_printf("supported commands are:\r\n");
+    am_util_stdio_printf("  show     display state residency and charge estimates\r\n");
+    am_util_stdio_printf("  reset    reset residency counters\r\n");
+    am_util_stdio_printf("  current  [state] [uA] display or set a state supply current\r\n");
+    am_util_stdio_printf("  uplink   <start|stop> [period] [port]\r\n");
+    am_util_stdio_printf("           periodically transmit a compact energy report\r\n");
+    am_util_stdio_printf("  sleep    [reset|auto|normal|deep] display sleep mode statistics,\r\n");
+    am_util_stdio_printf("           reset them, or select the sleep mode\r\n\r\n");
+}
+
+static void show(char *pui8OutBuffer, size_t argc, char **argv)
+{
+    energy_stats_t stats;
+    energy_stats_get(&stats);
+
+    uint64_t ui64Elapsed = stats.ui64Elapsed ? stats.ui64Elapsed : 1;
+
+    am_util_stdio_printf("\r\n");
+    am_util_stdio_printf("State            Time (ms)   %%     Count      Charge (uAh)\r\n");
+    for (uint32_t i = 0; i < ENERGY_STATES; i++)
+    {
+        uint32_t ui32Time = (uint32_t)((stats.ui64Residency[i] * 1000) / ENERGY_TIMER_HZ);
+        uint32_t ui32Ratio = (uint32_t)((stats.ui64Residency[i] * 1000) / ui64Elapsed);
+        uint32_t ui32Charge = (uint32_t)stats.ui64Charge[i];
+
+        am_util_stdio_printf("%-16s %10u  %3u.%u  %8u  %8u.%03u\r\n",
+                             energy_state_name(i),
+                             ui32Time,
+                             ui32Ratio / 10,
+                             ui32Ratio % 10,
+                             stats.ui32Transitions[i],
+                             ui32Charge / 1000,
+                             ui32Charge % 1000);
+    }
+
+    am_util_stdio_printf("\r\n");
+    for (uint32_t i = 0; i < ENERGY_DOMAINS; i++)
+    {
+        uint32_t ui32Charge = (uint32_t)stats.ui64DomainCharge[i];
+        am_util_stdio_printf("Total %-6s : %u.%03u (uAh)\r\n",
+                             energy_domain_name[i],
+                             ui32Charge / 1000,
+                             ui32Charge % 1000);
+    }
+}
+
+static void current(char *pui8OutBuffer, size_t argc, char **argv)
+{
+    if (argc == 4)
+    {
+        energy_current_set(strtol(argv[2], NULL, 10), strtol(argv[3], NULL, 10));
+        return;
+    }
+
+    am_util_stdio_printf("\r\n");
+    for (uint32_t i = 0; i < ENERGY_STATES; i++)
+    {
+        am_util_stdio_printf("%2u  %-16s %8u (uA)\r\n", i, energy_state_name(i), energy_current_get(i));
+    }
+}
+
+static void uplink(char *pui8OutBuffer, size_t argc, char **argv)
+{
+    uint32_t ui32Period = 3600;
+    uint32_t ui32Port = 2;
+
+    if (argc < 3)
+    {
+        return;
+    }
+
+    if (strcmp(argv[2], "stop") == 0)
+    {
+        energy_uplink_set(0, 0);
+    }
+    else if (strcmp(argv[2], "start") == 0)
+    {
+        if (argc > 3)
+        {
+            ui32Period = strtol(argv[3], NULL, 10);
+        }
+
+        if (argc > 4)
+        {
+            ui32Port = strtol(argv[4], NULL, 10);
+        }
+
+        energy_uplink_set(ui32Period, ui32Port);
+    }
+}
+
+static void sleep_histogram(const char *pcName,
+                            uint32_t ui32Histogram[SLEEP_POLICY_MODES][SLEEP_POLICY_HISTOGRAM_BINS],
+                            const char **ppcBins)
+{
+    am_util_stdio_printf("\r\n%-10s %10s %10s\r\n",
+                         pcName,
+                         sleep_policy_mode_name(SLEEP_POLICY_MODE_NORMAL),
+                         sleep_policy_mode_name(SLEEP_POLICY_MODE_DEEP));
+    for (uint32_t i = 0; i < SLEEP_POLICY_HISTOGRAM_BINS; i++)
+    {
+        am_util_stdio_printf("%-10s %10u %10u\r\n",
+                             ppcBins[i],
+                             ui32Histogram[SLEEP_POLICY_MODE_NORMAL][i],
+                             ui32Histogram[SLEEP_POLICY_MODE_DEEP][i]);
+    }
+}
+
+static void sleep_stats(char *pui8OutBuffer, size_t argc, char **argv)
+{
+    static const char *residency_bins[SLEEP_POLICY_HISTOGRAM_BINS] = {
+        "<1 ms", "<4 ms", "<16 ms", "<64 ms", "<256 ms", "<1 s", "<4 s", ">=4 s"};
+    static const char *latency_bins[SLEEP_POLICY_HISTOGRAM_BINS] = {
+        "<31 us", "<61 us", "<122 us", "<244 us", "<488 us", "<977 us", "<1953 us", ">=1953 us"};
+    sleep_policy_stats_t stats;
+
+    if (argc > 2)
+    {
+        if (strcmp(argv[2], "reset") == 0)
+        {
+            sleep_policy_stats_reset();
+        }
+        else
+        {
+            for (uint32_t i = 0; i <= SLEEP_POLICY_MODE_AUTO; i++)
+            {
+                if (strcmp(argv[2], sleep_policy_mode_name(i)) == 0)
+                {
+                    sleep_policy_mode_set(i);
+                }
+            }
+        }
+        return;
+    }
+
+    sleep_policy_stats_get(&stats);
+
+    am_util_stdio_printf("\r\n");
+    am_util_stdio_printf("Mode          : %s\r\n", sleep_policy_mode_name(sleep_policy_mode_get()));
+    am_util_stdio_printf("Deep sleep at : %u (us)\r\n",
+                         (uint32_t)(((uint64_t)stats.ui32Threshold * 1000000) / ENERGY_TIMER_HZ));
+    am_util_stdio_printf("\r\n");
+    am_util_stdio_printf("Mode        Entries   Early    Time (ms)  Latency (us)\r\n");
+    for (uint32_t i = 0; i < SLEEP_POLICY_MODES; i++)
+    {
+        uint32_t ui32Time = (uint32_t)((stats.ui64Residency[i] * 1000) / ENERGY_TIMER_HZ);
+        uint32_t ui32Latency =
+            (uint32_t)(((uint64_t)stats.ui32Latency[i] * 1000000) / (ENERGY_TIMER_HZ * 16));
+
+        am_util_stdio_printf("%-10s %8u %7u %12u %13u\r\n",
+                             sleep_policy_mode_name(i),
+                             stats.ui32Entries[i],
+                             stats.ui32Early[i],
+                             ui32Time,
+                             ui32Latency);
+    }
+
+    sleep_histogram("Residency", stats.ui32ResidencyHistogram, residency_bins);
+    sleep_histogram("Latency", stats.ui32LatencyHistogram, latency_bins);
+}
+
+static portBASE_TYPE
+energy_cli_entry(char *pui8OutBuffer, size_t ui32OutBufferLength, const char *pui8Command)
+{
+    pui8OutBuffer[0] = 0;
+
+    memset(argz, 0, COMMAND_LINE_BUFFER_MAX);
+    strcpy(argz, pui8Command);
+    FreeRTOS_CLIExtractParameters(argz, &argc, argv);
+
+    if (argc < 2)
+    {
+        show(pui8OutBuffer, argc, argv);
+    }
+    else if (strcmp(argv[1], "help") == 0)
+    {
+        help(pui8OutBuffer, argc, argv);
+    }
+    else if (strcmp(argv[1], "show") == 0)
+    {
+        show(pui8OutBuffer, argc, argv);
+    }
+    else if (strcmp(argv[1], "reset") == 0)
+    {
+        energy_stats_reset();
+    }
+    else if (strcmp(argv[1], "current") == 0)
+    {
+        current(pui8OutBuffer, argc, argv);
+    }
+    else if (strcmp(argv[1], "uplink") == 0)
+    {
+        uplink(pui8OutBuffer, argc, argv);
+    }
+    else if (strcmp(argv[1], "sleep") == 0)
+    {
+        sleep_stats(pui8OutBuffer, argc, argv);
+    }
+    else
+    {
+        help(pui8OutBuffer, argc, argv);
+    }
+
+    return pdFALSE;
+}
@@ -47,8 +47,11 @@
 
 #include "application_task.h"
 #include "button_task.h"
+#include "energy.h"
 #include "led_task.h"
 #include "lorawan_task.h"
+#include "sleep_policy.h"
+#include "sys_monitor.h"
 
 //*****************************************************************************
 //
@@ -60,7 +63,16 @@
 //*****************************************************************************
 uint32_t am_freertos_sleep(uint32_t idleTime)
 {
-    am_hal_sysctrl_sleep(AM_HAL_SYSCTRL_SLEEP_DEEP);
+    if (sleep_policy_select(idleTime) == SLEEP_POLICY_MODE_DEEP)
+    {
+        energy_state_set(ENERGY_DOMAIN_MCU, ENERGY_STATE_MCU_DEEP_SLEEP);
+        am_hal_sysctrl_sleep(AM_HAL_SYSCTRL_SLEEP_DEEP);
+    }
+    else
+    {
+        energy_state_set(ENERGY_DOMAIN_MCU, ENERGY_STATE_MCU_SLEEP);
+        am_hal_sysctrl_sleep(AM_HAL_SYSCTRL_SLEEP_NORMAL);
+    }
     return 0;
 }
 
@@ -72,6 +84,8 @@ uint32_t am_freertos_sleep(uint32_t idleTime)
 //*****************************************************************************
 void am_freertos_wakeup(uint32_t idleTime)
 {
+    sleep_policy_wakeup();
+    energy_state_set(ENERGY_DOMAIN_MCU, ENERGY_STATE_MCU_ACTIVE);
 }
 
 //*****************************************************************************
@@ -146,6 +160,10 @@ void system_setup(void)
 
 void system_start(void)
 {
+    energy_init();
+    sleep_policy_init();
+    sys_monitor_init();
+
 #if defined(CLI_ENABLE)
     console_task_create(2, CONSOLE_OUTPUT_UART);
 #endif
@@ -0,0 +1,289 @@
+/*
+ * BSD 3-Clause License
+ *
+ * Copyright (c) 2024, Northern Mechatronics, Inc.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its
+ *    contributors may be used to endorse or promote products derived from
+ *    this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+#include <pthread.h>
+#include <sched.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <LmHandler.h>
+
+#include "lorawan_downlink_ring.h"
+
+//
+// Host test of the downlink ring: a producer and a consumer thread run the
+// ring the way the LoRaWAN task and the application task do.  Every
+// downlink carries its sequence number in the frame counter and a payload
+// and metadata derived from it, so the consumer can tell a reordered, lost
+// or torn slot apart.  Exits non-zero on the first failure.
+//
+
+#define TEST_SLOTS     (8)
+#define TEST_DOWNLINKS (2000000)
+
+static lorawan_downlink_t test_slots[TEST_SLOTS];
+static lorawan_downlink_ring_t test_ring;
+
+// Sequence numbers the producer got into the ring.  Written before the
+// commit, so the consumer sees them once it sees the slot.
+static uint8_t test_accepted[TEST_DOWNLINKS];
+static uint32_t test_dropped;
+static uint32_t test_refused;
+static bool test_produced;
+
+static uint32_t test_failures;
+
+#define TEST_CHECK(x)                                                                              \
+    do                                                                                             \
+    {                                                                                              \
+        if (!(x))                                                                                  \
+        {                                                                                          \
+            printf("%s:%d: check failed: %s\n", __FILE__, __LINE__, #x);                           \
+            test_failures++;                                                                       \
+        }                                                                                          \
+    } while (0)
+
+static uint32_t test_size(uint32_t ui32Sequence)
+{
+    return 1 + (ui32Sequence * 7) % LORAWAN_DOWNLINK_PAYLOAD_MAX;
+}
+
+static uint8_t test_byte(uint32_t ui32Sequence, uint32_t ui32Offset)
+{
+    return (uint8_t)(ui32Sequence * 31 + ui32Offset);
+}
+
+static bool test_push(uint32_t ui32Sequence)
+{
+    uint8_t pui8Buffer[LORAWAN_DOWNLINK_PAYLOAD_MAX];
+    LmHandlerAppData_t sData;
+    LmHandlerRxParams_t sParams;
+
+    memset(&sParams, 0, sizeof(sParams));
+    sData.Port = 1 + ui32Sequence % 223;
+    sData.BufferSize = test_size(ui32Sequence);
+    sData.Buffer = pui8Buffer;
+    for (uint32_t i = 0; i < sData.BufferSize; i++)
+    {
+        pui8Buffer[i] = test_byte(ui32Sequence, i);
+    }
+    sParams.DownlinkCounter = ui32Sequence;
+    sParams.Rssi = -(int16_t)(ui32Sequence % 120);
+    sParams.Snr = (int8_t)(ui32Sequence % 20);
+    sParams.Datarate = ui32Sequence % 8;
+
+    return lorawan_downlink_ring_push(&test_ring, &sData, &sParams);
+}
+
+static bool test_verify(const lorawan_downlink_t *psDownlink, uint32_t ui32Sequence)
+{
+    if ((psDownlink->ui32Counter != ui32Sequence) ||
+        (psDownlink->ui32Port != 1 + ui32Sequence % 223) ||
+        (psDownlink->i32Rssi != -(int32_t)(ui32Sequence % 120)) ||
+        (psDownlink->i32Snr != (int32_t)(ui32Sequence % 20)) ||
+        (psDownlink->i32Datarate != (int32_t)(ui32Sequence % 8)) ||
+        (psDownlink->ui32Size != test_size(ui32Sequence)))
+    {
+        return false;
+    }
+
+    for (uint32_t i = 0; i < psDownlink->ui32Size; i++)
+    {
+        if (psDownlink->pui8Payload[i] != test_byte(ui32Sequence, i))
+        {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+static void *test_producer(void *pvParameters)
+{
+    for (uint32_t i = 0; i < TEST_DOWNLINKS; i++)
+    {
+        // Mark the downlink accepted ahead of the push, the commit inside
+        // publishes the mark together with the slot.
+        // Alternate between bursts that wait for a free slot, so that
+        // every downlink goes through, and bursts that drop on overflow.
+        bool bWait = (i / 4096) & 1;
+
+        __atomic_store_n(&test_accepted[i], 1, __ATOMIC_RELAXED);
+        while (!test_push(i))
+        {
+            test_refused++;
+            if (!bWait)
+            {
+                __atomic_store_n(&test_accepted[i], 0, __ATOMIC_RELAXED);
+                test_dropped++;
+                break;
+            }
+            sched_yield();
+        }
+
+        // Leave the consumer room now and then so that both the full and
+        // the partly full ring are exercised.
+        if ((i & 0xFF) == 0)
+        {
+            sched_yield();
+        }
+    }
+
+    __atomic_store_n(&test_produced, true, __ATOMIC_RELEASE);
+
+    return NULL;
+}
+
+static void test_concurrent(void)
+{
+    pthread_t sProducer;
+    uint32_t ui32Received = 0;
+    uint32_t ui32Expected = 0;
+
+    lorawan_downlink_ring_init(&test_ring, test_slots, TEST_SLOTS);
+    memset(test_accepted, 0, sizeof(test_accepted));
+    test_dropped = 0;
+    test_refused = 0;
+    test_produced = false;
+
+    pthread_create(&sProducer, NULL, test_producer, NULL);
+
+    while (1)
+    {
+        // Once the producer is done, an empty ring stays empty.
+        bool bProduced = __atomic_load_n(&test_produced, __ATOMIC_ACQUIRE);
+        lorawan_downlink_t *psDownlink = lorawan_downlink_ring_peek(&test_ring);
+        if (psDownlink == NULL)
+        {
+            if (bProduced)
+            {
+                break;
+            }
+            sched_yield();
+            continue;
+        }
+
+        // The next downlink must be the oldest one accepted after the
+        // previous, anything else is a reordered or lost slot.
+        while ((ui32Expected < TEST_DOWNLINKS) &&
+               !__atomic_load_n(&test_accepted[ui32Expected], __ATOMIC_RELAXED))
+        {
+            ui32Expected++;
+        }
+
+        // Report and resynchronize, the producer may be waiting for room.
+        if ((ui32Expected >= TEST_DOWNLINKS) || !test_verify(psDownlink, ui32Expected))
+        {
+            printf("downlink %u: got counter %u size %u\n",
+                   ui32Expected,
+                   psDownlink->ui32Counter,
+                   psDownlink->ui32Size);
+            test_failures++;
+            ui32Expected = psDownlink->ui32Counter;
+        }
+
+        lorawan_downlink_ring_release(&test_ring);
+        ui32Received++;
+        ui32Expected++;
+    }
+
+    pthread_join(sProducer, NULL);
+
+    lorawan_downlink_ring_stats_t sStats;
+    lorawan_downlink_ring_stats_get(&test_ring, &sStats);
+
+    TEST_CHECK(sStats.ui32Received == TEST_DOWNLINKS - test_dropped);
+    TEST_CHECK(sStats.ui32Overflows == test_refused);
+    TEST_CHECK(sStats.ui32Consumed == ui32Received);
+    TEST_CHECK(ui32Received == TEST_DOWNLINKS - test_dropped);
+    TEST_CHECK(sStats.ui32HighWater <= TEST_SLOTS);
+    TEST_CHECK(lorawan_downlink_ring_count(&test_ring) == 0);
+
+    printf("concurrent: %u downlinks, %u received, %u dropped, %u overflows, high water %u\n",
+           TEST_DOWNLINKS,
+           ui32Received,
+           test_dropped,
+           sStats.ui32Overflows,
+           sStats.ui32HighWater);
+}
+
+static void test_overflow(void)
+{
+    lorawan_downlink_ring_init(&test_ring, test_slots, TEST_SLOTS);
+
+    // A burst twice the ring size with a stalled consumer keeps the
+    // oldest downlinks and counts each one turned away.
+    for (uint32_t i = 0; i < 2 * TEST_SLOTS; i++)
+    {
+        TEST_CHECK(test_push(i) == (i < TEST_SLOTS));
+    }
+
+    LmHandlerAppData_t sData = {.Port = 1, .BufferSize = LORAWAN_DOWNLINK_PAYLOAD_MAX + 1};
+    LmHandlerRxParams_t sParams = {0};
+    TEST_CHECK(!lorawan_downlink_ring_push(&test_ring, &sData, &sParams));
+
+    lorawan_downlink_ring_stats_t sStats;
+    lorawan_downlink_ring_stats_get(&test_ring, &sStats);
+    TEST_CHECK(sStats.ui32Received == TEST_SLOTS);
+    TEST_CHECK(sStats.ui32Overflows == TEST_SLOTS);
+    TEST_CHECK(sStats.ui32Oversize == 1);
+    TEST_CHECK(sStats.ui32HighWater == TEST_SLOTS);
+    TEST_CHECK(lorawan_downlink_ring_count(&test_ring) == TEST_SLOTS);
+
+    for (uint32_t i = 0; i < TEST_SLOTS; i++)
+    {
+        lorawan_downlink_t *psDownlink = lorawan_downlink_ring_peek(&test_ring);
+        TEST_CHECK((psDownlink != NULL) && test_verify(psDownlink, i));
+        lorawan_downlink_ring_release(&test_ring);
+    }
+    TEST_CHECK(lorawan_downlink_ring_peek(&test_ring) == NULL);
+
+    // Room again once the consumer caught up.
+    TEST_CHECK(test_push(2 * TEST_SLOTS));
+
+    lorawan_downlink_ring_t sRing;
+    TEST_CHECK(lorawan_downlink_ring_init(&sRing, test_slots, 6) == -1);
+
+    printf("overflow: %u failures\n", test_failures);
+}
+
+int main(int argc, char **argv)
+{
+    test_overflow();
+    test_concurrent();
+
+    printf("%s\n", test_failures ? "FAIL" : "PASS");
+
+    return test_failures ? EXIT_FAILURE : EXIT_SUCCESS;
+}
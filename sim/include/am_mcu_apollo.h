@@ -0,0 +1,80 @@
+/*
+ * BSD 3-Clause License
+ *
+ * Copyright (c) 2024, Northern Mechatronics, Inc.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its
+ *    contributors may be used to endorse or promote products derived from
+ *    this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+#ifndef _SIM_AM_MCU_APOLLO_H_
+#define _SIM_AM_MCU_APOLLO_H_
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include <FreeRTOS.h>
+#include <task.h>
+
+//
+// Host replacement for the subset of the Apollo3 HAL used by the LoRaWAN
+// task and its helpers.  Interrupts are emulated by the simulation task with
+// the scheduler suspended, so a critical section maps onto the kernel one.
+//
+#define AM_HAL_STATUS_SUCCESS       0
+
+#define AM_HAL_SYSCTRL_WAKE         0
+#define AM_HAL_SYSCTRL_NORMALSLEEP  1
+#define AM_HAL_SYSCTRL_DEEPSLEEP    2
+
+#define AM_HAL_SYSCTRL_SLEEP_NORMAL 0
+#define AM_HAL_SYSCTRL_SLEEP_DEEP   1
+
+#define AM_HAL_FLASH_PAGE_SIZE      (8 * 1024)
+#define AM_HAL_FLASH_PROGRAM_KEY    0x12344321
+
+#define AM_CRITICAL_BEGIN                                                                          \
+    if (1)                                                                                         \
+    {                                                                                              \
+        taskENTER_CRITICAL();
+
+#define AM_CRITICAL_END                                                                            \
+        taskEXIT_CRITICAL();                                                                       \
+    }
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+extern uint32_t am_hal_iom_power_ctrl(void *pHandle, uint32_t ePowerState, bool bRetainState);
+extern uint32_t am_hal_stimer_counter_get(void);
+
+extern BaseType_t xPortIsInsideInterrupt(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,196 @@
+/*
+ * BSD 3-Clause License
+ *
+ * Copyright (c) 2024, Northern Mechatronics, Inc.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its
+ *    contributors may be used to endorse or promote products derived from
+ *    this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <am_mcu_apollo.h>
+#include <am_util.h>
+
+#include <FreeRTOS.h>
+#include <task.h>
+
+#include <board.h>
+#include <delay-board.h>
+#include <eeprom-board.h>
+#include <utilities.h>
+
+#include "lorawan.h"
+#include "lorawan_task.h"
+
+#include "sim_board.h"
+
+// Size of the emulated EEPROM holding the LoRaMac NVM context
+#define SIM_BOARD_EEPROM_SIZE (8192)
+
+void *SX126xHandle;
+
+static uint32_t sim_board_seed = 1;
+static uint8_t sim_board_eeprom[SIM_BOARD_EEPROM_SIZE];
+static uint8_t sim_board_eeprom_address;
+
+void sim_board_seed_set(uint32_t ui32Seed)
+{
+    sim_board_seed = ui32Seed;
+}
+
+//
+// board.h
+//
+void BoardInitMcu(void)
+{
+}
+
+void BoardInitPeriph(void)
+{
+}
+
+void BoardDeInitMcu(void)
+{
+}
+
+void BoardResetMcu(void)
+{
+    exit(0);
+}
+
+void BoardLowPowerHandler(void)
+{
+}
+
+uint32_t BoardGetRandomSeed(void)
+{
+    return sim_board_seed;
+}
+
+void BoardGetUniqueId(uint8_t *id)
+{
+    for (int i = 0; i < 8; i++)
+    {
+        id[i] = (uint8_t)(sim_board_seed >> ((i & 3) * 8)) ^ (uint8_t)(0xA5 + i);
+    }
+}
+
+uint8_t BoardGetBatteryLevel(void)
+{
+    // LoRaWAN DevStatusAns: 254 is the maximum battery level
+    return 254;
+}
+
+uint16_t BoardGetBatteryVoltage(void)
+{
+    return 3300;
+}
+
+int16_t BoardGetTemperature(void)
+{
+    return 25;
+}
+
+void BoardCriticalSectionBegin(uint32_t *mask)
+{
+    taskENTER_CRITICAL();
+}
+
+void BoardCriticalSectionEnd(uint32_t *mask)
+{
+    taskEXIT_CRITICAL();
+}
+
+//
+// delay-board.h
+//
+void DelayMsMcu(uint32_t ms)
+{
+}
+
+//
+// eeprom-board.h
+//
+LmnStatus_t EepromMcuWriteBuffer(uint16_t addr, uint8_t *buffer, uint16_t size)
+{
+    if ((uint32_t)addr + size > SIM_BOARD_EEPROM_SIZE)
+    {
+        return LMN_STATUS_ERROR;
+    }
+
+    memcpy(&sim_board_eeprom[addr], buffer, size);
+    return LMN_STATUS_OK;
+}
+
+LmnStatus_t EepromMcuReadBuffer(uint16_t addr, uint8_t *buffer, uint16_t size)
+{
+    if ((uint32_t)addr + size > SIM_BOARD_EEPROM_SIZE)
+    {
+        return LMN_STATUS_ERROR;
+    }
+
+    memcpy(buffer, &sim_board_eeprom[addr], size);
+    return LMN_STATUS_OK;
+}
+
+void EepromMcuSetDeviceAddr(uint8_t addr)
+{
+    sim_board_eeprom_address = addr;
+}
+
+LmnStatus_t EepromMcuGetDeviceAddr(void)
+{
+    return sim_board_eeprom_address;
+}
+
+//
+// Apollo3 HAL and utilities
+//
+uint32_t am_hal_iom_power_ctrl(void *pHandle, uint32_t ePowerState, bool bRetainState)
+{
+    return AM_HAL_STATUS_SUCCESS;
+}
+
+uint32_t am_util_id_device(am_util_id_t *psIDDevice)
+{
+    psIDDevice->sMcuCtrlDevice.ui32ChipID0 = sim_board_seed;
+    psIDDevice->sMcuCtrlDevice.ui32ChipID1 = 0x51AD0000 | (sim_board_seed >> 16);
+    return 0;
+}
+
+void am_util_delay_ms(uint32_t ui32MilliSeconds)
+{
+}
+
+//
+// Application layer hooks that are board specific on the target
+//
+void lorawan_task_cli_register()
+{
+}
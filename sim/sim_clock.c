@@ -0,0 +1,259 @@
+/*
+ * BSD 3-Clause License
+ *
+ * Copyright (c) 2024, Northern Mechatronics, Inc.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its
+ *    contributors may be used to endorse or promote products derived from
+ *    this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+#include <signal.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+#include <am_mcu_apollo.h>
+
+#include <FreeRTOS.h>
+#include <task.h>
+
+#include <board.h>
+#include <rtc-board.h>
+#include <timer.h>
+
+#include "sim_clock.h"
+
+#define SIM_CLOCK_STIMER_HZ (32768)
+
+extern void lorawan_wake_on_timer_irq();
+
+static volatile uint64_t sim_clock_time;
+static uint64_t sim_clock_context;
+static uint64_t sim_clock_alarm;
+static bool sim_clock_alarm_armed;
+static uint32_t sim_clock_backup[2];
+static volatile uint32_t sim_irq_nesting;
+
+// Virtual milliseconds not yet credited to the kernel tick.
+static uint64_t sim_clock_ticks_pending;
+
+// Set by traceTASK_SWITCHED_IN, see FreeRTOSConfig.h.
+const volatile void *sim_clock_unblock;
+
+static void sim_clock_ticks_flush()
+{
+    if ((sim_clock_ticks_pending == 0) ||
+        (xTaskGetSchedulerState() != taskSCHEDULER_RUNNING))
+    {
+        return;
+    }
+
+    // Tasks unblocked by the ticks, the timer service first, run before
+    // this returns.
+    TickType_t xTicks = (TickType_t)sim_clock_ticks_pending;
+    sim_clock_ticks_pending = 0;
+    xTaskCatchUpTicks(xTicks);
+}
+
+void sim_clock_tick_attach()
+{
+    // The POSIX port raises the tick with SIGALRM on wall time, from here
+    // on the tick only moves with the virtual clock.
+    signal(SIGALRM, SIG_IGN);
+    sim_clock_ticks_pending = 0;
+}
+
+bool sim_clock_tick_event_get(uint64_t *pui64Time)
+{
+    if (sim_clock_unblock == NULL)
+    {
+        return false;
+    }
+
+    TickType_t xNext = *(const volatile TickType_t *)sim_clock_unblock;
+    if (xNext == portMAX_DELAY)
+    {
+        return false;
+    }
+
+    TickType_t xNow = xTaskGetTickCount() + (TickType_t)sim_clock_ticks_pending;
+    TickType_t xWait = xNext - xNow;
+    if (xWait > (portMAX_DELAY / 2))
+    {
+        // due, its tick is being processed
+        xWait = 0;
+    }
+
+    *pui64Time = sim_clock_time + xWait;
+    return true;
+}
+
+uint64_t sim_clock_now()
+{
+    return sim_clock_time;
+}
+
+void sim_clock_advance(uint64_t ui64Time)
+{
+    if (ui64Time > sim_clock_time)
+    {
+        sim_clock_ticks_pending += ui64Time - sim_clock_time;
+        sim_clock_time = ui64Time;
+    }
+
+    if (sim_irq_nesting == 0)
+    {
+        sim_clock_ticks_flush();
+    }
+}
+
+bool sim_clock_alarm_get(uint64_t *pui64Time)
+{
+    *pui64Time = sim_clock_alarm;
+    return sim_clock_alarm_armed;
+}
+
+void sim_clock_alarm_fire()
+{
+    sim_clock_alarm_armed = false;
+    TimerIrqHandler();
+    lorawan_wake_on_timer_irq();
+}
+
+void sim_irq_enter()
+{
+    vTaskSuspendAll();
+    sim_irq_nesting++;
+}
+
+void sim_irq_exit()
+{
+    sim_irq_nesting--;
+    xTaskResumeAll();
+    if (sim_irq_nesting == 0)
+    {
+        sim_clock_ticks_flush();
+    }
+}
+
+BaseType_t xPortIsInsideInterrupt(void)
+{
+    return sim_irq_nesting ? pdTRUE : pdFALSE;
+}
+
+uint32_t am_hal_stimer_counter_get(void)
+{
+    return (uint32_t)((sim_clock_time * SIM_CLOCK_STIMER_HZ) / 1000);
+}
+
+//
+// rtc-board.h implementation on top of the virtual clock.
+//
+void RtcInit(void)
+{
+}
+
+uint32_t RtcGetMinimumTimeout(void)
+{
+    return 1;
+}
+
+uint32_t RtcMs2Tick(TimerTime_t milliseconds)
+{
+    return milliseconds;
+}
+
+TimerTime_t RtcTick2Ms(uint32_t tick)
+{
+    return tick;
+}
+
+void RtcDelayMs(TimerTime_t milliseconds)
+{
+    sim_clock_advance(sim_clock_time + milliseconds);
+}
+
+void RtcSetAlarm(uint32_t timeout)
+{
+    RtcStartAlarm(timeout);
+}
+
+void RtcStopAlarm(void)
+{
+    sim_clock_alarm_armed = false;
+}
+
+void RtcStartAlarm(uint32_t timeout)
+{
+    sim_clock_alarm = sim_clock_context + timeout;
+    sim_clock_alarm_armed = true;
+}
+
+uint32_t RtcSetTimerContext(void)
+{
+    sim_clock_context = sim_clock_time;
+    return (uint32_t)sim_clock_context;
+}
+
+uint32_t RtcGetTimerContext(void)
+{
+    return (uint32_t)sim_clock_context;
+}
+
+uint32_t RtcGetCalendarTime(uint16_t *milliseconds)
+{
+    *milliseconds = (uint16_t)(sim_clock_time % 1000);
+    return (uint32_t)(sim_clock_time / 1000);
+}
+
+uint32_t RtcGetTimerValue(void)
+{
+    return (uint32_t)sim_clock_time;
+}
+
+uint32_t RtcGetTimerElapsedTime(void)
+{
+    return (uint32_t)(sim_clock_time - sim_clock_context);
+}
+
+void RtcBkupWrite(uint32_t data0, uint32_t data1)
+{
+    sim_clock_backup[0] = data0;
+    sim_clock_backup[1] = data1;
+}
+
+void RtcBkupRead(uint32_t *data0, uint32_t *data1)
+{
+    *data0 = sim_clock_backup[0];
+    *data1 = sim_clock_backup[1];
+}
+
+void RtcProcess(void)
+{
+}
+
+TimerTime_t RtcTempCompensation(TimerTime_t period, float temperature)
+{
+    return period;
+}
@@ -0,0 +1,114 @@
+/*
+ * BSD 3-Clause License
+ *
+ * Copyright (c) 2024, Northern Mechatronics, Inc.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its
+ *    contributors may be used to endorse or promote products derived from
+ *    this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+#ifndef _SIM_CLOCK_H_
+#define _SIM_CLOCK_H_
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief Current virtual time in milliseconds.
+ *
+ * @remarks
+ * The virtual clock only moves when the simulation advances it.  One RTC
+ * tick of the LoRaMac timer driver is one virtual millisecond.
+ */
+extern uint64_t sim_clock_now();
+
+/**
+ * @brief Move the virtual clock forward.
+ *
+ * @param ui64Time absolute virtual time in milliseconds.  Times in the past
+ *                 are ignored.
+ */
+extern void sim_clock_advance(uint64_t ui64Time);
+
+/**
+ * @brief Drive the FreeRTOS tick from the virtual clock.
+ *
+ * @remarks
+ * Stops the wall clock tick of the POSIX port.  From then on every virtual
+ * millisecond the clock advances is one kernel tick, so that the software
+ * timers and the tick count follow the same clock as the LoRaMac timers.
+ * Called once from the simulation task.
+ */
+extern void sim_clock_tick_attach();
+
+/**
+ * @brief Virtual time at which the kernel next unblocks a task.
+ *
+ * @param pui64Time returns the time in milliseconds.
+ *
+ * @return true if a task, e.g. the timer service for its next software
+ *         timer, is blocked with a timeout.
+ */
+extern bool sim_clock_tick_event_get(uint64_t *pui64Time);
+
+/**
+ * @brief Virtual time at which the LoRaMac timer alarm expires.
+ *
+ * @param pui64Time returns the alarm time in milliseconds.
+ *
+ * @return true if an alarm is armed.
+ */
+extern bool sim_clock_alarm_get(uint64_t *pui64Time);
+
+/**
+ * @brief Expire the LoRaMac timer alarm.
+ *
+ * @remarks
+ * Runs the timer interrupt handler and wakes the LoRaWAN task in the
+ * same way as the RTC interrupt on the target.  Must be called from
+ * within sim_irq_enter() / sim_irq_exit().
+ */
+extern void sim_clock_alarm_fire();
+
+/**
+ * @brief Enter an emulated interrupt context.
+ *
+ * @remarks
+ * The scheduler is suspended so that tasks woken by the handler only run
+ * once the handler returns, matching the behaviour of a hardware
+ * interrupt preempting the simulation task.
+ */
+extern void sim_irq_enter();
+extern void sim_irq_exit();
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,215 @@
+/*
+ * BSD 3-Clause License
+ *
+ * Copyright (c) 2024, Northern Mechatronics, Inc.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its
+ *    contributors may be used to endorse or promote products derived from
+ *    this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+#include <fcntl.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "ota_config.h"
+
+#include "lorawan_flash.h"
+
+#include "sim_clock.h"
+#include "sim_flash.h"
+
+#define SIM_FLASH_PAGE_SIZE (8 * 1024)
+
+static int32_t sim_flash_program(uint32_t ui32Offset,
+                                 const uint32_t *pui32Data,
+                                 uint32_t ui32Words,
+                                 uint32_t *pui32Time);
+static int32_t sim_flash_erase(uint32_t ui32Page, uint32_t *pui32Time);
+static int32_t sim_flash_read(uint32_t ui32Offset, uint8_t *pui8Data, uint32_t ui32Size);
+
+static lorawan_flash_t sim_flash = {
+    OTA_FLASH_MAX_SIZE,
+    SIM_FLASH_PAGE_SIZE,
+    NULL,
+    sim_flash_program,
+    sim_flash_erase,
+    sim_flash_read,
+};
+
+static uint8_t *sim_flash_memory;
+static sim_flash_stats_t sim_flash_stats;
+
+static void sim_flash_account(uint32_t ui32Time)
+{
+    uint64_t ui64Now = sim_clock_now();
+
+    if (sim_flash_stats.ui32Programs + sim_flash_stats.ui32Erases == 0)
+    {
+        sim_flash_stats.ui64First = ui64Now;
+    }
+    sim_flash_stats.ui64Last = ui64Now;
+    sim_flash_stats.ui64Busy += ui32Time;
+}
+
+static int32_t sim_flash_program(uint32_t ui32Offset,
+                                 const uint32_t *pui32Data,
+                                 uint32_t ui32Words,
+                                 uint32_t *pui32Time)
+{
+    if ((ui32Offset & 3) || (ui32Offset > sim_flash.ui32Size) ||
+        (ui32Words > (sim_flash.ui32Size - ui32Offset) / 4))
+    {
+        return -1;
+    }
+
+    uint32_t *pui32Flash = (uint32_t *)(sim_flash_memory + ui32Offset);
+    for (uint32_t i = 0; i < ui32Words; i++)
+    {
+        if (~pui32Flash[i] & pui32Data[i])
+        {
+            sim_flash_stats.ui32Corrupted++;
+        }
+        pui32Flash[i] &= pui32Data[i];
+    }
+
+    *pui32Time = SIM_FLASH_PROGRAM_SETUP_US + ui32Words * SIM_FLASH_PROGRAM_WORD_US;
+    sim_flash_account(*pui32Time);
+    sim_flash_stats.ui32Programs++;
+    sim_flash_stats.ui32Words += ui32Words;
+
+    return 0;
+}
+
+static int32_t sim_flash_erase(uint32_t ui32Page, uint32_t *pui32Time)
+{
+    if (ui32Page >= sim_flash.ui32Size / sim_flash.ui32PageSize)
+    {
+        return -1;
+    }
+
+    memset(sim_flash_memory + ui32Page * sim_flash.ui32PageSize, 0xFF, sim_flash.ui32PageSize);
+
+    *pui32Time = SIM_FLASH_ERASE_US;
+    sim_flash_account(*pui32Time);
+    sim_flash_stats.ui32Erases++;
+
+    return 0;
+}
+
+static int32_t sim_flash_read(uint32_t ui32Offset, uint8_t *pui8Data, uint32_t ui32Size)
+{
+    if ((ui32Offset > sim_flash.ui32Size) || (ui32Size > sim_flash.ui32Size - ui32Offset))
+    {
+        return -1;
+    }
+
+    memcpy(pui8Data, sim_flash_memory + ui32Offset, ui32Size);
+    return 0;
+}
+
+bool sim_flash_open(const char *pcPath)
+{
+    void *pvMemory;
+
+    if (pcPath == NULL)
+    {
+        pvMemory = mmap(NULL,
+                        sim_flash.ui32Size,
+                        PROT_READ | PROT_WRITE,
+                        MAP_PRIVATE | MAP_ANONYMOUS,
+                        -1,
+                        0);
+        if (pvMemory == MAP_FAILED)
+        {
+            return false;
+        }
+        memset(pvMemory, 0xFF, sim_flash.ui32Size);
+    }
+    else
+    {
+        int iFile = open(pcPath, O_RDWR | O_CREAT, 0644);
+        struct stat sStat;
+
+        if ((iFile < 0) || (fstat(iFile, &sStat) < 0))
+        {
+            if (iFile >= 0)
+            {
+                close(iFile);
+            }
+            return false;
+        }
+
+        // A new or short file is extended with erased pages.
+        if (sStat.st_size < sim_flash.ui32Size)
+        {
+            uint8_t pui8Erased[SIM_FLASH_PAGE_SIZE];
+            off_t iSize = sStat.st_size;
+
+            memset(pui8Erased, 0xFF, sizeof(pui8Erased));
+
+            while (iSize < sim_flash.ui32Size)
+            {
+                size_t iLength = sim_flash.ui32Size - iSize;
+                if (iLength > sizeof(pui8Erased))
+                {
+                    iLength = sizeof(pui8Erased);
+                }
+                if (pwrite(iFile, pui8Erased, iLength, iSize) != (ssize_t)iLength)
+                {
+                    close(iFile);
+                    return false;
+                }
+                iSize += iLength;
+            }
+        }
+
+        pvMemory = mmap(NULL, sim_flash.ui32Size, PROT_READ | PROT_WRITE, MAP_SHARED, iFile, 0);
+        close(iFile);
+        if (pvMemory == MAP_FAILED)
+        {
+            return false;
+        }
+    }
+
+    sim_flash_memory = pvMemory;
+    sim_flash.pui8Base = sim_flash_memory;
+    memset(&sim_flash_stats, 0, sizeof(sim_flash_stats));
+
+    return true;
+}
+
+void sim_flash_stats_get(sim_flash_stats_t *psStats)
+{
+    memcpy(psStats, &sim_flash_stats, sizeof(sim_flash_stats_t));
+}
+
+const lorawan_flash_t *lorawan_flash_ota(void)
+{
+    return &sim_flash;
+}
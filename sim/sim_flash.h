@@ -0,0 +1,94 @@
+/*
+ * BSD 3-Clause License
+ *
+ * Copyright (c) 2024, Northern Mechatronics, Inc.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its
+ *    contributors may be used to endorse or promote products derived from
+ *    this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+#ifndef _SIM_FLASH_H_
+#define _SIM_FLASH_H_
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief Timing model of the OTA flash, in us.
+ *
+ * @remarks
+ * Placeholder figures for the Apollo3 flash.  Calibrate them against the
+ * program and erase times `lorawan frag` reports on the target.
+ */
+#ifndef SIM_FLASH_PROGRAM_SETUP_US
+#define SIM_FLASH_PROGRAM_SETUP_US (10)
+#endif
+
+#ifndef SIM_FLASH_PROGRAM_WORD_US
+#define SIM_FLASH_PROGRAM_WORD_US (20)
+#endif
+
+#ifndef SIM_FLASH_ERASE_US
+#define SIM_FLASH_ERASE_US (15000)
+#endif
+
+typedef struct
+{
+    uint32_t ui32Programs;
+    uint32_t ui32Words;      ///< words programmed
+    uint32_t ui32Erases;     ///< pages erased
+    uint32_t ui32Corrupted;  ///< words programmed over bits already cleared
+    uint64_t ui64Busy;       ///< modeled flash busy time in us
+    uint64_t ui64First;      ///< virtual ms of the first operation
+    uint64_t ui64Last;       ///< virtual ms of the last operation
+} sim_flash_stats_t;
+
+/**
+ * @brief Back the OTA region of lorawan_flash.h with a file.
+ *
+ * @param pcPath file mapped as the region, created or extended with 0xFF
+ *               as needed so that its contents persist between runs like
+ *               the flash of a device.  NULL maps anonymous memory that
+ *               starts erased.
+ *
+ * @return false if the file cannot be mapped.
+ *
+ * @remarks
+ * Programming clears bits like the flash does, so words programmed twice
+ * without an erase in between are counted as corrupted.
+ */
+extern bool sim_flash_open(const char *pcPath);
+
+extern void sim_flash_stats_get(sim_flash_stats_t *psStats);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,282 @@
+/*
+ * BSD 3-Clause License
+ *
+ * Copyright (c) 2024, Northern Mechatronics, Inc.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its
+ *    contributors may be used to endorse or promote products derived from
+ *    this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+#include <netdb.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <unistd.h>
+
+#include "sim_clock.h"
+#include "sim_link.h"
+#include "sim_radio.h"
+
+// Link protocol shared with tools/lns_emulator.py, all fields little
+// endian.  Every request is answered with zero or more downlinks followed
+// by one acknowledgement carrying the time of the next scheduled downlink.
+#define SIM_LINK_VERSION  (2)
+
+#define SIM_LINK_SYNC     (0x01)
+#define SIM_LINK_UPLINK   (0x02)
+#define SIM_LINK_END      (0x03)
+#define SIM_LINK_DOWNLINK (0x81)
+#define SIM_LINK_ACK      (0x82)
+
+#define SIM_LINK_HEADER_SIZE   (4)
+#define SIM_LINK_MESSAGE_SIZE  (SIM_LINK_HEADER_SIZE + 32 + SIM_RADIO_PAYLOAD_MAX_SIZE)
+#define SIM_LINK_NO_EVENT      (UINT64_MAX)
+
+// Real time to wait for an answer before giving up on the emulator.  It
+// holds the answer back until the other simulations sharing the channel
+// caught up.
+#define SIM_LINK_TIMEOUT_MS (30000)
+
+static int sim_link_socket = -1;
+static uint64_t sim_link_next = SIM_LINK_NO_EVENT;
+
+static uint8_t *sim_link_put(uint8_t *pui8Buffer, uint64_t ui64Value, uint32_t ui32Size)
+{
+    for (uint32_t i = 0; i < ui32Size; i++)
+    {
+        *pui8Buffer++ = (uint8_t)(ui64Value >> (8 * i));
+    }
+
+    return pui8Buffer;
+}
+
+static uint64_t sim_link_get(const uint8_t *pui8Buffer, uint32_t ui32Size)
+{
+    uint64_t ui64Value = 0;
+
+    for (uint32_t i = 0; i < ui32Size; i++)
+    {
+        ui64Value |= (uint64_t)pui8Buffer[i] << (8 * i);
+    }
+
+    return ui64Value;
+}
+
+static uint8_t *sim_link_header(uint8_t *pui8Buffer, uint8_t ui8Type)
+{
+    pui8Buffer = sim_link_put(pui8Buffer, ui8Type, 1);
+    pui8Buffer = sim_link_put(pui8Buffer, SIM_LINK_VERSION, 1);
+    return sim_link_put(pui8Buffer, 0, 2);
+}
+
+static void sim_link_downlink(const uint8_t *pui8Body, uint32_t ui32Size)
+{
+    sim_radio_frame_t sFrame;
+
+    if (ui32Size < 15)
+    {
+        return;
+    }
+
+    sFrame.ui64Start = sim_link_get(&pui8Body[0], 8);
+    sFrame.ui32Frequency = sim_link_get(&pui8Body[8], 4);
+    sFrame.ui32Datarate = pui8Body[12];
+    sFrame.ui32Bandwidth = pui8Body[13];
+    sFrame.ui32Size = pui8Body[14];
+
+    if ((sFrame.ui32Size > ui32Size - 15) || (sFrame.ui32Size > SIM_RADIO_PAYLOAD_MAX_SIZE))
+    {
+        return;
+    }
+    memcpy(sFrame.pui8Payload, &pui8Body[15], sFrame.ui32Size);
+
+    if (!sim_radio_downlink(&sFrame))
+    {
+        printf("link: downlink at %llu ms dropped, too many scheduled\n",
+               (unsigned long long)sFrame.ui64Start);
+    }
+}
+
+static bool sim_link_exchange(const uint8_t *pui8Request, uint32_t ui32Size)
+{
+    uint8_t pui8Message[SIM_LINK_MESSAGE_SIZE];
+
+    if (sim_link_socket < 0)
+    {
+        return false;
+    }
+
+    if (send(sim_link_socket, pui8Request, ui32Size, 0) != (ssize_t)ui32Size)
+    {
+        perror("link: send");
+        return false;
+    }
+
+    while (1)
+    {
+        ssize_t iSize = recv(sim_link_socket, pui8Message, sizeof(pui8Message), 0);
+        if (iSize < 0)
+        {
+            printf("link: no answer from the network emulator\n");
+            return false;
+        }
+
+        if ((iSize < SIM_LINK_HEADER_SIZE) || (pui8Message[1] != SIM_LINK_VERSION))
+        {
+            continue;
+        }
+
+        const uint8_t *pui8Body = &pui8Message[SIM_LINK_HEADER_SIZE];
+        uint32_t ui32Body = iSize - SIM_LINK_HEADER_SIZE;
+
+        switch (pui8Message[0])
+        {
+        case SIM_LINK_DOWNLINK:
+            sim_link_downlink(pui8Body, ui32Body);
+            break;
+
+        case SIM_LINK_ACK:
+            sim_link_next = (ui32Body >= 8) ? sim_link_get(pui8Body, 8) : SIM_LINK_NO_EVENT;
+            return true;
+
+        default:
+            break;
+        }
+    }
+}
+
+bool sim_link_open(const char *pcAddress)
+{
+    char pcHost[128];
+    const char *pcPort = strrchr(pcAddress, ':');
+    struct addrinfo sHints = {
+        .ai_family = AF_UNSPEC,
+        .ai_socktype = SOCK_DGRAM,
+    };
+    struct addrinfo *psResult;
+
+    if ((pcPort == NULL) || ((size_t)(pcPort - pcAddress) >= sizeof(pcHost)))
+    {
+        return false;
+    }
+
+    memcpy(pcHost, pcAddress, pcPort - pcAddress);
+    pcHost[pcPort - pcAddress] = '\0';
+
+    if (getaddrinfo(pcHost, pcPort + 1, &sHints, &psResult) != 0)
+    {
+        return false;
+    }
+
+    sim_link_socket = socket(psResult->ai_family, psResult->ai_socktype, psResult->ai_protocol);
+    if ((sim_link_socket >= 0) &&
+        (connect(sim_link_socket, psResult->ai_addr, psResult->ai_addrlen) != 0))
+    {
+        close(sim_link_socket);
+        sim_link_socket = -1;
+    }
+    freeaddrinfo(psResult);
+
+    if (sim_link_socket < 0)
+    {
+        return false;
+    }
+
+    struct timeval sTimeout = {
+        .tv_sec = SIM_LINK_TIMEOUT_MS / 1000,
+        .tv_usec = (SIM_LINK_TIMEOUT_MS % 1000) * 1000,
+    };
+    setsockopt(sim_link_socket, SOL_SOCKET, SO_RCVTIMEO, &sTimeout, sizeof(sTimeout));
+
+    return true;
+}
+
+bool sim_link_is_open()
+{
+    return sim_link_socket >= 0;
+}
+
+void sim_link_close()
+{
+    uint8_t pui8Message[SIM_LINK_HEADER_SIZE];
+
+    if (sim_link_socket < 0)
+    {
+        return;
+    }
+
+    sim_link_header(pui8Message, SIM_LINK_END);
+    sim_link_exchange(pui8Message, sizeof(pui8Message));
+
+    close(sim_link_socket);
+    sim_link_socket = -1;
+}
+
+bool sim_link_uplink(const sim_radio_frame_t *psFrame, int16_t i16Rssi, int8_t i8Snr)
+{
+    uint8_t pui8Message[SIM_LINK_MESSAGE_SIZE];
+    uint8_t *pui8Cursor = sim_link_header(pui8Message, SIM_LINK_UPLINK);
+
+    pui8Cursor = sim_link_put(pui8Cursor, psFrame->ui64Start, 8);
+    pui8Cursor = sim_link_put(pui8Cursor, psFrame->ui64End, 8);
+    pui8Cursor = sim_link_put(pui8Cursor, psFrame->ui32Frequency, 4);
+    pui8Cursor = sim_link_put(pui8Cursor, psFrame->ui32Datarate, 1);
+    pui8Cursor = sim_link_put(pui8Cursor, psFrame->ui32Bandwidth, 1);
+    pui8Cursor = sim_link_put(pui8Cursor, (uint16_t)i16Rssi, 2);
+    pui8Cursor = sim_link_put(pui8Cursor, (uint8_t)i8Snr, 1);
+    pui8Cursor = sim_link_put(pui8Cursor, psFrame->ui32Size, 1);
+    memcpy(pui8Cursor, psFrame->pui8Payload, psFrame->ui32Size);
+    pui8Cursor += psFrame->ui32Size;
+
+    return sim_link_exchange(pui8Message, pui8Cursor - pui8Message);
+}
+
+bool sim_link_sync(uint64_t ui64Next)
+{
+    uint8_t pui8Message[SIM_LINK_HEADER_SIZE + 24];
+    uint8_t *pui8Cursor = sim_link_header(pui8Message, SIM_LINK_SYNC);
+    uint64_t ui64OnAir;
+
+    // the emulator decides the collisions with the frame on air once it ends
+    if (!sim_radio_tx_get(&ui64OnAir))
+    {
+        ui64OnAir = SIM_LINK_NO_EVENT;
+    }
+
+    pui8Cursor = sim_link_put(pui8Cursor, sim_clock_now(), 8);
+    pui8Cursor = sim_link_put(pui8Cursor, ui64Next, 8);
+    pui8Cursor = sim_link_put(pui8Cursor, ui64OnAir, 8);
+
+    return sim_link_exchange(pui8Message, pui8Cursor - pui8Message);
+}
+
+bool sim_link_event_get(uint64_t *pui64Time)
+{
+    *pui64Time = sim_link_next;
+    return (sim_link_socket >= 0) && (sim_link_next != SIM_LINK_NO_EVENT);
+}
@@ -0,0 +1,96 @@
+/*
+ * BSD 3-Clause License
+ *
+ * Copyright (c) 2024, Northern Mechatronics, Inc.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its
+ *    contributors may be used to endorse or promote products derived from
+ *    this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+#ifndef _SIM_LINK_H_
+#define _SIM_LINK_H_
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "sim_radio.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief Connect to a network server emulator (tools/lns_emulator.py).
+ *
+ * @param pcAddress "<host>:<port>" of the emulator, UDP.
+ *
+ * @return false if the address cannot be resolved or the socket cannot be
+ *         opened.
+ *
+ * @remarks
+ * Delivered uplinks are forwarded to the emulator and the downlinks it
+ * schedules are put on air with sim_radio_downlink().  Both sides work in
+ * virtual time; the emulator only answers requests, so a run is exactly
+ * reproducible.
+ */
+extern bool sim_link_open(const char *pcAddress);
+extern bool sim_link_is_open();
+extern void sim_link_close();
+
+/**
+ * @brief Forward an uplink that reached the network.
+ *
+ * @param psFrame frame as it was put on air.
+ * @param i16Rssi RSSI seen by the gateway (dBm).
+ * @param i8Snr   SNR seen by the gateway (dB).
+ */
+extern bool sim_link_uplink(const sim_radio_frame_t *psFrame, int16_t i16Rssi, int8_t i8Snr);
+
+/**
+ * @brief Collect the downlinks due before the next simulation event.
+ *
+ * @param ui64Next virtual time the simulation is about to advance to.
+ *
+ * @remarks
+ * Must be called before the virtual clock moves, so that downlinks in a
+ * receive window are scheduled before the window opens.  The emulator
+ * answers only once the other simulations sharing it reached the same
+ * virtual time.
+ */
+extern bool sim_link_sync(uint64_t ui64Next);
+
+/**
+ * @brief Virtual time at which the emulator has further downlinks to hand
+ * over.
+ *
+ * @return false if nothing is scheduled.
+ */
+extern bool sim_link_event_get(uint64_t *pui64Time);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
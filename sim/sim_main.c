@@ -0,0 +1,989 @@
+/*
+ * BSD 3-Clause License
+ *
+ * Copyright (c) 2024, Northern Mechatronics, Inc.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its
+ *    contributors may be used to endorse or promote products derived from
+ *    this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+#include <getopt.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <time.h>
+
+#include <FreeRTOS.h>
+#include <task.h>
+
+#include <LmHandler.h>
+#include <radio.h>
+
+#include "energy.h"
+#include "lorawan.h"
+#include "lorawan_downlink_ring.h"
+#include "lorawan_frag_store.h"
+#include "lorawan_latency.h"
+#include "lorawan_nvm.h"
+#include "lorawan_record.h"
+#include "lorawan_task.h"
+
+#include "sim_board.h"
+#include "sim_clock.h"
+#include "sim_flash.h"
+#include "sim_link.h"
+#include "sim_radio.h"
+#include "sim_replay.h"
+
+#define SIM_TASK_PRIORITY         (tskIDLE_PRIORITY + 1)
+#define SIM_LORAWAN_TASK_PRIORITY (5)
+
+#define SIM_UPLINK_PORT           (1)
+#define SIM_UPLINK_MAX_SIZE       (242)
+#define SIM_PENDING_MAX           (LORAWAN_TRANSMIT_QUEUE_MAX_SIZE + 2)
+#define SIM_RX_SLOTS              (4)
+
+// ABP session of the simulated device.  The network emulator uses the
+// same values.
+#define SIM_DEVICE_ADDRESS        (0x260B0001)
+#define SIM_NETWORK_ID            (0x000000)
+#define SIM_NWK_S_KEY             "2b7e151628aed2a6abf7158809cf4f3c"
+#define SIM_APP_S_KEY             "3c4fcf098815f7aba6d2ae2816157e2b"
+
+// OTAA credentials, the device index is appended to the DevEUI.
+#define SIM_JOIN_EUI              "70b3d57ed0000000"
+#define SIM_DEV_EUI_PREFIX        "00800000"
+#define SIM_APP_KEY               "2b7e151628aed2a6abf7158809cf4f3c"
+
+typedef struct
+{
+    uint32_t ui32Device; ///< index of the device in a fleet run
+    uint32_t ui32Uplinks;
+    uint32_t ui32Period; ///< ms between uplinks, 0 sends back to back
+    uint32_t ui32Size;
+    lorawan_region_e eRegion;
+    lorawan_datarate_e eDatarate;
+    uint32_t ui32Tracing;
+    uint32_t ui32Otaa;
+    uint32_t ui32Adr;
+    uint32_t ui32FastBoot;
+    uint32_t ui32Segmentation;
+    uint32_t ui32ClassC;
+    uint32_t ui32RxProcessing; ///< virtual ms the application spends per downlink
+    const char *pcNetwork; ///< "<host>:<port>" of tools/lns_emulator.py
+    const char *pcRecord;  ///< event recorder log written at the end of the run
+    const char *pcReplay;  ///< event recorder log replayed
+    const char *pcFlash;   ///< file backing the OTA flash region
+    sim_radio_config_t sRadio;
+} sim_options_t;
+
+typedef struct
+{
+    uint64_t ui64Enqueued;
+    uint64_t ui64Transmitted;
+} sim_pending_t;
+
+typedef struct
+{
+    const char *pcName;
+    lorawan_region_e eRegion;
+} sim_region_t;
+
+static const sim_region_t sim_regions[] = {
+    {"as923", LORAWAN_REGION_AS923},
+    {"au915", LORAWAN_REGION_AU915},
+    {"cn470", LORAWAN_REGION_CN470},
+    {"cn779", LORAWAN_REGION_CN779},
+    {"eu433", LORAWAN_REGION_EU433},
+    {"eu868", LORAWAN_REGION_EU868},
+    {"kr920", LORAWAN_REGION_KR920},
+    {"in865", LORAWAN_REGION_IN865},
+    {"us915", LORAWAN_REGION_US915},
+    {"ru864", LORAWAN_REGION_RU864},
+};
+
+static sim_options_t sim_options = {
+    .ui32Device = 0,
+    .ui32Uplinks = 100,
+    .ui32Period = 0,
+    .ui32Size = 16,
+    .eRegion = LORAWAN_REGION_US915,
+    .eDatarate = LORAWAN_DATARATE_3,
+    .ui32Tracing = 0,
+    .ui32Otaa = 0,
+    .ui32Adr = 0,
+    .ui32FastBoot = 0,
+    .ui32Segmentation = 0,
+    .ui32ClassC = 0,
+    .ui32RxProcessing = 0,
+    .pcNetwork = NULL,
+    .pcRecord = NULL,
+    .pcReplay = NULL,
+    .pcFlash = NULL,
+    .sRadio = {
+        .ui32Seed = 1,
+        .ui32UplinkLoss = 0,
+        .ui32DownlinkLoss = 0,
+        .i16Rssi = -60,
+        .i8Snr = 8,
+    },
+};
+
+static sim_pending_t sim_pending[SIM_PENDING_MAX];
+static uint32_t sim_pending_head;
+static uint32_t sim_pending_count;
+
+static uint32_t sim_uplinks_requested;
+static uint32_t sim_uplinks_completed;
+static uint32_t sim_uplinks_failed;
+static uint32_t sim_uplinks_delivered;
+static uint64_t sim_bytes_delivered;
+static uint64_t sim_uplink_next;
+
+static uint32_t *sim_latency_radio;
+static uint32_t *sim_latency_confirm;
+static uint32_t sim_latency_count;
+static uint32_t *sim_latency_downlink;
+static uint32_t sim_latency_downlink_count;
+
+// Downlinks handed to the application model, consumed one every
+// ui32RxProcessing virtual ms.
+static lorawan_downlink_t sim_rx_slots[SIM_RX_SLOTS];
+static lorawan_downlink_ring_t sim_rx_ring;
+static uint64_t sim_rx_done;
+static uint64_t sim_rx_free;
+static bool sim_rx_busy;
+
+static uint64_t sim_join_start;
+static uint64_t sim_join_time;
+static uint32_t sim_join_attempts;
+
+static struct timespec sim_wall_start;
+
+static sim_pending_t *sim_pending_front()
+{
+    return sim_pending_count ? &sim_pending[sim_pending_head] : NULL;
+}
+
+static void sim_pending_pop(bool bCompleted)
+{
+    sim_pending_t *psPending = sim_pending_front();
+    if (psPending == NULL)
+    {
+        return;
+    }
+
+    if (bCompleted && psPending->ui64Transmitted)
+    {
+        sim_latency_radio[sim_latency_count] =
+            (uint32_t)(psPending->ui64Transmitted - psPending->ui64Enqueued);
+        sim_latency_confirm[sim_latency_count] =
+            (uint32_t)(sim_clock_now() - psPending->ui64Enqueued);
+        sim_latency_count++;
+    }
+
+    sim_pending_head = (sim_pending_head + 1) % SIM_PENDING_MAX;
+    sim_pending_count--;
+}
+
+static void sim_on_uplink(const sim_radio_frame_t *psFrame, bool bDelivered)
+{
+    // The uplink in flight is always the oldest pending one.  Only the
+    // first transmission counts towards the latency.
+    sim_pending_t *psPending = sim_pending_front();
+    if (psPending && (psPending->ui64Transmitted == 0))
+    {
+        psPending->ui64Transmitted = psFrame->ui64End;
+    }
+
+    if (bDelivered)
+    {
+        sim_uplinks_delivered++;
+        sim_bytes_delivered += psFrame->ui32Size;
+
+        if (sim_link_is_open() &&
+            !sim_link_uplink(psFrame, sim_options.sRadio.i16Rssi, sim_options.sRadio.i8Snr))
+        {
+            sim_link_close();
+        }
+    }
+}
+
+static void sim_on_join_request(LmHandlerJoinParams_t *psParams)
+{
+    // The LoRaWAN task schedules the retry.
+    if (psParams->Status == LORAMAC_HANDLER_ERROR)
+    {
+        sim_join_attempts++;
+        return;
+    }
+
+    sim_join_time = sim_clock_now() - sim_join_start;
+    sim_uplink_next = sim_clock_now();
+
+    // the commands of the recorded application are in the log
+    if (sim_replay_active())
+    {
+        return;
+    }
+
+    if (sim_options.ui32ClassC)
+    {
+        lorawan_class_set(LORAWAN_CLASS_C);
+    }
+
+    if (sim_link_is_open())
+    {
+        lorawan_request_time_sync();
+    }
+}
+
+static void sim_on_rx_data(LmHandlerAppData_t *psAppData, LmHandlerRxParams_t *psParams)
+{
+    if ((psAppData == NULL) || (psAppData->Port == 0))
+    {
+        return;
+    }
+    lorawan_downlink_ring_push(&sim_rx_ring, psAppData, psParams);
+
+    // round trip of an application downlink answering the uplink in
+    // flight, e.g. the emulator in echo mode
+    sim_pending_t *psPending = sim_pending_front();
+    if ((psAppData->Port == SIM_UPLINK_PORT) && psPending && psPending->ui64Transmitted)
+    {
+        sim_latency_downlink[sim_latency_downlink_count++] =
+            (uint32_t)(sim_clock_now() - psPending->ui64Enqueued);
+    }
+}
+
+static void sim_on_mcps_request(LoRaMacStatus_t eStatus, McpsReq_t *psMcpsReq, TimerTime_t ui32NextTxDelay)
+{
+    if ((eStatus != LORAMAC_STATUS_OK) && (psMcpsReq->Type == MCPS_UNCONFIRMED) &&
+        (psMcpsReq->Req.Unconfirmed.fPort == SIM_UPLINK_PORT))
+    {
+        sim_uplinks_failed++;
+        sim_pending_pop(false);
+    }
+}
+
+static bool sim_uplink_is_last_frame(LmHandlerAppData_t *psAppData)
+{
+    if (psAppData->Port == SIM_UPLINK_PORT)
+    {
+        return true;
+    }
+
+    // a segmented uplink completes with its last segment
+    return (psAppData->Port == LORAWAN_SEGMENT_PORT) && (psAppData->BufferSize >= 2) &&
+           (psAppData->Buffer[1] & 0x80);
+}
+
+static void sim_on_tx_data(LmHandlerTxParams_t *psParams)
+{
+    if (sim_uplink_is_last_frame(&psParams->AppData))
+    {
+        sim_uplinks_completed++;
+        sim_pending_pop(true);
+    }
+}
+
+static bool sim_rx_due(uint64_t *pui64Time)
+{
+    if (lorawan_downlink_ring_peek(&sim_rx_ring) == NULL)
+    {
+        return false;
+    }
+
+    // the application starts on the oldest downlink as soon as it is done
+    // with the previous one
+    if (!sim_rx_busy)
+    {
+        uint64_t ui64Start = sim_clock_now() > sim_rx_free ? sim_clock_now() : sim_rx_free;
+        sim_rx_done = ui64Start + sim_options.ui32RxProcessing;
+        sim_rx_busy = true;
+    }
+
+    *pui64Time = sim_rx_done;
+    return true;
+}
+
+static void sim_rx_consume()
+{
+    lorawan_downlink_ring_release(&sim_rx_ring);
+    sim_rx_free = sim_rx_done;
+    sim_rx_busy = false;
+}
+
+static void sim_uplink()
+{
+    static uint8_t pui8Payload[SIM_UPLINK_MAX_SIZE];
+    lorawan_transmit_stats_t sBefore;
+    lorawan_transmit_stats_t sAfter;
+
+    memset(pui8Payload, 0, sim_options.ui32Size);
+    memcpy(pui8Payload,
+           &sim_uplinks_requested,
+           sim_options.ui32Size < sizeof(uint32_t) ? sim_options.ui32Size : sizeof(uint32_t));
+
+    // record the request first, the LoRaWAN task runs as soon as it is
+    // queued
+    sim_pending_t *psPending = &sim_pending[(sim_pending_head + sim_pending_count) % SIM_PENDING_MAX];
+    psPending->ui64Enqueued = sim_clock_now();
+    psPending->ui64Transmitted = 0;
+    sim_pending_count++;
+    sim_uplinks_requested++;
+    sim_uplink_next += sim_options.ui32Period;
+
+    lorawan_transmit_stats_get(&sBefore);
+    lorawan_transmit(SIM_UPLINK_PORT,
+                     LORAMAC_HANDLER_UNCONFIRMED_MSG,
+                     sim_options.ui32Size,
+                     pui8Payload);
+    lorawan_transmit_stats_get(&sAfter);
+
+    if (sAfter.ui32Dropped != sBefore.ui32Dropped)
+    {
+        sim_pending_count--;
+    }
+}
+
+static int sim_compare(const void *a, const void *b)
+{
+    uint32_t x = *(const uint32_t *)a;
+    uint32_t y = *(const uint32_t *)b;
+
+    return (x > y) - (x < y);
+}
+
+// Stage histograms kept by the LoRaWAN task, percentiles are the upper
+// bound of their log2 bucket.
+static void sim_stage_report()
+{
+    lorawan_latency_stats_t sStats;
+
+    for (uint32_t i = 0; i <= LORAWAN_LATENCY_CLASSES; i++)
+    {
+        if (!lorawan_latency_stats_get(i, &sStats))
+        {
+            continue;
+        }
+
+        for (uint32_t j = 0; j < LORAWAN_LATENCY_STAGES; j++)
+        {
+            printf("stage %-10s port %u  p50 %u  p90 %u  p99 %u  max %u ms\n",
+                   lorawan_latency_stage_name(j),
+                   sStats.ui32Port,
+                   lorawan_latency_percentile(&sStats, j, 500),
+                   lorawan_latency_percentile(&sStats, j, 900),
+                   lorawan_latency_percentile(&sStats, j, 990),
+                   sStats.pui32Max[j]);
+        }
+    }
+}
+
+static void sim_latency_report(const char *pcName, uint32_t *pui32Latency, uint32_t ui32Count)
+{
+    if (ui32Count == 0)
+    {
+        printf("%-16s n/a\n", pcName);
+        return;
+    }
+
+    uint64_t ui64Sum = 0;
+    qsort(pui32Latency, ui32Count, sizeof(uint32_t), sim_compare);
+    for (uint32_t i = 0; i < ui32Count; i++)
+    {
+        ui64Sum += pui32Latency[i];
+    }
+
+    printf("%-16s min %u  avg %llu  p50 %u  p95 %u  p99 %u  max %u ms\n",
+           pcName,
+           pui32Latency[0],
+           (unsigned long long)(ui64Sum / ui32Count),
+           pui32Latency[(ui32Count * 50) / 100],
+           pui32Latency[(ui32Count * 95) / 100],
+           pui32Latency[(ui32Count * 99) / 100],
+           pui32Latency[ui32Count - 1]);
+}
+
+static void sim_boot_report()
+{
+    lorawan_boot_stats_t sBoot;
+    lorawan_boot_stats_get(&sBoot);
+
+    printf("boot (%s)", sBoot.ui32FastBoot ? "fast" : "full");
+    for (uint32_t i = LORAWAN_BOOT_BOARD; i < LORAWAN_BOOT_PHASES; i++)
+    {
+        if (sBoot.ui32Reached & (1 << i))
+        {
+            uint32_t ui32Ticks = sBoot.pui32Timestamp[i] - sBoot.pui32Timestamp[LORAWAN_BOOT_START];
+            printf("  %s %llu",
+                   lorawan_boot_phase_name(i),
+                   (unsigned long long)ui32Ticks * 1000 / LORAWAN_BOOT_TIMER_HZ);
+        }
+    }
+    printf(" ms\n");
+}
+
+static void sim_report()
+{
+    struct timespec sWallEnd;
+    clock_gettime(CLOCK_MONOTONIC, &sWallEnd);
+
+    double dWall = (sWallEnd.tv_sec - sim_wall_start.tv_sec) +
+                   (sWallEnd.tv_nsec - sim_wall_start.tv_nsec) / 1e9;
+    double dVirtual = sim_clock_now() / 1000.0;
+
+    lorawan_transmit_stats_t sTransmit;
+    sim_radio_stats_t sRadio;
+    energy_stats_t sEnergy;
+    lorawan_nvm_stats_t sNvm;
+
+    lorawan_transmit_stats_get(&sTransmit);
+    sim_radio_stats_get(&sRadio);
+    energy_stats_get(&sEnergy);
+    lorawan_nvm_stats_get(&sNvm);
+
+    printf("\n");
+    printf("virtual time     %.3f s\n", dVirtual);
+    printf("wall time        %.3f s\n", dWall);
+    printf("speed-up         %.0fx\n", dWall > 0 ? dVirtual / dWall : 0.0);
+    printf("\n");
+    printf("uplinks          requested %u  dropped %u  failed %u  completed %u\n",
+           sim_uplinks_requested,
+           sTransmit.ui32Dropped,
+           sim_uplinks_failed,
+           sim_uplinks_completed);
+    printf("radio            tx %u  lost %u  airtime %llu ms  rx windows %u  rx on %llu ms\n",
+           sRadio.ui32TxFrames,
+           sRadio.ui32UplinksLost,
+           (unsigned long long)sRadio.ui64TxTime,
+           sRadio.ui32RxWindows,
+           (unsigned long long)sRadio.ui64RxTime);
+    printf("downlinks        rx %u  lost %u  missed %u\n",
+           sRadio.ui32RxFrames,
+           sRadio.ui32DownlinksLost,
+           sRadio.ui32DownlinksMissed);
+    printf("throughput       %.1f uplinks/h  %.2f B/s\n",
+           dVirtual > 0 ? sim_uplinks_delivered * 3600.0 / dVirtual : 0.0,
+           dVirtual > 0 ? sim_bytes_delivered / dVirtual : 0.0);
+    printf("goodput          %.2f B/s  %u segmented  %u segments  airtime %.1f ms/B\n",
+           dVirtual > 0 ? (double)sim_uplinks_completed * sim_options.ui32Size / dVirtual : 0.0,
+           sTransmit.ui32Segmented,
+           sTransmit.ui32Segments,
+           sim_uplinks_completed ? (double)sRadio.ui64TxTime /
+                                       ((double)sim_uplinks_completed * sim_options.ui32Size)
+                                 : 0.0);
+    lorawan_downlink_ring_stats_t sRx;
+    lorawan_downlink_ring_stats_get(&sim_rx_ring, &sRx);
+    printf("downlink ring    received %u  consumed %u  overflows %u  high water %u/%u\n",
+           sRx.ui32Received,
+           sRx.ui32Consumed,
+           sRx.ui32Overflows,
+           sRx.ui32HighWater,
+           SIM_RX_SLOTS);
+    sim_boot_report();
+    sim_latency_report("latency tx", sim_latency_radio, sim_latency_count);
+    sim_latency_report("latency confirm", sim_latency_confirm, sim_latency_count);
+    sim_latency_report("latency downlink", sim_latency_downlink, sim_latency_downlink_count);
+    sim_stage_report();
+    if (sim_options.ui32Otaa)
+    {
+        lorawan_join_stats_t sJoin;
+        lorawan_join_stats_get(&sJoin);
+
+        printf("join             %llu ms  %u failed attempts  %u rejected  airtime %u ms\n",
+               (unsigned long long)sim_join_time,
+               sim_join_attempts,
+               sJoin.ui32Rejected,
+               sJoin.ui32Airtime);
+    }
+    printf("nvm              %u words  %u.%03u per uplink  %u commits  %u compactions  "
+           "%u coalesced  lifetime %u days\n",
+           sNvm.ui32Words,
+           sNvm.ui32WordsPerKUplink / 1000,
+           sNvm.ui32WordsPerKUplink % 1000,
+           sNvm.ui32Commits,
+           sNvm.ui32Compactions,
+           sNvm.ui32Coalesced,
+           sNvm.ui32LifetimeDays);
+    printf("charge           mcu %.3f  radio %.3f  port %.3f uAh\n",
+           sEnergy.ui64DomainCharge[ENERGY_DOMAIN_MCU] / 1000.0,
+           sEnergy.ui64DomainCharge[ENERGY_DOMAIN_RADIO] / 1000.0,
+           sEnergy.ui64DomainCharge[ENERGY_DOMAIN_RADIO_PORT] / 1000.0);
+
+    lorawan_frag_store_stats_t sFrag;
+    sim_flash_stats_t sFlash;
+
+    lorawan_frag_store_stats_get(&sFrag);
+    sim_flash_stats_get(&sFlash);
+    if (sFrag.ui32Writes)
+    {
+        printf("fuota            written %u B  programmed %u B  amplification %.2f  "
+               "programs %u  erases %u (%u inline)\n",
+               sFrag.ui32Bytes,
+               sFrag.ui32Words * 4,
+               (double)sFrag.ui32Words * 4 / sFrag.ui32Bytes,
+               sFrag.ui32Programs,
+               sFrag.ui32Erases + sFrag.ui32ErasesInline,
+               sFrag.ui32ErasesInline);
+        printf("fuota flash      span %llu ms  busy %.1f ms  longest %u us  corrupted %u words  "
+               "partial %u words (%u programmed twice)\n",
+               (unsigned long long)(sFlash.ui64Last - sFlash.ui64First),
+               sFlash.ui64Busy / 1000.0,
+               sFrag.ui32CriticalMax,
+               sFlash.ui32Corrupted,
+               sFrag.ui32Partials,
+               sFrag.ui32Reprograms);
+    }
+}
+
+static bool sim_start()
+{
+    lorawan_latency_stats_reset();
+    lorawan_tracing_set(sim_options.ui32Tracing);
+    lorawan_network_config(sim_options.eRegion, sim_options.eDatarate, sim_options.ui32Adr, true);
+    lorawan_fast_boot_set(sim_options.ui32FastBoot);
+    lorawan_segmentation_set(sim_options.ui32Segmentation);
+    lorawan_downlink_ring_init(&sim_rx_ring, sim_rx_slots, SIM_RX_SLOTS);
+
+    // the multicast keys are derived from the AppKey in both modes
+    lorawan_key_set_by_str(LORAWAN_KEY_APP, SIM_APP_KEY);
+
+    if (sim_options.ui32Otaa)
+    {
+        char pcDevEui[17];
+        snprintf(pcDevEui, sizeof(pcDevEui), SIM_DEV_EUI_PREFIX "%08X", sim_options.ui32Device);
+
+        lorawan_activation_config(LORAWAN_ACTIVATION_OTAA, NULL);
+        lorawan_key_set_by_str(LORAWAN_KEY_DEV_EUI, pcDevEui);
+        lorawan_key_set_by_str(LORAWAN_KEY_JOIN_EUI, SIM_JOIN_EUI);
+        lorawan_key_set_by_str(LORAWAN_KEY_NWK, SIM_APP_KEY);
+    }
+    else
+    {
+        lorawan_activation_parameters_t sParams = {
+            .abp_server_version = 0x01000400,
+            .abp_network_id = SIM_NETWORK_ID,
+            .abp_device_address = SIM_DEVICE_ADDRESS + sim_options.ui32Device,
+        };
+        lorawan_activation_config(LORAWAN_ACTIVATION_ABP, &sParams);
+
+        lorawan_key_set_by_str(LORAWAN_KEY_F_NWK_S_INT, SIM_NWK_S_KEY);
+        lorawan_key_set_by_str(LORAWAN_KEY_S_NWK_S_INT, SIM_NWK_S_KEY);
+        lorawan_key_set_by_str(LORAWAN_KEY_NWK_S_ENC, SIM_NWK_S_KEY);
+        lorawan_key_set_by_str(LORAWAN_KEY_APP_S, SIM_APP_S_KEY);
+    }
+
+    lorawan_event_callback_register(LORAWAN_EVENT_MAC_MCPS_REQUEST, sim_on_mcps_request);
+    lorawan_event_callback_register(LORAWAN_EVENT_JOIN_REQUEST, sim_on_join_request);
+    lorawan_event_callback_register(LORAWAN_EVENT_TX_DATA, sim_on_tx_data);
+    lorawan_event_callback_register(LORAWAN_EVENT_RX_DATA, sim_on_rx_data);
+
+    if (sim_options.pcNetwork && !sim_link_open(sim_options.pcNetwork))
+    {
+        printf("cannot reach the network emulator at %s\n", sim_options.pcNetwork);
+        return false;
+    }
+
+    // The LoRaWAN task has a higher priority, each call below has
+    // completed by the time it returns.  An OTAA join completes later
+    // when the join accept is received.
+    if (sim_options.pcRecord || sim_replay_active())
+    {
+        lorawan_record_start(false);
+    }
+
+    sim_join_start = sim_clock_now();
+    if (sim_replay_active())
+    {
+        sim_replay_align(sim_clock_now());
+        lorawan_stack_state_set(LORAWAN_STACK_STARTED);
+
+        printf("device %u (%s): replaying %s\n",
+               sim_options.ui32Device,
+               sim_options.ui32Otaa ? "otaa" : "abp",
+               sim_options.pcReplay);
+        return true;
+    }
+
+    lorawan_stack_state_set(LORAWAN_STACK_STARTED);
+    lorawan_join();
+    if (sim_options.ui32ClassC && !sim_options.ui32Otaa)
+    {
+        lorawan_class_set(LORAWAN_CLASS_C);
+    }
+
+    printf("device %u (%s): %u uplinks of %u bytes every %u ms\n",
+           sim_options.ui32Device,
+           sim_options.ui32Otaa ? "otaa" : "abp",
+           sim_options.ui32Uplinks,
+           sim_options.ui32Size,
+           sim_options.ui32Period);
+
+    return sim_options.ui32Otaa || (lorawan_get_join_state() != 0);
+}
+
+static bool sim_uplink_due(uint64_t *pui64Time)
+{
+    if ((sim_uplinks_requested >= sim_options.ui32Uplinks) || !lorawan_get_join_state())
+    {
+        return false;
+    }
+
+    if (sim_options.ui32Period == 0)
+    {
+        // back to back: the next request follows the completion of the
+        // previous one
+        *pui64Time = sim_clock_now();
+        return sim_pending_count == 0;
+    }
+
+    *pui64Time = sim_uplink_next;
+    return true;
+}
+
+static void sim_task(void *pvParameters)
+{
+    int iStatus = 0;
+    uint64_t ui64Synced = 0;
+
+    sim_clock_tick_attach();
+
+    if (!sim_start())
+    {
+        printf("activation failed\n");
+        exit(1);
+    }
+
+    clock_gettime(CLOCK_MONOTONIC, &sim_wall_start);
+
+    while (1)
+    {
+        // Without a wall clock tick there is no time slicing, let the
+        // tasks of the same priority finish first.
+        taskYIELD();
+
+        // This task has the lowest priority: when it runs, every other
+        // task is blocked and the device is idle.  Jump straight to the
+        // next event.
+        uint64_t ui64Radio, ui64Alarm, ui64Uplink, ui64Network, ui64Rx, ui64Tick;
+        bool bRadio = sim_radio_event_get(&ui64Radio);
+        bool bAlarm = sim_clock_alarm_get(&ui64Alarm);
+        bool bRx = sim_rx_due(&ui64Rx);
+        bool bTick = sim_clock_tick_event_get(&ui64Tick);
+
+        if (sim_replay_active())
+        {
+            // The log gives the order of the records: the application
+            // inputs and the radio interrupts are raised once the run has
+            // reproduced every record before them, the timer alarms have
+            // to come from the run.  The kernel timeouts are not recorded
+            // and run whenever they are due.
+            uint64_t ui64Step;
+            sim_replay_sync();
+            sim_replay_step_e eStep = sim_replay_step_get(&ui64Step);
+
+            if (eStep == SIM_REPLAY_END)
+            {
+                break;
+            }
+
+            if (bTick && ((eStep != SIM_REPLAY_WAIT) ? (ui64Tick < ui64Step)
+                                                      : (!bAlarm || ui64Tick < ui64Alarm)))
+            {
+                sim_clock_advance(ui64Tick);
+            }
+            else if (eStep == SIM_REPLAY_INPUT)
+            {
+                sim_clock_advance(ui64Step);
+                sim_replay_input();
+            }
+            else if (eStep == SIM_REPLAY_RADIO)
+            {
+                sim_clock_advance(ui64Step);
+                sim_irq_enter();
+                sim_replay_radio();
+                sim_irq_exit();
+            }
+            else if (bAlarm)
+            {
+                sim_clock_advance(ui64Alarm);
+                sim_irq_enter();
+                sim_clock_alarm_fire();
+                sim_irq_exit();
+            }
+            else
+            {
+                sim_replay_stalled();
+                iStatus = 1;
+                break;
+            }
+            continue;
+        }
+
+        if ((sim_uplinks_requested >= sim_options.ui32Uplinks) && (sim_pending_count == 0))
+        {
+            break;
+        }
+
+        bool bUplink = sim_uplink_due(&ui64Uplink);
+        bool bNetwork = sim_link_event_get(&ui64Network);
+
+        if (sim_link_is_open())
+        {
+            // Let the network emulator schedule its downlinks up to the
+            // next event before time moves on.  They may add a radio
+            // event, so start over once they are in.
+            uint64_t ui64Next = UINT64_MAX;
+            ui64Next = (bRadio && ui64Radio < ui64Next) ? ui64Radio : ui64Next;
+            ui64Next = (bAlarm && ui64Alarm < ui64Next) ? ui64Alarm : ui64Next;
+            ui64Next = (bUplink && ui64Uplink < ui64Next) ? ui64Uplink : ui64Next;
+            ui64Next = (bRx && ui64Rx < ui64Next) ? ui64Rx : ui64Next;
+            ui64Next = (bTick && ui64Tick < ui64Next) ? ui64Tick : ui64Next;
+
+            bool bSync = (ui64Next != UINT64_MAX) && (ui64Next > ui64Synced);
+
+            if (bNetwork && (ui64Network < ui64Next))
+            {
+                // the device is idle until the network has more to send
+                sim_clock_advance(ui64Network);
+                ui64Next = sim_clock_now();
+                bSync = true;
+            }
+
+            if (bSync)
+            {
+                ui64Synced = ui64Next;
+                if (!sim_link_sync(ui64Next))
+                {
+                    sim_link_close();
+                }
+                continue;
+            }
+        }
+
+        if (bTick && (!bRx || ui64Tick < ui64Rx) && (!bRadio || ui64Tick < ui64Radio) &&
+            (!bAlarm || ui64Tick < ui64Alarm) && (!bUplink || ui64Tick < ui64Uplink))
+        {
+            // a software timer or a task timeout, the kernel runs it from
+            // the tick
+            sim_clock_advance(ui64Tick);
+        }
+        else if (bRx && (!bRadio || ui64Rx < ui64Radio) && (!bAlarm || ui64Rx < ui64Alarm) &&
+                 (!bUplink || ui64Rx < ui64Uplink))
+        {
+            sim_clock_advance(ui64Rx);
+            sim_rx_consume();
+        }
+        else if (bRadio && (!bAlarm || ui64Radio <= ui64Alarm) &&
+                 (!bUplink || ui64Radio <= ui64Uplink))
+        {
+            sim_clock_advance(ui64Radio);
+            sim_irq_enter();
+            sim_radio_event_fire();
+            sim_irq_exit();
+        }
+        else if (bAlarm && (!bUplink || ui64Alarm <= ui64Uplink))
+        {
+            sim_clock_advance(ui64Alarm);
+            sim_irq_enter();
+            sim_clock_alarm_fire();
+            sim_irq_exit();
+        }
+        else if (bUplink)
+        {
+            sim_clock_advance(ui64Uplink);
+            sim_uplink();
+        }
+        else
+        {
+            printf("stalled: %u uplinks pending with no event scheduled\n", sim_pending_count);
+            iStatus = 1;
+            break;
+        }
+    }
+
+    sim_link_close();
+    sim_report();
+    if (sim_replay_active())
+    {
+        sim_replay_report();
+    }
+    if (sim_options.pcRecord && !sim_replay_save(sim_options.pcRecord))
+    {
+        printf("cannot write the records to %s\n", sim_options.pcRecord);
+        iStatus = 1;
+    }
+    fflush(stdout);
+    exit(iStatus);
+}
+
+static void sim_usage(const char *pcName)
+{
+    printf("usage: %s [options]\n", pcName);
+    printf("  -i <index>    device index, selects the device address (default %u)\n", sim_options.ui32Device);
+    printf("  -n <count>    number of uplinks (default %u)\n", sim_options.ui32Uplinks);
+    printf("  -p <ms>       uplink period, 0 sends back to back (default %u)\n", sim_options.ui32Period);
+    printf("  -s <bytes>    uplink payload size (default %u)\n", sim_options.ui32Size);
+    printf("  -r <region>   as923 au915 cn470 cn779 eu433 eu868 kr920 in865 us915 ru864\n");
+    printf("  -d <dr>       uplink data rate (default %u)\n", sim_options.eDatarate);
+    printf("  -u <permille> uplink loss\n");
+    printf("  -l <permille> downlink loss\n");
+    printf("  -S <seed>     random seed\n");
+    printf("  -o            activate over the air instead of by personalization\n");
+    printf("  -a            enable adaptive data rate\n");
+    printf("  -f            fast boot, defer packages to the first uplink\n");
+    printf("  -g            split uplinks larger than the data rate allows\n");
+    printf("  -c            switch to class C once activated\n");
+    printf("  -k <ms>       application processing time per downlink (default %u)\n",
+           sim_options.ui32RxProcessing);
+    printf("  -L <host:port> exchange frames with tools/lns_emulator.py\n");
+    printf("  -W <file>     write the event records of the run\n");
+    printf("  -R <file>     replay event records, from the target or -W\n");
+    printf("  -F <file>     back the OTA flash region with a file\n");
+    printf("  -v            enable stack tracing\n");
+    printf("  -V            binary stack tracing, decode with tools/lorawan_trace.py\n");
+}
+
+int main(int argc, char *argv[])
+{
+    int iOption;
+
+    while ((iOption = getopt(argc, argv, "i:n:p:s:r:d:u:l:S:oafgck:L:W:R:F:vVh")) != -1)
+    {
+        switch (iOption)
+        {
+        case 'i':
+            sim_options.ui32Device = strtoul(optarg, NULL, 0);
+            break;
+        case 'n':
+            sim_options.ui32Uplinks = strtoul(optarg, NULL, 0);
+            break;
+        case 'p':
+            sim_options.ui32Period = strtoul(optarg, NULL, 0);
+            break;
+        case 's':
+            sim_options.ui32Size = strtoul(optarg, NULL, 0);
+            if (sim_options.ui32Size > SIM_UPLINK_MAX_SIZE)
+            {
+                sim_options.ui32Size = SIM_UPLINK_MAX_SIZE;
+            }
+            break;
+        case 'r':
+            for (size_t i = 0; i < sizeof(sim_regions) / sizeof(sim_regions[0]); i++)
+            {
+                if (strcasecmp(optarg, sim_regions[i].pcName) == 0)
+                {
+                    sim_options.eRegion = sim_regions[i].eRegion;
+                    break;
+                }
+            }
+            break;
+        case 'd':
+            sim_options.eDatarate = (lorawan_datarate_e)strtoul(optarg, NULL, 0);
+            break;
+        case 'u':
+            sim_options.sRadio.ui32UplinkLoss = strtoul(optarg, NULL, 0);
+            break;
+        case 'l':
+            sim_options.sRadio.ui32DownlinkLoss = strtoul(optarg, NULL, 0);
+            break;
+        case 'S':
+            sim_options.sRadio.ui32Seed = strtoul(optarg, NULL, 0);
+            break;
+        case 'o':
+            sim_options.ui32Otaa = 1;
+            break;
+        case 'a':
+            sim_options.ui32Adr = 1;
+            break;
+        case 'f':
+            sim_options.ui32FastBoot = 1;
+            break;
+        case 'g':
+            sim_options.ui32Segmentation = 1;
+            break;
+        case 'c':
+            sim_options.ui32ClassC = 1;
+            break;
+        case 'k':
+            sim_options.ui32RxProcessing = strtoul(optarg, NULL, 0);
+            break;
+        case 'L':
+            sim_options.pcNetwork = optarg;
+            break;
+        case 'W':
+            sim_options.pcRecord = optarg;
+            break;
+        case 'R':
+            sim_options.pcReplay = optarg;
+            break;
+        case 'F':
+            sim_options.pcFlash = optarg;
+            break;
+        case 'v':
+            sim_options.ui32Tracing = LORAWAN_TRACING_TEXT;
+            break;
+        case 'V':
+            sim_options.ui32Tracing = LORAWAN_TRACING_BINARY;
+            break;
+        default:
+            sim_usage(argv[0]);
+            return 1;
+        }
+    }
+
+    if (sim_options.pcReplay && !sim_replay_open(sim_options.pcReplay))
+    {
+        printf("cannot read event records from %s\n", sim_options.pcReplay);
+        return 1;
+    }
+
+    if (!sim_flash_open(sim_options.pcFlash))
+    {
+        printf("cannot map the OTA flash region onto %s\n", sim_options.pcFlash);
+        return 1;
+    }
+
+    sim_latency_radio = calloc(sim_options.ui32Uplinks + 1, sizeof(uint32_t));
+    sim_latency_confirm = calloc(sim_options.ui32Uplinks + 1, sizeof(uint32_t));
+    sim_latency_downlink = calloc(sim_options.ui32Uplinks + 1, sizeof(uint32_t));
+
+    sim_board_seed_set(sim_options.sRadio.ui32Seed + sim_options.ui32Device);
+    sim_radio_config_set(&sim_options.sRadio);
+    sim_radio_uplink_handler_set(sim_on_uplink);
+
+    energy_init();
+    lorawan_task_create(SIM_LORAWAN_TASK_PRIORITY);
+    xTaskCreate(sim_task, "sim", 1024, 0, SIM_TASK_PRIORITY, NULL);
+
+    vTaskStartScheduler();
+
+    return 0;
+}
@@ -0,0 +1,828 @@
+/*
+ * BSD 3-Clause License
+ *
+ * Copyright (c) 2024, Northern Mechatronics, Inc.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its
+ *    contributors may be used to endorse or promote products derived from
+ *    this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+
+#include <am_mcu_apollo.h>
+
+#include <radio.h>
+
+#include "lorawan_radio.h"
+
+#include "sim_clock.h"
+#include "sim_radio.h"
+
+#define SIM_RADIO_DOWNLINKS_MAX (16)
+
+// Number of preamble symbols the receiver needs to lock onto a frame.
+#define SIM_RADIO_PREAMBLE_LOCK (4)
+
+// Wake up time reported to the MAC (TCXO + radio), ms.
+#define SIM_RADIO_WAKEUP_TIME (3)
+
+extern void lorawan_wake_on_radio_irq();
+
+typedef enum
+{
+    SIM_RADIO_EVENT_NONE,
+    SIM_RADIO_EVENT_TX_DONE,
+    SIM_RADIO_EVENT_TX_TIMEOUT,
+    SIM_RADIO_EVENT_RX_DONE,
+    SIM_RADIO_EVENT_RX_TIMEOUT,
+    SIM_RADIO_EVENT_RX_ERROR,
+    SIM_RADIO_EVENT_CAD_DONE,
+} sim_radio_event_e;
+
+typedef struct
+{
+    uint32_t ui32Bandwidth;
+    uint32_t ui32Datarate;
+    uint32_t ui32Coderate;
+    uint32_t ui32PreambleLength;
+    uint32_t ui32SymbolTimeout;
+    bool bFixedLength;
+    bool bCrc;
+    bool bContinuous;
+} sim_radio_modulation_t;
+
+typedef struct
+{
+    sim_radio_event_e eEvent;
+    uint64_t ui64Time;
+    uint32_t ui32Size;
+    uint8_t pui8Payload[SIM_RADIO_PAYLOAD_MAX_SIZE];
+} sim_radio_event_t;
+
+static sim_radio_config_t sim_radio_config = {
+    .ui32Seed = 1,
+    .ui32UplinkLoss = 0,
+    .ui32DownlinkLoss = 0,
+    .i16Rssi = -60,
+    .i8Snr = 8,
+};
+
+static sim_radio_uplink_handler_t sim_radio_uplink_handler;
+static sim_radio_stats_t sim_radio_stats;
+static uint32_t sim_radio_random_state = 1;
+
+static RadioEvents_t *sim_radio_events;
+static RadioState_t sim_radio_state;
+static RadioModems_t sim_radio_modem;
+static uint32_t sim_radio_frequency;
+static sim_radio_modulation_t sim_radio_tx;
+static sim_radio_modulation_t sim_radio_rx;
+static uint64_t sim_radio_rx_start;
+
+static sim_radio_frame_t sim_radio_tx_frame;
+static sim_radio_frame_t sim_radio_downlinks[SIM_RADIO_DOWNLINKS_MAX];
+static bool sim_radio_downlink_valid[SIM_RADIO_DOWNLINKS_MAX];
+
+// Event the radio will raise next and the one raised but not yet
+// serviced by IrqProcess().
+static sim_radio_event_t sim_radio_next;
+static sim_radio_event_t sim_radio_irq;
+
+static uint32_t sim_radio_random()
+{
+    // xorshift32, kept local so that runs are reproducible from the seed
+    uint32_t x = sim_radio_random_state;
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    sim_radio_random_state = x;
+    return x;
+}
+
+static bool sim_radio_lost(uint32_t ui32PerMille)
+{
+    return (sim_radio_random() % 1000) < ui32PerMille;
+}
+
+static uint32_t sim_radio_bandwidth_hz(uint32_t ui32Bandwidth)
+{
+    switch (ui32Bandwidth)
+    {
+    case 1:
+        return 250000;
+    case 2:
+        return 500000;
+    default:
+        return 125000;
+    }
+}
+
+static uint64_t sim_radio_symbol_us(uint32_t ui32Bandwidth, uint32_t ui32Datarate)
+{
+    return ((uint64_t)(1 << ui32Datarate) * 1000000) / sim_radio_bandwidth_hz(ui32Bandwidth);
+}
+
+uint32_t sim_radio_time_on_air(uint32_t ui32Bandwidth,
+                               uint32_t ui32Datarate,
+                               uint32_t ui32Coderate,
+                               uint32_t ui32PreambleLength,
+                               bool bFixedLength,
+                               uint32_t ui32Size,
+                               bool bCrc)
+{
+    // Semtech SX126x data sheet, section 6.1.4
+    int32_t i32Coderate = ui32Coderate + 4;
+    int32_t i32Datarate = ui32Datarate;
+    int32_t i32Preamble = ui32PreambleLength;
+    bool bLowDatarate = ((ui32Bandwidth == 0) && (ui32Datarate >= 11)) ||
+                        ((ui32Bandwidth == 1) && (ui32Datarate == 12));
+
+    if ((i32Datarate <= 6) && (i32Preamble < 12))
+    {
+        i32Preamble = 12;
+    }
+
+    int32_t i32Numerator = (ui32Size << 3) + (bCrc ? 16 : 0) - (4 * i32Datarate) +
+                           (bFixedLength ? 0 : 20);
+    int32_t i32Denominator = 4 * i32Datarate;
+    if (i32Datarate > 6)
+    {
+        i32Numerator += 8;
+        if (bLowDatarate)
+        {
+            i32Denominator = 4 * (i32Datarate - 2);
+        }
+    }
+
+    if (i32Numerator < 0)
+    {
+        i32Numerator = 0;
+    }
+
+    int32_t i32Symbols = ((i32Numerator + i32Denominator - 1) / i32Denominator) * i32Coderate +
+                         i32Preamble + 12;
+    if (i32Datarate <= 6)
+    {
+        i32Symbols += 2;
+    }
+
+    // time on air in units of 1 / (4 * BW)
+    uint64_t ui64Quarters = (uint64_t)(4 * i32Symbols + 1) * (1 << (i32Datarate - 2));
+    uint64_t ui64Bandwidth = sim_radio_bandwidth_hz(ui32Bandwidth);
+
+    return (uint32_t)((ui64Quarters * 1000 + ui64Bandwidth - 1) / ui64Bandwidth);
+}
+
+static uint32_t sim_radio_fsk_time_on_air(uint32_t ui32Datarate,
+                                          uint32_t ui32PreambleLength,
+                                          bool bFixedLength,
+                                          uint32_t ui32Size,
+                                          bool bCrc)
+{
+    uint32_t ui32Bits = (ui32PreambleLength + 3 + (bFixedLength ? 0 : 1) + ui32Size + (bCrc ? 2 : 0)) << 3;
+
+    return (ui32Bits * 1000 + ui32Datarate - 1) / ui32Datarate;
+}
+
+static void sim_radio_cancel()
+{
+    if (sim_radio_state == RF_RX_RUNNING)
+    {
+        sim_radio_stats.ui64RxTime += sim_clock_now() - sim_radio_rx_start;
+    }
+
+    sim_radio_next.eEvent = SIM_RADIO_EVENT_NONE;
+    sim_radio_state = RF_IDLE;
+}
+
+static void sim_radio_downlinks_purge()
+{
+    uint64_t ui64Now = sim_clock_now();
+
+    for (int i = 0; i < SIM_RADIO_DOWNLINKS_MAX; i++)
+    {
+        if (sim_radio_downlink_valid[i] && (sim_radio_downlinks[i].ui64End <= ui64Now))
+        {
+            sim_radio_downlink_valid[i] = false;
+            sim_radio_stats.ui32DownlinksMissed++;
+        }
+    }
+}
+
+// Find the first downlink the receiver can lock onto given the
+// current receive configuration, and schedule its reception.
+static bool sim_radio_rx_lock(uint64_t ui64WindowEnd)
+{
+    uint64_t ui64Symbol = sim_radio_symbol_us(sim_radio_rx.ui32Bandwidth, sim_radio_rx.ui32Datarate);
+    uint64_t ui64Lock = (ui64Symbol * SIM_RADIO_PREAMBLE_LOCK + 999) / 1000;
+    int iFound = -1;
+
+    for (int i = 0; i < SIM_RADIO_DOWNLINKS_MAX; i++)
+    {
+        sim_radio_frame_t *psFrame = &sim_radio_downlinks[i];
+
+        if (!sim_radio_downlink_valid[i] ||
+            (psFrame->ui32Frequency != sim_radio_frequency) ||
+            (psFrame->ui32Datarate != sim_radio_rx.ui32Datarate) ||
+            (psFrame->ui32Bandwidth != sim_radio_rx.ui32Bandwidth))
+        {
+            continue;
+        }
+
+        // the receiver must see enough of the preamble to lock
+        uint64_t ui64Preamble = psFrame->ui64Start +
+            (ui64Symbol * sim_radio_rx.ui32PreambleLength) / 1000;
+        if ((ui64Preamble < sim_radio_rx_start + ui64Lock) || (psFrame->ui64Start > ui64WindowEnd))
+        {
+            continue;
+        }
+
+        if ((iFound < 0) || (psFrame->ui64Start < sim_radio_downlinks[iFound].ui64Start))
+        {
+            iFound = i;
+        }
+    }
+
+    if (iFound < 0)
+    {
+        return false;
+    }
+
+    sim_radio_frame_t *psFrame = &sim_radio_downlinks[iFound];
+    sim_radio_downlink_valid[iFound] = false;
+
+    if (sim_radio_lost(sim_radio_config.ui32DownlinkLoss))
+    {
+        sim_radio_stats.ui32DownlinksLost++;
+        return false;
+    }
+
+    sim_radio_next.eEvent = SIM_RADIO_EVENT_RX_DONE;
+    sim_radio_next.ui64Time = psFrame->ui64End;
+    sim_radio_next.ui32Size = psFrame->ui32Size;
+    memcpy(sim_radio_next.pui8Payload, psFrame->pui8Payload, psFrame->ui32Size);
+
+    return true;
+}
+
+static void sim_radio_rx_schedule(uint32_t ui32Timeout)
+{
+    uint64_t ui64WindowEnd = UINT64_MAX;
+
+    if (!sim_radio_rx.bContinuous)
+    {
+        if (sim_radio_rx.ui32SymbolTimeout)
+        {
+            uint64_t ui64Symbol = sim_radio_symbol_us(sim_radio_rx.ui32Bandwidth, sim_radio_rx.ui32Datarate);
+            ui64WindowEnd = sim_radio_rx_start + (ui64Symbol * sim_radio_rx.ui32SymbolTimeout + 999) / 1000;
+        }
+
+        if (ui32Timeout && (sim_radio_rx_start + ui32Timeout < ui64WindowEnd))
+        {
+            ui64WindowEnd = sim_radio_rx_start + ui32Timeout;
+        }
+    }
+
+    if (sim_radio_rx_lock(ui64WindowEnd))
+    {
+        return;
+    }
+
+    if (ui64WindowEnd != UINT64_MAX)
+    {
+        sim_radio_next.eEvent = SIM_RADIO_EVENT_RX_TIMEOUT;
+        sim_radio_next.ui64Time = ui64WindowEnd;
+    }
+}
+
+void sim_radio_config_set(const sim_radio_config_t *psConfig)
+{
+    sim_radio_config = *psConfig;
+    sim_radio_random_state = psConfig->ui32Seed ? psConfig->ui32Seed : 1;
+}
+
+void sim_radio_uplink_handler_set(sim_radio_uplink_handler_t pfnHandler)
+{
+    sim_radio_uplink_handler = pfnHandler;
+}
+
+bool sim_radio_downlink(sim_radio_frame_t *psFrame)
+{
+    psFrame->ui64End = psFrame->ui64Start +
+                       sim_radio_time_on_air(psFrame->ui32Bandwidth, psFrame->ui32Datarate, 1, 8,
+                                             false, psFrame->ui32Size, false);
+
+    sim_radio_downlinks_purge();
+    for (int i = 0; i < SIM_RADIO_DOWNLINKS_MAX; i++)
+    {
+        if (!sim_radio_downlink_valid[i])
+        {
+            sim_radio_downlinks[i] = *psFrame;
+            sim_radio_downlink_valid[i] = true;
+
+            // a continuous receiver (class C) picks up frames as they come
+            if ((sim_radio_state == RF_RX_RUNNING) && (sim_radio_next.eEvent == SIM_RADIO_EVENT_NONE))
+            {
+                sim_radio_rx_schedule(0);
+            }
+            return true;
+        }
+    }
+
+    return false;
+}
+
+bool sim_radio_tx_get(uint64_t *pui64Start)
+{
+    *pui64Start = sim_radio_tx_frame.ui64Start;
+    return sim_radio_next.eEvent == SIM_RADIO_EVENT_TX_DONE;
+}
+
+bool sim_radio_event_get(uint64_t *pui64Time)
+{
+    sim_radio_downlinks_purge();
+
+    *pui64Time = sim_radio_next.ui64Time;
+    return sim_radio_next.eEvent != SIM_RADIO_EVENT_NONE;
+}
+
+void sim_radio_event_fire()
+{
+    sim_radio_irq = sim_radio_next;
+    sim_radio_next.eEvent = SIM_RADIO_EVENT_NONE;
+
+    switch (sim_radio_irq.eEvent)
+    {
+    case SIM_RADIO_EVENT_TX_DONE:
+        sim_radio_stats.ui32TxFrames++;
+        sim_radio_stats.ui64TxTime += sim_radio_tx_frame.ui64End - sim_radio_tx_frame.ui64Start;
+        {
+            bool bDelivered = !sim_radio_lost(sim_radio_config.ui32UplinkLoss);
+            if (!bDelivered)
+            {
+                sim_radio_stats.ui32UplinksLost++;
+            }
+
+            if (sim_radio_uplink_handler)
+            {
+                sim_radio_uplink_handler(&sim_radio_tx_frame, bDelivered);
+            }
+        }
+        break;
+
+    case SIM_RADIO_EVENT_RX_DONE:
+        sim_radio_stats.ui32RxFrames++;
+        if (sim_radio_rx.bContinuous)
+        {
+            sim_radio_rx_schedule(0);
+        }
+        else
+        {
+            sim_radio_cancel();
+        }
+        break;
+
+    case SIM_RADIO_EVENT_RX_TIMEOUT:
+        sim_radio_stats.ui32RxTimeouts++;
+        sim_radio_cancel();
+        break;
+
+    case SIM_RADIO_EVENT_RX_ERROR:
+        sim_radio_cancel();
+        break;
+
+    case SIM_RADIO_EVENT_TX_TIMEOUT:
+    case SIM_RADIO_EVENT_CAD_DONE:
+        sim_radio_state = RF_IDLE;
+        break;
+
+    default:
+        return;
+    }
+
+    lorawan_wake_on_radio_irq();
+
+    // Like the SX126x driver, leave the transmit mode once the interrupt
+    // has been serviced so that the interrupt sees the radio transmitting.
+    if (sim_radio_irq.eEvent == SIM_RADIO_EVENT_TX_DONE)
+    {
+        sim_radio_state = RF_IDLE;
+    }
+}
+
+bool sim_radio_event_replay(uint32_t ui32State,
+                            uint32_t ui32Rx,
+                            const uint8_t *pui8Payload,
+                            uint32_t ui32Size)
+{
+    if (sim_radio_state != ui32State)
+    {
+        return false;
+    }
+
+    sim_radio_next.ui64Time = sim_clock_now();
+    sim_radio_next.ui32Size = 0;
+
+    switch (ui32State)
+    {
+    case RF_TX_RUNNING:
+        sim_radio_next.eEvent = SIM_RADIO_EVENT_TX_DONE;
+        break;
+
+    case RF_RX_RUNNING:
+        if (ui32Rx == LORAWAN_RADIO_RX_DONE)
+        {
+            sim_radio_next.eEvent = SIM_RADIO_EVENT_RX_DONE;
+            sim_radio_next.ui32Size = ui32Size;
+            memcpy(sim_radio_next.pui8Payload, pui8Payload, ui32Size);
+        }
+        else if (ui32Rx == LORAWAN_RADIO_RX_ERROR)
+        {
+            sim_radio_next.eEvent = SIM_RADIO_EVENT_RX_ERROR;
+        }
+        else
+        {
+            sim_radio_next.eEvent = SIM_RADIO_EVENT_RX_TIMEOUT;
+        }
+        break;
+
+    case RF_CAD:
+        sim_radio_next.eEvent = SIM_RADIO_EVENT_CAD_DONE;
+        break;
+
+    default:
+        return false;
+    }
+
+    sim_radio_event_fire();
+    return true;
+}
+
+lorawan_radio_rx_e lorawan_radio_rx_pending_get(uint8_t *pui8Payload, uint32_t *pui32Size)
+{
+    lorawan_radio_rx_e eResult = LORAWAN_RADIO_RX_NONE;
+
+    *pui32Size = 0;
+
+    AM_CRITICAL_BEGIN
+    switch (sim_radio_irq.eEvent)
+    {
+    case SIM_RADIO_EVENT_RX_DONE:
+        memcpy(pui8Payload, sim_radio_irq.pui8Payload, sim_radio_irq.ui32Size);
+        *pui32Size = sim_radio_irq.ui32Size;
+        eResult = LORAWAN_RADIO_RX_DONE;
+        break;
+
+    case SIM_RADIO_EVENT_RX_TIMEOUT:
+        eResult = LORAWAN_RADIO_RX_TIMEOUT;
+        break;
+
+    case SIM_RADIO_EVENT_RX_ERROR:
+        eResult = LORAWAN_RADIO_RX_ERROR;
+        break;
+
+    default:
+        break;
+    }
+    AM_CRITICAL_END
+
+    return eResult;
+}
+
+void sim_radio_stats_get(sim_radio_stats_t *psStats)
+{
+    *psStats = sim_radio_stats;
+}
+
+//
+// Radio driver interface
+//
+static void sim_radio_init(RadioEvents_t *events)
+{
+    sim_radio_events = events;
+    sim_radio_state = RF_IDLE;
+    sim_radio_next.eEvent = SIM_RADIO_EVENT_NONE;
+    sim_radio_irq.eEvent = SIM_RADIO_EVENT_NONE;
+}
+
+static RadioState_t sim_radio_get_status(void)
+{
+    return sim_radio_state;
+}
+
+static void sim_radio_set_modem(RadioModems_t modem)
+{
+    sim_radio_modem = modem;
+}
+
+static void sim_radio_set_channel(uint32_t freq)
+{
+    sim_radio_frequency = freq;
+}
+
+static bool sim_radio_is_channel_free(uint32_t freq,
+                                      uint32_t rxBandwidth,
+                                      int16_t rssiThresh,
+                                      uint32_t maxCarrierSenseTime)
+{
+    return true;
+}
+
+static uint32_t sim_radio_random_get(void)
+{
+    return sim_radio_random();
+}
+
+static void sim_radio_set_rx_config(RadioModems_t modem,
+                                    uint32_t bandwidth,
+                                    uint32_t datarate,
+                                    uint8_t coderate,
+                                    uint32_t bandwidthAfc,
+                                    uint16_t preambleLen,
+                                    uint16_t symbTimeout,
+                                    bool fixLen,
+                                    uint8_t payloadLen,
+                                    bool crcOn,
+                                    bool freqHopOn,
+                                    uint8_t hopPeriod,
+                                    bool iqInverted,
+                                    bool rxContinuous)
+{
+    sim_radio_modem = modem;
+    sim_radio_rx.ui32Bandwidth = bandwidth;
+    sim_radio_rx.ui32Datarate = datarate;
+    sim_radio_rx.ui32Coderate = coderate;
+    sim_radio_rx.ui32PreambleLength = preambleLen;
+    sim_radio_rx.ui32SymbolTimeout = symbTimeout;
+    sim_radio_rx.bFixedLength = fixLen;
+    sim_radio_rx.bCrc = crcOn;
+    sim_radio_rx.bContinuous = rxContinuous;
+}
+
+static void sim_radio_set_tx_config(RadioModems_t modem,
+                                    int8_t power,
+                                    uint32_t fdev,
+                                    uint32_t bandwidth,
+                                    uint32_t datarate,
+                                    uint8_t coderate,
+                                    uint16_t preambleLen,
+                                    bool fixLen,
+                                    bool crcOn,
+                                    bool freqHopOn,
+                                    uint8_t hopPeriod,
+                                    bool iqInverted,
+                                    uint32_t timeout)
+{
+    sim_radio_modem = modem;
+    sim_radio_tx.ui32Bandwidth = bandwidth;
+    sim_radio_tx.ui32Datarate = datarate;
+    sim_radio_tx.ui32Coderate = coderate;
+    sim_radio_tx.ui32PreambleLength = preambleLen;
+    sim_radio_tx.bFixedLength = fixLen;
+    sim_radio_tx.bCrc = crcOn;
+}
+
+static bool sim_radio_check_rf_frequency(uint32_t frequency)
+{
+    return true;
+}
+
+static uint32_t sim_radio_time_on_air_get(RadioModems_t modem,
+                                          uint32_t bandwidth,
+                                          uint32_t datarate,
+                                          uint8_t coderate,
+                                          uint16_t preambleLen,
+                                          bool fixLen,
+                                          uint8_t payloadLen,
+                                          bool crcOn)
+{
+    if (modem == MODEM_FSK)
+    {
+        return sim_radio_fsk_time_on_air(datarate, preambleLen, fixLen, payloadLen, crcOn);
+    }
+
+    return sim_radio_time_on_air(bandwidth, datarate, coderate, preambleLen, fixLen, payloadLen, crcOn);
+}
+
+static void sim_radio_send(uint8_t *buffer, uint8_t size)
+{
+    sim_radio_cancel();
+
+    sim_radio_tx_frame.ui64Start = sim_clock_now();
+    sim_radio_tx_frame.ui64End = sim_clock_now() +
+        sim_radio_time_on_air_get(sim_radio_modem, sim_radio_tx.ui32Bandwidth,
+                                  sim_radio_tx.ui32Datarate, sim_radio_tx.ui32Coderate,
+                                  sim_radio_tx.ui32PreambleLength, sim_radio_tx.bFixedLength,
+                                  size, sim_radio_tx.bCrc);
+    sim_radio_tx_frame.ui32Frequency = sim_radio_frequency;
+    sim_radio_tx_frame.ui32Datarate = sim_radio_tx.ui32Datarate;
+    sim_radio_tx_frame.ui32Bandwidth = sim_radio_tx.ui32Bandwidth;
+    sim_radio_tx_frame.ui32Size = size;
+    memcpy(sim_radio_tx_frame.pui8Payload, buffer, size);
+
+    sim_radio_state = RF_TX_RUNNING;
+    sim_radio_next.eEvent = SIM_RADIO_EVENT_TX_DONE;
+    sim_radio_next.ui64Time = sim_radio_tx_frame.ui64End;
+}
+
+static void sim_radio_sleep(void)
+{
+    sim_radio_cancel();
+}
+
+static void sim_radio_standby(void)
+{
+    sim_radio_cancel();
+}
+
+static void sim_radio_rx_start_timeout(uint32_t timeout)
+{
+    sim_radio_cancel();
+
+    sim_radio_stats.ui32RxWindows++;
+    sim_radio_state = RF_RX_RUNNING;
+    sim_radio_rx_start = sim_clock_now();
+    sim_radio_rx_schedule(timeout);
+}
+
+static void sim_radio_start_cad(void)
+{
+    sim_radio_next.eEvent = SIM_RADIO_EVENT_CAD_DONE;
+    sim_radio_next.ui64Time = sim_clock_now() + 1;
+}
+
+static void sim_radio_set_tx_continuous_wave(uint32_t freq, int8_t power, uint16_t time)
+{
+    sim_radio_cancel();
+
+    sim_radio_frequency = freq;
+    sim_radio_state = RF_TX_RUNNING;
+    sim_radio_next.eEvent = SIM_RADIO_EVENT_TX_TIMEOUT;
+    sim_radio_next.ui64Time = sim_clock_now() + (uint64_t)time * 1000;
+}
+
+static int16_t sim_radio_rssi(RadioModems_t modem)
+{
+    return sim_radio_config.i16Rssi;
+}
+
+static void sim_radio_write(uint32_t addr, uint8_t data)
+{
+}
+
+static uint8_t sim_radio_read(uint32_t addr)
+{
+    return 0;
+}
+
+static void sim_radio_write_buffer(uint32_t addr, uint8_t *buffer, uint8_t size)
+{
+}
+
+static void sim_radio_read_buffer(uint32_t addr, uint8_t *buffer, uint8_t size)
+{
+    memset(buffer, 0, size);
+}
+
+static void sim_radio_set_max_payload_length(RadioModems_t modem, uint8_t max)
+{
+}
+
+static void sim_radio_set_public_network(bool enable)
+{
+}
+
+static uint32_t sim_radio_get_wakeup_time(void)
+{
+    return SIM_RADIO_WAKEUP_TIME;
+}
+
+static void sim_radio_irq_process(void)
+{
+    sim_radio_event_t sEvent;
+
+    AM_CRITICAL_BEGIN
+    sEvent = sim_radio_irq;
+    sim_radio_irq.eEvent = SIM_RADIO_EVENT_NONE;
+    AM_CRITICAL_END
+
+    if (sim_radio_events == NULL)
+    {
+        return;
+    }
+
+    switch (sEvent.eEvent)
+    {
+    case SIM_RADIO_EVENT_TX_DONE:
+        if (sim_radio_events->TxDone)
+        {
+            sim_radio_events->TxDone();
+        }
+        break;
+
+    case SIM_RADIO_EVENT_TX_TIMEOUT:
+        if (sim_radio_events->TxTimeout)
+        {
+            sim_radio_events->TxTimeout();
+        }
+        break;
+
+    case SIM_RADIO_EVENT_RX_DONE:
+        if (sim_radio_events->RxDone)
+        {
+            sim_radio_events->RxDone(sEvent.pui8Payload,
+                                     sEvent.ui32Size,
+                                     sim_radio_config.i16Rssi,
+                                     sim_radio_config.i8Snr);
+        }
+        break;
+
+    case SIM_RADIO_EVENT_RX_TIMEOUT:
+        if (sim_radio_events->RxTimeout)
+        {
+            sim_radio_events->RxTimeout();
+        }
+        break;
+
+    case SIM_RADIO_EVENT_RX_ERROR:
+        if (sim_radio_events->RxError)
+        {
+            sim_radio_events->RxError();
+        }
+        break;
+
+    case SIM_RADIO_EVENT_CAD_DONE:
+        if (sim_radio_events->CadDone)
+        {
+            sim_radio_events->CadDone(false);
+        }
+        break;
+
+    default:
+        break;
+    }
+}
+
+static void sim_radio_rx_boosted(uint32_t timeout)
+{
+    sim_radio_rx_start_timeout(timeout);
+}
+
+static void sim_radio_set_rx_duty_cycle(uint32_t rxTime, uint32_t sleepTime)
+{
+    sim_radio_rx_start_timeout(0);
+}
+
+const struct Radio_s Radio = {
+    .Init = sim_radio_init,
+    .GetStatus = sim_radio_get_status,
+    .SetModem = sim_radio_set_modem,
+    .SetChannel = sim_radio_set_channel,
+    .IsChannelFree = sim_radio_is_channel_free,
+    .Random = sim_radio_random_get,
+    .SetRxConfig = sim_radio_set_rx_config,
+    .SetTxConfig = sim_radio_set_tx_config,
+    .CheckRfFrequency = sim_radio_check_rf_frequency,
+    .TimeOnAir = sim_radio_time_on_air_get,
+    .Send = sim_radio_send,
+    .Sleep = sim_radio_sleep,
+    .Standby = sim_radio_standby,
+    .Rx = sim_radio_rx_start_timeout,
+    .StartCad = sim_radio_start_cad,
+    .SetTxContinuousWave = sim_radio_set_tx_continuous_wave,
+    .Rssi = sim_radio_rssi,
+    .Write = sim_radio_write,
+    .Read = sim_radio_read,
+    .WriteBuffer = sim_radio_write_buffer,
+    .ReadBuffer = sim_radio_read_buffer,
+    .SetMaxPayloadLength = sim_radio_set_max_payload_length,
+    .SetPublicNetwork = sim_radio_set_public_network,
+    .GetWakeupTime = sim_radio_get_wakeup_time,
+    .IrqProcess = sim_radio_irq_process,
+    .RxBoosted = sim_radio_rx_boosted,
+    .SetRxDutyCycle = sim_radio_set_rx_duty_cycle,
+};
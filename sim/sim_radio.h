@@ -0,0 +1,157 @@
+/*
+ * BSD 3-Clause License
+ *
+ * Copyright (c) 2024, Northern Mechatronics, Inc.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its
+ *    contributors may be used to endorse or promote products derived from
+ *    this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+#ifndef _SIM_RADIO_H_
+#define _SIM_RADIO_H_
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define SIM_RADIO_PAYLOAD_MAX_SIZE (255)
+
+typedef struct
+{
+    uint32_t ui32Seed;         ///< seed of the loss and Random() generator
+    uint32_t ui32UplinkLoss;   ///< per mille of uplinks that never reach the network
+    uint32_t ui32DownlinkLoss; ///< per mille of downlinks that are not demodulated
+    int16_t i16Rssi;           ///< reported downlink RSSI (dBm)
+    int8_t i8Snr;              ///< reported downlink SNR (dB)
+} sim_radio_config_t;
+
+typedef struct
+{
+    uint64_t ui64Start;     ///< virtual time the frame starts on air (ms)
+    uint64_t ui64End;       ///< virtual time the frame leaves the air (ms)
+    uint32_t ui32Frequency; ///< Hz
+    uint32_t ui32Datarate;  ///< spreading factor
+    uint32_t ui32Bandwidth; ///< 0: 125 kHz, 1: 250 kHz, 2: 500 kHz
+    uint32_t ui32Size;
+    uint8_t pui8Payload[SIM_RADIO_PAYLOAD_MAX_SIZE];
+} sim_radio_frame_t;
+
+typedef struct
+{
+    uint32_t ui32TxFrames;
+    uint32_t ui32UplinksLost;
+    uint32_t ui32RxWindows;
+    uint32_t ui32RxTimeouts;
+    uint32_t ui32RxFrames;
+    uint32_t ui32DownlinksLost;   ///< demodulated by the channel model as lost
+    uint32_t ui32DownlinksMissed; ///< no receive window was open
+    uint64_t ui64TxTime;          ///< total time on air (ms)
+    uint64_t ui64RxTime;          ///< total time with the receiver on (ms)
+} sim_radio_stats_t;
+
+/**
+ * @brief Called at the end of every transmission.
+ *
+ * @param psFrame    the frame as it was put on air.
+ * @param bDelivered false if the channel model dropped the frame.
+ */
+typedef void (*sim_radio_uplink_handler_t)(const sim_radio_frame_t *psFrame, bool bDelivered);
+
+extern void sim_radio_config_set(const sim_radio_config_t *psConfig);
+extern void sim_radio_uplink_handler_set(sim_radio_uplink_handler_t pfnHandler);
+
+/**
+ * @brief Put a downlink on air.
+ *
+ * @param psFrame frame to transmit.  ui64End is filled in from the
+ *                time on air of the frame.
+ *
+ * @return false if too many downlinks are already scheduled.
+ *
+ * @remarks
+ * The frame is received only if a receive window with matching frequency,
+ * spreading factor and bandwidth is open when its preamble starts.
+ */
+extern bool sim_radio_downlink(sim_radio_frame_t *psFrame);
+
+/**
+ * @brief Virtual time the frame on air started.
+ *
+ * @return true while a frame is transmitted.
+ */
+extern bool sim_radio_tx_get(uint64_t *pui64Start);
+
+/**
+ * @brief Virtual time of the next radio interrupt.
+ *
+ * @return true if an interrupt is pending.
+ */
+extern bool sim_radio_event_get(uint64_t *pui64Time);
+
+/**
+ * @brief Raise the pending radio interrupt.
+ *
+ * @remarks
+ * Must be called from within sim_irq_enter() / sim_irq_exit().
+ */
+extern void sim_radio_event_fire();
+
+/**
+ * @brief Raise a radio interrupt taken from a replayed log instead of the
+ * radio model.
+ *
+ * @param ui32State radio state the interrupt was raised in, RadioState_t.
+ * @param ui32Rx outcome of a receive window, lorawan_radio_rx_e.
+ * @param pui8Payload frame of LORAWAN_RADIO_RX_DONE.
+ * @param ui32Size frame size.
+ *
+ * @return false if the radio is not in that state.
+ *
+ * @remarks
+ * Must be called from within sim_irq_enter() / sim_irq_exit().
+ */
+extern bool sim_radio_event_replay(uint32_t ui32State,
+                                   uint32_t ui32Rx,
+                                   const uint8_t *pui8Payload,
+                                   uint32_t ui32Size);
+
+extern uint32_t sim_radio_time_on_air(uint32_t ui32Bandwidth,
+                                      uint32_t ui32Datarate,
+                                      uint32_t ui32Coderate,
+                                      uint32_t ui32PreambleLength,
+                                      bool bFixedLength,
+                                      uint32_t ui32Size,
+                                      bool bCrc);
+
+extern void sim_radio_stats_get(sim_radio_stats_t *psStats);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,381 @@
+/*
+ * BSD 3-Clause License
+ *
+ * Copyright (c) 2024, Northern Mechatronics, Inc.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its
+ *    contributors may be used to endorse or promote products derived from
+ *    this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <FreeRTOS.h>
+#include <task.h>
+
+#include <LmHandler.h>
+
+#include "lorawan.h"
+#include "lorawan_radio.h"
+#include "lorawan_record.h"
+#include "lorawan_task.h"
+
+#include "sim_clock.h"
+#include "sim_radio.h"
+#include "sim_replay.h"
+
+typedef struct
+{
+    uint8_t ui8Type;
+    uint8_t ui8Argument;
+    uint16_t ui16Value;
+    uint32_t ui32Time;
+} sim_replay_record_t;
+
+static const char *const sim_replay_names[] = {
+    "?", "START", "STOP", "RADIO_IRQ", "TIMER_IRQ", "WAKE", "COMMAND",
+    "QUEUE_SEND", "QUEUE_DROP", "QUEUE_RECEIVE", "QUEUE_EXPIRE", "RX", "RX_DATA",
+};
+
+static sim_replay_record_t *sim_replay_log;
+static uint32_t sim_replay_count;
+
+// The stack start of the log is the origin of the replay, records before
+// it are ignored.
+static uint32_t sim_replay_start;
+static uint64_t sim_replay_origin;
+
+// Next record of the log the run has to reproduce, and next record of the
+// run to compare with it.
+static uint32_t sim_replay_cursor;
+static uint32_t sim_replay_run;
+static bool sim_replay_run_started;
+static uint32_t sim_replay_run_start;
+static uint32_t sim_replay_skew;
+
+static bool sim_replay_diverged;
+static sim_replay_record_t sim_replay_divergence;
+static const char *sim_replay_reason;
+
+static void sim_replay_decode(const uint8_t *pui8Record, sim_replay_record_t *psRecord)
+{
+    psRecord->ui8Type = pui8Record[0];
+    psRecord->ui8Argument = pui8Record[1];
+    psRecord->ui16Value = pui8Record[2] | (pui8Record[3] << 8);
+    psRecord->ui32Time = pui8Record[4] | (pui8Record[5] << 8) | (pui8Record[6] << 16) |
+                         ((uint32_t)pui8Record[7] << 24);
+}
+
+static const char *sim_replay_name(uint32_t ui32Type)
+{
+    return (ui32Type < sizeof(sim_replay_names) / sizeof(sim_replay_names[0]))
+               ? sim_replay_names[ui32Type]
+               : sim_replay_names[0];
+}
+
+static uint32_t sim_replay_elapsed(const sim_replay_record_t *psRecord)
+{
+    return psRecord->ui32Time - sim_replay_log[sim_replay_start].ui32Time;
+}
+
+static uint64_t sim_replay_time(const sim_replay_record_t *psRecord)
+{
+    return sim_replay_origin + sim_replay_elapsed(psRecord);
+}
+
+static bool sim_replay_is_input(const sim_replay_record_t *psRecord)
+{
+    if (psRecord->ui8Type == LORAWAN_RECORD_QUEUE_SEND)
+    {
+        return true;
+    }
+
+    // the simulation starts the stack itself
+    return (psRecord->ui8Type == LORAWAN_RECORD_COMMAND) &&
+           (psRecord->ui8Argument != LORAWAN_START) && (psRecord->ui8Argument != LORAWAN_STOP);
+}
+
+static void sim_replay_diverge(const sim_replay_record_t *psRun, const char *pcReason)
+{
+    sim_replay_diverged = true;
+    sim_replay_reason = pcReason;
+    if (psRun)
+    {
+        sim_replay_divergence = *psRun;
+    }
+}
+
+bool sim_replay_open(const char *pcPath)
+{
+    uint8_t pui8Record[LORAWAN_RECORD_SIZE];
+    FILE *psFile = fopen(pcPath, "rb");
+
+    if (psFile == NULL)
+    {
+        return false;
+    }
+
+    fseek(psFile, 0, SEEK_END);
+    long lSize = ftell(psFile);
+    fseek(psFile, 0, SEEK_SET);
+
+    sim_replay_log = calloc(lSize / LORAWAN_RECORD_SIZE + 1, sizeof(sim_replay_record_t));
+    sim_replay_count = 0;
+    while (fread(pui8Record, 1, LORAWAN_RECORD_SIZE, psFile) == LORAWAN_RECORD_SIZE)
+    {
+        sim_replay_decode(pui8Record, &sim_replay_log[sim_replay_count++]);
+    }
+    fclose(psFile);
+
+    // A log kept by a wrapping recorder may have lost the stack start,
+    // its first record is then taken as the origin.
+    sim_replay_start = 0;
+    for (uint32_t i = 0; i < sim_replay_count; i++)
+    {
+        if (sim_replay_log[i].ui8Type == LORAWAN_RECORD_START)
+        {
+            sim_replay_start = i;
+            break;
+        }
+    }
+
+    sim_replay_cursor = sim_replay_start;
+
+    return sim_replay_count > 0;
+}
+
+bool sim_replay_active()
+{
+    return sim_replay_count > 0;
+}
+
+void sim_replay_align(uint64_t ui64Now)
+{
+    sim_replay_origin = ui64Now;
+}
+
+void sim_replay_sync()
+{
+    uint8_t pui8Record[LORAWAN_RECORD_SIZE];
+    sim_replay_record_t sRun;
+
+    while (!sim_replay_diverged && (lorawan_record_read(sim_replay_run, pui8Record, 1) == 1))
+    {
+        sim_replay_run++;
+        sim_replay_decode(pui8Record, &sRun);
+
+        // The run is compared from its stack start on, like the log.
+        if (!sim_replay_run_started)
+        {
+            if ((sRun.ui8Type != LORAWAN_RECORD_START) &&
+                (sim_replay_log[sim_replay_start].ui8Type == LORAWAN_RECORD_START))
+            {
+                continue;
+            }
+            sim_replay_run_started = true;
+            sim_replay_run_start = sRun.ui32Time;
+        }
+
+        if (sim_replay_cursor >= sim_replay_count)
+        {
+            sim_replay_diverge(&sRun, "the run went on past the end of the log");
+            return;
+        }
+
+        const sim_replay_record_t *psRecord = &sim_replay_log[sim_replay_cursor];
+        if ((sRun.ui8Type != psRecord->ui8Type) || (sRun.ui8Argument != psRecord->ui8Argument) ||
+            (sRun.ui16Value != psRecord->ui16Value))
+        {
+            sim_replay_diverge(&sRun, "the run raised a different record");
+            return;
+        }
+
+        uint32_t ui32Log = sim_replay_elapsed(psRecord);
+        uint32_t ui32Run = sRun.ui32Time - sim_replay_run_start;
+        uint32_t ui32Delta = (ui32Log > ui32Run) ? ui32Log - ui32Run : ui32Run - ui32Log;
+        sim_replay_skew = (ui32Delta > sim_replay_skew) ? ui32Delta : sim_replay_skew;
+        sim_replay_cursor++;
+    }
+}
+
+sim_replay_step_e sim_replay_step_get(uint64_t *pui64Time)
+{
+    if (sim_replay_diverged || (sim_replay_cursor >= sim_replay_count))
+    {
+        return SIM_REPLAY_END;
+    }
+
+    const sim_replay_record_t *psRecord = &sim_replay_log[sim_replay_cursor];
+    uint64_t ui64Time = sim_replay_time(psRecord);
+    uint64_t ui64Now = sim_clock_now();
+
+    // Inputs and radio interrupts are issued in the order of the log, as
+    // soon as the records before them have been reproduced.
+    *pui64Time = (ui64Time > ui64Now) ? ui64Time : ui64Now;
+
+    if (sim_replay_is_input(psRecord))
+    {
+        return SIM_REPLAY_INPUT;
+    }
+
+    if (psRecord->ui8Type == LORAWAN_RECORD_RADIO_IRQ)
+    {
+        return SIM_REPLAY_RADIO;
+    }
+
+    // timer alarms, task wakes, queue receives and receive outcomes follow
+    // from the run itself
+    return SIM_REPLAY_WAIT;
+}
+
+void sim_replay_input()
+{
+    // The payload content does not change the timing, only its size does.
+    static uint8_t pui8Payload[256];
+    const sim_replay_record_t *psRecord = &sim_replay_log[sim_replay_cursor];
+
+    if (psRecord->ui8Type == LORAWAN_RECORD_QUEUE_SEND)
+    {
+        lorawan_transmit_options_t sOptions = {
+            .ui32TimeToLive = 0,
+            .ui32Urgent = (psRecord->ui16Value & LORAWAN_RECORD_QUEUE_URGENT) != 0,
+        };
+
+        lorawan_transmit_with_options(psRecord->ui8Argument,
+                                      (psRecord->ui16Value & LORAWAN_RECORD_QUEUE_CONFIRMED) != 0,
+                                      psRecord->ui16Value & 0xFF,
+                                      pui8Payload,
+                                      &sOptions);
+    }
+    else
+    {
+        lorawan_command_t sCommand = {
+            .eCommand = (lorawan_command_e)psRecord->ui8Argument,
+            .pvParameters = (void *)(uintptr_t)psRecord->ui16Value,
+        };
+
+        lorawan_send_command(&sCommand);
+    }
+}
+
+void sim_replay_radio()
+{
+    static uint8_t pui8Payload[LORAWAN_RADIO_RX_PAYLOAD_MAX];
+    const sim_replay_record_t *psRecord = &sim_replay_log[sim_replay_cursor];
+    uint32_t ui32Rx = LORAWAN_RADIO_RX_NONE;
+    uint32_t ui32Size = 0;
+
+    // The outcome of a receive window is recorded once the LoRaWAN task
+    // has been woken, after the interrupt.
+    for (uint32_t i = sim_replay_cursor + 1; i < sim_replay_count; i++)
+    {
+        const sim_replay_record_t *psNext = &sim_replay_log[i];
+
+        if (psNext->ui8Type == LORAWAN_RECORD_RADIO_IRQ)
+        {
+            break;
+        }
+
+        if (psNext->ui8Type == LORAWAN_RECORD_RX)
+        {
+            ui32Rx = psNext->ui8Argument;
+            while ((ui32Size < psNext->ui16Value) && (ui32Size < LORAWAN_RADIO_RX_PAYLOAD_MAX) &&
+                   (++i < sim_replay_count) &&
+                   (sim_replay_log[i].ui8Type == LORAWAN_RECORD_RX_DATA))
+            {
+                const sim_replay_record_t *psData = &sim_replay_log[i];
+
+                pui8Payload[ui32Size++] = psData->ui8Argument;
+                pui8Payload[ui32Size++] = psData->ui16Value;
+                pui8Payload[ui32Size++] = psData->ui16Value >> 8;
+            }
+            ui32Size = (ui32Size < psNext->ui16Value) ? ui32Size : psNext->ui16Value;
+            break;
+        }
+    }
+
+    if (!sim_radio_event_replay(psRecord->ui8Argument, ui32Rx, pui8Payload, ui32Size))
+    {
+        sim_replay_diverge(NULL, "the radio was not in the recorded state");
+    }
+}
+
+void sim_replay_stalled()
+{
+    sim_replay_diverge(NULL, "the run has no event left to raise it");
+}
+
+void sim_replay_report()
+{
+    uint32_t ui32Total = sim_replay_count - sim_replay_start;
+    uint32_t ui32Matched = sim_replay_cursor - sim_replay_start;
+
+    if (sim_replay_diverged)
+    {
+        const sim_replay_record_t *psRecord = &sim_replay_log[sim_replay_cursor];
+
+        printf("replay           diverged at record %u (%u ms), log %s %u %u: %s\n",
+               ui32Matched,
+               sim_replay_elapsed(psRecord),
+               sim_replay_name(psRecord->ui8Type),
+               psRecord->ui8Argument,
+               psRecord->ui16Value,
+               sim_replay_reason);
+        if (sim_replay_divergence.ui8Type)
+        {
+            printf("                 run %s %u %u\n",
+                   sim_replay_name(sim_replay_divergence.ui8Type),
+                   sim_replay_divergence.ui8Argument,
+                   sim_replay_divergence.ui16Value);
+        }
+    }
+
+    printf("replay           %u of %u records matched  max skew %u ms\n",
+           ui32Matched,
+           ui32Total,
+           sim_replay_skew);
+}
+
+bool sim_replay_save(const char *pcPath)
+{
+    uint8_t pui8Record[LORAWAN_RECORD_SIZE];
+    FILE *psFile = fopen(pcPath, "wb");
+
+    if (psFile == NULL)
+    {
+        return false;
+    }
+
+    for (uint32_t i = 0; lorawan_record_read(i, pui8Record, 1) == 1; i++)
+    {
+        fwrite(pui8Record, 1, LORAWAN_RECORD_SIZE, psFile);
+    }
+    fclose(psFile);
+
+    return true;
+}
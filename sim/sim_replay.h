@@ -0,0 +1,122 @@
+/*
+ * BSD 3-Clause License
+ *
+ * Copyright (c) 2024, Northern Mechatronics, Inc.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its
+ *    contributors may be used to endorse or promote products derived from
+ *    this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+#ifndef _SIM_REPLAY_H_
+#define _SIM_REPLAY_H_
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef enum
+{
+    SIM_REPLAY_WAIT,  ///< the next record of the log follows from the run itself
+    SIM_REPLAY_INPUT, ///< an application input is due
+    SIM_REPLAY_RADIO, ///< a radio interrupt is due
+    SIM_REPLAY_END,   ///< every record was reproduced, or the run diverged
+} sim_replay_step_e;
+
+/**
+ * @brief Load a log of the event recorder (comms/lorawan/lorawan_record.h).
+ *
+ * @param pcPath raw records, see tools/lorawan_record.py to extract them
+ *               from a console log.
+ *
+ * @return false if the file cannot be read or holds no record.
+ *
+ * @remarks
+ * The replay walks the log in order.  The application inputs (uplinks
+ * handed to lorawan_transmit() and commands) and the radio interrupts,
+ * with the recorded outcome and frame of each receive window, are issued
+ * by the replay.  Every other record has to be raised by the run itself
+ * before the replay moves on; the records of the run are matched with the
+ * log as they are written and the replay ends at the first one that
+ * differs.
+ */
+extern bool sim_replay_open(const char *pcPath);
+extern bool sim_replay_active();
+
+/**
+ * @brief Map the stack start of the log onto the virtual clock.
+ *
+ * @param ui64Now virtual time the stack is started at.
+ */
+extern void sim_replay_align(uint64_t ui64Now);
+
+/**
+ * @brief Match the records the run wrote since the last call with the log.
+ */
+extern void sim_replay_sync();
+
+/**
+ * @brief What the replay does next.
+ *
+ * @param pui64Time returns the virtual time of an input or a radio
+ *                  interrupt: the recorded one, or now if it has passed.
+ */
+extern sim_replay_step_e sim_replay_step_get(uint64_t *pui64Time);
+
+/**
+ * @brief Issue the application input of SIM_REPLAY_INPUT.
+ */
+extern void sim_replay_input();
+
+/**
+ * @brief Raise the radio interrupt of SIM_REPLAY_RADIO.
+ *
+ * @remarks
+ * Must be called from within sim_irq_enter() / sim_irq_exit().
+ */
+extern void sim_replay_radio();
+
+/**
+ * @brief End the replay, the run cannot raise the next record of the log.
+ */
+extern void sim_replay_stalled();
+
+/**
+ * @brief Report the records reproduced and the first divergence.
+ */
+extern void sim_replay_report();
+
+/**
+ * @brief Write the records of the run for a later replay.
+ */
+extern bool sim_replay_save(const char *pcPath);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
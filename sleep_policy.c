@@ -0,0 +1,222 @@
+/*
+ * BSD 3-Clause License
+ *
+ * Copyright (c) 2024, Northern Mechatronics, Inc.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its
+ *    contributors may be used to endorse or promote products derived from
+ *    this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+
+#include <am_mcu_apollo.h>
+#include <am_util.h>
+
+#include <FreeRTOS.h>
+
+#include "energy.h"
+
+#include "sleep_policy.h"
+
+static const char *sleep_policy_name[SLEEP_POLICY_MODES + 1] = {"normal", "deep", "auto"};
+
+// Upper bounds of the residency histogram bins in ms.
+static const uint32_t sleep_policy_residency_bound[SLEEP_POLICY_HISTOGRAM_BINS - 1] = {
+    1, 4, 16, 64, 256, 1024, 4096};
+
+static sleep_policy_mode_e sleep_policy_forced;
+
+static sleep_policy_mode_e sleep_policy_mode;
+static uint32_t sleep_policy_since;
+static uint32_t sleep_policy_expected;
+
+// Running averages of the wake-up latency in 1/16 ticks.  They are what
+// the policy has learned and survive a statistics reset.
+static uint32_t sleep_policy_latency[SLEEP_POLICY_MODES];
+static uint32_t sleep_policy_latency_samples[SLEEP_POLICY_MODES];
+static uint32_t sleep_policy_threshold;
+
+static sleep_policy_stats_t sleep_policy_stats;
+
+static uint32_t sleep_policy_residency_bin(uint32_t ui32Ticks)
+{
+    uint32_t ui32Time = (uint32_t)(((uint64_t)ui32Ticks * 1000) / ENERGY_TIMER_HZ);
+    uint32_t i = 0;
+
+    while ((i < SLEEP_POLICY_HISTOGRAM_BINS - 1) && (ui32Time >= sleep_policy_residency_bound[i]))
+    {
+        i++;
+    }
+
+    return i;
+}
+
+static uint32_t sleep_policy_latency_bin(uint32_t ui32Ticks)
+{
+    uint32_t i = 0;
+
+    while ((i < SLEEP_POLICY_HISTOGRAM_BINS - 1) && (ui32Ticks >= (1u << i)))
+    {
+        i++;
+    }
+
+    return i;
+}
+
+static void sleep_policy_threshold_update(void)
+{
+    uint32_t ui32Extra = sleep_policy_latency[SLEEP_POLICY_MODE_DEEP];
+
+    if (sleep_policy_latency_samples[SLEEP_POLICY_MODE_NORMAL])
+    {
+        uint32_t ui32Normal = sleep_policy_latency[SLEEP_POLICY_MODE_NORMAL];
+        ui32Extra = (ui32Extra > ui32Normal) ? ui32Extra - ui32Normal : 0;
+    }
+
+    uint32_t ui32Active = energy_current_get(ENERGY_STATE_MCU_ACTIVE);
+    uint32_t ui32Sleep = energy_current_get(ENERGY_STATE_MCU_SLEEP);
+    uint32_t ui32Deep = energy_current_get(ENERGY_STATE_MCU_DEEP_SLEEP);
+
+    if (ui32Sleep <= ui32Deep)
+    {
+        sleep_policy_threshold = UINT32_MAX;
+        return;
+    }
+
+    // Deep sleep pays off once the charge saved while asleep exceeds the
+    // charge of the extra wake-up time spent at the active current.
+    uint64_t ui64Threshold = ((uint64_t)ui32Extra * ui32Active) / ((ui32Sleep - ui32Deep) * 16);
+    if (ui64Threshold < SLEEP_POLICY_DEEP_MIN)
+    {
+        ui64Threshold = SLEEP_POLICY_DEEP_MIN;
+    }
+
+    sleep_policy_threshold = (ui64Threshold > UINT32_MAX) ? UINT32_MAX : (uint32_t)ui64Threshold;
+}
+
+void sleep_policy_init(void)
+{
+    sleep_policy_forced = SLEEP_POLICY_MODE_AUTO;
+    sleep_policy_mode = SLEEP_POLICY_MODE_DEEP;
+
+    memset(sleep_policy_latency, 0, sizeof(sleep_policy_latency));
+    memset(sleep_policy_latency_samples, 0, sizeof(sleep_policy_latency_samples));
+    sleep_policy_threshold_update();
+
+    sleep_policy_stats_reset();
+}
+
+sleep_policy_mode_e sleep_policy_select(uint32_t ui32IdleTime)
+{
+    uint64_t ui64Expected = ((uint64_t)ui32IdleTime * ENERGY_TIMER_HZ) / configTICK_RATE_HZ;
+
+    sleep_policy_expected = (ui64Expected > UINT32_MAX) ? UINT32_MAX : (uint32_t)ui64Expected;
+
+    if (sleep_policy_forced != SLEEP_POLICY_MODE_AUTO)
+    {
+        sleep_policy_mode = sleep_policy_forced;
+    }
+    else if (sleep_policy_expected >= sleep_policy_threshold)
+    {
+        sleep_policy_mode = SLEEP_POLICY_MODE_DEEP;
+    }
+    else
+    {
+        sleep_policy_mode = SLEEP_POLICY_MODE_NORMAL;
+    }
+
+    sleep_policy_since = am_hal_stimer_counter_get();
+
+    return sleep_policy_mode;
+}
+
+void sleep_policy_wakeup(void)
+{
+    uint32_t ui32Elapsed = am_hal_stimer_counter_get() - sleep_policy_since;
+    sleep_policy_mode_e eMode = sleep_policy_mode;
+
+    AM_CRITICAL_BEGIN
+    sleep_policy_stats.ui64Residency[eMode] += ui32Elapsed;
+    sleep_policy_stats.ui32Entries[eMode]++;
+    sleep_policy_stats.ui32ResidencyHistogram[eMode][sleep_policy_residency_bin(ui32Elapsed)]++;
+
+    if (ui32Elapsed < sleep_policy_expected)
+    {
+        // An interrupt ended the sleep, the latency is unknown.
+        sleep_policy_stats.ui32Early[eMode]++;
+    }
+    else
+    {
+        uint32_t ui32Latency = ui32Elapsed - sleep_policy_expected;
+
+        sleep_policy_stats.ui32LatencyHistogram[eMode][sleep_policy_latency_bin(ui32Latency)]++;
+
+        if (sleep_policy_latency_samples[eMode]++ == 0)
+        {
+            sleep_policy_latency[eMode] = ui32Latency << 4;
+        }
+        else
+        {
+            int32_t i32Delta = (int32_t)((ui32Latency << 4) - sleep_policy_latency[eMode]);
+            sleep_policy_latency[eMode] += i32Delta >> SLEEP_POLICY_AVERAGE_SHIFT;
+        }
+
+        sleep_policy_threshold_update();
+    }
+    AM_CRITICAL_END
+}
+
+void sleep_policy_mode_set(sleep_policy_mode_e eMode)
+{
+    sleep_policy_forced = eMode;
+}
+
+sleep_policy_mode_e sleep_policy_mode_get(void)
+{
+    return sleep_policy_forced;
+}
+
+const char *sleep_policy_mode_name(sleep_policy_mode_e eMode)
+{
+    return sleep_policy_name[eMode];
+}
+
+void sleep_policy_stats_get(sleep_policy_stats_t *psStats)
+{
+    AM_CRITICAL_BEGIN
+    memcpy(psStats, &sleep_policy_stats, sizeof(sleep_policy_stats_t));
+    memcpy(psStats->ui32Latency, sleep_policy_latency, sizeof(sleep_policy_latency));
+    psStats->ui32Threshold = sleep_policy_threshold;
+    AM_CRITICAL_END
+}
+
+void sleep_policy_stats_reset(void)
+{
+    AM_CRITICAL_BEGIN
+    memset(&sleep_policy_stats, 0, sizeof(sleep_policy_stats_t));
+    AM_CRITICAL_END
+}
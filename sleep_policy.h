@@ -0,0 +1,124 @@
+/*
+ * BSD 3-Clause License
+ *
+ * Copyright (c) 2024, Northern Mechatronics, Inc.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its
+ *    contributors may be used to endorse or promote products derived from
+ *    this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+#ifndef _SLEEP_POLICY_H_
+#define _SLEEP_POLICY_H_
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief Shortest expected idle, in STIMER ticks, for which deep sleep is
+ * considered at all.  About 1 ms.
+ */
+#ifndef SLEEP_POLICY_DEEP_MIN
+#define SLEEP_POLICY_DEEP_MIN (33)
+#endif
+
+/**
+ * @brief Weight of a new wake-up latency sample in the running average,
+ * as a power of two.
+ */
+#ifndef SLEEP_POLICY_AVERAGE_SHIFT
+#define SLEEP_POLICY_AVERAGE_SHIFT (3)
+#endif
+
+#define SLEEP_POLICY_HISTOGRAM_BINS (8)
+
+typedef enum
+{
+    SLEEP_POLICY_MODE_NORMAL,
+    SLEEP_POLICY_MODE_DEEP,
+    SLEEP_POLICY_MODES,
+    SLEEP_POLICY_MODE_AUTO = SLEEP_POLICY_MODES
+} sleep_policy_mode_e;
+
+typedef struct
+{
+    uint64_t ui64Residency[SLEEP_POLICY_MODES];    ///< STIMER ticks asleep
+    uint32_t ui32Entries[SLEEP_POLICY_MODES];
+    uint32_t ui32Early[SLEEP_POLICY_MODES];        ///< woken by an interrupt before the idle ended
+    uint32_t ui32Latency[SLEEP_POLICY_MODES];      ///< average wake-up latency in 1/16 ticks
+
+    /// Sleep durations, in bins of under 1, 4, 16, 64, 256, 1024, 4096 ms and above.
+    uint32_t ui32ResidencyHistogram[SLEEP_POLICY_MODES][SLEEP_POLICY_HISTOGRAM_BINS];
+
+    /// Wake-up latencies past the end of the idle, in bins of 0, 1, 2-3, 4-7,
+    /// 8-15, 16-31, 32-63 and 64 or more STIMER ticks.
+    uint32_t ui32LatencyHistogram[SLEEP_POLICY_MODES][SLEEP_POLICY_HISTOGRAM_BINS];
+
+    uint32_t ui32Threshold;                        ///< current deep sleep threshold in ticks
+} sleep_policy_stats_t;
+
+extern void sleep_policy_init(void);
+
+/**
+ * @brief Choose the sleep mode for an idle period.
+ *
+ * Deep sleep is chosen when the expected idle is long enough for its lower
+ * current to pay back the longer wake-up, measured as the difference of the
+ * average wake-up latencies of the two modes and costed at the MCU active
+ * current of the energy accounting.
+ *
+ * Called from am_freertos_sleep with interrupts disabled.
+ *
+ * @param ui32IdleTime  expected idle time in RTOS ticks.
+ *
+ * @return the sleep mode to enter.
+ */
+extern sleep_policy_mode_e sleep_policy_select(uint32_t ui32IdleTime);
+
+/**
+ * @brief Account the sleep that just ended.
+ *
+ * Called from am_freertos_wakeup with interrupts disabled.
+ */
+extern void sleep_policy_wakeup(void);
+
+/**
+ * @brief Force a sleep mode, or return to SLEEP_POLICY_MODE_AUTO.
+ */
+extern void sleep_policy_mode_set(sleep_policy_mode_e eMode);
+extern sleep_policy_mode_e sleep_policy_mode_get(void);
+
+extern const char *sleep_policy_mode_name(sleep_policy_mode_e eMode);
+
+extern void sleep_policy_stats_get(sleep_policy_stats_t *psStats);
+extern void sleep_policy_stats_reset(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
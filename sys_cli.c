@@ -0,0 +1,193 @@
+/*
+ * BSD 3-Clause License
+ *
+ * Copyright (c) 2024, Northern Mechatronics, Inc.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its
+ *    contributors may be used to endorse or promote products derived from
+ *    this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <am_mcu_apollo.h>
+#include <am_util.h>
+
+#include <FreeRTOS.h>
+#include <FreeRTOS_CLI.h>
+
+#include "sys_monitor.h"
+#include "sys_cli.h"
+
+#define COMMAND_LINE_BUFFER_MAX     (128)
+
+static portBASE_TYPE sys_cli_entry(char *pui8OutBuffer,
+                                   size_t ui32OutBufferLength,
+                                   const char *pui8Command);
+
+static CLI_Command_Definition_t sys_cli_definition = {
+    (const char *const) "sys",
+    (const char *const) "sys    :  task load, stack and heap usage\r\n",
+    sys_cli_entry,
+    -1};
+
+static size_t argc;
+static char *argv[8];
+static char argz[COMMAND_LINE_BUFFER_MAX];
+
+// Too large for the stack of the console task.
+static sys_monitor_stats_t sys_cli_stats;
+
+void sys_cli_register(void)
+{
+    FreeRTOS_CLIRegisterCommand(&sys_cli_definition);
+    argc = 0;
+}
+
+static void help(char *pui8OutBuffer, size_t argc, char **argv)
+{
+    am_util_stdio_printf("\r\nusage: sys <command>\r\n");
+    am_util_stdio_printf("\r\n");
+    am_util_stdio_printf("supported commands are:\r\n");
+    am_util_stdio_printf("  tasks    display task CPU load and stack high water marks\r\n");
+    am_util_stdio_printf("  heap     display heap usage\r\n");
+    am_util_stdio_printf("  reset    restart the CPU load measurement\r\n");
+    am_util_stdio_printf("  uplink   <start|stop> [period] [port]\r\n");
+    am_util_stdio_printf("           periodically transmit a compact system report\r\n\r\n");
+}
+
+static void tasks(char *pui8OutBuffer, size_t argc, char **argv)
+{
+    sys_monitor_stats_t *psStats = &sys_cli_stats;
+    sys_monitor_stats_get(psStats);
+
+    am_util_stdio_printf("\r\n");
+    am_util_stdio_printf(" #  Task             Prio  Stack free  Time (ms)   %%\r\n");
+    for (uint32_t i = 0; i < psStats->ui32Tasks; i++)
+    {
+        sys_monitor_task_t *psTask = &psStats->sTask[i];
+        uint32_t ui32Time = (uint32_t)(((uint64_t)psTask->ui32Runtime * 1000) /
+                                       SYS_MONITOR_RUNTIME_HZ);
+
+        am_util_stdio_printf("%2u  %-16s %4u  %10u  %9u  %3u.%u\r\n",
+                             psTask->ui32Number,
+                             psTask->pcName,
+                             psTask->ui32Priority,
+                             psTask->ui32StackFree,
+                             ui32Time,
+                             psTask->ui32Load / 10,
+                             psTask->ui32Load % 10);
+    }
+
+    if (psStats->ui32TasksRunning > psStats->ui32Tasks)
+    {
+        am_util_stdio_printf("\r\n%u tasks running, raise SYS_MONITOR_TASKS_MAX\r\n",
+                             psStats->ui32TasksRunning);
+    }
+}
+
+static void heap(char *pui8OutBuffer, size_t argc, char **argv)
+{
+    sys_monitor_stats_t *psStats = &sys_cli_stats;
+    sys_monitor_stats_get(psStats);
+
+    am_util_stdio_printf("\r\n");
+    am_util_stdio_printf("Heap size     : %u\r\n", psStats->ui32HeapSize);
+    am_util_stdio_printf("Heap free     : %u\r\n", psStats->ui32HeapFree);
+    am_util_stdio_printf("Heap min free : %u\r\n", psStats->ui32HeapMinFree);
+}
+
+static void uplink(char *pui8OutBuffer, size_t argc, char **argv)
+{
+    uint32_t ui32Period = 3600;
+    uint32_t ui32Port = 3;
+
+    if (argc < 3)
+    {
+        return;
+    }
+
+    if (strcmp(argv[2], "stop") == 0)
+    {
+        sys_monitor_uplink_set(0, 0);
+    }
+    else if (strcmp(argv[2], "start") == 0)
+    {
+        if (argc > 3)
+        {
+            ui32Period = strtol(argv[3], NULL, 10);
+        }
+
+        if (argc > 4)
+        {
+            ui32Port = strtol(argv[4], NULL, 10);
+        }
+
+        sys_monitor_uplink_set(ui32Period, ui32Port);
+    }
+}
+
+static portBASE_TYPE
+sys_cli_entry(char *pui8OutBuffer, size_t ui32OutBufferLength, const char *pui8Command)
+{
+    pui8OutBuffer[0] = 0;
+
+    memset(argz, 0, COMMAND_LINE_BUFFER_MAX);
+    strcpy(argz, pui8Command);
+    FreeRTOS_CLIExtractParameters(argz, &argc, argv);
+
+    if (argc < 2)
+    {
+        tasks(pui8OutBuffer, argc, argv);
+        heap(pui8OutBuffer, argc, argv);
+    }
+    else if (strcmp(argv[1], "help") == 0)
+    {
+        help(pui8OutBuffer, argc, argv);
+    }
+    else if (strcmp(argv[1], "tasks") == 0)
+    {
+        tasks(pui8OutBuffer, argc, argv);
+    }
+    else if (strcmp(argv[1], "heap") == 0)
+    {
+        heap(pui8OutBuffer, argc, argv);
+    }
+    else if (strcmp(argv[1], "reset") == 0)
+    {
+        sys_monitor_stats_reset();
+    }
+    else if (strcmp(argv[1], "uplink") == 0)
+    {
+        uplink(pui8OutBuffer, argc, argv);
+    }
+    else
+    {
+        help(pui8OutBuffer, argc, argv);
+    }
+
+    return pdFALSE;
+}
@@ -0,0 +1,260 @@
+/*
+ * BSD 3-Clause License
+ *
+ * Copyright (c) 2024, Northern Mechatronics, Inc.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its
+ *    contributors may be used to endorse or promote products derived from
+ *    this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+
+#include <am_mcu_apollo.h>
+#include <am_util.h>
+
+#include <FreeRTOS.h>
+#include <task.h>
+#include <timers.h>
+
+#include "lorawan.h"
+
+#include "sys_monitor.h"
+
+#if (configUSE_TRACE_FACILITY != 1)
+#error "uxTaskGetSystemState requires configUSE_TRACE_FACILITY, see config/FreeRTOSConfig.h"
+#endif
+
+#if (configGENERATE_RUN_TIME_STATS != 1)
+#error "the task loads require configGENERATE_RUN_TIME_STATS, see config/FreeRTOSConfig.h"
+#endif
+
+typedef struct
+{
+    uint32_t ui32Tasks;
+    uint32_t ui32Number[SYS_MONITOR_TASKS_MAX];
+    uint32_t ui32Runtime[SYS_MONITOR_TASKS_MAX];
+    uint32_t ui32Total;
+} sys_monitor_mark_t;
+
+// Counters at the last reset and at the last report.  Loads are computed
+// against one of them.
+static sys_monitor_mark_t sys_monitor_reset_mark;
+static sys_monitor_mark_t sys_monitor_uplink_mark;
+
+// Shared by the callers, only used with the scheduler suspended.
+static TaskStatus_t sys_monitor_status[SYS_MONITOR_TASKS_MAX];
+
+// Too large for the stack of the timer service task and of the console.
+static sys_monitor_stats_t sys_monitor_uplink_stats;
+static sys_monitor_stats_t sys_monitor_reset_stats;
+
+static TimerHandle_t sys_monitor_uplink_timer;
+static uint32_t sys_monitor_uplink_port;
+
+static uint32_t sys_monitor_mark_find(sys_monitor_mark_t *psMark, uint32_t ui32Number)
+{
+    for (uint32_t i = 0; i < psMark->ui32Tasks; i++)
+    {
+        if (psMark->ui32Number[i] == ui32Number)
+        {
+            return psMark->ui32Runtime[i];
+        }
+    }
+
+    return 0;
+}
+
+static void sys_monitor_sample(sys_monitor_stats_t *psStats, sys_monitor_mark_t *psMark, bool bMark)
+{
+    uint32_t ui32Total = 0;
+    UBaseType_t uxTasks;
+
+    memset(psStats, 0, sizeof(sys_monitor_stats_t));
+
+    vTaskSuspendAll();
+
+    // Returns no task at all when they do not fit.
+    uxTasks = uxTaskGetSystemState(sys_monitor_status, SYS_MONITOR_TASKS_MAX, &ui32Total);
+    psStats->ui32TasksRunning = uxTaskGetNumberOfTasks();
+
+    psStats->ui32Runtime = ui32Total - psMark->ui32Total;
+
+    for (uint32_t i = 0; i < uxTasks; i++)
+    {
+        TaskStatus_t *psStatus = &sys_monitor_status[i];
+
+        // Insert ordered by task number so that reports line up.
+        uint32_t j = i;
+        while ((j > 0) && (psStats->sTask[j - 1].ui32Number > psStatus->xTaskNumber))
+        {
+            psStats->sTask[j] = psStats->sTask[j - 1];
+            j--;
+        }
+
+        sys_monitor_task_t *psTask = &psStats->sTask[j];
+        strncpy(psTask->pcName, psStatus->pcTaskName, configMAX_TASK_NAME_LEN - 1);
+        psTask->pcName[configMAX_TASK_NAME_LEN - 1] = 0;
+        psTask->ui32Number = psStatus->xTaskNumber;
+        psTask->ui32Priority = psStatus->uxCurrentPriority;
+        psTask->ui32StackFree = psStatus->usStackHighWaterMark;
+        psTask->ui32Runtime =
+            psStatus->ulRunTimeCounter - sys_monitor_mark_find(psMark, psStatus->xTaskNumber);
+        psTask->ui32Load = psStats->ui32Runtime
+                               ? (uint32_t)(((uint64_t)psTask->ui32Runtime * 1000) /
+                                            psStats->ui32Runtime)
+                               : 0;
+    }
+    psStats->ui32Tasks = uxTasks;
+
+    if (bMark)
+    {
+        for (uint32_t i = 0; i < uxTasks; i++)
+        {
+            psMark->ui32Number[i] = sys_monitor_status[i].xTaskNumber;
+            psMark->ui32Runtime[i] = sys_monitor_status[i].ulRunTimeCounter;
+        }
+        psMark->ui32Tasks = uxTasks;
+        psMark->ui32Total = ui32Total;
+    }
+
+    xTaskResumeAll();
+
+    psStats->ui32HeapSize = configTOTAL_HEAP_SIZE;
+    psStats->ui32HeapFree = xPortGetFreeHeapSize();
+    psStats->ui32HeapMinFree = xPortGetMinimumEverFreeHeapSize();
+}
+
+void sys_monitor_init(void)
+{
+    memset(&sys_monitor_reset_mark, 0, sizeof(sys_monitor_reset_mark));
+    memset(&sys_monitor_uplink_mark, 0, sizeof(sys_monitor_uplink_mark));
+
+    sys_monitor_uplink_timer = NULL;
+}
+
+void sys_monitor_stats_get(sys_monitor_stats_t *psStats)
+{
+    sys_monitor_sample(psStats, &sys_monitor_reset_mark, false);
+}
+
+void sys_monitor_stats_reset(void)
+{
+    sys_monitor_sample(&sys_monitor_reset_stats, &sys_monitor_reset_mark, true);
+}
+
+static void sys_monitor_uplink_callback(TimerHandle_t handle)
+{
+    sys_monitor_stats_t *psStats = &sys_monitor_uplink_stats;
+    uint8_t pui8Payload[3 + 3 * SYS_MONITOR_TASKS_MAX];
+    bool pbSelected[SYS_MONITOR_TASKS_MAX] = {false};
+    uint32_t ui32Index = 0;
+
+    sys_monitor_sample(psStats, &sys_monitor_uplink_mark, true);
+
+    uint32_t ui32Size = lorawan_transmit_size_max_get();
+    if (ui32Size < 3)
+    {
+        return;
+    }
+
+    // Keep the busiest tasks that fit, the others are idle enough not to
+    // matter between two reports.
+    uint32_t ui32Selected = (ui32Size - 3) / 3;
+    ui32Selected = (ui32Selected < psStats->ui32Tasks) ? ui32Selected : psStats->ui32Tasks;
+    for (uint32_t n = 0; n < ui32Selected; n++)
+    {
+        uint32_t ui32Busiest = 0;
+        int32_t i32Load = -1;
+        for (uint32_t i = 0; i < psStats->ui32Tasks; i++)
+        {
+            if (!pbSelected[i] && ((int32_t)psStats->sTask[i].ui32Load > i32Load))
+            {
+                ui32Busiest = i;
+                i32Load = psStats->sTask[i].ui32Load;
+            }
+        }
+        pbSelected[ui32Busiest] = true;
+    }
+
+    uint32_t ui32Heap = psStats->ui32HeapMinFree;
+    ui32Heap = (ui32Heap > UINT16_MAX) ? UINT16_MAX : ui32Heap;
+    pui8Payload[ui32Index++] = SYS_MONITOR_UPLINK_FORMAT_VERSION;
+    pui8Payload[ui32Index++] = ui32Heap & 0xFF;
+    pui8Payload[ui32Index++] = (ui32Heap >> 8) & 0xFF;
+
+    for (uint32_t i = 0; i < psStats->ui32Tasks; i++)
+    {
+        sys_monitor_task_t *psTask = &psStats->sTask[i];
+
+        if (!pbSelected[i])
+        {
+            continue;
+        }
+
+        pui8Payload[ui32Index++] = psTask->ui32Number & 0xFF;
+        pui8Payload[ui32Index++] = (psTask->ui32Load + 5) / 10;
+        pui8Payload[ui32Index++] = (psTask->ui32StackFree > UINT8_MAX) ? UINT8_MAX
+                                                                       : psTask->ui32StackFree;
+    }
+
+    lorawan_transmit(sys_monitor_uplink_port, 0, ui32Index, pui8Payload);
+}
+
+void sys_monitor_uplink_set(uint32_t ui32Period, uint32_t ui32Port)
+{
+    if (ui32Period == 0)
+    {
+        if (sys_monitor_uplink_timer)
+        {
+            xTimerStop(sys_monitor_uplink_timer, portMAX_DELAY);
+            xTimerDelete(sys_monitor_uplink_timer, portMAX_DELAY);
+            sys_monitor_uplink_timer = NULL;
+        }
+        return;
+    }
+
+    sys_monitor_uplink_port = ui32Port;
+
+    if (sys_monitor_uplink_timer == NULL)
+    {
+        // Loads in the first report are measured from now.
+        sys_monitor_sample(&sys_monitor_uplink_stats, &sys_monitor_uplink_mark, true);
+
+        sys_monitor_uplink_timer = xTimerCreate("sys uplink",
+                                                pdMS_TO_TICKS(ui32Period * 1000),
+                                                pdTRUE,
+                                                NULL,
+                                                sys_monitor_uplink_callback);
+        xTimerStart(sys_monitor_uplink_timer, portMAX_DELAY);
+    }
+    else
+    {
+        xTimerChangePeriod(sys_monitor_uplink_timer,
+                           pdMS_TO_TICKS(ui32Period * 1000),
+                           portMAX_DELAY);
+    }
+}
@@ -0,0 +1,124 @@
+/*
+ * BSD 3-Clause License
+ *
+ * Copyright (c) 2024, Northern Mechatronics, Inc.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its
+ *    contributors may be used to endorse or promote products derived from
+ *    this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+#ifndef _SYS_MONITOR_H_
+#define _SYS_MONITOR_H_
+
+#include <stdint.h>
+
+#include <FreeRTOS.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief Frequency of the run-time stats counter.
+ *
+ * The kernel samples the STIMER, which also drives the tickless idle, as
+ * set up in config/FreeRTOSConfig.h.
+ */
+#ifndef SYS_MONITOR_RUNTIME_HZ
+#define SYS_MONITOR_RUNTIME_HZ (32768)
+#endif
+
+/**
+ * @brief Most tasks reported, including the idle and timer service tasks.
+ *
+ * The application, with the LoRaWAN tracing, event bus, port worker and
+ * fragment erase tasks, runs eleven.  With more tasks than this nothing is
+ * reported, see sys_monitor_stats_t.ui32TasksRunning.
+ */
+#ifndef SYS_MONITOR_TASKS_MAX
+#define SYS_MONITOR_TASKS_MAX (24)
+#endif
+
+#define SYS_MONITOR_UPLINK_FORMAT_VERSION (1)
+
+typedef struct
+{
+    char pcName[configMAX_TASK_NAME_LEN];
+    uint32_t ui32Number;       ///< FreeRTOS task number, stable for the task life
+    uint32_t ui32Priority;
+    uint32_t ui32StackFree;    ///< stack high water mark in words
+    uint32_t ui32Runtime;      ///< run-time counter ticks since the last reset
+    uint32_t ui32Load;         ///< share of the run time in 0.1 %
+} sys_monitor_task_t;
+
+typedef struct
+{
+    uint32_t ui32Tasks;
+    uint32_t ui32TasksRunning; ///< tasks in the system, more than ui32Tasks if they do not fit
+    sys_monitor_task_t sTask[SYS_MONITOR_TASKS_MAX]; ///< ordered by task number
+    uint32_t ui32Runtime;      ///< run-time counter ticks since the last reset
+    uint32_t ui32HeapSize;
+    uint32_t ui32HeapFree;
+    uint32_t ui32HeapMinFree;  ///< lowest free heap since boot
+} sys_monitor_stats_t;
+
+extern void sys_monitor_init(void);
+
+/**
+ * @brief Take a snapshot of the tasks, their stack headroom and CPU load
+ * since the last reset, and of the heap.
+ *
+ * @remarks The stack headroom is the value of uxTaskGetStackHighWaterMark.
+ * The run-time counter is 32 bits wide and the loads are only meaningful
+ * when reset at least once every 36 hours at 32768 Hz.
+ */
+extern void sys_monitor_stats_get(sys_monitor_stats_t *psStats);
+extern void sys_monitor_stats_reset(void);
+
+/**
+ * @brief Periodically transmit a compact system report.
+ *
+ * The payload is:
+ *   byte 0      format version
+ *   bytes 1-2   heap minimum ever free in bytes, uint16 little endian,
+ *               saturated
+ *   then for the busiest tasks, ordered by task number
+ *   byte 0      task number
+ *   byte 1      CPU load since the last report in %
+ *   byte 2      stack high water mark in words, saturated at 255
+ *
+ * The report is cut to the tasks with the highest load that fit the
+ * payload allowed at the current data rate, e.g. two at US915 DR0.
+ *
+ * @param ui32Period  report period in seconds, 0 to stop.
+ * @param ui32Port    LoRaWAN port to report on.
+ */
+extern void sys_monitor_uplink_set(uint32_t ui32Period, uint32_t ui32Port);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
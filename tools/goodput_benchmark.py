@@ -0,0 +1,119 @@
+#!/usr/bin/env python3
+# ******************************************************************************
+#
+# Goodput versus data rate benchmark
+#
+# Runs sim/lorawan_sim once per data rate with the uplink segmentation
+# enabled and tabulates the application bytes delivered per second of
+# virtual time, the frames sent per message and the airtime spent per
+# application byte.  Back to back uplinks (-p 0) measure the rate the
+# stack sustains; give a period to measure a duty cycled application.
+#
+#   python3 tools/goodput_benchmark.py --sim build/sim/lorawan_sim -s 200
+#
+# ******************************************************************************
+
+import argparse
+import csv
+import re
+import subprocess
+import sys
+
+DATARATES = {
+    'us915': range(0, 5),
+    'au915': range(0, 7),
+    'eu868': range(0, 6),
+    'eu433': range(0, 6),
+    'in865': range(0, 6),
+    'kr920': range(0, 6),
+    'ru864': range(0, 6),
+    'as923': range(0, 6),
+    'cn470': range(0, 6),
+    'cn779': range(0, 6),
+}
+
+PATTERNS = {
+    'virtual': re.compile(r'^virtual time\s+([\d.]+) s'),
+    'uplinks': re.compile(r'^uplinks\s+requested (\d+)\s+dropped (\d+)\s+failed (\d+)'
+                          r'\s+completed (\d+)'),
+    'radio': re.compile(r'^radio\s+tx (\d+)\s+lost (\d+)\s+airtime (\d+) ms'),
+    'goodput': re.compile(r'^goodput\s+([\d.]+) B/s\s+(\d+) segmented\s+(\d+) segments'),
+}
+
+
+def run(args, datarate):
+    command = [args.sim, '-r', args.region, '-d', str(datarate), '-n', str(args.uplinks),
+               '-p', str(args.period), '-s', str(args.size), '-g'] + args.extra
+    output = subprocess.run(command, capture_output=True, text=True, timeout=args.timeout)
+
+    result = {'dr': datarate}
+    for line in output.stdout.splitlines():
+        for name, pattern in PATTERNS.items():
+            match = pattern.match(line)
+            if match:
+                result[name] = match.groups()
+    if 'goodput' not in result:
+        print('DR%d: no report (exit %d)' % (datarate, output.returncode), file=sys.stderr)
+        print(output.stdout + output.stderr, file=sys.stderr)
+        return None
+
+    completed = int(result['uplinks'][3])
+    frames = int(result['radio'][0])
+    airtime = int(result['radio'][2])
+    return {
+        'dr': datarate,
+        'completed': completed,
+        'failed': int(result['uplinks'][2]),
+        'frames': frames,
+        'frames_per_message': frames / completed if completed else 0.0,
+        'segmented': int(result['goodput'][1]),
+        'goodput': float(result['goodput'][0]),
+        'airtime': airtime,
+        'airtime_per_byte': airtime / (completed * args.size) if completed else 0.0,
+        'virtual': float(result['virtual'][0]),
+    }
+
+# ******************************************************************************
+#
+# Main function
+#
+# ******************************************************************************
+def main():
+    parser = argparse.ArgumentParser(description='LoRaWAN goodput versus data rate')
+    parser.add_argument('--sim', default='build/sim/lorawan_sim', help='simulation binary')
+    parser.add_argument('-r', '--region', choices=sorted(DATARATES), default='us915')
+    parser.add_argument('-d', '--datarates', help='comma separated list (default all)')
+    parser.add_argument('-s', '--size', type=int, default=200, help='message size')
+    parser.add_argument('-n', '--uplinks', type=int, default=50, help='messages per data rate')
+    parser.add_argument('-p', '--period', type=int, default=0, help='message period (ms)')
+    parser.add_argument('--timeout', type=int, default=600, help='seconds per run')
+    parser.add_argument('--csv', help='write the results to this file')
+    parser.add_argument('extra', nargs='*', help='options passed on to the simulation')
+    args = parser.parse_args()
+
+    datarates = DATARATES[args.region]
+    if args.datarates:
+        datarates = [int(x) for x in args.datarates.split(',')]
+
+    print('%s, %d byte messages, %d per data rate' % (args.region, args.size, args.uplinks))
+    print('%-4s %9s %8s %12s %10s %12s %12s'
+          % ('DR', 'completed', 'frames', 'frames/msg', 'goodput', 'airtime', 'airtime/B'))
+    results = []
+    for datarate in datarates:
+        result = run(args, datarate)
+        if result is None:
+            continue
+        results.append(result)
+        print('DR%-2d %9d %8d %12.2f %8.2f B/s %9d ms %9.1f ms'
+              % (datarate, result['completed'], result['frames'], result['frames_per_message'],
+                 result['goodput'], result['airtime'], result['airtime_per_byte']), flush=True)
+
+    if args.csv and results:
+        with open(args.csv, 'w', newline='') as f:
+            writer = csv.DictWriter(f, fieldnames=list(results[0].keys()))
+            writer.writeheader()
+            writer.writerows(results)
+
+
+if __name__ == '__main__':
+    main()
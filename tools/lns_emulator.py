@@ -0,0 +1,1015 @@
+#!/usr/bin/env python3
+# ******************************************************************************
+#
+# LoRaWAN network server emulator for the host simulation
+#
+# Stands in for a gateway and a network server in end-to-end benchmarks of
+# sim/lorawan_sim.  The simulation exchanges radio frames with this process
+# over UDP on the loopback interface, stamped with its virtual clock, so
+# every receive window and class C session is scheduled in simulated time.
+#
+# Implemented:
+#   - OTAA join accept (LoRaWAN 1.0.x key derivation) and ABP sessions
+#   - uplink MIC and frame counter validation, payload decryption
+#   - RX1 / RX2 downlink scheduling for US915 and EU868
+#   - ACK, LinkCheckAns, DeviceTimeAns and ADR (LinkADRReq)
+#   - remote multicast setup and fragmented data block transport (FUOTA)
+#   - reassembly of segmented uplinks (tools/lorawan_segments.py)
+#   - class C downlink bursts to stress the device receive path
+#   - collisions between the uplinks of simulations sharing the emulator
+#   - per-message latency and airtime report
+#
+# ******************************************************************************
+
+import argparse
+import collections
+import csv
+import math
+import socket
+import struct
+import zlib
+
+from Crypto.Cipher import AES
+from Crypto.Hash import CMAC
+
+from lorawan_segments import Reassembler, SEGMENT_PORT
+
+# ******************************************************************************
+#
+# Link protocol, all fields little endian.  Every request from the simulation
+# is answered with zero or more DOWNLINK messages followed by one ACK.
+#
+#   SYNC      type u8, version u8, rsvd u16, now u64, next u64, on air u64
+#   UPLINK    type u8, version u8, rsvd u16, start u64, end u64, freq u32,
+#             sf u8, bw u8, rssi i16, snr i8, size u8, payload
+#   END       type u8, version u8, rsvd u16
+#   DOWNLINK  type u8, version u8, rsvd u16, start u64, freq u32, sf u8,
+#             bw u8, size u8, payload
+#   ACK       type u8, version u8, rsvd u16, next event u64
+#
+# On air is the start of the frame being transmitted, all ones if none.
+#
+# ******************************************************************************
+LINK_VERSION = 2
+
+LINK_SYNC = 0x01
+LINK_UPLINK = 0x02
+LINK_END = 0x03
+LINK_DOWNLINK = 0x81
+LINK_ACK = 0x82
+
+LINK_HEADER = struct.Struct('<BBH')
+LINK_SYNC_BODY = struct.Struct('<QQQ')
+LINK_UPLINK_BODY = struct.Struct('<QQIBBhbB')
+LINK_DOWNLINK_BODY = struct.Struct('<QIBBB')
+LINK_ACK_BODY = struct.Struct('<Q')
+
+LINK_NO_EVENT = 0xFFFFFFFFFFFFFFFF
+
+# Downlinks starting within this many ms of the next simulation event are
+# handed over, so they are queued before the receive window opens.
+LINK_LOOKAHEAD = 1000
+
+# An uplink overlapping another one on the same frequency, spreading factor
+# and bandwidth is still received if it is this much stronger (dB).
+CAPTURE_THRESHOLD = 6
+
+# ******************************************************************************
+#
+# LoRaWAN constants
+#
+# ******************************************************************************
+MTYPE_JOIN_REQUEST = 0
+MTYPE_JOIN_ACCEPT = 1
+MTYPE_UNCONFIRMED_UP = 2
+MTYPE_UNCONFIRMED_DOWN = 3
+MTYPE_CONFIRMED_UP = 4
+MTYPE_CONFIRMED_DOWN = 5
+
+RECEIVE_DELAY1 = 1000
+RECEIVE_DELAY2 = 2000
+JOIN_ACCEPT_DELAY1 = 5000
+JOIN_ACCEPT_DELAY2 = 6000
+
+# The emulated network clock: GPS seconds at virtual time 0.
+GPS_EPOCH_AT_START = 1400000000
+
+# Uplink MAC commands: CID -> payload length
+UPLINK_MAC_COMMANDS = {
+    0x01: 1,  # ResetInd
+    0x02: 0,  # LinkCheckReq
+    0x03: 1,  # LinkADRAns
+    0x04: 0,  # DutyCycleAns
+    0x05: 1,  # RXParamSetupAns
+    0x06: 2,  # DevStatusAns
+    0x07: 1,  # NewChannelAns
+    0x08: 0,  # RXTimingSetupAns
+    0x09: 0,  # TxParamSetupAns
+    0x0A: 1,  # DlChannelAns
+    0x0B: 1,  # RekeyInd
+    0x0C: 1,  # ADRParamSetupAns
+    0x0D: 0,  # DeviceTimeReq
+    0x0F: 1,  # RejoinParamSetupAns
+    0x10: 1,  # PingSlotInfoReq
+    0x11: 1,  # PingSlotChannelAns
+    0x12: 0,  # BeaconTimingReq
+    0x13: 1,  # BeaconFreqAns
+}
+
+# Demodulation floor per spreading factor (dB)
+REQUIRED_SNR = {7: -7.5, 8: -10.0, 9: -12.5, 10: -15.0, 11: -17.5, 12: -20.0}
+
+# Application layer packages
+REMOTE_MCAST_PORT = 200
+FRAGMENTATION_PORT = 201
+
+# ******************************************************************************
+#
+# Regional parameters
+#
+# ******************************************************************************
+class US915:
+    name = 'us915'
+    uplink = {0: (10, 0), 1: (9, 0), 2: (8, 0), 3: (7, 0), 4: (8, 2)}
+    downlink = {8: (12, 2), 9: (11, 2), 10: (10, 2), 11: (9, 2), 12: (8, 2), 13: (7, 2)}
+    rx1_datarate = {0: 10, 1: 11, 2: 12, 3: 13, 4: 13}
+    rx2_frequency = 923300000
+    rx2_datarate = 8
+    multicast_datarate = 13
+    adr_max_datarate = 3
+    adr_max_power = 10
+
+    @staticmethod
+    def rx1_frequency(frequency, bandwidth):
+        if bandwidth == 0:
+            channel = (frequency - 902300000) // 200000
+        else:
+            channel = 64 + (frequency - 903000000) // 1600000
+        return 923300000 + (channel % 8) * 600000
+
+    @staticmethod
+    def adr_channel_mask():
+        # ChMaskCntl 6: all 125 kHz channels on, mask applies to 64..71
+        return 0x00FF, 6
+
+
+class EU868:
+    name = 'eu868'
+    uplink = {0: (12, 0), 1: (11, 0), 2: (10, 0), 3: (9, 0), 4: (8, 0), 5: (7, 0), 6: (7, 1)}
+    downlink = uplink
+    rx1_datarate = {dr: dr for dr in range(7)}
+    rx2_frequency = 869525000
+    rx2_datarate = 0
+    multicast_datarate = 5
+    adr_max_datarate = 5
+    adr_max_power = 7
+
+    @staticmethod
+    def rx1_frequency(frequency, bandwidth):
+        return frequency
+
+    @staticmethod
+    def adr_channel_mask():
+        # the three default channels
+        return 0x0007, 0
+
+
+REGIONS = {region.name: region for region in (US915, EU868)}
+
+# ******************************************************************************
+#
+# Helpers
+#
+# ******************************************************************************
+def time_on_air(sf, bw, size, preamble=8, coderate=1, crc=True, implicit=False):
+    bandwidth = (125000, 250000, 500000)[bw]
+    symbol = (1 << sf) / bandwidth
+    low_datarate = (symbol * 1000) > 16
+    numerator = 8 * size - 4 * sf + 28 + (16 if crc else 0) - (20 if implicit else 0)
+    denominator = 4 * (sf - (2 if low_datarate else 0))
+    payload = 8 + max(math.ceil(numerator / denominator) * (coderate + 4), 0)
+    return int(math.ceil((preamble + 4.25 + payload) * symbol * 1000))
+
+
+def aes_encrypt(key, block):
+    return AES.new(key, AES.MODE_ECB).encrypt(block)
+
+
+def aes_decrypt(key, block):
+    return AES.new(key, AES.MODE_ECB).decrypt(block)
+
+
+def aes_cmac(key, message):
+    mac = CMAC.new(key, ciphermod=AES)
+    mac.update(message)
+    return mac.digest()
+
+
+def block(prefix, direction, address, counter, suffix):
+    return struct.pack('<BIBIIBB', prefix, 0, direction, address, counter, 0, suffix)
+
+
+def frame_mic(key, direction, address, counter, message):
+    b0 = block(0x49, direction, address, counter, len(message))
+    return aes_cmac(key, b0 + message)[:4]
+
+
+def frame_crypt(key, direction, address, counter, payload):
+    stream = b''
+    for i in range((len(payload) + 15) // 16):
+        stream += aes_encrypt(key, block(0x01, direction, address, counter, i + 1))
+    return bytes(a ^ b for a, b in zip(payload, stream))
+
+
+def session_key(key, prefix, *fields):
+    data = bytes([prefix]) + b''.join(fields)
+    return aes_encrypt(key, data.ljust(16, b'\x00'))
+
+
+def unhex(text):
+    return bytes.fromhex(text.replace(':', '').replace('-', ''))
+
+
+def fcnt_extend(last, fcnt16):
+    if last is None:
+        return fcnt16
+    candidate = (last & 0xFFFF0000) | fcnt16
+    if candidate + 0x8000 < last:
+        candidate += 0x10000
+    return candidate
+
+
+def percentile(values, p):
+    ordered = sorted(values)
+    return ordered[min(len(ordered) - 1, (len(ordered) * p) // 100)]
+
+# ******************************************************************************
+#
+# Network state
+#
+# ******************************************************************************
+class Session:
+    def __init__(self, address, nwk_s_key, app_s_key):
+        self.address = address
+        self.nwk_s_key = nwk_s_key
+        self.app_s_key = app_s_key
+        self.fcnt_up = None
+        self.fcnt_down = 0
+        self.snr = []
+        self.adr_datarate = None
+        self.adr_power = 0
+        self.pending_mac = b''
+        self.pending_app = []
+        self.fuota = None
+
+
+class Fuota:
+    # Multicast group and fragmentation session of one device.
+    STATE_GROUP_SETUP = 0
+    STATE_FRAG_SETUP = 1
+    STATE_SESSION_SETUP = 2
+    STATE_SENDING = 3
+    STATE_DONE = 4
+
+    def __init__(self, image, fragment_size, redundancy):
+        padding = (-len(image)) % fragment_size
+        self.image = image
+        self.data = image + b'\x00' * padding
+        self.padding = padding
+        self.fragment_size = fragment_size
+        self.fragments = len(self.data) // fragment_size
+        self.redundancy = redundancy
+        self.state = Fuota.STATE_GROUP_SETUP
+        self.started = None
+        self.finished = None
+        self.airtime = 0
+        self.sent = 0
+
+    def fragment(self, n):
+        # n is 1 based.  Beyond the data fragments, send the coded fragments
+        # of the LoRa Alliance parity matrix used by FragDecoder.
+        m = self.fragments
+        size = self.fragment_size
+        if n <= m:
+            return self.data[(n - 1) * size:n * size]
+        row = parity_matrix_row(n - m, m)
+        out = bytearray(size)
+        for i in range(m):
+            if row[i]:
+                chunk = self.data[i * size:(i + 1) * size]
+                for j in range(size):
+                    out[j] ^= chunk[j]
+        return bytes(out)
+
+
+def prbs23(value):
+    b0 = value & 1
+    b1 = (value & 32) >> 5
+    return (value >> 1) + ((b0 ^ b1) << 22)
+
+
+def parity_matrix_row(n, m):
+    m_temp = 1 if (m & (m - 1)) == 0 else 0
+    x = 1 + 1001 * n
+    row = [0] * m
+    coefficients = 0
+    while coefficients < (m >> 1):
+        r = 1 << 16
+        while r >= m:
+            x = prbs23(x)
+            r = x % (m + m_temp)
+        row[r] = 1
+        coefficients += 1
+    return row
+
+
+class Network:
+    def __init__(self, args):
+        self.args = args
+        self.region = REGIONS[args.region]
+        self.app_key = unhex(args.app_key)
+        self.net_id = args.net_id
+        self.sessions = {}
+        self.dev_nonces = {}
+        self.next_address = args.otaa_address
+        self.join_nonce = 1
+        self.now = 0
+        self.queue = []
+        self.log = []
+        self.counters = {
+            'uplinks': 0, 'duplicates': 0, 'mic_errors': 0, 'replays': 0,
+            'unknown': 0, 'collisions': 0, 'joins': 0, 'downlinks': 0, 'adr': 0,
+        }
+        self.segments = Reassembler()
+        self.mc_key = unhex(args.mc_key)
+        self.mc_address = args.mc_address
+        self.mc_fcnt = 0
+        self.image = None
+        if args.fuota:
+            with open(args.fuota, 'rb') as f:
+                self.image = f.read()
+
+        for i in range(args.abp_devices):
+            address = args.abp_address + i
+            self.sessions[address] = Session(address, unhex(args.nwk_s_key), unhex(args.app_s_key))
+
+    def gps_time(self, time_ms):
+        return GPS_EPOCH_AT_START + time_ms / 1000.0
+
+    def record(self, kind, address, time_ms, fcnt, port, size, airtime, latency, note=''):
+        entry = {
+            'time': time_ms, 'type': kind, 'device': '%08X' % address, 'fcnt': fcnt,
+            'port': '' if port is None else port, 'size': size, 'airtime': airtime,
+            'latency': '' if latency is None else latency, 'note': note,
+        }
+        self.log.append(entry)
+        if self.args.verbose:
+            print('%10d ms  %-8s %s  fcnt %-5s port %-3s %3d B  airtime %4d ms  latency %s %s'
+                  % (time_ms, kind, entry['device'], fcnt, entry['port'], size, airtime,
+                     entry['latency'], note), flush=True)
+
+    # --------------------------------------------------------------------------
+    # Scheduling
+    # --------------------------------------------------------------------------
+    def schedule(self, start, frequency, datarate, payload, address):
+        sf, bw = self.region.downlink[datarate]
+        self.queue.append((start, frequency, sf, bw, payload, address))
+        self.queue.sort(key=lambda d: d[0])
+        return time_on_air(sf, bw, len(payload), crc=False)
+
+    def schedule_class_a(self, address, end, sf, bw, frequency, payload, delay1, delay2):
+        up_datarate = next(dr for dr, mod in self.region.uplink.items() if mod == (sf, bw))
+        if self.args.rx2:
+            start = end + delay2
+            frequency = self.region.rx2_frequency
+            datarate = self.region.rx2_datarate
+        else:
+            start = end + delay1
+            frequency = self.region.rx1_frequency(frequency, bw)
+            datarate = self.region.rx1_datarate[up_datarate]
+        airtime = self.schedule(start, frequency, datarate, payload, address)
+        return start, airtime
+
+    def sync(self, now, next_event, devices):
+        # hand over the downlinks of the devices of one simulation
+        self.now = max(self.now, now)
+        self.fuota_pump(next_event)
+        horizon = next_event + LINK_LOOKAHEAD
+        due = [d[:5] for d in self.queue if d[5] in devices and d[0] <= horizon]
+        self.queue = [d for d in self.queue if d[5] not in devices or d[0] > horizon]
+        return due, self.later(devices)
+
+    def later(self, devices):
+        for d in self.queue:
+            if d[5] in devices:
+                return d[0] - LINK_LOOKAHEAD
+        return LINK_NO_EVENT
+
+    # --------------------------------------------------------------------------
+    # Uplinks
+    # --------------------------------------------------------------------------
+    def uplink(self, start, end, frequency, sf, bw, rssi, snr, payload):
+        # returns the address of the device that sent it, None if unknown
+        self.now = max(self.now, end)
+        airtime = end - start
+        if len(payload) < 1:
+            return None
+        mtype = payload[0] >> 5
+        if mtype == MTYPE_JOIN_REQUEST:
+            return self.join_request(end, frequency, sf, bw, payload, airtime)
+        if mtype in (MTYPE_UNCONFIRMED_UP, MTYPE_CONFIRMED_UP):
+            self.data_uplink(end, frequency, sf, bw, snr, payload, airtime)
+            if len(payload) >= 5:
+                return struct.unpack_from('<I', payload, 1)[0]
+        return None
+
+    def collision(self, start, end, payload):
+        # lost on air, the network server never sees it
+        address = 0
+        if len(payload) >= 5 and (payload[0] >> 5) != MTYPE_JOIN_REQUEST:
+            address = struct.unpack_from('<I', payload, 1)[0]
+        self.counters['collisions'] += 1
+        self.record('collision', address, end, '', None, len(payload), end - start, None)
+
+    def join_request(self, end, frequency, sf, bw, payload, airtime):
+        if len(payload) != 23:
+            return
+        mhdr = payload[:1]
+        join_eui = payload[1:9]
+        dev_eui = payload[9:17]
+        dev_nonce = struct.unpack('<H', payload[17:19])[0]
+        if aes_cmac(self.app_key, payload[:19])[:4] != payload[19:]:
+            self.counters['mic_errors'] += 1
+            self.record('join-req', 0, end, dev_nonce, None, len(payload), airtime, None, 'MIC')
+            return
+
+        key = dev_eui[::-1].hex()
+        last = self.dev_nonces.get(key)
+        if last is not None and dev_nonce <= last:
+            self.counters['replays'] += 1
+            self.record('join-req', 0, end, dev_nonce, None, len(payload), airtime, None,
+                        'DevNonce replay')
+            return
+        self.dev_nonces[key] = dev_nonce
+
+        address = self.next_address
+        self.next_address += 1
+        join_nonce = struct.pack('<I', self.join_nonce)[:3]
+        self.join_nonce += 1
+        net_id = struct.pack('<I', self.net_id)[:3]
+        nonce = struct.pack('<H', dev_nonce)
+
+        # LoRaWAN 1.0.x join accept (OptNeg cleared)
+        dl_settings = self.region.rx2_datarate & 0x0F
+        body = join_nonce + net_id + struct.pack('<IBB', address, dl_settings, 1)
+        accept = bytes([MTYPE_JOIN_ACCEPT << 5])
+        mic = aes_cmac(self.app_key, accept + body)[:4]
+        accept += aes_decrypt(self.app_key, body + mic)
+
+        nwk_s_key = session_key(self.app_key, 0x01, join_nonce, net_id, nonce)
+        app_s_key = session_key(self.app_key, 0x02, join_nonce, net_id, nonce)
+        session = Session(address, nwk_s_key, app_s_key)
+        session.dev_eui = key
+        session.join_end = end
+        self.sessions[address] = session
+
+        self.counters['joins'] += 1
+        self.record('join-req', address, end, dev_nonce, None, len(payload), airtime, None, key)
+        start, down_airtime = self.schedule_class_a(address, end, sf, bw, frequency, accept,
+                                                    JOIN_ACCEPT_DELAY1, JOIN_ACCEPT_DELAY2)
+        self.counters['downlinks'] += 1
+        self.record('join-acc', address, start + down_airtime, 0, None, len(accept),
+                    down_airtime, start + down_airtime - end)
+        return address
+
+    def data_uplink(self, end, frequency, sf, bw, snr, payload, airtime):
+        if len(payload) < 12:
+            return
+        mhdr = payload[0]
+        address, fctrl, fcnt16 = struct.unpack('<IBH', payload[1:8])
+        fopts_len = fctrl & 0x0F
+        session = self.sessions.get(address)
+        if session is None:
+            self.counters['unknown'] += 1
+            return
+
+        fcnt = fcnt_extend(session.fcnt_up, fcnt16)
+        message, mic = payload[:-4], payload[-4:]
+        if frame_mic(session.nwk_s_key, 0, address, fcnt, message) != mic:
+            self.counters['mic_errors'] += 1
+            self.record('uplink', address, end, fcnt, None, len(payload), airtime, None, 'MIC')
+            return
+        confirmed = (mhdr >> 5) == MTYPE_CONFIRMED_UP
+        if session.fcnt_up is not None and fcnt == session.fcnt_up:
+            # retransmission of the last frame, only acknowledge it again
+            self.counters['duplicates'] += 1
+            self.record('uplink', address, end, fcnt, None, len(payload), airtime, None, 'repeat')
+            if confirmed:
+                self.data_downlink(session, end, frequency, sf, bw, True)
+            return
+        if session.fcnt_up is not None and fcnt < session.fcnt_up:
+            self.counters['replays'] += 1
+            self.record('uplink', address, end, fcnt, None, len(payload), airtime, None, 'FCnt')
+            return
+        session.fcnt_up = fcnt
+        self.counters['uplinks'] += 1
+
+        fopts = payload[8:8 + fopts_len]
+        rest = payload[8 + fopts_len:-4]
+        port = None
+        data = b''
+        if rest:
+            port = rest[0]
+            key = session.nwk_s_key if port == 0 else session.app_s_key
+            data = frame_crypt(key, 0, address, fcnt, rest[1:])
+            if port == 0:
+                fopts, data = data, b''
+
+        note = ''
+        if hasattr(session, 'join_end'):
+            note = 'join %d ms' % (end - session.join_end)
+            del session.join_end
+        self.record('uplink', address, end, fcnt, port, len(payload), airtime, None, note)
+
+        session.snr = (session.snr + [snr])[-self.args.adr_history:]
+        if session.adr_datarate is None:
+            session.adr_datarate = next(dr for dr, mod in self.region.uplink.items()
+                                        if mod == (sf, bw))
+
+        answers = self.mac_commands(session, end, fopts, snr)
+        if fctrl & 0x80:
+            answers += self.adr(session)
+
+        if port == REMOTE_MCAST_PORT:
+            self.remote_mcast_answer(session, data)
+        elif port == FRAGMENTATION_PORT:
+            self.fragmentation_answer(session, end, data)
+        elif port == self.args.segment_port:
+            self.segmented_uplink(session, end, data)
+        elif port is not None and port > 0 and self.args.echo:
+            session.pending_app.append((port, data))
+
+        if self.image and session.fuota is None and port is not None and port > 0:
+            session.fuota = Fuota(self.image, self.args.fragment_size, self.args.redundancy)
+            session.pending_app.append((REMOTE_MCAST_PORT, self.mc_group_setup()))
+
+        session.pending_mac += answers
+        if confirmed or session.pending_mac or session.pending_app:
+            self.data_downlink(session, end, frequency, sf, bw, confirmed)
+        if self.args.burst and port is not None and port > 0:
+            self.burst(session, end)
+
+    def segmented_uplink(self, session, end, data):
+        message = self.segments.feed(session.address, data)
+        if message is None:
+            return
+        port, data, segments = message
+        self.record('message', session.address, end, '', port, len(data), 0, None,
+                    '%d segments' % segments)
+
+    def mac_commands(self, session, end, fopts, snr):
+        answers = b''
+        i = 0
+        while i < len(fopts):
+            cid = fopts[i]
+            length = UPLINK_MAC_COMMANDS.get(cid)
+            if length is None:
+                break
+            arguments = fopts[i + 1:i + 1 + length]
+            i += 1 + length
+            if cid == 0x02:
+                margin = int(snr - REQUIRED_SNR[self.region.uplink[session.adr_datarate][0]])
+                answers += bytes([0x02, max(0, min(254, margin)), 1])
+            elif cid == 0x0D:
+                gps = self.gps_time(end)
+                answers += bytes([0x0D]) + struct.pack('<IB', int(gps), int((gps % 1) * 256))
+            elif cid == 0x03:
+                if arguments and (arguments[0] & 0x07) != 0x07:
+                    self.record('adr-nak', session.address, end, '', None, 0, 0, None,
+                                'status %02X' % arguments[0])
+        return answers
+
+    def adr(self, session):
+        if len(session.snr) < self.args.adr_history:
+            return b''
+        sf = self.region.uplink[session.adr_datarate][0]
+        margin = max(session.snr) - REQUIRED_SNR[sf] - self.args.adr_margin
+        steps = int(margin // 3)
+        datarate = session.adr_datarate
+        power = session.adr_power
+        while steps > 0 and datarate < self.region.adr_max_datarate:
+            datarate += 1
+            steps -= 1
+        while steps > 0 and power < self.region.adr_max_power:
+            power += 1
+            steps -= 1
+        while steps < 0 and power > 0:
+            power -= 1
+            steps += 1
+        if (datarate, power) == (session.adr_datarate, session.adr_power):
+            return b''
+        session.adr_datarate = datarate
+        session.adr_power = power
+        session.snr = []
+        self.counters['adr'] += 1
+        mask, control = self.region.adr_channel_mask()
+        return struct.pack('<BBHB', 0x03, (datarate << 4) | power, mask, (control << 4) | 1)
+
+    def data_frame(self, session, fopts, port, data, ack, pending):
+        fcnt = session.fcnt_down
+        session.fcnt_down += 1
+        fctrl = 0x80 | (0x20 if ack else 0) | (0x10 if pending else 0) | len(fopts)
+        message = bytes([MTYPE_UNCONFIRMED_DOWN << 5]) + struct.pack('<IBH', session.address,
+                                                                     fctrl, fcnt & 0xFFFF)
+        message += fopts
+        if port is not None:
+            message += bytes([port]) + frame_crypt(session.app_s_key, 1, session.address,
+                                                   fcnt, data)
+        message += frame_mic(session.nwk_s_key, 1, session.address, fcnt, message)
+        return message, fcnt
+
+    def data_downlink(self, session, end, frequency, sf, bw, ack):
+        fopts = session.pending_mac[:15]
+        session.pending_mac = session.pending_mac[15:]
+        port = None
+        data = b''
+        if session.pending_app:
+            port, data = session.pending_app.pop(0)
+
+        message, fcnt = self.data_frame(session, fopts, port, data, ack,
+                                        session.pending_app or session.pending_mac)
+        start, airtime = self.schedule_class_a(session.address, end, sf, bw, frequency,
+                                               message, RECEIVE_DELAY1, RECEIVE_DELAY2)
+        self.counters['downlinks'] += 1
+        self.record('downlink', session.address, start + airtime, fcnt, port, len(message),
+                    airtime, start + airtime - end)
+
+    def burst(self, session, end):
+        # back to back class C downlinks once the receive windows are over
+        start = end + RECEIVE_DELAY2 + 500
+        for n in range(self.args.burst):
+            data = struct.pack('<I', n) + bytes(max(0, self.args.burst_size - 4))
+            message, fcnt = self.data_frame(session, b'', self.args.burst_port, data, False,
+                                            False)
+            airtime = self.schedule(start, self.region.rx2_frequency, self.region.rx2_datarate,
+                                    message, session.address)
+            self.counters['downlinks'] += 1
+            self.record('burst', session.address, start + airtime, fcnt, self.args.burst_port,
+                        len(message), airtime, None, 'burst %d' % n)
+            start += airtime + self.args.burst_gap
+
+    # --------------------------------------------------------------------------
+    # Remote multicast setup and fragmentation (FUOTA)
+    # --------------------------------------------------------------------------
+    def mc_keys(self):
+        mc_root_key = aes_encrypt(self.app_key, bytes(16))
+        mc_ke_key = aes_encrypt(mc_root_key, bytes(16))
+        address = struct.pack('<I', self.mc_address)
+        return (aes_decrypt(mc_ke_key, self.mc_key),
+                session_key(self.mc_key, 0x01, address),
+                session_key(self.mc_key, 0x02, address))
+
+    def mc_group_setup(self):
+        mc_key_encrypted, _, _ = self.mc_keys()
+        return (struct.pack('<BBI', 0x02, 0, self.mc_address) + mc_key_encrypted +
+                struct.pack('<II', self.mc_fcnt, 0xFFFFFFFF))
+
+    def remote_mcast_answer(self, session, data):
+        fuota = session.fuota
+        if fuota is None or not data:
+            return
+        if data[0] == 0x02 and fuota.state == Fuota.STATE_GROUP_SETUP:
+            if len(data) >= 2 and data[1] & 0x04:
+                print('%08X: McGroupSetupReq rejected' % session.address)
+                return
+            fuota.state = Fuota.STATE_FRAG_SETUP
+            control = 0x00  # FragAlgo 0, BlockAckDelay 0
+            session.pending_app.append((FRAGMENTATION_PORT, struct.pack(
+                '<BBHBBBI', 0x02, 0x01, fuota.fragments, fuota.fragment_size, control,
+                fuota.padding, 0)))
+        elif data[0] == 0x04 and fuota.state == Fuota.STATE_SESSION_SETUP:
+            if len(data) >= 2 and data[1] & 0x1C:
+                print('%08X: McClassCSessionReq rejected (%02X)' % (session.address, data[1]))
+                return
+            fuota.state = Fuota.STATE_SENDING
+
+    def fragmentation_answer(self, session, end, data):
+        fuota = session.fuota
+        if fuota is None or not data:
+            return
+        if data[0] == 0x02 and fuota.state == Fuota.STATE_FRAG_SETUP:
+            if len(data) >= 2 and data[1] & 0x0F:
+                print('%08X: FragSessionSetupReq rejected (%02X)' % (session.address, data[1]))
+                return
+            fuota.state = Fuota.STATE_SESSION_SETUP
+            # start the class C session once the device had time to answer
+            session_time = int(self.gps_time(end)) + self.args.session_delay
+            fuota.started = (session_time - GPS_EPOCH_AT_START) * 1000
+            timeout = max(0, math.ceil(math.log2(max(1, self.fuota_duration(fuota) // 1000))))
+            frequency = self.region.rx2_frequency // 100
+            session.pending_app.append((REMOTE_MCAST_PORT, struct.pack(
+                '<BBIB', 0x04, 0, session_time, min(timeout + 1, 15)) +
+                struct.pack('<I', frequency)[:3] + bytes([self.region.multicast_datarate])))
+        elif data[0] == 0x05 and len(data) >= 5:
+            crc = struct.unpack('<I', data[1:5])[0]
+            fuota.finished = end
+            fuota.state = Fuota.STATE_DONE
+            expected = zlib.crc32(fuota.image) & 0xFFFFFFFF
+            self.record('fuota', session.address, end, '', FRAGMENTATION_PORT, len(fuota.image),
+                        fuota.airtime, end - fuota.started,
+                        'crc %08X %s' % (crc, 'ok' if crc == expected else 'MISMATCH'))
+
+    def fuota_interval(self, fuota):
+        sf, bw = self.region.downlink[self.region.multicast_datarate]
+        return time_on_air(sf, bw, fuota.fragment_size + 16, crc=False) + self.args.fragment_gap
+
+    def fuota_duration(self, fuota):
+        total = fuota.fragments + fuota.redundancy
+        return total * self.fuota_interval(fuota) + 2000
+
+    def fuota_pump(self, horizon):
+        # queue multicast fragments of sessions that reached their start time
+        for session in self.sessions.values():
+            fuota = session.fuota
+            if fuota is None or fuota.state != Fuota.STATE_SENDING:
+                continue
+            total = fuota.fragments + fuota.redundancy
+            interval = self.fuota_interval(fuota)
+            while fuota.sent < total:
+                start = fuota.started + 1000 + fuota.sent * interval
+                if start > horizon + 2 * LINK_LOOKAHEAD:
+                    break
+                fuota.sent += 1
+                self.multicast(session.address, start, fuota, fuota.sent)
+
+    def multicast(self, address, start, fuota, n):
+        _, mc_app_s_key, mc_net_s_key = self.mc_keys()
+        data = struct.pack('<BH', 0x08, n & 0x3FFF) + fuota.fragment(n)
+        fcnt = self.mc_fcnt
+        self.mc_fcnt += 1
+        message = bytes([MTYPE_UNCONFIRMED_DOWN << 5]) + struct.pack('<IBH', self.mc_address, 0,
+                                                                     fcnt & 0xFFFF)
+        message += bytes([FRAGMENTATION_PORT])
+        message += frame_crypt(mc_app_s_key, 1, self.mc_address, fcnt, data)
+        message += frame_mic(mc_net_s_key, 1, self.mc_address, fcnt, message)
+        airtime = self.schedule(start, self.region.rx2_frequency, self.region.multicast_datarate,
+                                message, address)
+        fuota.airtime += airtime
+        self.counters['downlinks'] += 1
+        self.record('mcast', self.mc_address, start + airtime, fcnt, FRAGMENTATION_PORT,
+                    len(message), airtime, None, 'fragment %d' % n)
+
+    # --------------------------------------------------------------------------
+    # Report
+    # --------------------------------------------------------------------------
+    def report(self):
+        print()
+        print('uplinks          %(uplinks)d  duplicates %(duplicates)d  MIC errors %(mic_errors)d'
+              '  replays %(replays)d  unknown %(unknown)d  collisions %(collisions)d'
+              % self.counters)
+        print('downlinks        %(downlinks)d  joins %(joins)d  ADR %(adr)d' % self.counters)
+        for kind in ('uplink', 'collision', 'join-req', 'join-acc', 'downlink', 'burst', 'mcast'):
+            entries = [e for e in self.log if e['type'] == kind]
+            if not entries:
+                continue
+            airtime = [e['airtime'] for e in entries]
+            print('%-16s n %d  airtime total %d ms  avg %.1f ms'
+                  % (kind, len(entries), sum(airtime), sum(airtime) / len(airtime)))
+            latency = [e['latency'] for e in entries if e['latency'] != '']
+            if latency:
+                print('%-16s min %d  avg %.1f  p50 %d  p95 %d  max %d ms'
+                      % ('  latency', min(latency), sum(latency) / len(latency),
+                         percentile(latency, 50), percentile(latency, 95), max(latency)))
+        if self.segments.counters['segments']:
+            print('segmented        %s' % self.segments.report())
+        for entry in self.log:
+            if entry['type'] == 'fuota':
+                seconds = entry['latency'] / 1000.0
+                print('fuota            %s  %d B in %.1f s (%.1f B/s)  airtime %d ms  %s'
+                      % (entry['device'], entry['size'], seconds,
+                         entry['size'] / seconds if seconds > 0 else 0.0,
+                         entry['airtime'], entry['note']))
+
+        if self.args.csv:
+            with open(self.args.csv, 'w', newline='') as f:
+                writer = csv.DictWriter(f, fieldnames=list(self.log[0].keys()) if self.log else
+                                        ['time'])
+                writer.writeheader()
+                writer.writerows(self.log)
+
+# ******************************************************************************
+#
+# Shared channel
+#
+# ******************************************************************************
+Uplink = collections.namedtuple('Uplink', 'peer start end frequency sf bw rssi snr payload')
+
+
+class Peer:
+    def __init__(self, address):
+        self.address = address
+        self.devices = set()
+        # every uplink of the simulation starting before this virtual time
+        # has been reported
+        self.bound = 0
+        self.pending = 0
+        self.held = None
+
+
+class Channel:
+    # Every simulation runs its own virtual clock.  An uplink is decided
+    # only once no simulation can still report a frame starting before its
+    # end, and the answer to a simulation is held back until its own
+    # uplinks are decided, so the simulations sharing the emulator move on
+    # one time line, as fast as the slowest of them.
+    def __init__(self, network, sock, devices):
+        self.network = network
+        self.sock = sock
+        self.devices = devices
+        self.started = False
+        self.peers = {}
+        self.pending = []
+        self.air = []
+
+    def peer(self, address):
+        if address not in self.peers:
+            self.peers[address] = Peer(address)
+        return self.peers[address]
+
+    def answer(self, peer, due, later):
+        for start, frequency, sf, bw, payload in due:
+            self.sock.sendto(LINK_HEADER.pack(LINK_DOWNLINK, LINK_VERSION, 0) +
+                             LINK_DOWNLINK_BODY.pack(start, frequency, sf, bw, len(payload)) +
+                             payload, peer.address)
+        self.sock.sendto(LINK_HEADER.pack(LINK_ACK, LINK_VERSION, 0) + LINK_ACK_BODY.pack(later),
+                         peer.address)
+
+    def sync(self, peer, now, next_event, on_air):
+        # nothing is put on air before the next event but the frame on air
+        peer.bound = on_air if on_air != LINK_NO_EVENT else next_event
+        peer.held = (LINK_SYNC, now, next_event)
+
+    def uplink(self, frame):
+        frame.peer.bound = frame.end
+        frame.peer.pending += 1
+        frame.peer.held = (LINK_UPLINK,)
+        self.pending.append(frame)
+
+    def end(self, peer):
+        del self.peers[peer.address]
+        self.answer(peer, [], LINK_NO_EVENT)
+
+    def lost(self, frame):
+        for other in self.air + self.pending:
+            if (other is not frame and other.frequency == frame.frequency and
+                    other.sf == frame.sf and other.bw == frame.bw and
+                    other.start < frame.end and frame.start < other.end and
+                    frame.rssi < other.rssi + CAPTURE_THRESHOLD):
+                return True
+        return False
+
+    def step(self):
+        if self.peers and not self.started:
+            # none moves on before all have connected at virtual time 0
+            self.started = len(self.peers) >= self.devices
+            if not self.started:
+                return
+
+        horizon = min((peer.bound for peer in self.peers.values()), default=LINK_NO_EVENT)
+        self.pending.sort(key=lambda frame: (frame.end, frame.start, frame.payload))
+        while self.pending and self.pending[0].end <= horizon:
+            frame = self.pending.pop(0)
+            frame.peer.pending -= 1
+            self.air.append(frame)
+            if self.lost(frame):
+                self.network.collision(frame.start, frame.end, frame.payload)
+                continue
+            device = self.network.uplink(*frame[1:])
+            if device is not None:
+                frame.peer.devices.add(device)
+
+        # frames reported from now on start at the horizon or later
+        floor = min([horizon] + [frame.start for frame in self.pending])
+        self.air = [frame for frame in self.air if frame.end > floor]
+
+        for peer in self.peers.values():
+            if peer.held is None or peer.pending:
+                continue
+            due, later = [], self.network.later(peer.devices)
+            if peer.held[0] == LINK_SYNC:
+                due, later = self.network.sync(peer.held[1], peer.held[2], peer.devices)
+            peer.held = None
+            self.answer(peer, due, later)
+
+        if not self.peers:
+            self.started = False
+
+# ******************************************************************************
+#
+# UDP link
+#
+# ******************************************************************************
+def serve(network, args):
+    sock = socket.socket(socket.AF_INET, socket.SOCK_DGRAM)
+    sock.bind((args.address, args.port))
+    print('listening on %s:%d (%s)' % (args.address, args.port, network.region.name), flush=True)
+
+    channel = Channel(network, sock, args.devices)
+    while True:
+        message, address = sock.recvfrom(2048)
+        if len(message) < LINK_HEADER.size:
+            continue
+        kind, version, _ = LINK_HEADER.unpack_from(message)
+        if version != LINK_VERSION:
+            print('%s: link version %d not supported' % (address, version))
+            continue
+        body = message[LINK_HEADER.size:]
+
+        if kind == LINK_SYNC:
+            now, next_event, on_air = LINK_SYNC_BODY.unpack_from(body)
+            channel.sync(channel.peer(address), now, next_event, on_air)
+        elif kind == LINK_UPLINK:
+            start, end, frequency, sf, bw, rssi, snr, size = LINK_UPLINK_BODY.unpack_from(body)
+            payload = body[LINK_UPLINK_BODY.size:LINK_UPLINK_BODY.size + size]
+            channel.uplink(Uplink(channel.peer(address), start, end, frequency, sf, bw, rssi,
+                                  snr, payload))
+        elif kind == LINK_END:
+            channel.end(channel.peer(address))
+        else:
+            channel.answer(channel.peer(address), [], LINK_NO_EVENT)
+        channel.step()
+
+        if kind == LINK_END and not channel.peers and not args.keep_running:
+            break
+
+    network.report()
+
+# ******************************************************************************
+#
+# Main function
+#
+# ******************************************************************************
+def main():
+    parser = argparse.ArgumentParser(
+        description='LoRaWAN network server emulator for the host simulation')
+
+    parser.add_argument('-a', '--address', default='127.0.0.1', help='UDP address to bind')
+    parser.add_argument('-p', '--port', type=int, default=1700, help='UDP port to bind')
+    parser.add_argument('-r', '--region', choices=sorted(REGIONS), default='us915')
+    parser.add_argument('-v', '--verbose', action='store_true', help='print every message')
+    parser.add_argument('--csv', help='write the per-message report to this file')
+    parser.add_argument('--keep-running', action='store_true',
+                        help='keep serving after the last simulation disconnected')
+    parser.add_argument('-d', '--devices', type=int, default=1,
+                        help='simulations sharing the channel, none is served before all connected')
+
+    parser.add_argument('--app-key', default='2b7e151628aed2a6abf7158809cf4f3c',
+                        help='AppKey of the OTAA devices and root of the multicast keys')
+    parser.add_argument('--net-id', type=lambda x: int(x, 0), default=0)
+    parser.add_argument('--otaa-address', type=lambda x: int(x, 0), default=0x260C0001,
+                        help='first device address handed out in join accepts')
+    parser.add_argument('--abp-address', type=lambda x: int(x, 0), default=0x260B0001,
+                        help='device address of the first ABP device')
+    parser.add_argument('--abp-devices', type=int, default=64,
+                        help='number of consecutive ABP device addresses')
+    parser.add_argument('--nwk-s-key', default='2b7e151628aed2a6abf7158809cf4f3c')
+    parser.add_argument('--app-s-key', default='3c4fcf098815f7aba6d2ae2816157e2b')
+
+    parser.add_argument('--rx2', action='store_true', help='answer in RX2 instead of RX1')
+    parser.add_argument('--echo', action='store_true',
+                        help='send every application uplink back on the same port')
+    parser.add_argument('--segment-port', type=int, default=SEGMENT_PORT,
+                        help='port of segmented uplinks')
+    parser.add_argument('--burst', type=int, default=0,
+                        help='class C downlinks sent after every application uplink')
+    parser.add_argument('--burst-gap', type=int, default=0,
+                        help='idle time between the downlinks of a burst (ms)')
+    parser.add_argument('--burst-size', type=int, default=16, help='burst payload size')
+    parser.add_argument('--burst-port', type=int, default=2, help='burst application port')
+    parser.add_argument('--adr-history', type=int, default=20,
+                        help='uplinks considered by the ADR algorithm')
+    parser.add_argument('--adr-margin', type=float, default=10.0,
+                        help='ADR installation margin (dB)')
+
+    parser.add_argument('--fuota', help='image sent to every device over multicast')
+    parser.add_argument('--fragment-size', type=int, default=200)
+    parser.add_argument('--redundancy', type=int, default=10,
+                        help='coded fragments sent after the data fragments')
+    parser.add_argument('--fragment-gap', type=int, default=100,
+                        help='idle time between fragments (ms)')
+    parser.add_argument('--session-delay', type=int, default=30,
+                        help='seconds between the session setup and its start')
+    parser.add_argument('--mc-address', type=lambda x: int(x, 0), default=0x01FFFFFF)
+    parser.add_argument('--mc-key', default='01020304050607080910111213141516')
+
+    args = parser.parse_args()
+
+    network = Network(args)
+    try:
+        serve(network, args)
+    except KeyboardInterrupt:
+        network.report()
+
+
+if __name__ == '__main__':
+    main()
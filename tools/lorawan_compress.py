@@ -0,0 +1,349 @@
+#!/usr/bin/env python3
+# ******************************************************************************
+#
+# Decoder of compressed LoRaWAN readings
+#
+# Devices built with comms/lorawan/lorawan_compress.h send batches of
+# sensor readings as the difference of each value to the reading before,
+# zigzag mapped and written as varints or bit-packed.  Every frame starts
+# with
+#
+#   flags     u8, bit 7 keyframe, bits 6:0 frame sequence
+#   readings  u8
+#
+# A keyframe carries its first reading as is, a delta frame carries it as
+# the difference to the last reading of the frame before and is dropped
+# when that frame was lost, until the next keyframe.
+#
+# A schema describes the readings of a port:
+#
+#   <port>:<varint|bitpack>:<keyframe interval>:<field widths in bytes>
+#
+# decode turns uplinks, one per line of "<device> <port> <hex payload>" as
+# written by tools/lorawan_segments.py, back into comma separated readings:
+#
+#   python3 tools/lorawan_compress.py decode -s 10:bitpack:8:2,2,1 uplinks.txt
+#
+# report compresses a file of comma separated readings and prints the bytes
+# and the airtime saved per reading against the same batches sent as raw
+# values:
+#
+#   python3 tools/lorawan_compress.py report -s 10:varint:16:2,2 -b 4 readings.csv
+#
+# ******************************************************************************
+
+import argparse
+import csv
+import math
+import sys
+
+VARINT, BITPACK = 'varint', 'bitpack'
+
+KEYFRAME = 0x80
+SEQUENCE = 0x7F
+HEADER_SIZE = 2
+WIDTH_BITS = 6
+
+# MHDR, DevAddr, FCtrl, FCnt, FPort and MIC of an uplink without options
+FRAME_OVERHEAD = 13
+
+
+class Schema:
+    def __init__(self, text):
+        port, encoding, keyframe, widths = text.split(':')
+        self.port = int(port, 0)
+        self.encoding = encoding
+        self.keyframe = int(keyframe)
+        self.widths = [int(w) for w in widths.split(',')]
+        if encoding not in (VARINT, BITPACK):
+            raise ValueError('unknown encoding ' + encoding)
+
+    @property
+    def fields(self):
+        return len(self.widths)
+
+    @property
+    def raw_size(self):
+        return sum(self.widths)
+
+
+def zigzag(value):
+    return ((value << 1) ^ (value >> 31)) & 0xFFFFFFFF
+
+
+def unzigzag(value):
+    return (value >> 1) ^ -(value & 1)
+
+
+def wrap(value):
+    """Reduce to a signed 32 bit value, the device computes differences modulo 2^32."""
+    value &= 0xFFFFFFFF
+    return value - (1 << 32) if value & 0x80000000 else value
+
+
+class BitWriter:
+    def __init__(self):
+        self.data = bytearray()
+        self.value = 0
+        self.bits = 0
+
+    def varint(self, value):
+        while value >= 0x80:
+            self.data.append((value & 0x7F) | 0x80)
+            value >>= 7
+        self.data.append(value)
+
+    def put(self, value, bits):
+        self.value |= value << self.bits
+        self.bits += bits
+        while self.bits >= 8:
+            self.data.append(self.value & 0xFF)
+            self.value >>= 8
+            self.bits -= 8
+
+    def flush(self):
+        if self.bits:
+            self.data.append(self.value & 0xFF)
+            self.value = 0
+            self.bits = 0
+        return bytes(self.data)
+
+
+class BitReader:
+    def __init__(self, data):
+        self.data = data
+        self.offset = 0
+        self.value = 0
+        self.bits = 0
+
+    def byte(self):
+        if self.offset >= len(self.data):
+            raise ValueError('frame truncated')
+        self.offset += 1
+        return self.data[self.offset - 1]
+
+    def varint(self):
+        value = 0
+        for shift in range(0, 35, 7):
+            byte = self.byte()
+            value |= (byte & 0x7F) << shift
+            if not byte & 0x80:
+                return value & 0xFFFFFFFF
+        raise ValueError('varint too long')
+
+    def get(self, bits):
+        while self.bits < bits:
+            self.value |= self.byte() << self.bits
+            self.bits += 8
+        value = self.value & ((1 << bits) - 1)
+        self.value >>= bits
+        self.bits -= bits
+        return value
+
+
+class Codec:
+    """Encoder or decoder of one port, the counterpart of lorawan_compress_t."""
+
+    def __init__(self, schema):
+        self.schema = schema
+        self.last = [0] * schema.fields
+        self.sequence = 0
+        self.since_keyframe = 0
+        self.synchronized = False
+        self.counters = {
+            'frames': 0, 'keyframes': 0, 'readings': 0, 'raw': 0, 'encoded': 0,
+            'lost': 0, 'discarded': 0,
+        }
+
+    def account(self, keyframe, readings, size):
+        self.counters['frames'] += 1
+        self.counters['keyframes'] += 1 if keyframe else 0
+        self.counters['readings'] += len(readings)
+        self.counters['raw'] += len(readings) * self.schema.raw_size
+        self.counters['encoded'] += size
+
+    def deltas(self, readings, keyframe):
+        previous = [0] * self.schema.fields if keyframe else self.last
+        rows = []
+        for reading in readings:
+            rows.append([zigzag(wrap(v - p)) for v, p in zip(reading, previous)])
+            previous = reading
+        return rows
+
+    def encode(self, readings):
+        keyframe = not self.synchronized or (
+            self.schema.keyframe and self.since_keyframe + 1 >= self.schema.keyframe)
+        rows = self.deltas(readings, keyframe)
+
+        writer = BitWriter()
+        writer.data += bytes([(KEYFRAME if keyframe else 0) | (self.sequence & SEQUENCE),
+                              len(readings)])
+        varints = 1 if self.schema.encoding == BITPACK else len(rows)
+        for row in rows[:varints]:
+            for value in row:
+                writer.varint(value)
+        if varints < len(rows):
+            widths = [max(v.bit_length() for v in column)
+                      for column in zip(*rows[varints:])]
+            for width in widths:
+                writer.put(width, WIDTH_BITS)
+            for row in rows[varints:]:
+                for value, width in zip(row, widths):
+                    writer.put(value, width)
+        frame = writer.flush()
+
+        self.last = list(readings[-1])
+        self.sequence += 1
+        self.synchronized = True
+        self.since_keyframe = 0 if keyframe else self.since_keyframe + 1
+        self.account(keyframe, readings, len(frame))
+        return frame
+
+    def decode(self, frame):
+        """Returns the readings of a frame, None while waiting for a keyframe."""
+        if len(frame) < HEADER_SIZE or frame[1] == 0:
+            raise ValueError('frame too short')
+        keyframe = bool(frame[0] & KEYFRAME)
+        sequence = frame[0] & SEQUENCE
+        count = frame[1]
+
+        missing = (sequence - self.sequence) & SEQUENCE
+        if self.synchronized and missing:
+            self.counters['lost'] += missing
+            self.synchronized = keyframe
+        if not keyframe and not self.synchronized:
+            self.sequence = sequence + 1
+            self.counters['discarded'] += 1
+            return None
+
+        reader = BitReader(frame)
+        reader.offset = HEADER_SIZE
+        varints = 1 if self.schema.encoding == BITPACK else count
+        rows = [[reader.varint() for _ in range(self.schema.fields)] for _ in range(varints)]
+        if varints < count:
+            widths = [reader.get(WIDTH_BITS) for _ in range(self.schema.fields)]
+            if max(widths) > 32:
+                raise ValueError('field width out of range')
+            rows += [[reader.get(width) for width in widths] for _ in range(count - varints)]
+        if reader.offset != len(frame):
+            raise ValueError('trailing bytes')
+
+        previous = [0] * self.schema.fields if keyframe else self.last
+        readings = []
+        for row in rows:
+            previous = [wrap(p + unzigzag(v)) for p, v in zip(previous, row)]
+            readings.append(previous)
+
+        self.last = readings[-1]
+        self.sequence = sequence + 1
+        self.synchronized = True
+        self.account(keyframe, readings, len(frame))
+        return readings
+
+    def report(self):
+        return ('frames %(frames)d  keyframes %(keyframes)d  readings %(readings)d'
+                '  raw %(raw)d B  encoded %(encoded)d B  lost %(lost)d'
+                '  discarded %(discarded)d' % self.counters)
+
+
+def time_on_air(sf, bw, size, preamble=8, coderate=1, crc=True):
+    # Same as tools/lns_emulator.py, which needs pycryptodome to load.
+    bandwidth = (125000, 250000, 500000)[bw]
+    symbol = (1 << sf) / bandwidth
+    low_datarate = (symbol * 1000) > 16
+    numerator = 8 * size - 4 * sf + 28 + (16 if crc else 0)
+    denominator = 4 * (sf - (2 if low_datarate else 0))
+    payload = 8 + max(math.ceil(numerator / denominator) * (coderate + 4), 0)
+    return int(math.ceil((preamble + 4.25 + payload) * symbol * 1000))
+
+
+def decode(args, schemas):
+    codecs = {}
+    for line in args.input:
+        fields = line.split()
+        if len(fields) < 3 or fields[0].startswith('#'):
+            continue
+        device, port, payload = fields[0], int(fields[1], 0), bytes.fromhex(fields[2])
+        if port not in schemas:
+            continue
+        codec = codecs.setdefault((device, port), Codec(schemas[port]))
+        try:
+            readings = codec.decode(payload)
+        except ValueError as error:
+            print('%s %d # malformed, %s' % (device, port, error), file=sys.stderr)
+            continue
+        if readings is None:
+            print('%s %d # waiting for a keyframe' % (device, port), file=sys.stderr)
+            continue
+        for reading in readings:
+            print('%s %d %s' % (device, port, ','.join(str(v) for v in reading)), flush=True)
+
+    for (device, port), codec in sorted(codecs.items()):
+        print('%s %d %s' % (device, port, codec.report()), file=sys.stderr)
+
+
+def report(args, schema):
+    readings = [[int(v, 0) for v in row] for row in csv.reader(args.input)
+                if row and not row[0].startswith('#')]
+    readings = [row for row in readings if len(row) == schema.fields]
+    if not readings:
+        sys.exit('no readings of %d fields' % schema.fields)
+
+    encoder = Codec(schema)
+    decoder = Codec(schema)
+    raw_sizes, frame_sizes = [], []
+    for i in range(0, len(readings), args.batch):
+        batch = readings[i:i + args.batch]
+        frame = encoder.encode(batch)
+        if decoder.decode(frame) != batch:
+            sys.exit('frame %d does not round trip' % (i // args.batch))
+        raw_sizes.append((len(batch), len(batch) * schema.raw_size))
+        frame_sizes.append(len(frame))
+
+    count = len(readings)
+    raw = sum(size for _, size in raw_sizes)
+    encoded = sum(frame_sizes)
+    print('%d readings of %d bytes, %s, %d per frame, keyframe every %d frames'
+          % (count, schema.raw_size, schema.encoding, args.batch, schema.keyframe))
+    print('bytes/reading   raw %.2f  compressed %.2f  saved %.2f (%.0f%%)'
+          % (raw / count, encoded / count, (raw - encoded) / count,
+             100.0 * (raw - encoded) / raw if raw else 0.0))
+
+    print('%-5s %12s %12s %12s' % ('SF', 'raw', 'compressed', 'saved'))
+    for sf in args.sf:
+        airtime_raw = sum(time_on_air(sf, args.bw, FRAME_OVERHEAD + size)
+                          for _, size in raw_sizes)
+        airtime = sum(time_on_air(sf, args.bw, FRAME_OVERHEAD + size) for size in frame_sizes)
+        print('SF%-3d %9.1f ms %9.1f ms %9.1f ms'
+              % (sf, airtime_raw / count, airtime / count, (airtime_raw - airtime) / count))
+
+# ******************************************************************************
+#
+# Main function
+#
+# ******************************************************************************
+def main():
+    parser = argparse.ArgumentParser(description='Decode compressed LoRaWAN readings')
+    parser.add_argument('mode', choices=['decode', 'report'])
+    parser.add_argument('input', nargs='?', type=argparse.FileType('r'), default=sys.stdin,
+                        help='uplinks to decode or readings to report on (default stdin)')
+    parser.add_argument('-s', '--schema', action='append', required=True, type=Schema,
+                        help='port:encoding:keyframe:widths, once per port')
+    parser.add_argument('-b', '--batch', type=int, default=1, help='readings per frame')
+    parser.add_argument('--sf', type=lambda text: [int(x) for x in text.split(',')],
+                        default=list(range(7, 13)), help='spreading factors to report')
+    parser.add_argument('--bw', type=int, choices=[0, 1, 2], default=0,
+                        help='bandwidth, 0 125 kHz, 1 250 kHz, 2 500 kHz')
+    args = parser.parse_intermixed_args()
+
+    if not 1 <= args.batch <= 255:
+        parser.error('batch must be 1 to 255 readings')
+
+    if args.mode == 'decode':
+        decode(args, {schema.port: schema for schema in args.schema})
+    else:
+        report(args, args.schema[0])
+
+
+if __name__ == '__main__':
+    main()
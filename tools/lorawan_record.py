@@ -0,0 +1,182 @@
+#!/usr/bin/env python3
+# ******************************************************************************
+#
+# Decoder of the LoRaWAN event recorder
+#
+# `lorawan record start` keeps a compact record of every radio interrupt,
+# LoRaMac timer alarm, LoRaWAN task wake, transmit queue operation and
+# receive window outcome with the received frame
+# (comms/lorawan/lorawan_record.h) and `lorawan record dump` prints them on
+# the console as lines of
+#
+#   @R <hex record>
+#
+# This script lists the records with the time elapsed since the stack
+# start, sums them up, and writes them out raw for a replay by the host
+# simulation (doc/host_simulation.md).
+#
+#   python3 tools/lorawan_record.py console.log
+#   python3 tools/lorawan_record.py console.log -o field.rec
+#   build/sim/lorawan_sim -R field.rec
+#   python3 tools/lorawan_record.py --binary field.rec --summary
+#
+# ******************************************************************************
+
+import argparse
+import collections
+import struct
+import sys
+
+LINE_PREFIX = '@R'
+RECORD = struct.Struct('<BBHI')
+
+START, STOP, RADIO_IRQ, TIMER_IRQ, WAKE, COMMAND = range(1, 7)
+QUEUE_SEND, QUEUE_DROP, QUEUE_RECEIVE, QUEUE_EXPIRE = range(7, 11)
+RX, RX_DATA = 11, 12
+
+QUEUE_CONFIRMED = 1 << 8
+QUEUE_URGENT = 1 << 9
+
+NAMES = {
+    START: 'START', STOP: 'STOP', RADIO_IRQ: 'RADIO_IRQ', TIMER_IRQ: 'TIMER_IRQ', WAKE: 'WAKE',
+    COMMAND: 'COMMAND', QUEUE_SEND: 'QUEUE_SEND', QUEUE_DROP: 'QUEUE_DROP',
+    QUEUE_RECEIVE: 'QUEUE_RECEIVE', QUEUE_EXPIRE: 'QUEUE_EXPIRE', RX: 'RX', RX_DATA: 'RX_DATA',
+}
+
+RADIO_STATES = ['IDLE', 'RX', 'TX', 'CAD']
+
+WAKE_CAUSES = ['RADIO', 'TIMER', 'MAC', 'STACK', 'COMMAND', 'TRANSMIT', 'JOIN', 'MULTICAST',
+               'SEGMENT', 'NVM']
+
+COMMANDS = ['START', 'STOP', 'JOIN', 'SYNC_APP', 'SYNC_MAC', 'CLASS_SET']
+
+RX_OUTCOMES = ['NONE', 'DONE', 'TIMEOUT', 'ERROR']
+
+
+def name(table, index):
+    return table[index] if 0 <= index < len(table) else str(index)
+
+
+def describe(kind, argument, value):
+    if kind == RADIO_IRQ:
+        return 'radio %s' % name(RADIO_STATES, argument)
+    if kind == WAKE:
+        return name(WAKE_CAUSES, argument)
+    if kind == COMMAND:
+        text = name(COMMANDS, argument)
+        return text + (' %s' % 'ABC'[value] if text == 'CLASS_SET' and value < 3 else '')
+    if kind == QUEUE_SEND:
+        flags = [flag for bit, flag in ((QUEUE_CONFIRMED, 'confirmed'), (QUEUE_URGENT, 'urgent'))
+                 if value & bit]
+        return 'port %d  %d bytes  %s' % (argument, value & 0xFF, ' '.join(flags))
+    if kind in (QUEUE_DROP, QUEUE_RECEIVE, QUEUE_EXPIRE):
+        return 'port %d  %d bytes' % (argument, value)
+    if kind == RX:
+        return '%s  %d bytes' % (name(RX_OUTCOMES, argument), value)
+    if kind == RX_DATA:
+        return '%02x %02x %02x' % (argument, value & 0xFF, value >> 8)
+    return ''
+
+
+def read_console(source):
+    records = []
+    malformed = 0
+    for text in source:
+        index = text.find(LINE_PREFIX + ' ')
+        if index < 0:
+            continue
+        try:
+            record = bytes.fromhex(text[index + len(LINE_PREFIX) + 1:].strip())
+        except ValueError:
+            record = b''
+        if len(record) != RECORD.size:
+            malformed += 1
+            continue
+        records.append(record)
+    return records, malformed
+
+
+def read_binary(data):
+    size = len(data) - len(data) % RECORD.size
+    return [data[i:i + RECORD.size] for i in range(0, size, RECORD.size)], len(data) % RECORD.size
+
+
+def origin(records):
+    """Time of the stack start, or of the first record if the log lost it."""
+    for record in records:
+        kind, _, _, time = RECORD.unpack(record)
+        if kind == START:
+            return time
+    return RECORD.unpack(records[0])[3] if records else 0
+
+
+def listing(records, output):
+    start = origin(records)
+    previous = None
+    for record in records:
+        kind, argument, value, time = RECORD.unpack(record)
+        elapsed = (time - start) & 0xFFFFFFFF
+        if elapsed > 0x7FFFFFFF:
+            elapsed -= 1 << 32
+        delta = '' if previous is None else '+%d' % ((time - previous) & 0xFFFFFFFF)
+        previous = time
+        print('%10d ms %8s  %-13s %s' % (elapsed, delta, NAMES.get(kind, str(kind)),
+                                         describe(kind, argument, value)), file=output)
+
+
+def summary(records, output):
+    kinds = collections.Counter()
+    causes = collections.Counter()
+    states = collections.Counter()
+    for record in records:
+        kind, argument, _, _ = RECORD.unpack(record)
+        kinds[kind] += 1
+        if kind == WAKE:
+            causes[argument] += 1
+        elif kind == RADIO_IRQ:
+            states[argument] += 1
+
+    if records:
+        span = (RECORD.unpack(records[-1])[3] - RECORD.unpack(records[0])[3]) & 0xFFFFFFFF
+        print('%d records over %.3f s' % (len(records), span / 1000.0), file=output)
+    for kind in sorted(kinds):
+        print('  %-13s %8d' % (NAMES.get(kind, str(kind)), kinds[kind]), file=output)
+    for argument in sorted(states):
+        print('  radio irq %-3s %8d' % (name(RADIO_STATES, argument), states[argument]),
+              file=output)
+    for argument in sorted(causes):
+        print('  wake %-8s %8d' % (name(WAKE_CAUSES, argument), causes[argument]), file=output)
+
+# ******************************************************************************
+#
+# Main function
+#
+# ******************************************************************************
+def main():
+    parser = argparse.ArgumentParser(description='Decode the LoRaWAN event recorder log')
+    parser.add_argument('input', nargs='?', help='console log or raw records (default stdin)')
+    parser.add_argument('--binary', action='store_true', help='input holds raw records')
+    parser.add_argument('-o', '--output', help='write the raw records for lorawan_sim -R')
+    parser.add_argument('--summary', action='store_true', help='counters instead of the listing')
+    args = parser.parse_args()
+
+    if args.binary:
+        source = open(args.input, 'rb') if args.input else sys.stdin.buffer
+        records, malformed = read_binary(source.read())
+    else:
+        source = open(args.input, 'r', errors='replace') if args.input else sys.stdin
+        records, malformed = read_console(source)
+
+    if args.output:
+        with open(args.output, 'wb') as output:
+            output.write(b''.join(records))
+    elif args.summary:
+        summary(records, sys.stdout)
+    else:
+        listing(records, sys.stdout)
+
+    print('records %d  malformed %d' % (len(records), malformed), file=sys.stderr)
+
+
+if __name__ == '__main__':
+    main()
@@ -0,0 +1,146 @@
+#!/usr/bin/env python3
+# ******************************************************************************
+#
+# Reassembly of segmented LoRaWAN uplinks
+#
+# Devices with segmentation enabled (lorawan_segmentation_set) split uplinks
+# larger than the payload limit of their data rate over several frames on
+# the segment port.  Every segment starts with
+#
+#   message id  u8
+#   index       u8, bit 7 set on the last segment
+#
+# and the first segment (index 0) adds
+#
+#   port        u8, application port of the message
+#   length      u8, message length
+#
+# The segments of a message are sent in order and a device sends one
+# message at a time, so a new message id abandons the previous message.
+#
+# Used as a module by tools/lns_emulator.py, or on its own with one decoded
+# uplink per input line:
+#
+#   <device> <port> <hex payload>
+#
+# ******************************************************************************
+
+import argparse
+import sys
+
+SEGMENT_PORT = 199
+
+SEGMENT_LAST = 0x80
+SEGMENT_INDEX = 0x7F
+SEGMENT_HEADER = 2
+SEGMENT_FIRST_HEADER = 4
+
+
+class Message:
+    def __init__(self, message_id):
+        self.id = message_id
+        self.port = None
+        self.length = None
+        self.last = None
+        self.segments = {}
+
+    def complete(self):
+        if self.port is None or self.last is None:
+            return False
+        return all(i in self.segments for i in range(self.last + 1))
+
+
+class Reassembler:
+    def __init__(self):
+        self.pending = {}
+        self.done = {}
+        self.counters = {
+            'segments': 0, 'messages': 0, 'lost': 0, 'duplicates': 0, 'malformed': 0,
+        }
+
+    def feed(self, device, payload):
+        """Add one segment, returns (port, data, segments) once its message is complete."""
+        if len(payload) < SEGMENT_HEADER:
+            self.counters['malformed'] += 1
+            return None
+        message_id = payload[0]
+        index = payload[1] & SEGMENT_INDEX
+        last = payload[1] & SEGMENT_LAST
+
+        message = self.pending.get(device)
+        if message is not None and message.id != message_id:
+            self.counters['lost'] += 1
+            message = None
+        if message is None:
+            if self.done.get(device) == message_id:
+                self.counters['duplicates'] += 1
+                return None
+            message = Message(message_id)
+            self.pending[device] = message
+
+        if index in message.segments:
+            self.counters['duplicates'] += 1
+            return None
+
+        if index == 0:
+            if len(payload) < SEGMENT_FIRST_HEADER:
+                self.counters['malformed'] += 1
+                return None
+            message.port = payload[2]
+            message.length = payload[3]
+            body = payload[SEGMENT_FIRST_HEADER:]
+        else:
+            body = payload[SEGMENT_HEADER:]
+
+        self.counters['segments'] += 1
+        message.segments[index] = body
+        if last:
+            message.last = index
+        if not message.complete():
+            return None
+
+        del self.pending[device]
+        self.done[device] = message_id
+        data = b''.join(message.segments[i] for i in range(message.last + 1))
+        if len(data) != message.length:
+            self.counters['malformed'] += 1
+            return None
+        self.counters['messages'] += 1
+        return message.port, data, message.last + 1
+
+    def report(self):
+        return ('segments %(segments)d  messages %(messages)d  lost %(lost)d'
+                '  duplicates %(duplicates)d  malformed %(malformed)d' % self.counters)
+
+# ******************************************************************************
+#
+# Main function
+#
+# ******************************************************************************
+def main():
+    parser = argparse.ArgumentParser(description='Reassemble segmented LoRaWAN uplinks')
+    parser.add_argument('input', nargs='?', type=argparse.FileType('r'), default=sys.stdin,
+                        help='lines of "<device> <port> <hex payload>" (default stdin)')
+    parser.add_argument('--port', type=int, default=SEGMENT_PORT, help='segment port')
+    args = parser.parse_args()
+
+    reassembler = Reassembler()
+    for line in args.input:
+        fields = line.split()
+        if len(fields) < 2 or fields[0].startswith('#'):
+            continue
+        device, port = fields[0], int(fields[1], 0)
+        payload = bytes.fromhex(fields[2]) if len(fields) > 2 else b''
+        if port != args.port:
+            print('%s %d %s' % (device, port, payload.hex()), flush=True)
+            continue
+        message = reassembler.feed(device, payload)
+        if message is not None:
+            port, data, segments = message
+            print('%s %d %s  # %d segments' % (device, port, data.hex(), segments), flush=True)
+
+    print(reassembler.report(), file=sys.stderr)
+
+
+if __name__ == '__main__':
+    main()
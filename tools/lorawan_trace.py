@@ -0,0 +1,320 @@
+#!/usr/bin/env python3
+# ******************************************************************************
+#
+# Decoder of the LoRaWAN binary trace
+#
+# With `lorawan trace binary` the stack copies a compact record of every
+# MAC callback into a RAM buffer (comms/lorawan/lorawan_trace.h) and a low
+# priority task writes the records out, either on the console as lines of
+#
+#   @T <hex record>
+#
+# mixed with the regular output, or raw on an RTT channel.  This script
+# turns the records back into the text trace printed by `lorawan trace
+# enable`, with the time each event was raised.
+#
+#   python3 tools/lorawan_trace.py console.log
+#   python3 tools/lorawan_trace.py --serial /dev/ttyACM0
+#   python3 tools/lorawan_trace.py --binary rtt_channel1.bin
+#   build/sim/lorawan_sim -V | python3 tools/lorawan_trace.py
+#
+# ******************************************************************************
+
+import argparse
+import struct
+import sys
+
+LINE_PREFIX = '@T'
+HEADER = struct.Struct('<BBHI')
+
+NVM, NETWORK, MCPS_REQUEST, MLME_REQUEST, JOIN, TX, RX, CLASS, BEACON, TIME = range(1, 11)
+FRAG_PROGRESS, FRAG_DONE, FRAG_WRITE, FRAG_ERASE = range(11, 15)
+LOST = 0xFF
+
+MAC_STATUS = [
+    'OK', 'Busy', 'Service unknown', 'Parameter invalid', 'Frequency invalid',
+    'Datarate invalid', 'Frequency or datarate invalid', 'No network joined', 'Length error',
+    'Region not supported', 'Skipped APP data', 'Duty-cycle restricted', 'No channel found',
+    'No free channel found', 'Busy beacon reserved time', 'Busy ping-slot window time',
+    'Busy uplink collision', 'Crypto error', 'FCnt handler error', 'MAC command error',
+    'ClassB error', 'Confirm queue error', 'Multicast group undefined', 'Unknown error',
+]
+
+EVENT_STATUS = [
+    'OK', 'Error', 'Tx timeout', 'Rx 1 timeout', 'Rx 2 timeout', 'Rx1 error', 'Rx2 error',
+    'Join failed', 'Downlink repeated', 'Tx DR payload size error', 'Address fail', 'MIC fail',
+    'Multicast fail', 'Beacon locked', 'Beacon lost', 'Beacon not found',
+]
+
+MCPS_TYPES = ['UNCONFIRMED', 'CONFIRMED', 'MULTICAST', 'PROPRIETARY']
+
+MLME_TYPES = [
+    'UNKNOWN', 'JOIN', 'REJOIN_0', 'REJOIN_1', 'LINK_CHECK', 'TXCW', 'DERIVE_MC_KE_KEY',
+    'DERIVE_MC_KEY_PAIR', 'DEVICE_TIME', 'BEACON', 'BEACON_ACQUISITION', 'PING_SLOT_INFO',
+    'BEACON_TIMING', 'BEACON_LOST', 'REVERT_JOIN',
+]
+
+RX_SLOTS = ['1', '2', 'C', 'C Multicast', 'B Ping-Slot', 'B Multicast Ping-Slot']
+
+BEACON_STATES = ['ACQUIRING', 'LOST', 'RECEIVED', 'NOT RECEIVED']
+
+CLASSES = 'ABC'
+
+
+def name(table, index):
+    return table[index] if 0 <= index < len(table) else str(index)
+
+
+def banner(title):
+    return ['', '###### ' + title.center(37, '=') + ' ######']
+
+
+def hexdump(data, size):
+    text = ' '.join('%02X' % b for b in data)
+    if size > len(data):
+        text += ' ... (%d bytes)' % size
+    return text
+
+
+def decode_nvm(payload):
+    state, size = struct.unpack_from('<BH', payload)
+    return banner(' CTXS %s ' % ('RESTORED' if state == 0 else 'STORED')) + [
+        'Size        : %d' % size]
+
+
+def decode_network(payload):
+    dev_eui, join_eui = payload[0:8], payload[8:16]
+    return ['DevEui      : ' + '-'.join('%02X' % b for b in dev_eui),
+            'JoinEui     : ' + '-'.join('%02X' % b for b in join_eui)]
+
+
+def decode_request(kind, types, payload):
+    status, request, delay = struct.unpack_from('<BBI', payload)
+    lines = banner(' %s-Request ' % kind) + [
+        '###### %s ######' % name(MAC_STATUS, status).center(37),
+        'Type        : %s' % name(types, request)]
+    if status == 11:
+        lines.append('Next Tx in  : %d [ms]' % delay)
+    return lines
+
+
+def decode_join(payload):
+    status, datarate = struct.unpack_from('<bb', payload)
+    if status != 0:
+        return banner(' JOIN FAILED ')
+    return banner(' JOINED ') + ['DATA RATE   : DR_%d' % datarate]
+
+
+def decode_tx(payload):
+    status, msg_type, port, datarate, power, channel, ack, counter, size = \
+        struct.unpack_from('<BBBbbBBIB', payload)
+    data = payload[12:]
+    lines = banner(' UPLINK FRAME %8d ' % counter)
+    if status != 0:
+        lines.append('STATUS      : %s' % name(EVENT_STATUS, status))
+    lines += ['TX PORT     : %d' % port,
+              'TX DATA     : %s' % ('CONFIRMED' if msg_type else 'UNCONFIRMED')]
+    if size:
+        lines.append('              ' + hexdump(data, size))
+    lines += ['DATA RATE   : DR_%d' % datarate,
+              'TX POWER    : %d' % power,
+              'CHANNEL     : %d' % channel]
+    if msg_type:
+        lines.append('ACK         : %s' % ('RECEIVED' if ack else 'NOT RECEIVED'))
+    return lines
+
+
+def decode_rx(payload):
+    status, port, slot, datarate, rssi, snr, counter, size = \
+        struct.unpack_from('<BBbbhbIB', payload)
+    data = payload[12:]
+    lines = banner(' DOWNLINK FRAME %8d ' % counter)
+    if status != 0:
+        lines.append('STATUS      : %s' % name(EVENT_STATUS, status))
+    lines += ['RX WINDOW   : %s' % name(RX_SLOTS, slot),
+              'RX PORT     : %d' % port]
+    if size:
+        lines.append('RX DATA     : ' + hexdump(data, size))
+    lines += ['DATA RATE   : DR_%d' % datarate,
+              'RX RSSI     : %d' % rssi,
+              'RX SNR      : %d' % snr]
+    return lines
+
+
+def decode_class(payload):
+    return banner(' Switch to Class %s done. ' % name(CLASSES, payload[0]))
+
+
+def decode_beacon(payload):
+    state, frequency, datarate, rssi, snr, seconds = struct.unpack_from('<BIBhbI', payload)
+    lines = banner(' BEACON %s ' % name(BEACON_STATES, state))
+    if state == 2:
+        lines += ['GPS TIME    : %d' % seconds,
+                  'FREQ        : %d' % frequency,
+                  'DATA RATE   : DR_%d' % datarate,
+                  'RSSI        : %d' % rssi,
+                  'SNR         : %d' % snr]
+    return lines
+
+
+def decode_time(payload):
+    synchronized, correction = struct.unpack_from('<Bi', payload)
+    return ['Clock Synchronized: %d' % synchronized, 'Correction: %d' % correction]
+
+
+def decode_frag_progress(payload):
+    counter, blocks, size, lost = struct.unpack_from('<HHBH', payload)
+    return banner(' FRAG_DECODER ') + [
+        'RECEIVED    : %5d / %5d Fragments' % (counter, blocks),
+        '              %5d / %5d Bytes' % (counter * size, blocks * size),
+        'LOST        :       %7d Fragments' % lost]
+
+
+def decode_frag_done(payload):
+    status, size, crc = struct.unpack_from('<iII', payload)
+    return banner(' FRAG_DECODER FINISHED ') + [
+        'STATUS : %d' % status, 'SIZE   : %d' % size, 'CRC    : %08X' % crc]
+
+
+def decode_frag_write(payload):
+    offset, words = struct.unpack_from('<II', payload)
+    return ['Decoder Write: +0x%x, %d words' % (offset, words)]
+
+
+def decode_frag_erase(payload):
+    offset, pages = struct.unpack_from('<II', payload)
+    return ['Erasing %d pages at +0x%x' % (pages, offset)]
+
+
+def decode_lost(payload):
+    return ['# %d records lost, trace buffer full' % struct.unpack_from('<I', payload)]
+
+
+DECODERS = {
+    NVM: decode_nvm,
+    NETWORK: decode_network,
+    MCPS_REQUEST: lambda payload: decode_request('MCPS', MCPS_TYPES, payload),
+    MLME_REQUEST: lambda payload: decode_request('MLME', MLME_TYPES, payload),
+    JOIN: decode_join,
+    TX: decode_tx,
+    RX: decode_rx,
+    CLASS: decode_class,
+    BEACON: decode_beacon,
+    TIME: decode_time,
+    FRAG_PROGRESS: decode_frag_progress,
+    FRAG_DONE: decode_frag_done,
+    FRAG_WRITE: decode_frag_write,
+    FRAG_ERASE: decode_frag_erase,
+    LOST: decode_lost,
+}
+
+
+class Decoder:
+    def __init__(self, tick_hz, output):
+        self.tick_hz = tick_hz
+        self.output = output
+        self.sequence = None
+        self.counters = {'records': 0, 'lost': 0, 'malformed': 0}
+
+    def timestamp(self, ticks):
+        ms = ticks * 1000 // self.tick_hz
+        seconds, ms = divmod(ms, 1000)
+        minutes, seconds = divmod(seconds, 60)
+        hours, minutes = divmod(minutes, 60)
+        return '%02d:%02d:%02d.%03d' % (hours, minutes, seconds, ms)
+
+    def record(self, record):
+        """Decode one complete record, header included."""
+        if len(record) < HEADER.size:
+            self.counters['malformed'] += 1
+            return
+        kind, length, sequence, ticks = HEADER.unpack_from(record)
+        payload = record[HEADER.size:]
+        if len(payload) != length or kind not in DECODERS:
+            self.counters['malformed'] += 1
+            return
+
+        # Dropped records still take a sequence number, a gap without a
+        # LOST record means lines were lost between the device and here.
+        if self.sequence is not None and kind != LOST:
+            missing = (sequence - self.sequence - 1) & 0xFFFF
+            if missing:
+                self.counters['lost'] += missing
+        self.sequence = sequence
+        self.counters['records'] += 1
+
+        try:
+            lines = DECODERS[kind](payload)
+        except struct.error:
+            self.counters['malformed'] += 1
+            return
+        stamp = '[%s]' % self.timestamp(ticks)
+        for line in lines:
+            print('%s %s' % (stamp, line) if line else '', file=self.output)
+        self.output.flush()
+
+    def line(self, text):
+        """Decode a console line, other output is passed through unchanged."""
+        index = text.find(LINE_PREFIX + ' ')
+        if index < 0:
+            return False
+        try:
+            self.record(bytes.fromhex(text[index + len(LINE_PREFIX) + 1:].strip()))
+        except ValueError:
+            self.counters['malformed'] += 1
+        return True
+
+    def stream(self, data):
+        """Decode raw records read from an RTT channel, returns the unused tail."""
+        while len(data) >= HEADER.size:
+            size = HEADER.size + data[1]
+            if len(data) < size:
+                break
+            self.record(data[:size])
+            data = data[size:]
+        return data
+
+    def report(self):
+        return 'records %(records)d  lost %(lost)d  malformed %(malformed)d' % self.counters
+
+# ******************************************************************************
+#
+# Main function
+#
+# ******************************************************************************
+def main():
+    parser = argparse.ArgumentParser(description='Decode the LoRaWAN binary trace')
+    parser.add_argument('input', nargs='?', help='console log or raw records (default stdin)')
+    parser.add_argument('--binary', action='store_true', help='input is a raw RTT channel dump')
+    parser.add_argument('--serial', help='read the console from this serial port')
+    parser.add_argument('--baud', type=int, default=115200, help='serial port baud rate')
+    parser.add_argument('--tick-hz', type=int, default=1000, help='RTOS tick rate')
+    parser.add_argument('--quiet', action='store_true', help='drop the non trace console output')
+    args = parser.parse_args()
+
+    decoder = Decoder(args.tick_hz, sys.stdout)
+
+    if args.binary:
+        source = open(args.input, 'rb') if args.input else sys.stdin.buffer
+        pending = b''
+        while True:
+            chunk = source.read(4096)
+            if not chunk:
+                break
+            pending = decoder.stream(pending + chunk)
+    else:
+        if args.serial:
+            import serial
+            port = serial.Serial(args.serial, args.baud)
+            source = (raw.decode('ascii', 'replace') for raw in iter(port.readline, b''))
+        else:
+            source = open(args.input, 'r', errors='replace') if args.input else sys.stdin
+        for text in source:
+            if not decoder.line(text) and not args.quiet:
+                sys.stdout.write(text)
+
+    print(decoder.report(), file=sys.stderr)
+
+
+if __name__ == '__main__':
+    main()
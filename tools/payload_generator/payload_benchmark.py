@@ -0,0 +1,243 @@
+#!/usr/bin/env python3
+# ******************************************************************************
+#
+# Host benchmark of the generated payload codecs
+#
+# Generates the codecs of a message description, builds them with the host
+# compiler together with a harness that packs random messages in a loop,
+# and compares each message with the naive alternative of sending its C
+# structure as is: the time to encode and decode, the payload size and the
+# airtime per message.  The packed payloads are decoded again with the
+# generated Python decoder to check that every field round trips within
+# its resolution.
+#
+#   python3 tools/payload_generator/payload_benchmark.py tools/payload_generator/example.src
+#
+# The timings are those of the host, only their ratio to the copy of the
+# structure carries over to the Cortex-M4.
+#
+# ******************************************************************************
+
+import argparse
+import importlib.util
+import os.path
+import random
+import subprocess
+import sys
+import tempfile
+
+sys.path.insert(0, os.path.dirname(os.path.abspath(__file__)))
+sys.path.insert(0, os.path.join(os.path.dirname(os.path.abspath(__file__)), '..'))
+import payload_codec
+from lorawan_compress import FRAME_OVERHEAD, time_on_air
+
+MESSAGES = 256
+
+harness_template = '''
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "{codec}.h"
+
+static volatile uint32_t sink;
+
+static double now(void)
+{{
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return t.tv_sec * 1e9 + t.tv_nsec;
+}}
+{messages}
+int main(int argc, char **argv)
+{{
+    uint32_t iterations = (uint32_t)strtoul(argv[1], NULL, 0);
+{calls}
+    return 0;
+}}
+'''
+
+message_template = '''
+static const {name}_t {name}_messages[{count}] = {{
+{values}
+}};
+
+static void {name}_benchmark(uint32_t iterations)
+{{
+    uint8_t buffer[{upper}_SIZE > sizeof({name}_t) ? {upper}_SIZE : sizeof({name}_t)];
+    {name}_t decoded;
+    uint32_t sum = 0;
+    double start;
+
+    for (uint32_t i = 0; i < {count}; i++)
+    {{
+        {name}_encode(&{name}_messages[i], buffer, sizeof(buffer));
+        printf("payload {name} ");
+        for (uint32_t j = 0; j < {upper}_SIZE; j++)
+        {{
+            printf("%02x", buffer[j]);
+        }}
+        printf("\\n");
+    }}
+
+    start = now();
+    for (uint32_t i = 0; i < iterations; i++)
+    {{
+        {name}_encode(&{name}_messages[i % {count}], buffer, sizeof(buffer));
+        sum += buffer[i % {upper}_SIZE];
+    }}
+    printf("encode {name} %.2f\\n", (now() - start) / iterations);
+
+    start = now();
+    for (uint32_t i = 0; i < iterations; i++)
+    {{
+        memcpy(buffer, &{name}_messages[i % {count}], sizeof({name}_t));
+        __asm__ volatile("" : : "r"(buffer) : "memory");
+        sum += buffer[i % sizeof({name}_t)];
+    }}
+    printf("copy {name} %.2f\\n", (now() - start) / iterations);
+
+    {name}_encode(&{name}_messages[0], buffer, sizeof(buffer));
+    start = now();
+    for (uint32_t i = 0; i < iterations; i++)
+    {{
+        buffer[0] = (uint8_t)i;
+        {name}_decode(&decoded, buffer, {upper}_SIZE);
+        __asm__ volatile("" : : "r"(&decoded) : "memory");
+    }}
+    printf("decode {name} %.2f\\n", (now() - start) / iterations);
+
+    printf("struct {name} %u\\n", (unsigned)sizeof({name}_t));
+    sink = sum;
+}}
+'''
+
+
+def random_value(field):
+    if field.type == 'bool':
+        return random.random() < 0.5
+    if field.type == 'float':
+        return round(random.uniform(field.min, field.max), 4)
+    if field.min is not None:
+        return random.randint(field.min, field.max)
+    if field.type == 'int':
+        return random.randint(-(1 << (field.bits - 1)), (1 << (field.bits - 1)) - 1)
+    return random.randint(0, (1 << field.bits) - 1)
+
+
+def c_value(field, value):
+    if field.type == 'bool':
+        return 'true' if value else 'false'
+    if field.type == 'float':
+        return repr(float(value)) + 'f'
+    return str(value)
+
+
+def random_messages(message):
+    messages = []
+    for _ in range(MESSAGES):
+        messages.append({field.name: [random_value(field) for _ in range(field.count)]
+                         for field in message.fields})
+    return messages
+
+
+def c_messages(message, messages):
+    rows = []
+    for values in messages:
+        members = []
+        for field in message.fields:
+            items = [c_value(field, v) for v in values[field.name]]
+            members.append('{%s}' % ', '.join(items) if field.count > 1 else items[0])
+        rows.append('    {%s},' % ', '.join(members))
+    return '\n'.join(rows)
+
+
+def check(message, messages, payloads, decoder):
+    errors = 0
+    for values, payload in zip(messages, payloads):
+        decoded = decoder.decode(message.port, bytes.fromhex(payload))
+        for field in message.fields:
+            got = decoded[field.name] if field.count > 1 else [decoded[field.name]]
+            tolerance = field.resolution / 2 + 1e-3 if field.type == 'float' else 0
+            if any(abs(a - b) > tolerance for a, b in zip(values[field.name], got)):
+                errors += 1
+    return errors
+
+# ******************************************************************************
+#
+# Main function
+#
+# ******************************************************************************
+def main():
+    parser = argparse.ArgumentParser(description='Benchmark the generated payload codecs')
+    parser.add_argument('input', help='message description')
+    parser.add_argument('--cc', default='cc', help='host C compiler')
+    parser.add_argument('--iterations', type=int, default=10000000, help='loops per measure')
+    parser.add_argument('--sf', type=lambda text: [int(x) for x in text.split(',')],
+                        default=[7, 10, 12], help='spreading factors to report')
+    parser.add_argument('--seed', type=int, default=1, help='random messages seed')
+    args = parser.parse_args()
+
+    random.seed(args.seed)
+    codec, messages = payload_codec.load(args.input)
+
+    with tempfile.TemporaryDirectory() as output:
+        source = os.path.basename(args.input)
+        payload_codec.write_c(codec, messages, source, output)
+        payload_codec.write_python(codec, messages, source, output)
+
+        values = {message.name: random_messages(message) for message in messages}
+        harness = harness_template.format(
+            codec=codec,
+            messages=''.join(message_template.format(
+                name=message.name, upper=message.name.upper(), count=MESSAGES,
+                values=c_messages(message, values[message.name])) for message in messages),
+            calls='\n'.join('    %s_benchmark(iterations);' % message.name
+                            for message in messages))
+        with open(os.path.join(output, 'benchmark.c'), 'w') as f:
+            f.write(harness)
+
+        binary = os.path.join(output, 'benchmark')
+        subprocess.run([args.cc, '-O2', '-Wall', '-I', output, '-o', binary,
+                        os.path.join(output, 'benchmark.c'),
+                        os.path.join(output, codec + '.c')], check=True)
+        result = subprocess.run([binary, str(args.iterations)], check=True,
+                                capture_output=True, text=True)
+
+        spec = importlib.util.spec_from_file_location(codec, os.path.join(output, codec + '.py'))
+        decoder = importlib.util.module_from_spec(spec)
+        spec.loader.exec_module(decoder)
+
+    measures = {}
+    payloads = {}
+    for line in result.stdout.splitlines():
+        kind, name, value = line.split()
+        if kind == 'payload':
+            payloads.setdefault(name, []).append(value)
+        else:
+            measures[(kind, name)] = float(value)
+
+    print('%-14s %6s %6s %9s %9s %9s %7s' % ('message', 'packed', 'struct', 'encode',
+                                             'copy', 'decode', 'errors'))
+    for message in messages:
+        name = message.name
+        errors = check(message, values[name], payloads[name], decoder)
+        print('%-14s %4d B %4d B %6.1f ns %6.1f ns %6.1f ns %7d'
+              % (name, message.size, measures[('struct', name)], measures[('encode', name)],
+                 measures[('copy', name)], measures[('decode', name)], errors))
+
+    print()
+    print('%-14s %-5s %12s %12s %12s' % ('airtime', 'SF', 'packed', 'struct', 'saved'))
+    for message in messages:
+        struct = int(measures[('struct', message.name)])
+        for sf in args.sf:
+            packed = time_on_air(sf, 0, FRAME_OVERHEAD + message.size)
+            naive = time_on_air(sf, 0, FRAME_OVERHEAD + struct)
+            print('%-14s SF%-3d %9d ms %9d ms %9d ms'
+                  % (message.name, sf, packed, naive, naive - packed))
+
+
+if __name__ == '__main__':
+    main()
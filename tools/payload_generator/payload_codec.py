@@ -0,0 +1,608 @@
+#!/usr/bin/env python3
+# ******************************************************************************
+#
+# Generator of bit-packed uplink payload codecs
+#
+# Reads a description of the application messages, in the same indented
+# format as the BSP pin files, and writes
+#
+#   <codec>.h, <codec>.c   encoders and decoders for the firmware
+#   <codec>.py             decoder for a Python backend such as a Lambda
+#   <codec>.js             decodeUplink payload formatter for TTS and ChirpStack
+#
+# Every field takes the bits its range and resolution need, packed least
+# significant bit first with no padding between fields, so a message of
+# three sensor readings and a flag fits in six bytes instead of the sixteen
+# of the C structure.  The offsets are known when the code is generated,
+# the C functions are straight line byte operations on the caller's buffer.
+#
+#   python3 tools/payload_generator/payload_codec.py messages.src build/codec
+#
+# Top level keywords:
+#
+#   codec     name of the generated files and prefix of the C identifiers
+#   message   one per uplink type
+#
+# 'message' keywords:
+#
+#   name      C identifier of the message
+#   port      application port the message is sent on
+#   desc      description, copied into the generated header
+#   field     one per value, in transmit order
+#
+# 'field' keywords:
+#
+#   name        C identifier of the field
+#   type        uint, int, float or bool
+#   bits        width of a uint or int field sent as is, two's complement
+#               for int
+#   min, max    range of the field, values outside are clamped.  A uint or
+#               int field with a range is sent as its offset from min
+#   resolution  step of a float field, which requires min and max
+#   count       repeat the field, the C member becomes an array
+#   unit, desc  documentation
+#
+# ******************************************************************************
+
+import argparse
+import os.path
+import sys
+
+sys.path.insert(0, os.path.join(os.path.dirname(os.path.abspath(__file__)), '..', 'bsp_generator'))
+import rsonlite
+
+# ******************************************************************************
+#
+# Templates
+#
+# ******************************************************************************
+header_template = '''
+// Generated by tools/payload_generator/payload_codec.py from {source}, do not edit.
+#ifndef {guard}
+#define {guard}
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {{
+#endif
+{messages}
+#ifdef __cplusplus
+}}
+#endif
+
+#endif
+'''.lstrip()
+
+header_message_template = '''
+/**
+ * @brief {desc}
+ *
+ * {bits} bits packed in {size} bytes on port {port}.
+ */
+#define {upper}_PORT ({port})
+#define {upper}_SIZE ({size})
+
+typedef struct
+{{
+{members}
+}} {name}_t;
+
+/**
+ * @brief Pack a message into a buffer of at least {upper}_SIZE bytes.
+ *
+ * @return {upper}_SIZE, or -1 if the buffer is too small.
+ */
+{encode_prototype};
+
+/**
+ * @brief Unpack a message.
+ *
+ * @return {upper}_SIZE, or -1 if the payload is shorter than that.
+ */
+{decode_prototype};
+'''
+
+source_template = '''
+// Generated by tools/payload_generator/payload_codec.py from {source}, do not edit.
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "{codec}.h"
+{functions}'''.lstrip()
+
+encode_template = '''
+{encode_prototype}
+{{
+    uint32_t ui32Raw;
+
+    if (ui32Size < {upper}_SIZE)
+    {{
+        return -1;
+    }}
+
+    memset(pui8Buffer, 0, {upper}_SIZE);
+{body}
+    return {upper}_SIZE;
+}}
+'''
+
+decode_template = '''
+{decode_prototype}
+{{
+    uint32_t ui32Raw;
+
+    if (ui32Size < {upper}_SIZE)
+    {{
+        return -1;
+    }}
+{body}
+    return {upper}_SIZE;
+}}
+'''
+
+python_template = '''
+# Generated by tools/payload_generator/payload_codec.py from {source}, do not edit.
+
+FIELDS = {{
+{ports}
+}}
+
+NAMES = {{
+{names}
+}}
+
+
+def _signed(value, bits):
+    return value - (1 << bits) if value >> (bits - 1) else value
+
+
+def decode(port, payload):
+    """Returns the fields of a message as a dict, None for an unknown port."""
+    if port not in FIELDS:
+        return None
+    fields, size = FIELDS[port]
+    if len(payload) < size:
+        raise ValueError('%s needs %d bytes, got %d' % (NAMES[port], size, len(payload)))
+    packed = int.from_bytes(bytes(payload[:size]), 'little')
+    message = {{}}
+    for name, kind, offset, bits, minimum, maximum, resolution, count in fields:
+        values = []
+        for i in range(count):
+            raw = (packed >> (offset + i * bits)) & ((1 << bits) - 1)
+            if kind == 'bool':
+                values.append(bool(raw))
+            elif kind == 'float':
+                values.append(round(minimum + raw * resolution, 9))
+            elif minimum is not None:
+                values.append(minimum + raw)
+            elif kind == 'int':
+                values.append(_signed(raw, bits))
+            else:
+                values.append(raw)
+        message[name] = values if count > 1 else values[0]
+    return message
+
+
+def encode(port, message):
+    """Packs a dict of fields, the counterpart of the firmware encoder."""
+    fields, size = FIELDS[port]
+    packed = 0
+    for name, kind, offset, bits, minimum, maximum, resolution, count in fields:
+        values = message[name] if count > 1 else [message[name]]
+        for i, value in enumerate(values):
+            if minimum is not None:
+                value = min(max(value, minimum), maximum)
+            if kind == 'bool':
+                raw = 1 if value else 0
+            elif kind == 'float':
+                raw = int((value - minimum) / resolution + 0.5)
+            elif minimum is not None:
+                raw = int(value) - minimum
+            else:
+                raw = int(value) & ((1 << bits) - 1)
+            packed |= raw << (offset + i * bits)
+    return packed.to_bytes(size, 'little')
+'''.lstrip()
+
+javascript_template = '''
+// Generated by tools/payload_generator/payload_codec.py from {source}, do not edit.
+var FIELDS = {{
+{ports}
+}};
+
+function unpack(bytes, offset, bits) {{
+  var value = 0;
+  for (var i = 0; i < bits; i++) {{
+    var bit = offset + i;
+    if ((bytes[bit >> 3] >> (bit & 7)) & 1) {{
+      value += Math.pow(2, i);
+    }}
+  }}
+  return value;
+}}
+
+function decodeUplink(input) {{
+  var message = FIELDS[input.fPort];
+  if (!message) {{
+    return {{ errors: ['unknown port ' + input.fPort] }};
+  }}
+  if (input.bytes.length < message.size) {{
+    return {{ errors: [message.name + ' needs ' + message.size + ' bytes'] }};
+  }}
+  var data = {{}};
+  message.fields.forEach(function (field) {{
+    var values = [];
+    for (var i = 0; i < field.count; i++) {{
+      var raw = unpack(input.bytes, field.offset + i * field.bits, field.bits);
+      if (field.type === 'bool') {{
+        values.push(raw !== 0);
+      }} else if (field.type === 'float') {{
+        values.push(Number((field.min + raw * field.resolution).toPrecision(9)));
+      }} else if (field.min !== null) {{
+        values.push(field.min + raw);
+      }} else if (field.type === 'int' && raw >= Math.pow(2, field.bits - 1)) {{
+        values.push(raw - Math.pow(2, field.bits));
+      }} else {{
+        values.push(raw);
+      }}
+    }}
+    data[field.name] = field.count > 1 ? values : values[0];
+  }});
+  return {{ data: data }};
+}}
+'''.lstrip()
+
+# ******************************************************************************
+#
+# Schema
+#
+# ******************************************************************************
+def to_dict(items):
+    '''
+    rsonlite returns a list of (key, value) pairs, repeated keys such as
+    'field' are collected into lists.
+    '''
+    D = dict()
+    for key, value in items:
+        key = key.lower()
+        if value and isinstance(value[0], tuple):
+            value = to_dict(value)
+        else:
+            value = value[0].strip() if value else ''
+        D.setdefault(key, []).append(value)
+    return D
+
+
+def get_val(D, name, default=None):
+    return D[name][0] if name in D else default
+
+
+def number(text):
+    return float(text) if any(c in text for c in '.eE') and not text.startswith('0x') \
+        else int(text, 0)
+
+
+class Field:
+    def __init__(self, D, message):
+        self.name = get_val(D, 'name')
+        self.type = get_val(D, 'type', 'uint').lower()
+        self.desc = get_val(D, 'desc', '')
+        self.unit = get_val(D, 'unit', '')
+        self.count = int(get_val(D, 'count', '1'))
+        self.min = number(get_val(D, 'min')) if 'min' in D else None
+        self.max = number(get_val(D, 'max')) if 'max' in D else None
+        self.resolution = number(get_val(D, 'resolution')) if 'resolution' in D else None
+        self.bits = int(get_val(D, 'bits')) if 'bits' in D else None
+
+        where = '%s.%s' % (message, self.name)
+        if self.type not in ('uint', 'int', 'float', 'bool'):
+            raise ValueError('%s: unknown type %s' % (where, self.type))
+
+        if self.type == 'bool':
+            self.bits = 1
+        elif self.type == 'float':
+            if self.min is None or self.max is None or not self.resolution:
+                raise ValueError('%s: a float needs min, max and resolution' % where)
+            self.steps = int(round((self.max - self.min) / self.resolution))
+            self.bits = max(self.steps.bit_length(), 1)
+        elif self.min is not None or self.max is not None:
+            if self.min is None or self.max is None or self.max <= self.min:
+                raise ValueError('%s: the range needs min below max' % where)
+            self.min, self.max = int(self.min), int(self.max)
+            self.bits = (self.max - self.min).bit_length()
+        elif self.bits is None:
+            raise ValueError('%s: needs bits or a range' % where)
+
+        if not 1 <= self.bits <= 32:
+            raise ValueError('%s: %d bits, a field takes 1 to 32' % (where, self.bits))
+
+    @property
+    def ctype(self):
+        if self.type == 'bool':
+            return 'bool'
+        if self.type == 'float':
+            return 'float'
+        if self.min is not None:
+            low, high = self.min, self.max
+        elif self.type == 'int':
+            low, high = -(1 << (self.bits - 1)), (1 << (self.bits - 1)) - 1
+        else:
+            low, high = 0, (1 << self.bits) - 1
+        for width in (8, 16, 32):
+            if low >= 0 and high < (1 << width):
+                return 'uint%d_t' % width
+            if low >= -(1 << (width - 1)) and high < (1 << (width - 1)):
+                return 'int%d_t' % width
+        return 'int64_t'
+
+
+class Message:
+    def __init__(self, D):
+        self.name = get_val(D, 'name')
+        self.port = int(get_val(D, 'port'), 0)
+        self.desc = get_val(D, 'desc', self.name)
+        if not 1 <= self.port <= 223:
+            raise ValueError('%s: port %d is not an application port' % (self.name, self.port))
+        self.fields = [Field(field, self.name) for field in D.get('field', [])]
+        if not self.fields:
+            raise ValueError('%s: no fields' % self.name)
+
+        offset = 0
+        for field in self.fields:
+            field.offset = offset
+            offset += field.bits * field.count
+        self.bits = offset
+        self.size = (offset + 7) // 8
+
+
+def load(filename):
+    with open(filename) as f:
+        D = to_dict(rsonlite.loads(f.read()))
+    codec = get_val(D, 'codec', os.path.splitext(os.path.basename(filename))[0])
+    messages = [Message(message) for message in D.get('message', [])]
+    ports = [message.port for message in messages]
+    if len(set(ports)) != len(ports):
+        raise ValueError('two messages share a port')
+    return codec, messages
+
+# ******************************************************************************
+#
+# C code
+#
+# ******************************************************************************
+def c_number(value):
+    return repr(float(value)) + 'f'
+
+
+def c_prototype(prefix, name, parameters):
+    '''
+    Function declaration, the parameters aligned one per line when they do not
+    fit in 100 columns.
+    '''
+    line = '%s%s(%s)' % (prefix, name, ', '.join(parameters))
+    if len(line) <= 100:
+        return line
+    indent = ',\n' + ' ' * (len(prefix) + len(name) + 1)
+    return '%s%s(%s)' % (prefix, name, indent.join(parameters))
+
+
+def c_offset(variable, minimum, suffix=''):
+    '''
+    variable - minimum, without the subtraction of zero or of a negative number.
+    '''
+    if minimum == 0:
+        return variable
+    if minimum < 0:
+        return '(%s + %s%s)' % (variable, repr(-minimum), suffix)
+    return '(%s - %s%s)' % (variable, repr(minimum), suffix)
+
+
+def byte_ops(offset, bits):
+    '''
+    (byte, shift) pairs covering bits at offset, a positive shift moves the
+    value up into the byte and a negative one down.
+    '''
+    ops = []
+    position = 0
+    while position < bits:
+        bit = offset + position
+        ops.append((bit >> 3, (bit & 7) - position))
+        position += 8 - (bit & 7)
+    return ops
+
+
+def c_encode_field(field, index):
+    member = 'psMessage->%s%s' % (field.name, '[%d]' % index if field.count > 1 else '')
+    offset = field.offset + index * field.bits
+    mask = (1 << field.bits) - 1
+    lines = []
+
+    if field.type == 'bool':
+        lines.append('ui32Raw = %s ? 1 : 0;' % member)
+    elif field.type == 'float':
+        minimum, maximum = float(field.min), float(field.max)
+        lines += ['{',
+                  '    float fValue = %s;' % member,
+                  '    fValue = (fValue < %s) ? %s : fValue;' % ((c_number(minimum),) * 2),
+                  '    fValue = (fValue > %s) ? %s : fValue;' % ((c_number(maximum),) * 2),
+                  '    ui32Raw = (uint32_t)(%s * %s + 0.5f);'
+                  % (c_offset('fValue', minimum, 'f'), c_number(1.0 / field.resolution)),
+                  '}']
+    elif field.min is not None:
+        ctype, name = ('int64_t', 'i64Value') if field.ctype in ('uint32_t', 'int64_t') \
+            else ('int32_t', 'i32Value')
+        lines += ['{',
+                  '    %s %s = %s;' % (ctype, name, member),
+                  '    %s = (%s < %d) ? %d : %s;' % (name, name, field.min, field.min, name),
+                  '    %s = (%s > %d) ? %d : %s;' % (name, name, field.max, field.max, name),
+                  '    ui32Raw = (uint32_t)%s;' % c_offset(name, field.min),
+                  '}']
+    else:
+        lines.append('ui32Raw = (uint32_t)%s & 0x%XU;' % (member, mask))
+
+    for byte, shift in byte_ops(offset, field.bits):
+        if shift > 0:
+            lines.append('pui8Buffer[%d] |= (uint8_t)(ui32Raw << %d);' % (byte, shift))
+        elif shift < 0:
+            lines.append('pui8Buffer[%d] |= (uint8_t)(ui32Raw >> %d);' % (byte, -shift))
+        else:
+            lines.append('pui8Buffer[%d] |= (uint8_t)ui32Raw;' % byte)
+    return lines
+
+
+def c_decode_field(field, index):
+    member = 'psMessage->%s%s' % (field.name, '[%d]' % index if field.count > 1 else '')
+    offset = field.offset + index * field.bits
+    mask = (1 << field.bits) - 1
+    lines = []
+
+    for i, (byte, shift) in enumerate(byte_ops(offset, field.bits)):
+        operator = '|=' if i else '='
+        if shift > 0:
+            lines.append('ui32Raw %s (uint32_t)pui8Buffer[%d] >> %d;' % (operator, byte, shift))
+        elif shift < 0:
+            lines.append('ui32Raw %s (uint32_t)pui8Buffer[%d] << %d;' % (operator, byte, -shift))
+        else:
+            lines.append('ui32Raw %s (uint32_t)pui8Buffer[%d];' % (operator, byte))
+    if mask != 0xFFFFFFFF:
+        lines.append('ui32Raw &= 0x%XU;' % mask)
+
+    if field.type == 'bool':
+        lines.append('%s = ui32Raw != 0;' % member)
+    elif field.type == 'float':
+        lines.append('%s = %s + (float)ui32Raw * %s;'
+                     % (member, c_number(field.min), c_number(field.resolution)))
+    elif field.min is not None:
+        if field.min == 0:
+            lines.append('%s = (%s)ui32Raw;' % (member, field.ctype))
+        else:
+            wide = 'int64_t' if field.ctype in ('uint32_t', 'int64_t') else 'int32_t'
+            lines.append('%s = (%s)((%s)ui32Raw + %d);' % (member, field.ctype, wide, field.min))
+    elif field.type == 'int':
+        sign = 1 << (field.bits - 1)
+        value = '(int32_t)((ui32Raw ^ 0x%XU) - 0x%XU)' % (sign, sign)
+        if field.ctype != 'int32_t':
+            value = '(%s)%s' % (field.ctype, value)
+        lines.append('%s = %s;' % (member, value))
+    else:
+        lines.append('%s = (%s)ui32Raw;' % (member, field.ctype))
+    return lines
+
+
+def c_body(message, generate):
+    lines = []
+    for field in message.fields:
+        for index in range(field.count):
+            lines.append('')
+            lines += generate(field, index)
+    return '\n'.join('    ' + line if line else '' for line in lines)
+
+
+def c_member(field):
+    comment = ', '.join(x for x in (field.unit, field.desc) if x)
+    member = '    %s %s%s;' % (field.ctype, field.name,
+                               '[%d]' % field.count if field.count > 1 else '')
+    return member + (' ///< ' + comment if comment else '')
+
+
+def write_c(codec, messages, source, output):
+    guard = '_%s_H_' % codec.upper()
+    header = ''
+    source_functions = ''
+    for message in messages:
+        names = dict(name=message.name, upper=message.name.upper(), port=message.port,
+                     size=message.size, bits=message.bits, desc=message.desc)
+        encode = ['const %s_t *psMessage' % message.name, 'uint8_t *pui8Buffer',
+                  'uint32_t ui32Size']
+        decode = ['%s_t *psMessage' % message.name, 'const uint8_t *pui8Buffer',
+                  'uint32_t ui32Size']
+        header += header_message_template.format(
+            members='\n'.join(c_member(field) for field in message.fields),
+            encode_prototype=c_prototype('extern int32_t ', message.name + '_encode', encode),
+            decode_prototype=c_prototype('extern int32_t ', message.name + '_decode', decode),
+            **names)
+        source_functions += encode_template.format(
+            body=c_body(message, c_encode_field),
+            encode_prototype=c_prototype('int32_t ', message.name + '_encode', encode), **names)
+        source_functions += decode_template.format(
+            body=c_body(message, c_decode_field),
+            decode_prototype=c_prototype('int32_t ', message.name + '_decode', decode), **names)
+
+    with open(os.path.join(output, codec + '.h'), 'w') as f:
+        f.write(header_template.format(source=source, guard=guard, messages=header))
+    with open(os.path.join(output, codec + '.c'), 'w') as f:
+        f.write(source_template.format(source=source, codec=codec, functions=source_functions))
+
+# ******************************************************************************
+#
+# Backend decoders
+#
+# ******************************************************************************
+def write_python(codec, messages, source, output):
+    ports = []
+    for message in messages:
+        fields = ',\n'.join(
+            '        (%r, %r, %d, %d, %r, %r, %r, %d)'
+            % (field.name, field.type, field.offset, field.bits, field.min, field.max,
+               field.resolution, field.count) for field in message.fields)
+        ports.append('    %d: ([\n%s,\n    ], %d),' % (message.port, fields, message.size))
+    names = '\n'.join('    %d: %r,' % (message.port, message.name) for message in messages)
+
+    with open(os.path.join(output, codec + '.py'), 'w') as f:
+        f.write(python_template.format(source=source, ports='\n'.join(ports), names=names))
+
+
+def write_javascript(codec, messages, source, output):
+    def js(value):
+        return 'null' if value is None else repr(value)
+
+    ports = []
+    for message in messages:
+        fields = ',\n'.join(
+            "      { name: '%s', type: '%s', offset: %d, bits: %d, min: %s, resolution: %s, "
+            "count: %d }" % (field.name, field.type, field.offset, field.bits, js(field.min),
+                             js(field.resolution), field.count) for field in message.fields)
+        ports.append("  %d: {\n    name: '%s',\n    size: %d,\n    fields: [\n%s,\n    ],\n  },"
+                     % (message.port, message.name, message.size, fields))
+
+    with open(os.path.join(output, codec + '.js'), 'w') as f:
+        f.write(javascript_template.format(source=source, ports='\n'.join(ports)))
+
+# ******************************************************************************
+#
+# Main function
+#
+# ******************************************************************************
+def main():
+    parser = argparse.ArgumentParser(description='Generate bit-packed payload codecs')
+    parser.add_argument('input', help='message description')
+    parser.add_argument('output', nargs='?', default='.', help='output folder')
+    parser.add_argument('--summary', action='store_true', help='print the message layouts')
+    args = parser.parse_args()
+
+    try:
+        codec, messages = load(args.input)
+    except (ValueError, KeyError, TypeError) as error:
+        sys.exit('%s: %s' % (args.input, error))
+
+    source = os.path.basename(args.input)
+    os.makedirs(args.output, exist_ok=True)
+    write_c(codec, messages, source, args.output)
+    write_python(codec, messages, source, args.output)
+    write_javascript(codec, messages, source, args.output)
+
+    if args.summary:
+        for message in messages:
+            print('%s port %d, %d bits in %d bytes'
+                  % (message.name, message.port, message.bits, message.size))
+            for field in message.fields:
+                print('  %-16s %-6s bit %3d  %2d bits%s'
+                      % (field.name, field.type, field.offset, field.bits,
+                         ' x %d' % field.count if field.count > 1 else ''))
+
+
+if __name__ == '__main__':
+    main()